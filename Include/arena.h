@@ -0,0 +1,58 @@
+// Header file for the chunked arena allocator in the C-TurtleGraphics project.
+//
+// This file declares an append-only array built from fixed-size chunks. Chunks are allocated one at a time
+// as the array grows and never move once allocated, so growing the array never copies existing elements and
+// pointers into a chunk stay valid. Individual chunks can also be written to a spill file and freed, or
+// discarded entirely, which lets the owner bound the memory held by very large arrays.
+//
+// Key structures and functions:
+//    - Arena: The chunked array, with a table of chunk pointers and the state of each chunk.
+//    - arena_init / arena_free: Set up an empty arena for a given element size and release it.
+//    - arena_push: Appends one element and returns a pointer to it.
+//    - arena_at: Returns a pointer to an element, reloading its chunk from the spill file if needed.
+//    - arena_span: Returns a pointer to an element and the number of elements that follow it in its chunk.
+//    - arena_spill_chunk / arena_discard_chunk: Move a chunk out of memory.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Enum representing where the elements of a chunk live
+typedef enum {
+    CHUNK_RESIDENT = 0,       // The chunk is in memory
+    CHUNK_SPILLED = 1,        // The chunk was written to the spill file and freed
+    CHUNK_DISCARDED = 2       // The chunk was freed and its elements are gone
+} ChunkState;
+
+// Struct representing a chunked, append-only array
+typedef struct {
+    size_t elementSize;       // Size of one element in bytes
+    int chunkShift;           // log2 of the number of elements per chunk
+    int count;                // Number of elements in the arena
+    int chunkCount;           // Number of chunks in the chunk table
+    int chunkCapacity;        // Capacity of the chunk table
+    void** chunks;            // Chunk pointers, NULL for chunks that are not resident
+    ChunkState* states;       // State of each chunk
+    long* spillOffsets;       // Offset of each spilled chunk in the spill file
+    FILE* spillFile;          // Temporary file holding spilled chunks, opened on first spill
+    void* cache;              // Buffer holding the most recently reloaded spilled chunk
+    int cachedChunk;          // Index of the chunk in `cache`, or -1
+    int residentChunks;       // Number of chunks currently in memory
+} Arena;
+
+// Function prototypes
+void arena_init(Arena* arena, size_t elementSize, int chunkShift);
+void arena_free(Arena* arena);
+void* arena_push(Arena* arena);
+void* arena_at(Arena* arena, int index);
+int arena_span(Arena* arena, int index, void** element);
+void arena_truncate(Arena* arena, int count);
+int arena_chunk_size(const Arena* arena);
+size_t arena_resident_bytes(const Arena* arena);
+bool arena_spill_chunk(Arena* arena, int chunk);
+void arena_discard_chunk(Arena* arena, int chunk);
+
+#endif // ARENA_H
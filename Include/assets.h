@@ -0,0 +1,42 @@
+// Header file for the asset pipeline in the C-TurtleGraphics project.
+//
+// This file declares the background loading of the window's font and sprite images. A worker thread
+// decodes them while the window opens, or reads them back already converted from the asset cache, and
+// the render thread uploads them to OpenGL once they are ready.
+//
+// Key structures and functions:
+//    - AssetImage: A decoded image, RGBA with rows packed tightly.
+//    - assets_start: Starts decoding the assets on a worker thread.
+//    - assets_state: Tells whether the assets are still loading, ready or failed, without blocking.
+//    - assets_font / assets_sprites: The decoded assets, once ready.
+//    - assets_stop: Waits for the worker and frees the decoded assets.
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "text.h"
+
+// Progress of the worker thread
+typedef enum {
+    ASSETS_LOADING,               // Still decoding
+    ASSETS_READY,                 // Every asset is decoded
+    ASSETS_FAILED                 // An asset could not be loaded; the error was reported
+} AssetState;
+
+// Struct representing a decoded image
+typedef struct {
+    int w, h;                     // Size in pixels
+    Uint8* pixels;                // RGBA pixels, rows packed tightly
+} AssetImage;
+
+// Function prototypes
+bool assets_start(const char* cacheDir);
+AssetState assets_state(void);
+const FontAtlas* assets_font(void);
+const AssetImage* assets_sprites(int* count);
+void assets_stop(void);
+
+#endif // ASSETS_H
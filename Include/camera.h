@@ -0,0 +1,37 @@
+// Header file for the camera in the C-TurtleGraphics project.
+//
+// This file declares the camera that maps the unbounded drawing onto the window. The camera is a center
+// point in drawing coordinates plus a zoom factor, where a zoom of 1 shows one drawing unit per pixel. All
+// OpenGL projections of the drawing are derived from it, so panning and zooming only change two numbers.
+//
+// Key functions:
+//    - camera_init: Centers the camera on the window at zoom 1, which matches the original fixed view.
+//    - camera_apply: Loads the projection matrix for the current view.
+//    - camera_view: Reports the rectangle of the drawing visible in a window of a given size.
+//    - camera_pan / camera_zoom_at: Move the view in response to user input.
+//    - camera_follow: Pans just enough to keep a point, normally the turtle, inside the view.
+//    - camera_to_world: Converts a window position to drawing coordinates.
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <stdbool.h>
+
+// Struct representing a visible rectangle of the drawing
+typedef struct {
+    float minX, minY;         // Top-left corner in drawing coordinates
+    float maxX, maxY;         // Bottom-right corner in drawing coordinates
+} CameraView;
+
+// Function prototypes
+void camera_init(int windowWidth, int windowHeight);
+void camera_apply(int windowWidth, int windowHeight);
+CameraView camera_view(int windowWidth, int windowHeight);
+float camera_zoom(void);
+bool camera_view_equal(CameraView a, CameraView b);
+void camera_pan(float dx, float dy, int windowWidth, int windowHeight);
+void camera_zoom_at(float factor, int x, int y, int windowWidth, int windowHeight);
+void camera_follow(float x, float y, float margin, int windowWidth, int windowHeight);
+void camera_to_world(int x, int y, int windowWidth, int windowHeight, float* worldX, float* worldY);
+
+#endif // CAMERA_H
@@ -0,0 +1,44 @@
+// Header file for the persistent drawing canvas in the C-TurtleGraphics project.
+//
+// This file declares the functions that manage an offscreen canvas: a window-sized texture attached to a
+// framebuffer object into which committed lines are rasterized once, as they are added. Each frame the
+// renderer only blits the canvas instead of redrawing every line, so the frame cost no longer depends on
+// the number of lines in the drawing.
+//
+// The tiled canvas (see tiles.h) can stand in for it behind the same functions.
+//
+// Key functions:
+//    - canvas_configure: Chooses the tiled canvas instead of the window-sized one.
+//    - canvas_init: Creates the canvas for the given window size, if framebuffer objects are available.
+//    - canvas_active: Reports whether lines are being rasterized into the canvas.
+//    - canvas_resize: Recreates the canvas for a new window size and schedules a replay of all lines.
+//    - canvas_rewind: Schedules a replay of the lines starting from the given index.
+//    - canvas_truncate: Forgets lines the store freed after an undo, going back to an older checkpoint.
+//    - canvas_undo_floor: Reports how far undo can shorten the drawing without losing flattened lines.
+//    - canvas_line_count: Reports how many lines the canvas already holds.
+//    - canvas_update: Follows the camera and rasterizes the lines not yet on the canvas.
+//    - canvas_draw: Draws the canvas texture over the part of the drawing it shows.
+//    - canvas_pending: Reports whether lines in view are left to rasterize on a later frame.
+//    - canvas_shutdown: Releases the canvas texture and framebuffer object.
+
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Function prototypes
+void canvas_configure(bool tiled, size_t budgetBytes);
+bool canvas_init(int windowWidth, int windowHeight);
+bool canvas_active(void);
+void canvas_resize(int windowWidth, int windowHeight);
+void canvas_rewind(int firstLine);
+void canvas_truncate(int lineCount);
+int canvas_undo_floor(void);
+int canvas_line_count(void);
+void canvas_update(int lineCount);
+void canvas_draw(void);
+bool canvas_pending(void);
+void canvas_shutdown(void);
+
+#endif // CANVAS_H
@@ -0,0 +1,63 @@
+// Header file for the turtle command language in the C-TurtleGraphics project.
+//
+// This file declares a turtle that is driven by Logo-style commands instead of the keyboard, and the
+// compiler and interpreter that run programs written in those commands. A program is compiled once to
+// bytecode and can then be run any number of times. Every line the turtle draws is handed to a callback, so
+// the same program can feed the software rasterizer, the line store, or anything else that consumes lines.
+//
+// Key structures and functions:
+//    - Turtle: Position, heading, pen state and color of a command-driven turtle.
+//    - TurtleSwarm: The other turtles of a program that tells several.
+//    - LineSink: Callback receiving each line drawn by the turtle.
+//    - CommandProgram: A compiled program.
+//    - turtle_reset: Places a turtle at a home position, facing east with the pen down in black.
+//    - commands_compile / commands_load: Compile a program from a string or from a stream.
+//    - commands_decode: Build a program from commands in their compact binary form, one opcode byte each.
+//    - commands_run / commands_run_swarm: Run a compiled program with one turtle or with a swarm.
+//    - swarm_free: Releases the turtles of a swarm.
+//    - commands_free: Releases a compiled program.
+//    - run_command_stream: Compiles and runs a stream in one call.
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "linestore.h"
+
+// Struct representing a command-driven turtle
+typedef struct {
+    float x, y;               // Position in drawing coordinates
+    float angle;              // Heading in degrees, counterclockwise from east
+    bool pen;                 // Whether moving draws a line
+    GLfloat r, g, b;          // Pen color
+    float homeX, homeY;       // Position restored by the home command
+} Turtle;
+
+// Turtles of a program besides turtle 0, which tell creates as they are first told
+typedef struct {
+    Turtle* turtles;          // Turtle i + 1 at index i
+    int count;                // Number of turtles
+    int capacity;             // Number of turtles allocated
+} TurtleSwarm;
+
+// Callback receiving each line drawn by a turtle
+typedef void (*LineSink)(const Line* line, void* context);
+
+// Compiled program, opaque outside of commands.c
+typedef struct CommandProgram CommandProgram;
+
+// Function prototypes
+void turtle_reset(Turtle* turtle, float homeX, float homeY);
+CommandProgram* commands_compile(const char* source, const char* name);
+CommandProgram* commands_load(FILE* input, const char* name);
+CommandProgram* commands_decode(const unsigned char* data, size_t length, const char* name);
+bool commands_run(const CommandProgram* program, Turtle* turtle, LineSink sink, void* context);
+bool commands_run_swarm(const CommandProgram* program, Turtle* turtle, TurtleSwarm* swarm, LineSink sink,
+                        void* context, SDL_atomic_t* cancel);
+void swarm_free(TurtleSwarm* swarm);
+void commands_free(CommandProgram* program);
+bool run_command_stream(FILE* input, const char* name, Turtle* turtle, LineSink sink, void* context);
+
+#endif // COMMANDS_H
@@ -0,0 +1,37 @@
+// Header file for damage tracking in the C-TurtleGraphics project.
+//
+// This file declares the bookkeeping behind partial redraws: the rectangles of the window that changed
+// since the previous frame, and the rectangles a frame must redraw given how old the back buffer is.
+//
+// Key structures and functions:
+//    - DamageRect: A rectangle of the window in pixels.
+//    - damage_configure / damage_enabled: Turn partial redraws on or off.
+//    - damage_all: Marks the whole window as changed.
+//    - damage_window_rect / damage_drawing_rect: Mark a rectangle as changed.
+//    - damage_frame: Ends a frame's damage and returns the rectangles to redraw.
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <stdbool.h>
+
+#include "camera.h"
+
+#define DAMAGE_MAX_RECTS 8        // Rectangles kept per frame before they are merged into their bounds
+
+// Struct representing a rectangle of the window in pixels, with y growing downward and exclusive maxima
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} DamageRect;
+
+// Function prototypes
+void damage_configure(bool enable);
+bool damage_enabled(void);
+void damage_all(void);
+void damage_window_rect(float minX, float minY, float maxX, float maxY);
+void damage_drawing_rect(CameraView view, int width, int height, float minX, float minY, float maxX, float maxY,
+                         float padding);
+int damage_frame(int width, int height, int bufferAge, const DamageRect** rects);
+
+#endif // DAMAGE_H
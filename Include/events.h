@@ -7,9 +7,14 @@
 // Includes:
 //    - Standard boolean type from <stdbool.h>
 //
-// Main function:
+// Main functions:
 //    - handle_events: Processes SDL events, including key presses and window events,
-//      and updates the game state based on user input.
+//      and records the input state.
+//    - update_simulation: Advances the turtle by one fixed simulation step using that input state.
+//    - simulation_active: Reports whether the simulation may change anything, so the main loop can sleep.
+//    - run_script: Drives the turtle with a command file instead of the keyboard.
+//    - poll_script / stop_script: Send the lines of a running script to the render thread, or abandon it.
+//    - poll_remote: Runs the command batches sent by clients of the command server.
 
 #ifndef EVENTS_H
 #define EVENTS_H
@@ -17,6 +22,12 @@
 #include <stdbool.h>
 
 // Function prototypes
-bool handle_events(float deltaTime, int* windowWidth, int* windowHeight);
+bool handle_events(int* windowWidth, int* windowHeight);
+void update_simulation(float deltaTime);
+bool simulation_active(void);
+void run_script(const char* path);
+void poll_script(void);
+void poll_remote(void);
+void stop_script(void);
 
 #endif // EVENTS_H
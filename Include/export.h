@@ -0,0 +1,34 @@
+// Header file for vector export in the C-TurtleGraphics project.
+//
+// This file declares the exporter that writes drawings as SVG or PDF files for printing. Lines are
+// streamed to the exporter, which merges connected lines of one color into polylines and formats them on
+// worker threads, holding only a fixed number of lines at a time however large the drawing is.
+//
+// Key structures and functions:
+//    - ExportFormat: Selects SVG or PDF output.
+//    - ExportWriter: A vector file being written.
+//    - export_open / export_line / export_close: Stream lines to a vector file.
+//    - export_line_store: Exports every line of the line store.
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+#include "linestore.h"
+
+// Enum representing the vector file formats
+typedef enum {
+    EXPORT_SVG = 0,
+    EXPORT_PDF = 1
+} ExportFormat;
+
+// Vector file being written, opaque outside of export.c
+typedef struct ExportWriter ExportWriter;
+
+// Function prototypes
+ExportWriter* export_open(const char* path, ExportFormat format, float minX, float minY, float maxX, float maxY);
+void export_line(ExportWriter* writer, const Line* line);
+bool export_close(ExportWriter* writer);
+bool export_line_store(const char* path, ExportFormat format);
+
+#endif // EXPORT_H
@@ -0,0 +1,35 @@
+// Header file for background geometry generation in the C-TurtleGraphics project.
+//
+// This file declares generation jobs, which run a command program or draw an L-system on worker threads
+// while the caller keeps going. Workers only write to buffers of their own; the lines are handed over in
+// drawing order when the thread that owns the line store polls the job, so nothing shared is touched from
+// a worker.
+//
+// Key structures and functions:
+//    - GenerationJob: A drawing being generated.
+//    - generate_set_threads / generate_thread_count: Select and report how many workers draw an L-system
+//      that can be split.
+//    - generate_start: Reads a command file, an L-system definition or a saved session and starts generating it.
+//    - generate_poll / generate_wait: Deliver the lines generated so far, without blocking or until the end.
+//    - generate_end / generate_end_swarm: Stop a job and report where its turtle, or all its turtles, ended.
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "commands.h"
+
+// Drawing being generated, opaque outside of generate.c
+typedef struct GenerationJob GenerationJob;
+
+// Function prototypes
+void generate_set_threads(int threads);
+int generate_thread_count(void);
+GenerationJob* generate_start(FILE* input, const char* name, const Turtle* turtle);
+bool generate_poll(GenerationJob* job, LineSink sink, void* context, double seconds);
+void generate_wait(GenerationJob* job, LineSink sink, void* context);
+bool generate_end(GenerationJob* job, Turtle* turtle);
+bool generate_end_swarm(GenerationJob* job, Turtle* turtle, TurtleSwarm* swarm);
+
+#endif // GENERATE_H
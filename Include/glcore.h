@@ -0,0 +1,40 @@
+// Header file for the core profile rendering backend in the C-TurtleGraphics project.
+//
+// This file declares the small shader pipeline used instead of the fixed-function one on OpenGL 3.3 core
+// profile contexts: anti-aliased lines of any width, drawn as instanced quads straight from the line
+// buffers, and textured quads for the sprites and the text. The legacy paths in graphics.c, swarm.c and
+// text.c call into it when glCoreProfile is set.
+//
+// Key structures and functions:
+//    - LineVertex: Packed vertex of the line buffers, two per line, shared by both backends.
+//    - glcore_init / glcore_shutdown: Build and release the shader programs and buffers.
+//    - glcore_set_view: Selects the rectangle mapped onto the window, for the drawing or the status text.
+//    - glcore_set_line_width: Sets the width lines are drawn with, in pixels.
+//    - glcore_draw_line_buffer / glcore_stream_lines: Draw lines from a buffer object or from memory.
+//    - glcore_draw_quads: Draws textured quads, tinted by a color, in one call.
+
+#ifndef GLCORE_H
+#define GLCORE_H
+
+#include <stdbool.h>
+#include <GL/gl.h>
+
+#include "camera.h"
+
+// Struct representing the interleaved vertex layout of the line buffers, 12 bytes per vertex
+typedef struct {
+    GLfloat x, y;             // Position of the vertex
+    GLubyte r, g, b, a;       // Color of the vertex (RGBA components)
+} LineVertex;
+
+// Function prototypes
+bool glcore_init(void);
+void glcore_shutdown(void);
+void glcore_set_view(CameraView view, int windowWidth, int windowHeight);
+void glcore_set_line_width(float width);
+void glcore_draw_line_buffer(GLuint buffer, int first, int count);
+void glcore_stream_lines(const LineVertex* vertices, int count);
+void glcore_draw_quads(const GLfloat* vertices, const GLfloat* texCoords, int quadCount, GLuint texture,
+                       const GLfloat color[4]);
+
+#endif // GLCORE_H
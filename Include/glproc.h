@@ -0,0 +1,92 @@
+// Header file for OpenGL entry point loading in the C-TurtleGraphics project.
+//
+// This file declares the function pointers for OpenGL functionality that is newer than the
+// GL 1.1 ABI exported by the system OpenGL library, such as buffer objects. The pointers are
+// resolved at runtime through SDL so the program still starts on GL 2.1 contexts that lack
+// some of these features, in which case the renderer falls back to the legacy code paths.
+//
+// Key variables and functions:
+//    - glHasBufferObjects: True when vertex buffer objects are available in the current context.
+//    - glHasFramebufferObjects: True when framebuffer objects (render to texture) are available.
+//    - glHasTimerQueries: True when GPU time can be measured with GL_TIME_ELAPSED queries.
+//    - glCoreProfile: True when the context is a 3.3 core profile drawn through shaders (see glcore.c).
+//    - glHasBufferAge: True when the window system reports the age of the back buffer after a swap.
+//    - glHasResetStatus: True when the context reports that the GPU was reset and the context lost.
+//    - load_gl_procs: Resolves all optional OpenGL entry points for the current context.
+//    - gl_buffer_age: How many frames ago the back buffer was drawn, 0 when unknown.
+//    - gl_context_lost: Whether a GPU reset has made the context lose its objects.
+
+#ifndef GLPROC_H
+#define GLPROC_H
+
+#include <stdbool.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// Feature flags for the current OpenGL context
+extern bool glHasBufferObjects;
+extern bool glHasFramebufferObjects;
+extern bool glHasTimerQueries;
+extern bool glCoreProfile;
+extern bool glHasBufferAge;
+extern bool glHasResetStatus;
+
+// Buffer object entry points (GL 1.5 / ARB_vertex_buffer_object)
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+extern PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+
+// Framebuffer object entry points (GL 3.0 / ARB_framebuffer_object / EXT_framebuffer_object)
+extern PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus;
+extern PFNGLGENERATEMIPMAPPROC pglGenerateMipmap; // Optional, NULL when the driver cannot build mipmaps
+
+// Timer query entry points (GL 3.3 / ARB_timer_query / EXT_timer_query over GL 1.5 queries)
+extern PFNGLGENQUERIESPROC pglGenQueries;
+extern PFNGLDELETEQUERIESPROC pglDeleteQueries;
+extern PFNGLBEGINQUERYPROC pglBeginQuery;
+extern PFNGLENDQUERYPROC pglEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v;
+
+// Shader pipeline entry points (GL 3.3 core), loaded on core profile contexts only
+extern PFNGLCREATESHADERPROC pglCreateShader;
+extern PFNGLSHADERSOURCEPROC pglShaderSource;
+extern PFNGLCOMPILESHADERPROC pglCompileShader;
+extern PFNGLGETSHADERIVPROC pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+extern PFNGLDELETESHADERPROC pglDeleteShader;
+extern PFNGLCREATEPROGRAMPROC pglCreateProgram;
+extern PFNGLATTACHSHADERPROC pglAttachShader;
+extern PFNGLLINKPROGRAMPROC pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+extern PFNGLDELETEPROGRAMPROC pglDeleteProgram;
+extern PFNGLUSEPROGRAMPROC pglUseProgram;
+extern PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+extern PFNGLUNIFORM1FPROC pglUniform1f;
+extern PFNGLUNIFORM2FPROC pglUniform2f;
+extern PFNGLUNIFORM4FPROC pglUniform4f;
+extern PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor;
+extern PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced;
+extern PFNGLGENVERTEXARRAYSPROC pglGenVertexArrays;
+extern PFNGLBINDVERTEXARRAYPROC pglBindVertexArray;
+extern PFNGLDELETEVERTEXARRAYSPROC pglDeleteVertexArrays;
+
+// Reset status entry point (GL 4.5 / KHR_robustness / ARB_robustness), only used through gl_context_lost
+extern PFNGLGETGRAPHICSRESETSTATUSPROC pglGetGraphicsResetStatus;
+
+// Function prototypes
+bool load_gl_procs(void);
+int gl_buffer_age(void);
+bool gl_context_lost(void);
+
+#endif // GLPROC_H
@@ -11,9 +11,14 @@
  * Key Functions:
  *    - setup_opengl: Initializes OpenGL for 2D rendering, including setting up the viewport
  *      and projection matrix.
- *    - load_sprite: Loads an image as a texture and prepares it for use as the turtle sprite.
  *    - render_scene: Renders the entire scene, including lines, the sprite, and text.
  *    - render_text: Renders text on the screen by creating a texture from the provided text.
+ *    - draw_line_range: Draws a contiguous range of stored lines.
+ *    - draw_visible_lines: Draws the stored lines that cross a view rectangle.
+ *    - draw_box_lines: Draws the stored lines from an index onward that cross a rectangle, at a given zoom.
+ *    - add_line: Appends a line segment to the drawing.
+ *    - mark_lines / undo_lines / redo_lines: Apply the undo journal to the stored lines.
+ *    - cleanup_graphics: Releases the OpenGL objects owned by the renderer.
  *
  * Libraries:
  *    - SDL2 for window management and text rendering.
@@ -29,13 +34,29 @@
 #include <GL/glu.h>
 #include <SDL2/SDL_ttf.h>
 
+#include "linestore.h"
 #include "sprite.h"
 #include "utilities.h"
 
+// Collinear line merging performed by add_line
+extern bool lineMergeEnabled;       // Whether add_line extends collinear lines instead of appending
+extern float lineMergeTolerance;    // Maximum heading difference, in degrees, for two lines to merge
+extern int lineMergeCount;          // Number of lines absorbed into their predecessor so far
+
+// Width of the lines on screen in pixels, set before the renderer starts
+extern float lineWidth;
+
 // Function prototypes
-void setup_opengl(int windowWidth, int windowHeight);
-bool load_sprite(const char* bmp);
-void render_scene(int windowWidth, int windowHeight);
+bool setup_opengl(int windowWidth, int windowHeight);
+void render_scene(int windowWidth, int windowHeight, const Sprite* current, const Sprite* previous, float alpha);
 GLuint render_text(const char* text, SDL_Color color, int* w, int* h);
+void draw_line_range(int first, int count);
+void draw_visible_lines(float minX, float minY, float maxX, float maxY);
+void draw_box_lines(float minX, float minY, float maxX, float maxY, float zoom, int first);
+void add_line(const Line* line);
+void mark_lines(void);
+void undo_lines(void);
+void redo_lines(void);
+void cleanup_graphics(void);
 
 #endif // GRAPHICS_H
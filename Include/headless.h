@@ -0,0 +1,35 @@
+// Header file for the headless rendering mode in the C-TurtleGraphics project.
+//
+// This file declares the batch renderer that turns command streams into PNG images, or SVG and PDF files,
+// without creating a window or an OpenGL context. Each input is executed by a command-driven turtle (see
+// commands.h) and its lines are drawn by the software rasterizer (see raster.h) or the vector exporter (see
+// export.h).
+//
+// Key structures and functions:
+//    - HeadlessOutput: Selects the format of the files written.
+//    - HeadlessConfig: Image size, output format and directory, and input streams of a batch.
+//    - run_headless: Renders every input of a batch and reports the throughput.
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Enum representing the format of the files written in headless mode
+typedef enum {
+    HEADLESS_PNG = 0,
+    HEADLESS_SVG = 1,
+    HEADLESS_PDF = 2
+} HeadlessOutput;
+
+// Struct representing a batch of drawings to render
+typedef struct {
+    int width, height;        // Size of the images in pixels
+    HeadlessOutput output;    // Format of the files written
+    const char* outputDir;    // Directory receiving the PNG files
+    char** inputs;            // Paths of the command streams, "-" for standard input
+    int inputCount;           // Number of inputs
+} HeadlessConfig;
+
+// Function prototypes
+int run_headless(const HeadlessConfig* config);
+
+#endif // HEADLESS_H
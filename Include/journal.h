@@ -0,0 +1,28 @@
+// Header file for the undo journal in the C-TurtleGraphics project.
+//
+// This file declares the journal of strokes kept by the main thread for undo and redo. Every pen-down run of
+// the keyboard, and every script, is one entry recording the sprite as it was before the entry drew its
+// first line. The lines themselves belong to the render thread, which keeps a matching list of line ranges
+// (see graphics.c) and follows the journal through RENDER_MARK, RENDER_UNDO and RENDER_REDO messages, so
+// both sides always hold the same entries.
+//
+// Key functions:
+//    - journal_begin / journal_end: Open an entry before the first line of a stroke and close it after.
+//    - journal_undo / journal_redo: Step back or forward by one entry and restore the sprite it recorded.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+
+#include "sprite.h"
+
+#define JOURNAL_ENTRIES 256       // Entries kept for undo and redo; older ones are forgotten
+
+// Function prototypes
+void journal_begin(const Sprite* before);
+void journal_end(void);
+bool journal_undo(Sprite* sprite);
+bool journal_redo(Sprite* sprite);
+
+#endif // JOURNAL_H
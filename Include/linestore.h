@@ -0,0 +1,83 @@
+// Header file for the line storage in the C-TurtleGraphics project.
+//
+// This file declares the Line record and the functions that store the lines drawn by the turtle. The store
+// has two layouts that share one interface. The full layout keeps one Line record per line. The compact
+// layout splits the lines into separate streams: positions are kept as shared-vertex polylines, where a line
+// that starts at the end of the previous one only adds its end point, and colors are kept as a run-length
+// table of palette indices, since the color only changes through a handful of presets.
+//
+// Key structures and functions:
+//    - Line: A line segment with its endpoints and RGB color, the unit read from and written to the store.
+//    - LineStoreMode: Selects the full or the compact layout.
+//    - line_store_init: Allocates the store in the requested layout.
+//    - line_store_append: Appends a line.
+//    - line_store_get / line_store_read: Decode one line or a contiguous range of lines.
+//    - LineIterator / line_store_iterate / line_store_next_block: Walk a range of lines block by block,
+//      the way renderers and exporters should read the store.
+//    - line_store_set_limit: Caps the memory held by the store and selects what happens at the cap.
+//    - line_store_set_last_end: Moves the end point of the last line, used to extend collinear lines.
+//    - line_store_count / line_store_bytes: Report the number of lines and the memory held for them.
+//    - line_store_first: Reports the first line still readable after the oldest ones were flattened.
+//    - line_store_truncate / line_store_restore: Hide the newest lines and bring them back, for undo and redo.
+//    - line_store_free: Releases all memory held by the store.
+
+#ifndef LINESTORE_H
+#define LINESTORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/gl.h>
+
+#define LINE_BLOCK_SIZE 1024      // Maximum number of lines in a block returned by line_store_next_block
+
+// Struct representing a stored line
+typedef struct {
+    GLfloat x1, y1, x2, y2;   // Coordinates of the line
+    GLfloat r, g, b;          // Color of the line (RGB components)
+} Line;
+
+// Enum representing the memory layout of the line store
+typedef enum {
+    LINE_STORE_FULL = 0,      // One Line record per line
+    LINE_STORE_COMPACT = 1    // Shared-vertex polylines plus run-length palette colors
+} LineStoreMode;
+
+// Enum representing what the store does once its memory cap is reached
+typedef enum {
+    LINE_LIMIT_STOP = 0,      // Drop further lines
+    LINE_LIMIT_FLATTEN = 1,   // Discard the oldest lines once the canvas holds them
+    LINE_LIMIT_SPILL = 2      // Move the oldest lines to a temporary file
+} LineLimitPolicy;
+
+// Struct representing a walk over a range of lines, one block at a time
+typedef struct {
+    int first;                // Index of the first line of the current block
+    int count;                // Number of lines in the current block
+    const Line* lines;        // Lines of the current block
+    int next;                 // Index of the first line of the next block
+    int end;                  // Index one past the last line to visit
+    Line scratch[LINE_BLOCK_SIZE]; // Decoding buffer used by the compact layout
+} LineIterator;
+
+// Function prototypes
+bool line_store_init(LineStoreMode mode);
+void line_store_free(void);
+LineStoreMode line_store_mode(void);
+int line_store_count(void);
+int line_store_first(void);
+int line_store_dropped(void);
+size_t line_store_bytes(void);
+void line_store_set_limit(size_t maxBytes, LineLimitPolicy policy);
+void line_store_set_flatten_hook(int (*hook)(void));
+bool line_store_append(const Line* line);
+bool line_store_get(int index, Line* line);
+int line_store_read(int first, int count, Line* out);
+void line_store_iterate(LineIterator* it, int first, int count);
+bool line_store_next_block(LineIterator* it);
+void line_store_set_last_end(GLfloat x2, GLfloat y2);
+void line_store_truncate(int count);
+int line_store_restore(int count);
+int line_store_undone(void);
+void line_store_discard_undone(void);
+
+#endif // LINESTORE_H
@@ -0,0 +1,29 @@
+// Header file for the level-of-detail line simplification in the C-TurtleGraphics project.
+//
+// This file declares the simplified copies of the drawing used when the camera is zoomed out. The stored
+// lines are cut into fixed chunks, and each completed chunk is simplified once per level with the
+// Douglas-Peucker algorithm, each level allowing twice the error of the previous one. Zoomed out, a level
+// whose error stays under a pixel looks the same as the full drawing but has far fewer lines.
+//
+// Key functions:
+//    - lod_init / lod_free: Set up empty levels and release them.
+//    - lod_update: Simplifies the chunks completed since the last call.
+//    - lod_level: Picks the coarsest level that is still accurate at a given zoom.
+//    - lod_collect: Gathers the simplified lines of a level that cross a view rectangle.
+//    - lod_truncate: Drops the chunks covering lines the store has freed.
+
+#ifndef LOD_H
+#define LOD_H
+
+#include "camera.h"
+#include "linestore.h"
+
+// Function prototypes
+void lod_init(void);
+void lod_free(void);
+void lod_update(void);
+int lod_level(float zoom);
+int lod_collect(int level, CameraView view, const Line** lines, int* fullDetailFirst);
+void lod_truncate(int count);
+
+#endif // LOD_H
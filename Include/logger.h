@@ -0,0 +1,22 @@
+// Header file for the status logger in the C-TurtleGraphics project.
+//
+// This file declares the logger that status messages of the interactive paths go through, such as a color
+// change or a resize. The thread logging a message only formats it into a queue; a writer thread prints the
+// queue to stdout, so a slow terminal never stalls input handling. Messages past a rate limit are counted
+// instead of queued and reported as one line.
+//
+// Key functions:
+//    - logger_start / logger_stop: Start the writer thread, and print what is left and stop it.
+//    - log_message: Formats a message like printf and queues it.
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+
+// Function prototypes
+bool logger_start(void);
+void log_message(const char* format, ...);
+void logger_stop(void);
+
+#endif // LOGGER_H
@@ -0,0 +1,55 @@
+// Header file for L-system drawings in the C-TurtleGraphics project.
+//
+// This file declares an L-system definition and the functions that read it and draw it with a turtle. The
+// expansion is never built as a string: the rules are walked depth first and every symbol drives the turtle
+// as soon as it is reached, so memory depends on the recursion depth rather than on the number of lines.
+//
+// Key structures and functions:
+//    - LSystem: An axiom, its rewriting rules, and how the turtle interprets the symbols.
+//    - lsystem_parse / lsystem_free: Read a definition from a stream and release it.
+//    - lsystem_run: Expands a definition, handing each line to a sink, up to a segment budget.
+//    - LSystemPlan / lsystem_plan: Split a drawing into parts that threads can draw independently.
+//    - lsystem_run_part / lsystem_plan_end: Draw one part, and find where the whole drawing ends.
+//    - lsystem_file: Tells whether a file name is an L-system definition.
+//    - run_lsystem_stream: Reads and draws a definition in one call.
+
+#ifndef LSYSTEM_H
+#define LSYSTEM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "commands.h"
+
+#define LSYSTEM_MAX_DEPTH 64              // Deepest expansion accepted
+#define LSYSTEM_SYMBOLS 256               // Number of possible symbols, one per byte value
+
+// Struct representing an L-system definition
+typedef struct {
+    char* axiom;                          // Initial string
+    char* rules[LSYSTEM_SYMBOLS];         // Replacement of each symbol, or NULL for symbols that are kept
+    bool draws[LSYSTEM_SYMBOLS];          // Symbols that move forward drawing a line
+    bool moves[LSYSTEM_SYMBOLS];          // Symbols that move forward without drawing
+    float angle;                          // Turn in degrees of the '+' and '-' symbols
+    float step;                           // Distance covered by a forward symbol
+    int depth;                            // Number of times the rules are applied
+    int budget;                           // Most lines drawn, 0 for no limit
+} LSystem;
+
+// Drawing split into independent parts, opaque outside of lsystem.c
+typedef struct LSystemPlan LSystemPlan;
+
+// Function prototypes
+bool lsystem_parse(FILE* input, const char* name, LSystem* system);
+void lsystem_free(LSystem* system);
+int lsystem_run(const LSystem* system, Turtle* turtle, LineSink sink, void* context, bool* truncated);
+LSystemPlan* lsystem_plan(const LSystem* system, const Turtle* turtle);
+int lsystem_plan_parts(const LSystemPlan* plan);
+int lsystem_part_lines(const LSystemPlan* plan, int part);
+void lsystem_run_part(const LSystem* system, const LSystemPlan* plan, int part, LineSink sink, void* context,
+                      Turtle* end);
+bool lsystem_plan_end(const LSystem* system, const LSystemPlan* plan, const Turtle* lastPartEnd, Turtle* end);
+void lsystem_plan_free(LSystemPlan* plan);
+bool lsystem_file(const char* name);
+bool run_lsystem_stream(FILE* input, const char* name, Turtle* turtle, LineSink sink, void* context);
+
+#endif // LSYSTEM_H
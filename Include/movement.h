@@ -0,0 +1,25 @@
+// Header file for the turtle movement kernels in the C-TurtleGraphics project.
+//
+// This file declares the functions that turn headings and distances into positions. Headings on a
+// quarter-degree grid, which covers the 90 and 60 degree turns of most fractals, are read from a lookup
+// table of directions instead of being computed with sine and cosine.
+//
+// Key functions:
+//    - movement_init: Builds the direction table, once per process.
+//    - movement_direction: Returns the unit direction of a heading.
+//    - movement_batch: Computes the end points of a sequence of moves, with SIMD where available.
+//    - movement_batch_scalar: The reference implementation of movement_batch.
+//    - movement_kernel_name: Names the kernel movement_batch runs on this CPU.
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+// Function prototypes
+void movement_init(void);
+void movement_direction(float angle, float* dirX, float* dirY);
+void movement_batch(const float* headings, const float* distances, int count, float x, float y, float* xs, float* ys);
+void movement_batch_scalar(const float* headings, const float* distances, int count, float x, float y,
+                           float* xs, float* ys);
+const char* movement_kernel_name(void);
+
+#endif // MOVEMENT_H
@@ -0,0 +1,37 @@
+// Header file for the vector movement kernels in the C-TurtleGraphics project.
+//
+// This file declares what movement.c shares with the vector kernels of movement_batch in
+// movement_lanes.c: the direction table and the kernel variants. The CMake build compiles
+// movement_lanes.c once per instruction set and movement.c picks the best variant the CPU supports when
+// the table is built; other builds compile it once for the compiler's target as movement_batch_native.
+//
+// Key structures and functions:
+//    - MovementKernel: The signature shared by every implementation of movement_batch.
+//    - movementTableX / movementTableY: The direction of every quarter-degree heading.
+//    - movement_batch_avx2 / movement_batch_sse2 / movement_batch_neon / movement_batch_native: The variants.
+
+#ifndef MOVEMENT_KERNELS_H
+#define MOVEMENT_KERNELS_H
+
+#define MOVEMENT_TABLE_STEPS_PER_DEGREE 4                          // Headings per degree in the direction table
+#define MOVEMENT_TABLE_SIZE (360 * MOVEMENT_TABLE_STEPS_PER_DEGREE) // Table entries for a full turn
+
+// Function computing the end points of a sequence of moves, see movement_batch
+typedef void (*MovementKernel)(const float* headings, const float* distances, int count, float x, float y,
+                               float* xs, float* ys);
+
+// Direction table, built by movement_init
+extern float movementTableX[MOVEMENT_TABLE_SIZE];
+extern float movementTableY[MOVEMENT_TABLE_SIZE];
+
+// Function prototypes
+void movement_batch_avx2(const float* headings, const float* distances, int count, float x, float y,
+                         float* xs, float* ys);
+void movement_batch_sse2(const float* headings, const float* distances, int count, float x, float y,
+                         float* xs, float* ys);
+void movement_batch_neon(const float* headings, const float* distances, int count, float x, float y,
+                         float* xs, float* ys);
+void movement_batch_native(const float* headings, const float* distances, int count, float x, float y,
+                           float* xs, float* ys);
+
+#endif // MOVEMENT_KERNELS_H
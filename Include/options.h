@@ -0,0 +1,47 @@
+// Header file for command line options in the C-TurtleGraphics project.
+//
+// This file declares the settings that can be chosen on the command line and the parser that fills them.
+//
+// Key structures and functions:
+//    - Options: Every command line setting, with its default value.
+//    - parse_options: Parses the command line, printing the usage on errors.
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "headless.h"
+#include "linestore.h"
+#include "pacing.h"
+
+// Struct representing the command line settings
+typedef struct {
+    LineStoreMode lineStoreMode;    // Memory layout of the line store
+    size_t lineMemoryCap;           // Memory cap of the line store in bytes, 0 for none
+    LineLimitPolicy lineCapPolicy;  // What the line store does at its cap
+    PacingConfig pacing;            // Frame pacing
+    const char* script;             // Command file run when the window opens, or NULL
+    const char* save;               // Session file the drawing is saved to as it grows, or NULL
+    int threads;                    // Workers drawing L-systems that can be split, 0 for one per CPU
+    bool profile;                   // Whether to profile frames with the overlay shown
+    const char* profileOut;         // CSV or JSON file the profile is written to on exit, or NULL
+    const char* record;             // File the input is recorded to, or NULL
+    const char* replay;             // Recording played back instead of the live input, or NULL
+    bool coreProfile;               // Whether to draw through the OpenGL 3.3 core profile backend
+    float lineWidth;                // Width of the lines on screen in pixels
+    const char* assetCache;         // Directory the decoded font and sprites are cached in, or NULL
+    bool partialRedraw;             // Whether frames redraw only the parts of the window that changed
+    bool tiledCanvas;               // Whether lines are rasterized into tiles fixed in the drawing
+    size_t tileBudget;              // Memory the tiles may hold in bytes
+    const char* listen;             // Address the command server listens on, or NULL
+    const char* stats;              // File the telemetry counters are written to, "-" for stdout, or NULL
+    double statsInterval;           // Seconds between two lines of telemetry counters
+    bool headless;                  // Whether to render command streams to PNG files instead of opening a window
+    HeadlessConfig headlessConfig;  // Batch rendered in headless mode
+} Options;
+
+// Function prototypes
+bool parse_options(int argc, char* argv[], Options* options);
+
+#endif // OPTIONS_H
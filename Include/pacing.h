@@ -0,0 +1,42 @@
+// Header file for frame pacing in the C-TurtleGraphics project.
+//
+// This file declares how the render thread paces its frames and how the main loop waits for input.
+// Vertical sync is set through the swap interval, a frame rate cap sleeps away the rest of each frame, and
+// the idle mode stops rendering while nothing on screen changes, so a still turtle costs neither CPU nor
+// GPU time.
+//
+// Key structures and functions:
+//    - VsyncMode / PacingConfig: The pacing options selected on the command line.
+//    - pacing_init: Applies the vsync mode to the current OpenGL context.
+//    - pacing_end_frame: Sleeps until the next frame is due when a frame rate cap is set.
+//    - pacing_restart: Restarts the frame rate cap schedule after frames were skipped.
+//    - pacing_idle: Reports the idle mode.
+//    - pacing_wait_for_input: Blocks until an event arrives or a timeout expires.
+
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdbool.h>
+
+// Enum representing the swap interval requested from the driver
+typedef enum {
+    VSYNC_ADAPTIVE = -1,      // Sync to the display, but swap immediately when a frame is late
+    VSYNC_OFF = 0,            // Swap immediately
+    VSYNC_ON = 1              // Sync every swap to the display
+} VsyncMode;
+
+// Struct representing the frame pacing options
+typedef struct {
+    VsyncMode vsync;          // Swap interval
+    int fpsCap;               // Maximum frames per second, 0 for none
+    bool idle;                // Whether to stop rendering while nothing changes
+} PacingConfig;
+
+// Function prototypes
+void pacing_init(PacingConfig config);
+void pacing_end_frame(void);
+bool pacing_idle(void);
+void pacing_restart(void);
+void pacing_wait_for_input(double seconds);
+
+#endif // PACING_H
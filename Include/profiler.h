@@ -0,0 +1,46 @@
+// Header file for the frame-time profiler in the C-TurtleGraphics project.
+//
+// This file declares the optional instrumentation of the main loop and the render thread. Each stage of a
+// frame is timed on the CPU and, when the context supports timer queries, on the GPU. The samples feed
+// rolling histograms that report the median and 99th percentile shown by the overlay, and whole-run
+// histograms written to a CSV or JSON file when the program exits. Everything is off unless profiling was
+// requested on the command line.
+//
+// Key structures and functions:
+//    - ProfileStage: The timed parts of a frame.
+//    - profiler_configure / profiler_enabled: Turn profiling on before the render thread starts.
+//    - profiler_begin / profiler_end / profiler_add: Time a stage, or record a time measured elsewhere.
+//    - profiler_frame / profiler_restart: Mark presented frames and pauses between them.
+//    - profiler_overlay_text / profiler_toggle_overlay: The text the status display shows.
+//    - profiler_dump: Writes the whole-run statistics.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+
+// Enum representing the timed stages
+typedef enum {
+    PROFILE_EVENTS = 0,       // Event handling on the main thread
+    PROFILE_LINES = 1,        // Drawing the lines, canvas updates included
+    PROFILE_SPRITE = 2,       // Drawing the sprite
+    PROFILE_HUD = 3,          // Drawing the status text
+    PROFILE_FRAME = 4,        // Time between two presented frames
+    PROFILE_STAGES = 5
+} ProfileStage;
+
+// Function prototypes
+void profiler_configure(bool enabled, bool overlay, const char* dumpPath);
+bool profiler_enabled(void);
+void profiler_init_gpu(void);
+void profiler_shutdown_gpu(void);
+void profiler_begin(ProfileStage stage);
+void profiler_end(ProfileStage stage);
+void profiler_add(ProfileStage stage, double seconds);
+void profiler_frame(void);
+void profiler_restart(void);
+void profiler_toggle_overlay(void);
+const char* profiler_overlay_text(unsigned int* serial);
+bool profiler_dump(void);
+
+#endif // PROFILER_H
@@ -0,0 +1,33 @@
+// Header file for the software rasterizer in the C-TurtleGraphics project.
+//
+// This file declares an RGBA image in system memory and the functions that draw the turtle's lines into it
+// and save it as a PNG. It is used by the headless mode, which renders drawings without a window, an OpenGL
+// context, or a GPU.
+//
+// Key structures and functions:
+//    - Raster: An RGBA8 image with its dimensions.
+//    - raster_init / raster_free: Allocate and release the pixels.
+//    - raster_clear: Fills the image with a color.
+//    - raster_line: Draws a one-pixel line, clipped to the image, the way GL_LINES would.
+//    - raster_save_png: Writes the image to a PNG file.
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include "linestore.h"
+
+// Struct representing an image drawn by the software rasterizer
+typedef struct {
+    int width, height;        // Dimensions in pixels
+    unsigned char* pixels;    // RGBA8 pixels, rows from top to bottom
+} Raster;
+
+// Function prototypes
+bool raster_init(Raster* raster, int width, int height);
+void raster_free(Raster* raster);
+void raster_clear(Raster* raster, float r, float g, float b);
+void raster_line(Raster* raster, const Line* line);
+bool raster_save_png(const Raster* raster, const char* path);
+
+#endif // RASTER_H
@@ -0,0 +1,104 @@
+// Header file for the render thread in the C-TurtleGraphics project.
+//
+// This file declares the render thread, which owns the OpenGL context, and the messages the input and
+// simulation thread sends it. Messages travel through a single-producer, single-consumer ring that needs no
+// lock on either side: the simulation writes messages and publishes them with render_flush, and the render
+// thread applies every published message before it draws its next frame.
+//
+// Key structures and functions:
+//    - RenderMessage: A new line, a sprite snapshot or a change of the view, as queued for the render thread.
+//    - render_start / render_stop: Start the render thread on a context, saving its lines if asked, and stop it,
+//      taking back the context, which a GPU reset may have replaced.
+//    - render_send_line / render_send_sprite: Queue a new line or the sprite's latest simulation steps.
+//    - render_send_pan / render_send_zoom / render_send_follow / render_send_reset_view: Queue camera moves.
+//    - render_send_resize / render_send_redraw: Queue window changes.
+//    - render_send_export: Queue an export of the drawing.
+//    - render_send_swarm: Queue the turtles a script told, drawn along with the sprite.
+//    - render_send_timing / render_send_profiler_overlay: Feed the profiler and toggle its overlay.
+//    - render_flush: Publishes the queued messages to the render thread.
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "commands.h"
+#include "export.h"
+#include "linestore.h"
+#include "pacing.h"
+#include "profiler.h"
+#include "sprite.h"
+
+// Enum representing the kinds of messages sent to the render thread
+typedef enum {
+    RENDER_LINE,              // Add `line` to the drawing
+    RENDER_SPRITE,            // Replace the sprite poses drawn with `sprite`
+    RENDER_PAN,               // Pan the view by `view.x`, `view.y` window pixels
+    RENDER_ZOOM,              // Zoom by `view.value` around the window position `view.x`, `view.y`
+    RENDER_FOLLOW,            // Keep the point `view.x`, `view.y` at least `view.value` pixels inside the view
+    RENDER_RESET_VIEW,        // Return to the initial view
+    RENDER_RESIZE,            // The window is now `size.width` by `size.height` pixels
+    RENDER_REDRAW,            // Something else on screen may have changed
+    RENDER_EXPORT,            // Write the drawing to a vector file in `format`
+    RENDER_MARK,              // The lines that follow start a new journal entry
+    RENDER_UNDO,              // Hide the lines of the last journal entry
+    RENDER_REDO,              // Show the lines of the last journal entry undone again
+    RENDER_SWARM,             // Draw `turtle.index` turtles besides the sprite, placed by the messages that follow
+    RENDER_TURTLE,            // Place turtle `turtle.index` of the swarm at `turtle.x`, `turtle.y`, `turtle.angle`
+    RENDER_TIMING,            // Record `timing.seconds` for the profiler stage `timing.stage`
+    RENDER_PROFILER_OVERLAY,  // Show or hide the profiler overlay
+    RENDER_QUIT               // Stop the render thread
+} RenderMessageType;
+
+// Struct representing a message queued for the render thread
+typedef struct {
+    RenderMessageType type;
+    union {
+        Line line;
+        struct {
+            Sprite current;           // Sprite after the last simulation step
+            Sprite previous;          // Sprite before the last simulation step
+            Uint64 stepCounter;       // Performance counter value the last step corresponds to
+            float stepSeconds;        // Length of a simulation step, to interpolate between the two poses
+        } sprite;
+        struct {
+            float x, y, value;
+        } view;
+        struct {
+            int width, height;
+        } size;
+        struct {
+            int index;
+            float x, y, angle;
+        } turtle;
+        struct {
+            ProfileStage stage;
+            double seconds;
+        } timing;
+        ExportFormat format;
+    };
+} RenderMessage;
+
+// Function prototypes
+bool render_start(SDL_Window* window, SDL_GLContext context, int windowWidth, int windowHeight, PacingConfig pacing,
+                  const char* sessionPath);
+SDL_GLContext render_stop(void);
+void render_send_line(const Line* line);
+void render_send_sprite(const Sprite* current, const Sprite* previous, Uint64 stepCounter, float stepSeconds);
+void render_send_pan(float dx, float dy);
+void render_send_zoom(float factor, int x, int y);
+void render_send_follow(float x, float y, float margin);
+void render_send_reset_view(void);
+void render_send_resize(int windowWidth, int windowHeight);
+void render_send_redraw(void);
+void render_send_export(ExportFormat format);
+void render_send_mark(void);
+void render_send_undo(void);
+void render_send_redo(void);
+void render_send_swarm(const TurtleSwarm* swarm);
+void render_send_timing(ProfileStage stage, double seconds);
+void render_send_profiler_overlay(void);
+void render_flush(void);
+
+#endif // RENDER_H
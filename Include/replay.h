@@ -0,0 +1,28 @@
+// Header file for input recording and replay in the C-TurtleGraphics project.
+//
+// This file declares the recorder that saves the input the main loop handles, every event and the time
+// measured for every iteration, and the player that feeds a recording back in place of the live input.
+// The simulation only depends on those two, so replaying a recording draws the same lines as the session
+// it was made from, whatever the frame rate of either run.
+//
+// Key functions:
+//    - replay_record / replay_play: Start recording to a file or playing one back.
+//    - replay_frame_time: Records the time of an iteration, or returns the recorded one.
+//    - replay_peep_events / replay_mouse_position: Replace SDL_PeepEvents and SDL_GetMouseState.
+//    - replay_close: Finishes the recording or the replay.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Function prototypes
+bool replay_record(const char* path);
+bool replay_play(const char* path, SDL_Window* window);
+double replay_frame_time(double measured);
+int replay_peep_events(SDL_Event* events, int capacity);
+void replay_mouse_position(int* x, int* y);
+void replay_close(void);
+
+#endif // REPLAY_H
@@ -0,0 +1,57 @@
+// Header file for the command server in the C-TurtleGraphics project.
+//
+// This file declares the optional socket server that lets other programs drive the turtle and watch the
+// drawing grow. Clients connect over TCP or a Unix domain socket and exchange frames: a frame is one type
+// byte, a little-endian 32-bit payload length and the payload.
+//
+//    1 SERVER_FRAME_COMMANDS   Client to server: a batch of commands in their binary form (see
+//                              commands_decode), run by the turtle as one undo step.
+//    2 SERVER_FRAME_SUBSCRIBE  Client to server, empty: stream the lines drawn from now on to this client.
+//    3 SERVER_FRAME_LINES      Server to client: new lines, delta-encoded (see server.c).
+//    4 SERVER_FRAME_GAP        Server to client: a little-endian 32-bit count of lines that could not be
+//                              streamed; the next line starts from scratch.
+//    5 SERVER_FRAME_STATS      Client to server, empty: report the telemetry counters. Server to client:
+//                              the counters as a JSON object (see stats_format_json).
+//
+// Sockets are served by an I/O thread. Batches reach the main thread, and new lines the I/O thread,
+// through single-producer, single-consumer rings that take no lock.
+//
+// Key functions:
+//    - server_start / server_stop: Listen on an address on the I/O thread, and shut it down.
+//    - server_take_batch / server_free_batch: Hand over the next command batch a client sent.
+//    - server_publish_line: Queues a new line for the subscribed clients.
+//    - server_flush: Publishes the queued lines to the I/O thread.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "linestore.h"
+
+// Enum representing the types of the frames exchanged with clients
+typedef enum {
+    SERVER_FRAME_COMMANDS = 1,    // Commands to run
+    SERVER_FRAME_SUBSCRIBE = 2,   // Request for the lines drawn from now on
+    SERVER_FRAME_LINES = 3,       // Lines drawn
+    SERVER_FRAME_GAP = 4,         // Lines lost to a full ring
+    SERVER_FRAME_STATS = 5        // Request for the telemetry counters, and the reply
+} ServerFrameType;
+
+// Struct representing a batch of commands received from a client
+typedef struct {
+    int client;                   // Number of the connection, used in error messages
+    size_t length;                // Number of bytes of commands
+    unsigned char data[];         // The commands, in their binary form
+} ServerBatch;
+
+// Function prototypes
+bool server_start(const char* address);
+ServerBatch* server_take_batch(void);
+void server_free_batch(ServerBatch* batch);
+void server_publish_line(const Line* line);
+void server_flush(void);
+void server_stop(void);
+
+#endif // SERVER_H
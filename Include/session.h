@@ -0,0 +1,41 @@
+// Header file for saved drawings in the C-TurtleGraphics project.
+//
+// This file declares the session format, a compact binary file holding every line of a drawing. A session
+// is written as the drawing grows, one block of lines at a time, so it is never rewritten and a crash loses
+// only the last second or so of drawing. A saved session is read back like a script, see generate.h.
+//
+// Key structures and functions:
+//    - SessionWriter: A session file being written.
+//    - session_create / session_write / session_sync / session_close: Stream lines to a session file.
+//    - session_mark / session_undo / session_redo: Record the undo journal, so undone lines are not loaded.
+//    - SessionReader: A session file mapped into memory.
+//    - session_file: Tells whether a script name designates a session.
+//    - session_open / session_run / session_free: Read the lines of a session back.
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "commands.h"
+
+// Session file being written, opaque outside of session.c
+typedef struct SessionWriter SessionWriter;
+
+// Session file being read, opaque outside of session.c
+typedef struct SessionReader SessionReader;
+
+// Function prototypes
+SessionWriter* session_create(const char* path);
+void session_write(SessionWriter* writer, const Line* line);
+void session_mark(SessionWriter* writer);
+void session_undo(SessionWriter* writer);
+void session_redo(SessionWriter* writer);
+void session_sync(SessionWriter* writer);
+bool session_close(SessionWriter* writer);
+bool session_file(const char* name);
+SessionReader* session_open(FILE* input, const char* name);
+bool session_run(const SessionReader* reader, Turtle* turtle, LineSink sink, void* context);
+void session_free(SessionReader* reader);
+
+#endif // SESSION_H
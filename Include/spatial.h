@@ -0,0 +1,30 @@
+// Header file for the spatial index over stored lines in the C-TurtleGraphics project.
+//
+// This file declares a sparse uniform grid that maps regions of the drawing to the lines crossing them.
+// The index is updated as lines are added or extended, and answers box queries, used to cull lines outside
+// the view, and nearest-line queries, for tools that pick strokes under the cursor.
+//
+// Key functions:
+//    - spatial_init / spatial_free: Set up an empty index and release it.
+//    - spatial_insert: Adds a line, or records the cells newly covered by an extended line.
+//    - spatial_bounds: Reports the bounding box of every indexed line.
+//    - spatial_query_box: Lists the lines crossing an axis-aligned box, in drawing order.
+//    - spatial_nearest: Finds the line closest to a point within a maximum distance.
+//    - spatial_truncate: Forgets the lines from an index onward, once the store freed them.
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stdbool.h>
+#include "linestore.h"
+
+// Function prototypes
+void spatial_init(void);
+void spatial_free(void);
+void spatial_insert(int index, const Line* line);
+bool spatial_bounds(float* minX, float* minY, float* maxX, float* maxY);
+int spatial_query_box(float minX, float minY, float maxX, float maxY, const int** indices);
+bool spatial_nearest(float x, float y, float maxDistance, int* index, float* distance);
+void spatial_truncate(int count);
+
+#endif // SPATIAL_H
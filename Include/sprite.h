@@ -12,11 +12,16 @@
 //    - update_orientation: Adjusts the sprite's orientation based on the specified turn direction.
 //    - update_pen: Modifies the sprite's pen state, determining if it draws while moving.
 //    - change_color: Changes the sprite's pen color based on a user-defined color option.
+//    - preset_color: Looks up a preset pen color without changing the sprite.
+//    - save_sprite_state / interpolate_sprite: Keep the pose before the last simulation step and blend
+//      it with the current one, so rendering between steps stays smooth.
+//    - describe_sprite: Formats the status text shown for a sprite.
 
 #ifndef SPRITE_H
 #define SPRITE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <GL/gl.h>
 
 // Enum representing possible turn directions (not used in continuous movement but kept for compatibility)
@@ -37,11 +42,16 @@ typedef struct {
 
 // Externally accessible sprite variable
 extern Sprite sprite;
+extern Sprite previousSprite;   // Sprite state before the last simulation step
 
 // Function prototypes
-void update_location(float deltaTime, int windowWidth, int windowHeight);
+void update_location(float deltaTime);
 void update_orientation(TurnDirection direction);
 void update_pen(bool pen_state);
 void change_color(int color_option);
+bool preset_color(int color_option, GLfloat* r, GLfloat* g, GLfloat* b);
+void save_sprite_state(void);
+void interpolate_sprite(const Sprite* from, const Sprite* to, float alpha, float* x, float* y, float* angle);
+void describe_sprite(const Sprite* shown, char* text, size_t size);
 
 #endif // SPRITE_H
@@ -0,0 +1,53 @@
+// Header file for the telemetry counters in the C-TurtleGraphics project.
+//
+// This file declares the counters that let a running drawing be watched without a profiler: how much
+// the line store holds and allocates, how many lines it dropped or merged, and how many textures and
+// bytes go to the GPU. Any thread may update or read a counter at the cost of one relaxed atomic
+// operation. The counters can be read through this API, written to a file as JSON lines at a fixed
+// interval, and queried by clients of the command server (see server.h).
+//
+// Key structures and functions:
+//    - StatId: The counters.
+//    - stats_add / stats_set / stats_get: Update and read one counter.
+//    - stats_snapshot / stats_format_json: Read every counter, as values or as a JSON object.
+//    - stats_end_frame: Closes a frame, for the per-frame upload figures.
+//    - stats_start / stats_stop: Write the counters to a file at a fixed interval, and stop.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define STATS_JSON_MAX 1024       // Size of a buffer that holds the output of stats_format_json
+
+// Enum representing the counters, running totals unless marked as a current value
+typedef enum {
+    STAT_LINE_COUNT,              // Current: lines in the line store
+    STAT_LINE_CAPACITY,           // Current: lines the line store holds before allocating again
+    STAT_LINE_BYTES,              // Current: bytes the line store holds in memory
+    STAT_LINE_ALLOCATIONS,        // Chunks the line store allocated to grow
+    STAT_LINES_DROPPED,           // Lines rejected at the memory cap of the line store
+    STAT_LINES_MERGED,            // Lines merged into the previous one instead of being stored
+    STAT_LINES_UNSTREAMED,        // Lines the command server could not stream to its subscribers
+    STAT_TEXTURES_CREATED,        // OpenGL textures created
+    STAT_TEXTURES_DELETED,        // OpenGL textures deleted
+    STAT_UPLOAD_BYTES,            // Bytes of vertices, indices and pixels sent to the GPU
+    STAT_FRAMES,                  // Frames drawn
+    STAT_FRAME_UPLOAD_BYTES,      // Current: bytes sent to the GPU by the last frame
+    STAT_FRAME_UPLOAD_PEAK,       // Most bytes sent to the GPU by one frame
+    STAT_COUNT
+} StatId;
+
+// Function prototypes
+void stats_add(StatId id, long long amount);
+void stats_set(StatId id, long long value);
+long long stats_get(StatId id);
+const char* stats_name(StatId id);
+void stats_snapshot(long long values[STAT_COUNT]);
+size_t stats_format_json(char* buffer, size_t size);
+void stats_end_frame(void);
+bool stats_start(const char* path, double interval);
+void stats_stop(void);
+
+#endif // STATS_H
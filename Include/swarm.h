@@ -0,0 +1,32 @@
+// Header file for the turtles drawn on screen in the C-TurtleGraphics project.
+//
+// This file declares the sprite atlas, one texture holding every turtle image, and the batch that draws
+// the interactive turtle together with the turtles a script told, all with one draw call per frame.
+//
+// Key functions:
+//    - upload_sprites: Packs decoded sprite images into the atlas texture.
+//    - set_swarm_size / set_swarm_turtle: Replace the poses of the turtles told by a script.
+//    - prepare_turtles / draw_turtles: Build the rotated quads of every turtle inside the view, then draw them
+//      in a single call.
+//    - turtle_radius: The radius in screen pixels of the circle a turtle covers at any heading.
+//    - release_sprites: Releases the atlas and the swarm.
+
+#ifndef SWARM_H
+#define SWARM_H
+
+#include <GL/gl.h>
+#include <stdbool.h>
+
+#include "assets.h"
+#include "camera.h"
+
+// Function prototypes
+bool upload_sprites(const AssetImage* images, int count);
+void set_swarm_size(int count);
+void set_swarm_turtle(int index, float x, float y, float angle);
+void prepare_turtles(float x, float y, float angle, CameraView view, float zoom);
+void draw_turtles(void);
+float turtle_radius(void);
+void release_sprites(void);
+
+#endif // SWARM_H
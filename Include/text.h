@@ -5,10 +5,15 @@
 // by rendering text with SDL_ttf and converting it into a format suitable for OpenGL rendering.
 //
 // Key functions:
-//    - init_font: Initializes the font for text rendering from a specified file path and font size.
+//    - bake_font_atlas: Bakes the printable glyphs of a font into an atlas image in memory, without OpenGL.
+//    - use_font_atlas: Uploads a baked atlas and lays out text with its metrics from then on.
+//    - free_font_atlas: Frees the pixels of a baked atlas.
+//    - init_font_layout: Loads a font for build_text_quads alone, without an OpenGL context.
 //    - close_font: Closes the currently loaded font and frees resources.
 //    - render_text: Renders a given text string to an OpenGL texture, returning the texture ID and setting
 //      the text's width and height.
+//    - build_text_quads: Lays out a string as quads sampling the atlas passed to use_font_atlas.
+//    - draw_text_quads: Draws quads built by build_text_quads with a single draw call.
 
 #ifndef TEXT_H
 #define TEXT_H
@@ -17,9 +22,33 @@
 #include <GL/gl.h>
 #include <stdbool.h>  // Add this line
 
+#define ATLAS_FIRST_GLYPH 32                // First character baked into the atlas (space)
+#define ATLAS_LAST_GLYPH 126                // Last character baked into the atlas (tilde)
+#define ATLAS_GLYPH_COUNT (ATLAS_LAST_GLYPH - ATLAS_FIRST_GLYPH + 1)
+
+// Placement of a glyph inside the atlas
+typedef struct {
+    GLfloat u0, v0, u1, v1;   // Texture coordinates of the glyph rectangle
+    int w, h;                 // Size of the glyph rectangle in pixels
+    int advance;              // Horizontal distance to the next glyph in pixels
+} Glyph;
+
+// Glyph atlas baked in memory, before it is uploaded
+typedef struct {
+    Glyph glyphs[ATLAS_GLYPH_COUNT];  // Metrics, indexed by character - ATLAS_FIRST_GLYPH
+    int glyphHeight;                  // Height of a line of text in pixels
+    int width, height;                // Size of the atlas image in pixels
+    Uint8* pixels;                    // RGBA pixels, rows packed tightly
+} FontAtlas;
+
 // Function prototypes
-bool init_font(const char* fontPath, int fontSize);
+bool bake_font_atlas(TTF_Font* ttfFont, FontAtlas* atlas);
+bool use_font_atlas(const FontAtlas* atlas, bool upload);
+void free_font_atlas(FontAtlas* atlas);
+bool init_font_layout(const char* fontPath, int fontSize);
 void close_font();
 GLuint render_text(const char* text, SDL_Color color, int* w, int* h);
+int build_text_quads(const char* text, float x, float y, GLfloat* vertices, GLfloat* texCoords, int maxQuads);
+void draw_text_quads(const GLfloat* vertices, const GLfloat* texCoords, int quadCount, SDL_Color color);
 
 #endif // TEXT_H
@@ -0,0 +1,38 @@
+// Header file for the tiled canvas in the C-TurtleGraphics project.
+//
+// This file declares the canvas used for very large drawings. Instead of one window-sized texture tied to
+// the camera, the drawing is cut into square tiles fixed in drawing coordinates, one grid per zoom level,
+// each level having tiles twice as large as the previous one. Tiles are rasterized from the line store when
+// they first come into view and kept under a memory budget, so panning back over a drawing reuses them
+// and the memory held does not grow with the size of the drawing.
+//
+// Key functions:
+//    - tiles_init / tiles_shutdown: Create the framebuffer object the tiles are drawn through, and release
+//      every tile.
+//    - tiles_active: Reports whether lines are rasterized into tiles.
+//    - tiles_clear: Forgets every tile, which are rasterized again as they come into view.
+//    - tiles_rewind / tiles_truncate: Follow lines extended in place, and lines freed after an undo.
+//    - tiles_update: Rasterizes the tiles in view and the lines they are missing.
+//    - tiles_draw: Draws the tiles in view.
+//    - tiles_pending: Reports whether tiles in view are still waiting to be rasterized.
+
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "camera.h"
+
+// Function prototypes
+bool tiles_init(size_t budgetBytes);
+bool tiles_active(void);
+void tiles_clear(void);
+void tiles_rewind(int firstLine);
+void tiles_truncate(int lineCount);
+void tiles_update(int lineCount, CameraView view, int windowWidth, int windowHeight);
+void tiles_draw(void);
+bool tiles_pending(void);
+void tiles_shutdown(void);
+
+#endif // TILES_H
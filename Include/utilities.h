@@ -7,13 +7,37 @@
 //    - checkOpenGLError: Checks for OpenGL errors after an OpenGL call and prints an error message
 //      if any issues are detected. This helps in debugging OpenGL operations by ensuring that the
 //      rendering process does not encounter errors silently.
+//
+// glGetError waits for the driver to catch up with every command issued before it, so how often it runs
+// is a build setting, GL_ERROR_CHECKS:
+//    - 2: after every checked statement, the default unless NDEBUG is defined.
+//    - 1: on one checked statement in GL_ERROR_SAMPLE_INTERVAL, the default of release builds. OpenGL keeps
+//      an error until it is read, so errors are still reported, with the statement they were found after.
+//    - 0: never; checkOpenGLError compiles to nothing.
 
 #ifndef UTILITIES_H
 #define UTILITIES_H
 
 #include <GL/gl.h>
 
+#ifndef GL_ERROR_CHECKS
+#ifdef NDEBUG
+#define GL_ERROR_CHECKS 1
+#else
+#define GL_ERROR_CHECKS 2
+#endif
+#endif
+
+#define GL_ERROR_SAMPLE_INTERVAL 256  // Checked statements per glGetError call when GL_ERROR_CHECKS is 1
+
 // Function prototypes
-void checkOpenGLError(const char* stmt);
+void (checkOpenGLError)(const char* stmt);
+void check_opengl_error_sampled(const char* stmt);
+
+#if GL_ERROR_CHECKS == 0
+#define checkOpenGLError(stmt) ((void)0)
+#elif GL_ERROR_CHECKS == 1
+#define checkOpenGLError(stmt) check_opengl_error_sampled(stmt)
+#endif
 
 #endif // UTILITIES_H
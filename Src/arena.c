@@ -0,0 +1,394 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * arena.c - Chunked, append-only arrays with optional spilling to disk.
+ *
+ * A growing array backed by realloc has to copy every element each time it crosses its capacity,
+ * which for large arrays means multi-megabyte copies, a visible hitch, and a moment where both the
+ * old and new buffers are alive. An arena instead allocates fixed-size chunks as it grows. Only the
+ * small table of chunk pointers is ever reallocated, and elements never move.
+ *
+ * A chunk can be moved out of memory in two ways. Spilling appends it to a temporary file and frees
+ * it; reading an element of a spilled chunk reloads the whole chunk into a one-chunk cache, which
+ * keeps sequential walks cheap. Discarding frees the chunk for good, for data that is kept elsewhere.
+ *
+ * Key functions:
+ *    - arena_push: Appends an element, allocating a new chunk when the last one is full.
+ *    - arena_at / arena_span: Access elements, one at a time or a chunk-sized run at a time.
+ *    - arena_spill_chunk / arena_discard_chunk: Release the memory of a chunk.
+ */
+
+
+//==================== Header Files ====================
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Function Definitions ====================
+void arena_init(Arena* arena, const size_t elementSize, const int chunkShift) {
+/*
+ * arena_init - Initializes an empty arena.
+ *
+ * No memory is allocated until the first element is pushed.
+ *
+ * Parameters:
+ *    arena       - The arena to initialize.
+ *    elementSize - The size of one element in bytes.
+ *    chunkShift  - log2 of the number of elements per chunk.
+ */
+
+    memset(arena, 0, sizeof(Arena));
+    arena->elementSize = elementSize;
+    arena->chunkShift = chunkShift;
+    arena->cachedChunk = -1;
+}
+
+
+void arena_free(Arena* arena) {
+/*
+ * arena_free - Releases every chunk, the chunk table and the spill file, leaving the arena empty.
+ *
+ * Parameters:
+ *    arena - The arena to release.
+ */
+
+    for (int i = 0; i < arena->chunkCount; i++) {
+        free(arena->chunks[i]);
+    }
+    free(arena->chunks);
+    free(arena->states);
+    free(arena->spillOffsets);
+    free(arena->cache);
+    if (arena->spillFile) {
+        fclose(arena->spillFile);
+    }
+
+    arena_init(arena, arena->elementSize, arena->chunkShift);
+}
+
+
+int arena_chunk_size(const Arena* arena) {
+/*
+ * arena_chunk_size - Returns the number of elements per chunk.
+ */
+
+    return 1 << arena->chunkShift;
+}
+
+
+size_t arena_resident_bytes(const Arena* arena) {
+/*
+ * arena_resident_bytes - Returns the number of bytes held in memory by the arena's chunks.
+ */
+
+    return (size_t)arena->residentChunks * arena->elementSize * (size_t)arena_chunk_size(arena) +
+           (size_t)arena->chunkCapacity * (sizeof(void*) + sizeof(ChunkState) + sizeof(long));
+}
+
+
+static void add_chunk(Arena* arena) {
+/*
+ * add_chunk - Allocates a new chunk at the end of the chunk table.
+ *
+ * The program exits if the memory cannot be allocated, like every other allocation of line data.
+ */
+
+    if (arena->chunkCount == arena->chunkCapacity) {
+        const int newCapacity = arena->chunkCapacity > 0 ? arena->chunkCapacity * 2 : 16;
+        void** chunks = realloc(arena->chunks, (size_t)newCapacity * sizeof(void*));
+        ChunkState* states = chunks ? realloc(arena->states, (size_t)newCapacity * sizeof(ChunkState)) : NULL;
+        long* offsets = states ? realloc(arena->spillOffsets, (size_t)newCapacity * sizeof(long)) : NULL;
+        if (chunks) {
+            arena->chunks = chunks;
+        }
+        if (states) {
+            arena->states = states;
+        }
+        if (!offsets) {
+            printf("Error reallocating memory for the arena chunk table!\n");
+            exit(1);
+        }
+        arena->spillOffsets = offsets;
+        arena->chunkCapacity = newCapacity;
+    }
+
+    void* chunk = malloc(arena->elementSize * (size_t)arena_chunk_size(arena));
+    if (!chunk) {
+        printf("Error allocating memory for an arena chunk!\n");
+        exit(1);
+    }
+
+    arena->chunks[arena->chunkCount] = chunk;
+    arena->states[arena->chunkCount] = CHUNK_RESIDENT;
+    arena->spillOffsets[arena->chunkCount] = -1;
+    arena->chunkCount++;
+    arena->residentChunks++;
+}
+
+
+void* arena_push(Arena* arena) {
+/*
+ * arena_push - Appends an element and returns a pointer to it.
+ *
+ * The element is uninitialized. The pointer stays valid until its chunk is spilled or discarded.
+ *
+ * Parameters:
+ *    arena - The arena to append to.
+ *
+ * Returns:
+ *    A pointer to the new element.
+ */
+
+    const int chunk = arena->count >> arena->chunkShift;
+    if (chunk >= arena->chunkCount) {
+        add_chunk(arena);
+    }
+
+    const int offset = arena->count & (arena_chunk_size(arena) - 1);
+    arena->count++;
+    return (char*)arena->chunks[chunk] + (size_t)offset * arena->elementSize;
+}
+
+
+static void* load_chunk(Arena* arena, const int chunk) {
+/*
+ * load_chunk - Returns the memory of a chunk, reloading it into the cache if it was spilled.
+ *
+ * Returns:
+ *    A pointer to the chunk's elements, or NULL if the chunk was discarded or cannot be read.
+ */
+
+    if (arena->states[chunk] == CHUNK_RESIDENT) {
+        return arena->chunks[chunk];
+    }
+    if (arena->states[chunk] == CHUNK_DISCARDED) {
+        return NULL;
+    }
+    if (arena->cachedChunk == chunk) {
+        return arena->cache;
+    }
+
+    const size_t chunkBytes = arena->elementSize * (size_t)arena_chunk_size(arena);
+    if (!arena->cache) {
+        arena->cache = malloc(chunkBytes);
+        if (!arena->cache) {
+            printf("Error allocating memory for the arena spill cache!\n");
+            exit(1);
+        }
+    }
+
+    if (fseek(arena->spillFile, arena->spillOffsets[chunk], SEEK_SET) != 0 ||
+        fread(arena->cache, 1, chunkBytes, arena->spillFile) != chunkBytes) {
+        printf("Error reading a spilled arena chunk!\n");
+        arena->cachedChunk = -1;
+        return NULL;
+    }
+
+    arena->cachedChunk = chunk;
+    return arena->cache;
+}
+
+
+void* arena_at(Arena* arena, const int index) {
+/*
+ * arena_at - Returns a pointer to an element.
+ *
+ * For an element of a spilled chunk the pointer refers to the reload cache and is only valid until
+ * the next access to another spilled chunk of the same arena.
+ *
+ * Parameters:
+ *    arena - The arena to read from.
+ *    index - Index of the element, between 0 and arena->count - 1.
+ *
+ * Returns:
+ *    A pointer to the element, or NULL if its chunk was discarded.
+ */
+
+    void* element = NULL;
+    arena_span(arena, index, &element);
+    return element;
+}
+
+
+int arena_span(Arena* arena, const int index, void** element) {
+/*
+ * arena_span - Returns a pointer to an element and the number of contiguous elements starting there.
+ *
+ * This lets callers walk an arena chunk by chunk with plain pointer arithmetic.
+ *
+ * Parameters:
+ *    arena   - The arena to read from.
+ *    index   - Index of the first element, between 0 and arena->count - 1.
+ *    element - Receives a pointer to the element, or NULL if its chunk was discarded.
+ *
+ * Returns:
+ *    The number of elements, from `index`, stored contiguously in the same chunk.
+ */
+
+    *element = NULL;
+    if (index < 0 || index >= arena->count) {
+        return 0;
+    }
+
+    const int chunk = index >> arena->chunkShift;
+    const int offset = index & (arena_chunk_size(arena) - 1);
+    char* base = load_chunk(arena, chunk);
+
+    int span = arena_chunk_size(arena) - offset;
+    if (span > arena->count - index) {
+        span = arena->count - index;
+    }
+
+    if (base) {
+        *element = base + (size_t)offset * arena->elementSize;
+    }
+    return span;
+}
+
+
+void arena_truncate(Arena* arena, const int count) {
+/*
+ * arena_truncate - Shrinks the arena to `count` elements, freeing chunks that become empty.
+ *
+ * If the chunk holding the new last element was spilled it is reloaded, since it will be appended
+ * to again. Callers must not truncate into discarded chunks, whose elements are gone.
+ *
+ * Parameters:
+ *    arena - The arena to shrink.
+ *    count - The new number of elements; ignored if not smaller than the current count.
+ */
+
+    if (count < 0 || count >= arena->count) {
+        return;
+    }
+
+    const int keepChunks = (count + arena_chunk_size(arena) - 1) >> arena->chunkShift;
+    for (int i = keepChunks; i < arena->chunkCount; i++) {
+        if (arena->states[i] == CHUNK_RESIDENT) {
+            free(arena->chunks[i]);
+            arena->residentChunks--;
+        }
+        arena->chunks[i] = NULL;
+        if (arena->cachedChunk == i) {
+            arena->cachedChunk = -1;
+        }
+    }
+
+    arena->chunkCount = keepChunks;
+    arena->count = count;
+
+    // The last remaining chunk is appended to again, so it has to be back in memory
+    const int last = keepChunks - 1;
+    if (last >= 0 && arena->states[last] != CHUNK_RESIDENT) {
+        const size_t chunkBytes = arena->elementSize * (size_t)arena_chunk_size(arena);
+        void* chunk = calloc(1, chunkBytes);
+        if (!chunk) {
+            printf("Error allocating memory for an arena chunk!\n");
+            exit(1);
+        }
+        const void* spilled = arena->states[last] == CHUNK_SPILLED ? load_chunk(arena, last) : NULL;
+        if (spilled) {
+            memcpy(chunk, spilled, chunkBytes);
+        }
+        if (arena->cachedChunk == last) {
+            arena->cachedChunk = -1;
+        }
+        arena->chunks[last] = chunk;
+        arena->states[last] = CHUNK_RESIDENT;
+        arena->residentChunks++;
+    }
+}
+
+
+bool arena_spill_chunk(Arena* arena, const int chunk) {
+/*
+ * arena_spill_chunk - Writes a full chunk to the spill file and frees its memory.
+ *
+ * The last chunk is never spilled, since it is still being appended to.
+ *
+ * Parameters:
+ *    arena - The arena owning the chunk.
+ *    chunk - Index of the chunk to spill.
+ *
+ * Returns:
+ *    true if the chunk is no longer in memory, false if it could not be spilled.
+ */
+
+    if (chunk < 0 || chunk >= arena->chunkCount - 1) {
+        return false;
+    }
+    if (arena->states[chunk] != CHUNK_RESIDENT) {
+        return true;
+    }
+
+    if (!arena->spillFile) {
+        arena->spillFile = tmpfile();
+        if (!arena->spillFile) {
+            printf("Error creating the arena spill file!\n");
+            return false;
+        }
+    }
+
+    const size_t chunkBytes = arena->elementSize * (size_t)arena_chunk_size(arena);
+    if (fseek(arena->spillFile, 0, SEEK_END) != 0) {
+        return false;
+    }
+    const long offset = ftell(arena->spillFile);
+    if (offset < 0 || fwrite(arena->chunks[chunk], 1, chunkBytes, arena->spillFile) != chunkBytes) {
+        printf("Error writing an arena chunk to the spill file!\n");
+        return false;
+    }
+
+    free(arena->chunks[chunk]);
+    arena->chunks[chunk] = NULL;
+    arena->states[chunk] = CHUNK_SPILLED;
+    arena->spillOffsets[chunk] = offset;
+    arena->residentChunks--;
+    return true;
+}
+
+
+void arena_discard_chunk(Arena* arena, const int chunk) {
+/*
+ * arena_discard_chunk - Frees a full chunk for good; its elements can no longer be read.
+ *
+ * The last chunk is never discarded, since it is still being appended to.
+ *
+ * Parameters:
+ *    arena - The arena owning the chunk.
+ *    chunk - Index of the chunk to discard.
+ */
+
+    if (chunk < 0 || chunk >= arena->chunkCount - 1 || arena->states[chunk] == CHUNK_DISCARDED) {
+        return;
+    }
+
+    if (arena->states[chunk] == CHUNK_RESIDENT) {
+        free(arena->chunks[chunk]);
+        arena->residentChunks--;
+    }
+    if (arena->cachedChunk == chunk) {
+        arena->cachedChunk = -1;
+    }
+    arena->chunks[chunk] = NULL;
+    arena->states[chunk] = CHUNK_DISCARDED;
+}
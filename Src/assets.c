@@ -0,0 +1,478 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * assets.c - Loading the window's font and sprite images on a worker thread, through an on-disk cache.
+ *
+ * Opening the window used to wait for SDL_ttf to parse the font and bake its glyph atlas, and for
+ * SDL_image to decode and convert the sprite images. Here a worker thread started before the window is
+ * created does that work while the window and its OpenGL context come up and the first frames are drawn.
+ * The render thread polls assets_state every frame and uploads the textures once it reads ASSETS_READY;
+ * until then the turtles and the text overlay are simply not drawn.
+ *
+ * Decoded assets are also written to a cache directory, one file per asset named after a 64-bit FNV-1a
+ * hash of the source file's bytes mixed with everything that shapes the decoded result: the cache
+ * version, the font size, the layout of a glyph and the version of the decoding library. A warm start
+ * reads the file, hashes it and copies the ready RGBA pixels and glyph metrics back, without parsing the
+ * font or decoding a PNG. Editing an asset changes its hash, so a stale entry is never read, only left
+ * behind. A cache file is the header below followed by the glyph metrics of a font and the pixels, in
+ * the native byte order: it is a cache of this machine rather than an exchange format, and a file that
+ * does not match is decoded again and replaced. Entries are written to a temporary file renamed into
+ * place, so a concurrent instance never reads half an entry.
+ *
+ * SDL_image and SDL_ttf are only used by the worker thread while it runs, and assets_stop joins it
+ * before they are shut down.
+ *
+ * Key functions:
+ *    - assets_start: Starts the worker thread.
+ *    - assets_state: Tells, without blocking, whether the assets are ready.
+ *    - assets_font / assets_sprites: The baked glyph atlas and the decoded sprite images.
+ *    - assets_stop: Joins the worker thread and frees the decoded assets.
+ */
+
+
+//==================== Header Files ====================
+#include "assets.h"
+
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+//==================== Macros ====================
+#define FONT_PATH "./Fonts/DejaVuSansMNerdFont-Regular.ttf"
+#define FONT_SIZE 12
+#define SPRITE_IMAGE_COUNT 1              // Number of images in the sprite atlas
+#define CACHE_MAGIC "TRTLASST"            // First bytes of a cache file
+#define CACHE_MAGIC_SIZE 8
+#define CACHE_VERSION 1                   // Raise when decoding or atlas baking changes what is stored
+#define CACHE_PATH_SIZE 4096
+#define FNV_OFFSET 14695981039346656037ULL  // 64-bit FNV-1a parameters
+#define FNV_PRIME 1099511628211ULL
+
+
+//==================== Structure ====================
+typedef struct {  // Start of a cache file
+    char magic[CACHE_MAGIC_SIZE];         // CACHE_MAGIC
+    Uint32 version;                       // CACHE_VERSION
+    Uint32 glyphCount;                    // Glyph metrics following the header, 0 for an image
+    Uint64 key;                           // Hash the file is named after, to catch a misnamed file
+    Sint32 width, height;                 // Size of the pixels following the metrics
+    Sint32 glyphHeight;                   // Line height of a font, 0 for an image
+    Sint32 reserved;                      // Keeps the header free of padding
+} CacheHeader;
+
+
+//==================== Global Variables ====================
+static const char* const spritePaths[SPRITE_IMAGE_COUNT] = {"./Images/mateo.png"}; // Images turtles pick from
+
+static SDL_Thread* assetThread = NULL;    // Worker decoding the assets, NULL when not started
+static SDL_atomic_t state;                // AssetState, published by the worker when it is done
+static const char* cacheDirectory = NULL; // Directory of the cache files, or NULL not to cache
+
+// Written by the worker, then only read by the render thread once the state says ASSETS_READY
+static FontAtlas fontAtlas;
+static AssetImage sprites[SPRITE_IMAGE_COUNT];
+
+
+//==================== Function Definitions ====================
+static Uint64 hash_bytes(Uint64 hash, const void* data, const size_t size) {
+/*
+ * hash_bytes - Folds bytes into a 64-bit FNV-1a hash.
+ */
+
+    const Uint8* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+
+static Uint8* read_file(const char* path, size_t* size) {
+/*
+ * read_file - Reads a whole file into memory.
+ *
+ * Returns:
+ *    The bytes, to be freed by the caller, or NULL after reporting an error.
+ */
+
+    FILE* input = fopen(path, "rb");
+    if (!input) {
+        printf("Could not open %s\n", path);
+        return NULL;
+    }
+
+    Uint8* data = NULL;
+    long length = -1;
+    if (fseek(input, 0, SEEK_END) == 0 && (length = ftell(input)) >= 0 && fseek(input, 0, SEEK_SET) == 0) {
+        data = malloc(length > 0 ? (size_t)length : 1);
+        if (!data) {
+            printf("Error allocating memory for %s!\n", path);
+            exit(1);
+        }
+        if (fread(data, 1, (size_t)length, input) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(input);
+
+    if (!data) {
+        printf("Could not read %s\n", path);
+        return NULL;
+    }
+    *size = (size_t)length;
+    return data;
+}
+
+
+static bool cache_path(char* path, const Uint64 key, const char* suffix) {
+/*
+ * cache_path - Builds the path of the cache file of a key, returning false when caching is off.
+ */
+
+    if (!cacheDirectory) {
+        return false;
+    }
+    const int length = snprintf(path, CACHE_PATH_SIZE, "%s/%016llx%s", cacheDirectory, (unsigned long long)key,
+                                suffix);
+    return length > 0 && length < CACHE_PATH_SIZE;
+}
+
+
+static bool read_cache(const Uint64 key, const char* suffix, CacheHeader* header, Glyph* glyphs,
+                       const Uint32 glyphCount, Uint8** pixels) {
+/*
+ * read_cache - Reads an asset back from its cache file.
+ *
+ * A missing file is a cold start and a file that does not match is treated the same, silently, since
+ * the asset is decoded again and the entry replaced.
+ *
+ * Parameters:
+ *    key        - The hash of the asset.
+ *    suffix     - The extension of the kind of asset.
+ *    header     - Receives the header.
+ *    glyphs     - Receives the glyph metrics of a font, or NULL for an image.
+ *    glyphCount - The number of glyph metrics expected.
+ *    pixels     - Receives the RGBA pixels, to be freed by the caller.
+ *
+ * Returns:
+ *    true if the entry was read whole, false otherwise.
+ */
+
+    char path[CACHE_PATH_SIZE];
+    if (!cache_path(path, key, suffix)) {
+        return false;
+    }
+    FILE* input = fopen(path, "rb");
+    if (!input) {
+        return false;
+    }
+
+    *pixels = NULL;
+    bool valid = fread(header, sizeof(CacheHeader), 1, input) == 1 &&
+                 memcmp(header->magic, CACHE_MAGIC, CACHE_MAGIC_SIZE) == 0 &&
+                 header->version == CACHE_VERSION && header->key == key && header->glyphCount == glyphCount &&
+                 header->width > 0 && header->height > 0 && header->width <= 65536 && header->height <= 65536 &&
+                 (glyphCount == 0 || fread(glyphs, sizeof(Glyph), glyphCount, input) == glyphCount);
+    if (valid) {
+        const size_t bytes = (size_t)header->width * (size_t)header->height * 4;
+        *pixels = malloc(bytes);
+        if (!*pixels) {
+            printf("Error allocating memory for a cached asset!\n");
+            exit(1);
+        }
+        valid = fread(*pixels, 1, bytes, input) == bytes && fgetc(input) == EOF;
+    }
+    fclose(input);
+
+    if (!valid) {
+        free(*pixels);
+        *pixels = NULL;
+    }
+    return valid;
+}
+
+
+static void write_cache(const Uint64 key, const char* suffix, const CacheHeader* header, const Glyph* glyphs,
+                        const Uint8* pixels) {
+/*
+ * write_cache - Stores a decoded asset in its cache file, reporting but otherwise ignoring failures.
+ */
+
+    char path[CACHE_PATH_SIZE], temporary[CACHE_PATH_SIZE + 48];
+    if (!cache_path(path, key, suffix)) {
+        return;
+    }
+    if (mkdir(cacheDirectory, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create the asset cache %s\n", cacheDirectory);
+        return;
+    }
+
+    // Write a temporary file first, so the entry appears whole or not at all; the process and thread ids
+    // keep two instances, or two threads of one, from sharing it
+    snprintf(temporary, sizeof(temporary), "%s.%ld.%lu.tmp", path, (long)getpid(), (unsigned long)SDL_ThreadID());
+    FILE* output = fopen(temporary, "wb");
+    if (!output) {
+        printf("Could not write the asset cache %s\n", temporary);
+        return;
+    }
+    const size_t bytes = (size_t)header->width * (size_t)header->height * 4;
+    bool written = fwrite(header, sizeof(CacheHeader), 1, output) == 1 &&
+                   (header->glyphCount == 0 ||
+                    fwrite(glyphs, sizeof(Glyph), header->glyphCount, output) == header->glyphCount) &&
+                   fwrite(pixels, 1, bytes, output) == bytes;
+    written = fclose(output) == 0 && written;
+    if (!written || rename(temporary, path) != 0) {
+        printf("Could not write the asset cache %s\n", path);
+        remove(temporary);
+    }
+}
+
+
+static CacheHeader make_header(const Uint64 key, const int width, const int height, const int glyphHeight,
+                               const Uint32 glyphCount) {
+/*
+ * make_header - Fills the header of a cache file.
+ */
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+    header.version = CACHE_VERSION;
+    header.glyphCount = glyphCount;
+    header.key = key;
+    header.width = width;
+    header.height = height;
+    header.glyphHeight = glyphHeight;
+    return header;
+}
+
+
+static bool load_font(void) {
+/*
+ * load_font - Bakes the glyph atlas of the window's font, or reads it back from the cache.
+ *
+ * Returns:
+ *    true if `fontAtlas` holds the atlas, false after reporting an error.
+ */
+
+    size_t size;
+    Uint8* data = read_file(FONT_PATH, &size);
+    if (!data) {
+        return false;
+    }
+
+    const SDL_version* library = TTF_Linked_Version();
+    const Uint32 parameters[] = {CACHE_VERSION, FONT_SIZE, ATLAS_GLYPH_COUNT, (Uint32)sizeof(Glyph),
+                                 library->major, library->minor, library->patch};
+    const Uint64 key = hash_bytes(hash_bytes(FNV_OFFSET, data, size), parameters, sizeof(parameters));
+
+    // A warm start copies the baked atlas back without parsing the font
+    CacheHeader header;
+    memset(&fontAtlas, 0, sizeof(fontAtlas));
+    if (read_cache(key, ".font", &header, fontAtlas.glyphs, ATLAS_GLYPH_COUNT, &fontAtlas.pixels)) {
+        fontAtlas.glyphHeight = header.glyphHeight;
+        fontAtlas.width = header.width;
+        fontAtlas.height = header.height;
+        free(data);
+        return true;
+    }
+
+    // The font reads its bytes from memory until it is closed
+    TTF_Font* font = TTF_OpenFontRW(SDL_RWFromConstMem(data, (int)size), 1, FONT_SIZE);
+    if (!font) {
+        printf("Failed to load font! TTF_Error: %s\n", TTF_GetError());
+        free(data);
+        return false;
+    }
+    const bool baked = bake_font_atlas(font, &fontAtlas);
+    TTF_CloseFont(font);
+    free(data);
+    if (!baked) {
+        free_font_atlas(&fontAtlas);
+        return false;
+    }
+
+    header = make_header(key, fontAtlas.width, fontAtlas.height, fontAtlas.glyphHeight, ATLAS_GLYPH_COUNT);
+    write_cache(key, ".font", &header, fontAtlas.glyphs, fontAtlas.pixels);
+    return true;
+}
+
+
+static bool load_image(const char* path, AssetImage* image) {
+/*
+ * load_image - Decodes an image to RGBA, or reads the converted pixels back from the cache.
+ *
+ * Returns:
+ *    true if `image` holds the pixels, false after reporting an error.
+ */
+
+    size_t size;
+    Uint8* data = read_file(path, &size);
+    if (!data) {
+        return false;
+    }
+
+    const SDL_version* library = IMG_Linked_Version();
+    const Uint32 parameters[] = {CACHE_VERSION, library->major, library->minor, library->patch};
+    const Uint64 key = hash_bytes(hash_bytes(FNV_OFFSET, data, size), parameters, sizeof(parameters));
+
+    // A warm start copies the converted pixels back without decoding the image
+    CacheHeader header;
+    if (read_cache(key, ".rgba", &header, NULL, 0, &image->pixels)) {
+        image->w = header.width;
+        image->h = header.height;
+        free(data);
+        return true;
+    }
+
+    SDL_Surface* decoded = IMG_Load_RW(SDL_RWFromConstMem(data, (int)size), 1);
+    SDL_Surface* converted = NULL;
+    if (!decoded) {
+        printf("Error loading image %s: %s\n", path, IMG_GetError());
+    } else {
+        converted = SDL_ConvertSurfaceFormat(decoded, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(decoded);
+        if (!converted) {
+            printf("Error converting surface: %s\n", SDL_GetError());
+        }
+    }
+    free(data);
+    if (!converted) {
+        return false;
+    }
+
+    // Pack the rows tightly, as they are uploaded and cached
+    image->w = converted->w;
+    image->h = converted->h;
+    image->pixels = malloc((size_t)image->w * (size_t)image->h * 4);
+    if (!image->pixels) {
+        printf("Error allocating memory for image %s!\n", path);
+        exit(1);
+    }
+    for (int row = 0; row < image->h; row++) {
+        memcpy(image->pixels + (size_t)row * image->w * 4,
+               (const Uint8*)converted->pixels + (size_t)row * converted->pitch, (size_t)image->w * 4);
+    }
+    SDL_FreeSurface(converted);
+
+    header = make_header(key, image->w, image->h, 0, 0);
+    write_cache(key, ".rgba", &header, NULL, image->pixels);
+    return true;
+}
+
+
+static int asset_main(void* data) {
+/*
+ * asset_main - Body of the worker thread: loads every asset, then publishes the outcome.
+ */
+
+    (void)data;
+
+    bool loaded = load_font();
+    for (int i = 0; loaded && i < SPRITE_IMAGE_COUNT; i++) {
+        loaded = load_image(spritePaths[i], &sprites[i]);
+    }
+
+    // The assets must be visible before the state that publishes them
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&state, loaded ? ASSETS_READY : ASSETS_FAILED);
+    return 0;
+}
+
+
+bool assets_start(const char* cacheDir) {
+/*
+ * assets_start - Starts loading the font and the sprite images on a worker thread.
+ *
+ * SDL_image and SDL_ttf must be initialized, and must not be used elsewhere until assets_stop.
+ *
+ * Parameters:
+ *    cacheDir - The directory the decoded assets are cached in, created when needed, or NULL not to cache.
+ *
+ * Returns:
+ *    true if the thread is running, false after reporting an error.
+ */
+
+    cacheDirectory = cacheDir;
+    SDL_AtomicSet(&state, ASSETS_LOADING);
+    assetThread = SDL_CreateThread(asset_main, "assets", NULL);
+    if (!assetThread) {
+        printf("Error creating the asset thread: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+
+AssetState assets_state(void) {
+/*
+ * assets_state - Returns whether the assets are still loading, ready, or failed to load.
+ */
+
+    const AssetState current = (AssetState)SDL_AtomicGet(&state);
+    SDL_MemoryBarrierAcquire();
+    return current;
+}
+
+
+const FontAtlas* assets_font(void) {
+/*
+ * assets_font - Returns the baked glyph atlas; only valid once assets_state returns ASSETS_READY.
+ */
+
+    return &fontAtlas;
+}
+
+
+const AssetImage* assets_sprites(int* count) {
+/*
+ * assets_sprites - Returns the decoded sprite images; only valid once assets_state returns ASSETS_READY.
+ */
+
+    *count = SPRITE_IMAGE_COUNT;
+    return sprites;
+}
+
+
+void assets_stop(void) {
+/*
+ * assets_stop - Waits for the worker thread to finish and frees the decoded assets.
+ *
+ * The render thread must no longer read them.
+ */
+
+    if (assetThread) {
+        SDL_WaitThread(assetThread, NULL);
+        assetThread = NULL;
+    }
+    free_font_atlas(&fontAtlas);
+    for (int i = 0; i < SPRITE_IMAGE_COUNT; i++) {
+        free(sprites[i].pixels);
+        sprites[i].pixels = NULL;
+    }
+    SDL_AtomicSet(&state, ASSETS_LOADING);
+}
@@ -0,0 +1,550 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * bench.c - Benchmark suite for the drawing pipeline, run without a window.
+ *
+ * turtle_bench runs a fixed set of workloads and reports, for each, the median, 99th percentile and
+ * longest frame time, the segments processed per second and the peak resident memory, in a table meant
+ * to be compared between builds. Nothing here needs a display or an OpenGL context, so the suite runs on
+ * build servers; the GPU's share of a frame is measured in the window with --profile instead.
+ *
+ * A frame is the work the render thread does between two presented frames, done here on the CPU side:
+ *
+ *    - lines-10k, lines-1m, lines-10m: a command program draws that many segments over 1000 frames.
+ *      Each frame runs the program for its share of segments, adds them to the line store, the spatial
+ *      index and the levels of detail as add_line does, and rasterizes them onto a persistent image the
+ *      way the canvas only draws new lines.
+ *    - hud: the status text and the profiler overlay are formatted and laid out as glyph quads every
+ *      frame, for a sprite that moves every frame, so the cached geometry is never reused.
+ *    - resize-storm: a 100k-segment drawing is redrawn at a new window size every frame, as the canvas is
+ *      after a resize: a new image, a query of the spatial index for the view, and every line in it.
+ *
+ * Each workload runs in a child process, so the peak resident memory reported is its own and one
+ * workload cannot disturb the next through the heap. The table is preceded by the movement kernel in use
+ * (see movement.c), which builds with run-time dispatch choose on the machine running them.
+ *
+ * Key functions:
+ *    - main: Parses the workload selection and prints the table.
+ *    - run_workload: Runs one workload and collects its frame times.
+ */
+
+
+//==================== Header Files ====================
+#include "commands.h"
+#include "linestore.h"
+#include "lod.h"
+#include "movement.h"
+#include "profiler.h"
+#include "raster.h"
+#include "spatial.h"
+#include "sprite.h"
+#include "text.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+//==================== Macros ====================
+#define BENCH_WIDTH 800               // Size of the image, matching the initial window
+#define BENCH_HEIGHT 800
+#define BENCH_LINE_FRAMES 1000        // Frames the line workloads are spread over
+#define BENCH_HUD_FRAMES 5000         // Frames of the hud workload
+#define BENCH_HUD_QUADS 768           // Glyph quads reserved for the status text, as in graphics.c
+#define BENCH_RESIZE_LINES 100000     // Segments of the drawing redrawn by resize-storm
+#define BENCH_RESIZE_FRAMES 200       // Resizes of resize-storm
+#define BENCH_ROUND_LINES 1000        // Segments per round of the benchmark program
+#define FONT_PATH "./Fonts/DejaVuSansMNerdFont-Regular.ttf"  // The render thread's font
+#define FONT_SIZE 12
+
+
+//==================== Structure ====================
+typedef enum {  // Kinds of workloads
+    BENCH_LINES,
+    BENCH_HUD,
+    BENCH_RESIZE
+} BenchKind;
+
+typedef struct {  // A workload of the suite
+    const char* name;
+    BenchKind kind;
+    int segments;             // Segments drawn by line workloads
+} Workload;
+
+typedef struct {  // Frame times of a workload as it runs
+    double* samples;          // Frame times in seconds
+    int count;                // Number of frames so far
+    int capacity;             // Number of frames `samples` holds
+    Uint64 last;              // Performance counter value at the end of the previous frame
+} FrameClock;
+
+typedef struct {  // Line workload state handed to the line sink
+    Raster* raster;           // Image the lines are rasterized onto
+    FrameClock* clock;
+    int perFrame;             // Segments per frame
+    int inFrame;              // Segments added in the current frame
+} LineFrames;
+
+typedef struct {  // Result of a workload, sent from the child process
+    bool ok;
+    int frames;
+    double p50, p99, max;     // Frame times in seconds
+    double segmentsPerSecond; // 0 for workloads that draw no segments
+} BenchResult;
+
+
+//==================== Global Variables ====================
+static const Workload workloads[] = {
+    {"lines-10k", BENCH_LINES, 10000},
+    {"lines-1m", BENCH_LINES, 1000000},
+    {"lines-10m", BENCH_LINES, 10000000},
+    {"hud", BENCH_HUD, 0},
+    {"resize-storm", BENCH_RESIZE, BENCH_RESIZE_LINES}
+};
+#define WORKLOAD_COUNT ((int)(sizeof(workloads) / sizeof(workloads[0])))
+
+static LineStoreMode storeMode = LINE_STORE_FULL; // Layout of the line store, chosen on the command line
+
+
+//==================== Function Definitions ====================
+static bool clock_init(FrameClock* clock, const int frames) {
+/*
+ * clock_init - Reserves the frame times of a workload and starts its first frame.
+ */
+
+    clock->samples = malloc(sizeof(double) * (size_t)frames);
+    if (!clock->samples) {
+        printf("Error allocating memory for the frame times!\n");
+        return false;
+    }
+    clock->count = 0;
+    clock->capacity = frames;
+    clock->last = SDL_GetPerformanceCounter();
+    return true;
+}
+
+
+static void clock_frame(FrameClock* clock) {
+/*
+ * clock_frame - Ends a frame, recording the time since the previous one.
+ */
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (clock->count < clock->capacity) {
+        clock->samples[clock->count++] = (double)(now - clock->last) / (double)SDL_GetPerformanceFrequency();
+    }
+    clock->last = now;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+/*
+ * compare_doubles - qsort comparison of two doubles in increasing order.
+ */
+
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+static void clock_result(FrameClock* clock, BenchResult* result) {
+/*
+ * clock_result - Fills the frame time statistics of a result and releases the frame times.
+ */
+
+    result->frames = clock->count;
+    if (clock->count > 0) {
+        qsort(clock->samples, (size_t)clock->count, sizeof(double), compare_doubles);
+        result->p50 = clock->samples[(int)ceil(0.5 * clock->count) - 1];
+        result->p99 = clock->samples[(int)ceil(0.99 * clock->count) - 1];
+        result->max = clock->samples[clock->count - 1];
+    }
+    free(clock->samples);
+    clock->samples = NULL;
+}
+
+
+static bool start_drawing(void) {
+/*
+ * start_drawing - Creates the empty line store, spatial index and levels of detail of a workload.
+ */
+
+    if (!line_store_init(storeMode)) {
+        return false;
+    }
+    spatial_init();
+    lod_init();
+    return true;
+}
+
+
+static void end_drawing(void) {
+/*
+ * end_drawing - Releases the drawing of a workload.
+ */
+
+    line_store_free();
+    spatial_free();
+    lod_free();
+}
+
+
+static void store_line(const Line* line) {
+/*
+ * store_line - Adds a line to the drawing, as add_line does on the render thread.
+ */
+
+    if (line_store_append(line)) {
+        spatial_insert(line_store_count() - 1, line);
+        lod_update();
+    }
+}
+
+
+static void line_frame_sink(const Line* line, void* context) {
+/*
+ * line_frame_sink - Line sink of the line workloads: stores and rasterizes a line, ending frames.
+ */
+
+    LineFrames* frames = context;
+    store_line(line);
+    raster_line(frames->raster, line);
+    if (++frames->inFrame == frames->perFrame) {
+        clock_frame(frames->clock);
+        frames->inFrame = 0;
+    }
+}
+
+
+static void store_sink(const Line* line, void* context) {
+/*
+ * store_sink - Line sink adding lines to the drawing without timing them.
+ */
+
+    (void)context;
+    store_line(line);
+}
+
+
+static bool draw_program(const int segments, const LineSink sink, void* context) {
+/*
+ * draw_program - Runs the benchmark program, a rosette of circles, drawing `segments` segments.
+ *
+ * Each round draws a circle of BENCH_ROUND_LINES segments through the center of the image and turns, so
+ * the lines stay inside the image, cross each other and spread over many cells of the spatial index.
+ */
+
+    char source[128];
+    snprintf(source, sizeof(source), "repeat %d [repeat %d [fd 1.2 rt %g] rt 7]", segments / BENCH_ROUND_LINES,
+             BENCH_ROUND_LINES, 360.0 / BENCH_ROUND_LINES);
+    CommandProgram* program = commands_compile(source, "bench");
+    if (!program) {
+        return false;
+    }
+
+    Turtle turtle;
+    turtle_reset(&turtle, BENCH_WIDTH / 2.0f, BENCH_HEIGHT / 2.0f);
+    const bool executed = commands_run(program, &turtle, sink, context);
+    commands_free(program);
+    return executed;
+}
+
+
+static bool run_lines(const int segments, BenchResult* result) {
+/*
+ * run_lines - Runs a line workload.
+ */
+
+    Raster raster;
+    FrameClock clock;
+    if (!raster_init(&raster, BENCH_WIDTH, BENCH_HEIGHT)) {
+        return false;
+    }
+    if (!start_drawing()) {
+        raster_free(&raster);
+        return false;
+    }
+    if (!clock_init(&clock, BENCH_LINE_FRAMES)) {
+        end_drawing();
+        raster_free(&raster);
+        return false;
+    }
+    raster_clear(&raster, 1.0f, 1.0f, 1.0f);
+
+    LineFrames frames = {&raster, &clock, segments / BENCH_LINE_FRAMES, 0};
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const bool executed = draw_program(segments, line_frame_sink, &frames);
+    const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+    result->segmentsPerSecond = seconds > 0.0 ? (double)segments / seconds : 0.0;
+    clock_result(&clock, result);
+    end_drawing();
+    raster_free(&raster);
+    return executed;
+}
+
+
+static bool run_hud(BenchResult* result) {
+/*
+ * run_hud - Runs the hud workload.
+ */
+
+    if (TTF_Init() == -1) {
+        printf("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
+        return false;
+    }
+    FrameClock clock;
+    if (!init_font_layout(FONT_PATH, FONT_SIZE) || !clock_init(&clock, BENCH_HUD_FRAMES)) {
+        TTF_Quit();
+        return false;
+    }
+
+    // The overlay is fed with the workload's own frames, so it is refreshed at the usual rate
+    profiler_configure(true, true, NULL);
+    static GLfloat vertices[BENCH_HUD_QUADS * 8];
+    static GLfloat texCoords[BENCH_HUD_QUADS * 8];
+    Sprite shown = {BENCH_WIDTH / 2.0f, BENCH_HEIGHT / 2.0f, 0.0f, TURN_LEFT, true, 0.0f, 0.0f, 1.0f};
+    int quads = 0;
+
+    for (int frame = 0; frame < BENCH_HUD_FRAMES; frame++) {
+        shown.angle = fmodf(shown.angle + 1.5f, 360.0f);
+        shown.x += cosf(shown.angle * (float)M_PI / 180.0f);
+        shown.y -= sinf(shown.angle * (float)M_PI / 180.0f);
+
+        unsigned int serial;
+        char text[768];
+        describe_sprite(&shown, text, sizeof(text));
+        const size_t length = strlen(text);
+        snprintf(text + length, sizeof(text) - length, "%s", profiler_overlay_text(&serial));
+        quads += build_text_quads(text, 10.0f, 10.0f, vertices, texCoords, BENCH_HUD_QUADS);
+
+        profiler_frame();
+        clock_frame(&clock);
+    }
+
+    result->segmentsPerSecond = 0.0;
+    clock_result(&clock, result);
+    close_font();
+    TTF_Quit();
+    return quads > 0;
+}
+
+
+static bool run_resize(BenchResult* result) {
+/*
+ * run_resize - Runs the resize-storm workload.
+ */
+
+    static const int sizes[][2] = {{800, 800}, {1024, 640}, {640, 1024}, {1280, 720}, {720, 1280}, {1920, 1080}};
+    const int sizeCount = (int)(sizeof(sizes) / sizeof(sizes[0]));
+
+    FrameClock clock;
+    if (!start_drawing()) {
+        return false;
+    }
+    if (!draw_program(BENCH_RESIZE_LINES, store_sink, NULL) || !clock_init(&clock, BENCH_RESIZE_FRAMES)) {
+        end_drawing();
+        return false;
+    }
+
+    bool ok = true;
+    long redrawn = 0;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    clock.last = start;
+    for (int frame = 0; frame < BENCH_RESIZE_FRAMES && ok; frame++) {
+        const int width = sizes[frame % sizeCount][0];
+        const int height = sizes[frame % sizeCount][1];
+
+        // A new canvas at the new size, with every line inside the view drawn again
+        Raster raster;
+        if (!raster_init(&raster, width, height)) {
+            ok = false;
+            break;
+        }
+        raster_clear(&raster, 1.0f, 1.0f, 1.0f);
+        const int* indices;
+        const int count = spatial_query_box(0.0f, 0.0f, (float)width, (float)height, &indices);
+        for (int i = 0; i < count; i++) {
+            Line line;
+            if (line_store_get(indices[i], &line)) {
+                raster_line(&raster, &line);
+            }
+        }
+        redrawn += count;
+        raster_free(&raster);
+        clock_frame(&clock);
+    }
+    const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+    result->segmentsPerSecond = seconds > 0.0 ? (double)redrawn / seconds : 0.0;
+    clock_result(&clock, result);
+    end_drawing();
+    return ok;
+}
+
+
+static BenchResult run_workload(const Workload* workload) {
+/*
+ * run_workload - Runs one workload in the current process.
+ */
+
+    BenchResult result = {0};
+    switch (workload->kind) {
+        case BENCH_LINES:
+            result.ok = run_lines(workload->segments, &result);
+            break;
+        case BENCH_HUD:
+            result.ok = run_hud(&result);
+            break;
+        case BENCH_RESIZE:
+            result.ok = run_resize(&result);
+            break;
+    }
+    return result;
+}
+
+
+static bool run_isolated(const Workload* workload, BenchResult* result, long* peakKilobytes) {
+/*
+ * run_isolated - Runs one workload in a child process and collects its result and peak memory.
+ *
+ * Returns:
+ *    true if the child ran the workload to the end, false otherwise.
+ */
+
+    int channel[2];
+    if (pipe(channel) != 0) {
+        printf("Error creating the result pipe!\n");
+        return false;
+    }
+
+    fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) {
+        printf("Error starting the workload process!\n");
+        close(channel[0]);
+        close(channel[1]);
+        return false;
+    }
+    if (child == 0) {
+        close(channel[0]);
+        const BenchResult ran = run_workload(workload);
+        const bool sent = write(channel[1], &ran, sizeof(ran)) == (ssize_t)sizeof(ran);
+        close(channel[1]);
+        fflush(stdout);
+
+        // exit rather than _exit, so a build instrumented for profile-guided optimization writes its profile
+        exit(sent && ran.ok ? 0 : 1);
+    }
+
+    close(channel[1]);
+    const bool received = read(channel[0], result, sizeof(*result)) == (ssize_t)sizeof(*result);
+    close(channel[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child) {
+        printf("Error waiting for the workload process!\n");
+        return false;
+    }
+    *peakKilobytes = usage.ru_maxrss;
+    return received && result->ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+static void print_usage(const char* program) {
+/*
+ * print_usage - Prints the command line syntax and the workloads.
+ */
+
+    printf("Usage: %s [--compact-lines] [--workload NAME]...\n"
+           "Workloads:", program);
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        printf(" %s", workloads[i].name);
+    }
+    printf("\n");
+}
+
+
+//==================== Main ====================
+int main(int argc, char* argv[]) {
+
+    // Parse the command line: the layout of the line store and the workloads to run, all by default
+    bool selected[WORKLOAD_COUNT] = {false};
+    bool any = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compact-lines") == 0) {
+            storeMode = LINE_STORE_COMPACT;
+            continue;
+        }
+        int found = -1;
+        if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            i++;
+            for (int w = 0; w < WORKLOAD_COUNT; w++) {
+                if (strcmp(argv[i], workloads[w].name) == 0) {
+                    found = w;
+                }
+            }
+        }
+        if (found < 0) {
+            printf("Unknown option or workload: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        selected[found] = true;
+        any = true;
+    }
+
+    // Builds with run-time dispatch pick the movement kernel on the machine running them
+    printf("movement kernel: %s\n", movement_kernel_name());
+    printf("%-14s %8s %10s %10s %10s %14s %10s\n", "workload", "frames", "p50 ms", "p99 ms", "max ms",
+           "segments/s", "peak MB");
+
+    int failed = 0;
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        if (any && !selected[i]) {
+            continue;
+        }
+
+        BenchResult result = {0};
+        long peakKilobytes = 0;
+        if (!run_isolated(&workloads[i], &result, &peakKilobytes)) {
+            printf("%-14s failed\n", workloads[i].name);
+            failed++;
+            continue;
+        }
+
+        char rate[32] = "-";
+        if (result.segmentsPerSecond > 0.0) {
+            snprintf(rate, sizeof(rate), "%.0f", result.segmentsPerSecond);
+        }
+        printf("%-14s %8d %10.3f %10.3f %10.3f %14s %10.1f\n", workloads[i].name, result.frames,
+               result.p50 * 1e3, result.p99 * 1e3, result.max * 1e3, rate, (double)peakKilobytes / 1024.0);
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * camera.c - Pan and zoom over the unbounded drawing.
+ *
+ * The turtle is no longer confined to the window: lines are stored in drawing coordinates, which keep the
+ * original convention of y growing downward and one unit per pixel at zoom 1. The camera decides which part
+ * of the drawing is visible. Every function that changes the view reloads the projection matrix straight
+ * away, so anything drawn afterwards, including rasterization into the canvas, uses the new view. The shader
+ * backend has no projection matrix and takes the view from camera_view each frame instead (see glcore.c).
+ *
+ * Key functions:
+ *    - camera_apply: Loads the orthographic projection of the current view.
+ *    - camera_pan / camera_zoom_at / camera_follow: Change the view.
+ *    - camera_view: Reports the visible rectangle, for culling and level-of-detail decisions.
+ */
+
+
+//==================== Header Files ====================
+#include "camera.h"
+#include "glproc.h"
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <math.h>
+
+
+//==================== Macros ====================
+#define CAMERA_MIN_ZOOM (1.0f / 1024.0f)  // Furthest zoom out
+#define CAMERA_MAX_ZOOM 64.0f             // Closest zoom in
+
+
+//==================== Global Variables ====================
+static float cameraX = 0.0f;        // Drawing coordinates shown at the center of the window
+static float cameraY = 0.0f;
+static float cameraZoom = 1.0f;     // Window pixels per drawing unit
+
+
+//==================== Function Definitions ====================
+void camera_init(const int windowWidth, const int windowHeight) {
+/*
+ * camera_init - Centers the camera on the initial window at zoom 1.
+ *
+ * With this view drawing coordinates equal window coordinates, as they did before the camera existed.
+ *
+ * Parameters:
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    cameraX = (float)windowWidth / 2.0f;
+    cameraY = (float)windowHeight / 2.0f;
+    cameraZoom = 1.0f;
+}
+
+
+CameraView camera_view(const int windowWidth, const int windowHeight) {
+/*
+ * camera_view - Returns the rectangle of the drawing visible in a window of the given size.
+ *
+ * Parameters:
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ *
+ * Returns:
+ *    The visible rectangle in drawing coordinates.
+ */
+
+    const float halfWidth = (float)windowWidth / (2.0f * cameraZoom);
+    const float halfHeight = (float)windowHeight / (2.0f * cameraZoom);
+    return (CameraView){cameraX - halfWidth, cameraY - halfHeight, cameraX + halfWidth, cameraY + halfHeight};
+}
+
+
+void camera_apply(const int windowWidth, const int windowHeight) {
+/*
+ * camera_apply - Loads the projection matrix for the current view and selects the model-view matrix.
+ *
+ * Parameters:
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    if (glCoreProfile) {
+        return;
+    }
+    const CameraView view = camera_view(windowWidth, windowHeight);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(view.minX, view.maxX, view.maxY, view.minY);
+    glMatrixMode(GL_MODELVIEW);
+}
+
+
+float camera_zoom(void) {
+/*
+ * camera_zoom - Returns the current zoom factor, in window pixels per drawing unit.
+ */
+
+    return cameraZoom;
+}
+
+
+bool camera_view_equal(const CameraView a, const CameraView b) {
+/*
+ * camera_view_equal - Reports whether two views show exactly the same rectangle.
+ */
+
+    return a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY;
+}
+
+
+void camera_pan(const float dx, const float dy, const int windowWidth, const int windowHeight) {
+/*
+ * camera_pan - Moves the view by a distance given in window pixels.
+ *
+ * Parameters:
+ *    dx, dy       - How far the drawing should move on screen, in pixels.
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    cameraX -= dx / cameraZoom;
+    cameraY -= dy / cameraZoom;
+    camera_apply(windowWidth, windowHeight);
+}
+
+
+void camera_zoom_at(const float factor, const int x, const int y, const int windowWidth, const int windowHeight) {
+/*
+ * camera_zoom_at - Zooms the view while keeping the drawing under a window position in place.
+ *
+ * Parameters:
+ *    factor       - Zoom multiplier, greater than 1 to zoom in.
+ *    x, y         - The window position to zoom around, usually the mouse cursor.
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    float anchorX, anchorY;
+    camera_to_world(x, y, windowWidth, windowHeight, &anchorX, &anchorY);
+
+    cameraZoom = fminf(fmaxf(cameraZoom * factor, CAMERA_MIN_ZOOM), CAMERA_MAX_ZOOM);
+
+    // Move the center so that the anchor maps back to (x, y)
+    cameraX = anchorX - ((float)x - (float)windowWidth / 2.0f) / cameraZoom;
+    cameraY = anchorY - ((float)y - (float)windowHeight / 2.0f) / cameraZoom;
+    camera_apply(windowWidth, windowHeight);
+}
+
+
+void camera_follow(const float x, const float y, const float margin, const int windowWidth, const int windowHeight) {
+/*
+ * camera_follow - Pans the view just enough to keep a point inside it.
+ *
+ * The view does not move while the point stays at least `margin` pixels away from the window edges, so
+ * following the turtle does not fight with the user's own panning until the turtle reaches the edge.
+ *
+ * Parameters:
+ *    x, y         - The point to keep visible, in drawing coordinates.
+ *    margin       - The distance to keep from the window edges, in pixels.
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    const CameraView view = camera_view(windowWidth, windowHeight);
+    const float inset = margin / cameraZoom;
+    float dx = 0.0f, dy = 0.0f;
+
+    // Keep the inset below half the view, so very small windows still center the point
+    const float insetX = fminf(inset, (view.maxX - view.minX) / 2.0f);
+    const float insetY = fminf(inset, (view.maxY - view.minY) / 2.0f);
+
+    if (x < view.minX + insetX) {
+        dx = x - (view.minX + insetX);
+    } else if (x > view.maxX - insetX) {
+        dx = x - (view.maxX - insetX);
+    }
+    if (y < view.minY + insetY) {
+        dy = y - (view.minY + insetY);
+    } else if (y > view.maxY - insetY) {
+        dy = y - (view.maxY - insetY);
+    }
+
+    if (dx != 0.0f || dy != 0.0f) {
+        cameraX += dx;
+        cameraY += dy;
+        camera_apply(windowWidth, windowHeight);
+    }
+}
+
+
+void camera_to_world(const int x, const int y, const int windowWidth, const int windowHeight,
+                     float* worldX, float* worldY) {
+/*
+ * camera_to_world - Converts a window position to drawing coordinates.
+ *
+ * Parameters:
+ *    x, y           - The window position in pixels, from the top-left corner.
+ *    windowWidth    - The width of the window in pixels.
+ *    windowHeight   - The height of the window in pixels.
+ *    worldX, worldY - Receive the drawing coordinates.
+ */
+
+    *worldX = cameraX + ((float)x - (float)windowWidth / 2.0f) / cameraZoom;
+    *worldY = cameraY + ((float)y - (float)windowHeight / 2.0f) / cameraZoom;
+}
@@ -0,0 +1,655 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * canvas.c - Persistent render-to-texture canvas for committed lines.
+ *
+ * The turtle never erases, so a line is final as soon as add_line stores it. This file keeps a
+ * window-sized texture attached to a framebuffer object and rasterizes each line into it once.
+ * The renderer then draws the whole drawing as a single textured quad, and only the sprite and
+ * the status text are drawn on top of it every frame.
+ *
+ * The canvas remembers how many lines it already holds and which part of the drawing it shows.
+ * Whenever its contents no longer match the window or the camera (resize, pan, zoom), it is rebuilt
+ * and the visible lines are replayed from the line store, at the level of detail the zoom calls for.
+ * Lines the store has already flattened cannot be replayed, so a rebuild first copies the old canvas
+ * into the new one at its place in the drawing; flattened lines that were outside the old view are lost.
+ *
+ * Undo makes the drawing shorter, which the canvas cannot erase from its pixels. Every
+ * CANVAS_CHECKPOINT_LINES lines it therefore copies itself into a checkpoint texture, keeping the
+ * CANVAS_CHECKPOINTS most recent ones. When the drawing shrinks, the canvas starts again from the
+ * newest checkpoint that is not past the new end and only draws the lines after it; when redo brings
+ * lines back past a checkpoint, the canvas jumps to it instead of drawing the lines in between.
+ * Checkpoints only hold while the view and the lines they show stay the same.
+ *
+ * With --canvas tiled, every function below hands over to the tiled canvas instead (see tiles.c), which
+ * keeps the drawing in tiles fixed in drawing coordinates rather than in one texture tied to the view.
+ *
+ * SDL only reports lost render targets for its own renderer, never for a context made with
+ * SDL_GL_CreateContext. The render thread asks the context itself whether a GPU reset lost it, and replaces
+ * a lost one (see render.c); the canvas is then created again by canvas_init, empty, and replays the lines
+ * as after a resize.
+ *
+ * For partial redraws (see damage.c), an update that only adds lines reports their bounds as the part of the
+ * window that changed, and anything else, a rebuild, a replay or a checkpoint, reports the whole window.
+ *
+ * Key functions:
+ *    - canvas_configure: Chooses between the window-sized and the tiled canvas.
+ *    - canvas_init: Creates the canvas if the context supports framebuffer objects.
+ *    - canvas_resize / canvas_rewind: Schedule a full or partial replay.
+ *    - canvas_truncate / canvas_undo_floor: Follow lines freed after an undo, and report how far undo can go.
+ *    - canvas_update: Follows the camera and rasterizes the lines not yet on the canvas.
+ *    - canvas_draw: Blits the canvas to the window.
+ */
+
+
+//==================== Header Files ====================
+#include "canvas.h"
+#include "camera.h"
+#include "damage.h"
+#include "glproc.h"
+#include "graphics.h"
+#include "linestore.h"
+#include "stats.h"
+#include "tiles.h"
+#include "utilities.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define CANVAS_CHECKPOINTS 4              // Checkpoint textures kept for undo
+#define CANVAS_CHECKPOINT_LINES 20000     // Lines drawn between two checkpoints
+
+
+//==================== Structure ====================
+typedef struct {  // Copy of the canvas taken after a number of lines
+    GLuint textureID;         // Texture holding the copy
+    int lineCount;            // Number of lines on the canvas when it was copied
+} Checkpoint;
+
+
+//==================== Global Variables ====================
+static GLuint canvasFBO = 0;          // Framebuffer object rendering into the canvas texture
+static GLuint canvasTextureID = 0;    // Texture holding the rasterized lines
+static int canvasWidth = 0;           // Width of the canvas texture in pixels
+static int canvasHeight = 0;          // Height of the canvas texture in pixels
+static int canvasLineCount = 0;       // Number of lines already rasterized into the canvas
+static bool canvasNeedsClear = true;  // Whether the canvas must be cleared before the next update
+static CameraView canvasView;         // Part of the drawing rasterized into the canvas
+
+static bool tiledCanvas = false;      // Whether the tiled canvas stands in for this one
+static size_t tileBudget = 0;         // Memory the tiled canvas may hold in bytes
+
+static Checkpoint checkpoints[CANVAS_CHECKPOINTS]; // Checkpoints of the current view, by increasing line count
+static int checkpointCount = 0;       // Number of checkpoints in use
+
+
+//==================== Function Definitions ====================
+static void drop_checkpoints(const int lineCount) {
+/*
+ * drop_checkpoints - Deletes the checkpoints holding more than `lineCount` lines.
+ */
+
+    while (checkpointCount > 0 && checkpoints[checkpointCount - 1].lineCount > lineCount) {
+        checkpointCount--;
+        glDeleteTextures(1, &checkpoints[checkpointCount].textureID);
+        stats_add(STAT_TEXTURES_DELETED, 1);
+    }
+}
+
+
+static void destroy_canvas(void) {
+/*
+ * destroy_canvas - Deletes the canvas texture, its checkpoints and framebuffer object, if they exist.
+ */
+
+    drop_checkpoints(-1);
+
+    if (canvasFBO != 0) {
+        pglDeleteFramebuffers(1, &canvasFBO);
+        canvasFBO = 0;
+    }
+    if (canvasTextureID != 0) {
+        glDeleteTextures(1, &canvasTextureID);
+        stats_add(STAT_TEXTURES_DELETED, 1);
+        canvasTextureID = 0;
+    }
+}
+
+
+static bool create_canvas(const int width, const int height) {
+/*
+ * create_canvas - Creates the canvas texture and framebuffer object for the given size.
+ *
+ * Any existing canvas is deleted first. The new canvas is empty and every line will be
+ * replayed into it on the next call to canvas_update.
+ *
+ * Parameters:
+ *    width  - The width of the canvas in pixels.
+ *    height - The height of the canvas in pixels.
+ *
+ * Returns:
+ *    true if the canvas is complete and usable, false otherwise.
+ */
+
+    destroy_canvas();
+
+    canvasWidth = width > 0 ? width : 1;
+    canvasHeight = height > 0 ? height : 1;
+    canvasLineCount = 0;
+    canvasNeedsClear = true;
+    canvasView = camera_view(canvasWidth, canvasHeight);
+
+    // Allocate the texture that receives the lines
+    glGenTextures(1, &canvasTextureID);
+    stats_add(STAT_TEXTURES_CREATED, 1);
+    glBindTexture(GL_TEXTURE_2D, canvasTextureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, canvasWidth, canvasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    checkOpenGLError("glTexImage2D for canvas");
+
+    // Attach it to a framebuffer object
+    pglGenFramebuffers(1, &canvasFBO);
+    pglBindFramebuffer(GL_FRAMEBUFFER, canvasFBO);
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, canvasTextureID, 0);
+    const GLenum status = pglCheckFramebufferStatus(GL_FRAMEBUFFER);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Canvas framebuffer incomplete (0x%04x), redrawing lines every frame\n", status);
+        destroy_canvas();
+        return false;
+    }
+
+    return true;
+}
+
+
+void canvas_configure(const bool tiled, const size_t budgetBytes) {
+/*
+ * canvas_configure - Chooses the tiled canvas instead of the window-sized one, before the renderer starts.
+ *
+ * Parameters:
+ *    tiled       - Whether lines are rasterized into tiles (see tiles.c).
+ *    budgetBytes - The memory the tile textures may hold.
+ */
+
+    tiledCanvas = tiled;
+    tileBudget = budgetBytes;
+}
+
+
+bool canvas_init(const int windowWidth, const int windowHeight) {
+/*
+ * canvas_init - Creates the canvas for the given window size.
+ *
+ * This function must be called after load_gl_procs. When the context has no framebuffer objects, or
+ * draws through the shader backend, the canvas stays inactive and the renderer keeps drawing every line
+ * each frame.
+ *
+ * Parameters:
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ *
+ * Returns:
+ *    true if the canvas is active, false otherwise.
+ */
+
+    if (!glHasFramebufferObjects || glCoreProfile) {
+        return false;
+    }
+    if (tiledCanvas) {
+        canvasWidth = windowWidth;
+        canvasHeight = windowHeight;
+        return tiles_init(tileBudget);
+    }
+    return create_canvas(windowWidth, windowHeight);
+}
+
+
+bool canvas_active(void) {
+/*
+ * canvas_active - Reports whether lines are rasterized into the canvas.
+ *
+ * Returns:
+ *    true if the canvas exists, false if the renderer must draw every line itself.
+ */
+
+    return tiledCanvas ? tiles_active() : canvasFBO != 0;
+}
+
+
+static void draw_texture(const GLuint textureID, const CameraView view) {
+/*
+ * draw_texture - Draws a canvas texture over the part of the drawing it shows.
+ *
+ * The texture is stored bottom-up like any framebuffer, so the top of the view samples t = 1.
+ * The current projection must be the camera's.
+ */
+
+    const GLfloat vertices[] = {
+        view.minX, view.maxY,
+        view.maxX, view.maxY,
+        view.maxX, view.minY,
+        view.minX, view.minY
+    };
+
+    const GLfloat texCoords[] = {
+        0.0f, 0.0f,  // Bottom-left
+        1.0f, 0.0f,  // Bottom-right
+        1.0f, 1.0f,  // Top-right
+        0.0f, 1.0f   // Top-left
+    };
+
+    glEnable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+
+    glDrawArrays(GL_QUADS, 0, 4);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glEnable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+}
+
+
+static void rebuild_canvas(const int width, const int height) {
+/*
+ * rebuild_canvas - Recreates the canvas for a new size or camera view.
+ *
+ * Lines the store discarded exist only on the canvas, so when there are any the old texture is kept
+ * long enough to draw it into the new canvas. The remaining lines are then replayed over it on the
+ * next update.
+ *
+ * Parameters:
+ *    width  - The width of the new canvas in pixels.
+ *    height - The height of the new canvas in pixels.
+ */
+
+    const int flattened = line_store_first();
+    const CameraView oldView = canvasView;
+    const GLuint oldTextureID = canvasTextureID;
+    if (flattened > 0) {
+        canvasTextureID = 0;
+    }
+
+    if (!create_canvas(width, height) || flattened == 0) {
+        if (flattened > 0) {
+            glDeleteTextures(1, &oldTextureID);
+            stats_add(STAT_TEXTURES_DELETED, 1);
+        }
+        return;
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, canvasFBO);
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw_texture(oldTextureID, oldView);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glDeleteTextures(1, &oldTextureID);
+    stats_add(STAT_TEXTURES_DELETED, 1);
+    checkOpenGLError("rebuild_canvas");
+
+    // The flattened lines are on the new canvas, the others are replayed at full quality
+    canvasLineCount = flattened;
+    canvasNeedsClear = false;
+}
+
+
+void canvas_resize(const int windowWidth, const int windowHeight) {
+/*
+ * canvas_resize - Recreates the canvas for a new window size.
+ *
+ * The canvas texture always matches the window, so a resize reallocates it. The visible lines are
+ * replayed into the new texture on the next update.
+ *
+ * Parameters:
+ *    windowWidth  - The new width of the window in pixels.
+ *    windowHeight - The new height of the window in pixels.
+ */
+
+    if (tiledCanvas) {
+        canvasWidth = windowWidth;
+        canvasHeight = windowHeight;
+        return;
+    }
+    if (!canvas_active() || (windowWidth == canvasWidth && windowHeight == canvasHeight)) {
+        return;
+    }
+    rebuild_canvas(windowWidth, windowHeight);
+}
+
+
+void canvas_rewind(const int firstLine) {
+/*
+ * canvas_rewind - Schedules the lines from `firstLine` onward to be rasterized again.
+ *
+ * This is used when lines that are already on the canvas are modified in place. Since lines are
+ * only ever extended, drawing them again over their previous pixels is enough.
+ *
+ * Parameters:
+ *    firstLine - Index of the first line to rasterize again.
+ */
+
+    if (tiledCanvas) {
+        tiles_rewind(firstLine);
+        return;
+    }
+    if (firstLine < canvasLineCount) {
+        canvasLineCount = firstLine > 0 ? firstLine : 0;
+    }
+    drop_checkpoints(firstLine);
+}
+
+
+void canvas_truncate(const int lineCount) {
+/*
+ * canvas_truncate - Forgets the lines from `lineCount` onward, once the store freed the lines undone.
+ *
+ * New lines are about to take their indices, so the checkpoints showing them are dropped, and a canvas
+ * still showing them starts again from an older checkpoint on the next update.
+ *
+ * Parameters:
+ *    lineCount - The number of lines the store keeps.
+ */
+
+    if (tiledCanvas) {
+        tiles_truncate(lineCount);
+        return;
+    }
+    drop_checkpoints(lineCount);
+    if (canvasLineCount > lineCount) {
+        canvasLineCount = 0;
+        canvasNeedsClear = true;
+    }
+}
+
+
+int canvas_undo_floor(void) {
+/*
+ * canvas_undo_floor - Returns the fewest lines the drawing can be cut back to without losing pixels.
+ *
+ * Once the store has flattened lines, they only exist on the canvas and cannot be drawn again, so the
+ * canvas can only go back to a checkpoint taken after them, or not at all.
+ *
+ * Returns:
+ *    The smallest line count undo may leave.
+ */
+
+    const int first = line_store_first();
+    if (!canvas_active() || first == 0) {
+        return first;
+    }
+    for (int i = 0; i < checkpointCount; i++) {
+        if (checkpoints[i].lineCount >= first) {
+            return checkpoints[i].lineCount;
+        }
+    }
+    return canvasLineCount > first ? canvasLineCount : first;
+}
+
+
+static void restore_checkpoint(const int lineCount) {
+/*
+ * restore_checkpoint - Restarts the canvas from the newest checkpoint holding at most `lineCount` lines.
+ *
+ * This is needed when the canvas is cleared or shows more lines than the drawing has, and worth it when
+ * the checkpoint is ahead of the canvas. The framebuffer object must be bound.
+ */
+
+    int best = checkpointCount - 1;
+    while (best >= 0 && checkpoints[best].lineCount > lineCount) {
+        best--;
+    }
+
+    const bool goBack = canvasNeedsClear || lineCount < canvasLineCount;
+    if (best < 0 || (!goBack && checkpoints[best].lineCount <= canvasLineCount)) {
+        if (goBack) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            canvasLineCount = 0;
+            canvasNeedsClear = false;
+        }
+        return;
+    }
+
+    draw_texture(checkpoints[best].textureID, canvasView);
+    canvasLineCount = checkpoints[best].lineCount;
+    canvasNeedsClear = false;
+}
+
+
+static void take_checkpoint(void) {
+/*
+ * take_checkpoint - Copies the canvas into a new checkpoint, reusing the oldest one when all are taken.
+ *
+ * The framebuffer object must be bound.
+ */
+
+    GLuint textureID = 0;
+    if (checkpointCount == CANVAS_CHECKPOINTS) {
+        textureID = checkpoints[0].textureID;
+        memmove(&checkpoints[0], &checkpoints[1], (size_t)(CANVAS_CHECKPOINTS - 1) * sizeof(Checkpoint));
+        checkpointCount--;
+    } else {
+        glGenTextures(1, &textureID);
+        stats_add(STAT_TEXTURES_CREATED, 1);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, canvasWidth, canvasHeight, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Checkpoints past the canvas still hold lines hidden by undo, keep the list sorted
+    int slot = checkpointCount;
+    while (slot > 0 && checkpoints[slot - 1].lineCount > canvasLineCount) {
+        checkpoints[slot] = checkpoints[slot - 1];
+        slot--;
+    }
+    checkpoints[slot] = (Checkpoint){textureID, canvasLineCount};
+    checkpointCount++;
+    checkOpenGLError("take_checkpoint");
+}
+
+
+static bool checkpoint_due(void) {
+/*
+ * checkpoint_due - Reports whether the canvas is CANVAS_CHECKPOINT_LINES past its newest checkpoint.
+ */
+
+    int newest = 0;
+    for (int i = 0; i < checkpointCount; i++) {
+        if (checkpoints[i].lineCount == canvasLineCount) {
+            return false;
+        }
+        if (checkpoints[i].lineCount < canvasLineCount) {
+            newest = checkpoints[i].lineCount;
+        }
+    }
+    return canvasLineCount - newest >= CANVAS_CHECKPOINT_LINES;
+}
+
+
+static void damage_lines(const int first, const int end) {
+/*
+ * damage_lines - Reports the window area of the lines [first, end) as changed, for partial redraws.
+ */
+
+    if (!damage_enabled() || first >= end) {
+        return;
+    }
+
+    Line line;
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = first; i < end; i++) {
+        if (line_store_get(i, &line)) {
+            minX = fminf(minX, fminf(line.x1, line.x2));
+            minY = fminf(minY, fminf(line.y1, line.y2));
+            maxX = fmaxf(maxX, fmaxf(line.x1, line.x2));
+            maxY = fmaxf(maxY, fmaxf(line.y1, line.y2));
+        }
+    }
+    if (minX <= maxX) {
+        damage_drawing_rect(canvasView, canvasWidth, canvasHeight, minX, minY, maxX, maxY, lineWidth / 2.0f + 1.0f);
+    }
+}
+
+
+int canvas_line_count(void) {
+/*
+ * canvas_line_count - Returns the number of leading lines already rasterized into the canvas.
+ *
+ * The tiled canvas draws tiles again from the store, so it never holds lines the store could free.
+ *
+ * Returns:
+ *    The number of lines on the canvas, or 0 if the canvas is inactive or tiled.
+ */
+
+    return canvas_active() && !tiledCanvas ? canvasLineCount : 0;
+}
+
+
+void canvas_update(const int lineCount) {
+/*
+ * canvas_update - Rasterizes the lines that are not yet on the canvas.
+ *
+ * Only the lines in the range [canvasLineCount, lineCount) are drawn. If the camera moved since the
+ * last update the canvas is rebuilt for the new view first, and if the drawing got shorter the canvas
+ * goes back to a checkpoint. The canvas uses the same viewport and projection as the window, so the
+ * current matrices are left untouched.
+ *
+ * Parameters:
+ *    lineCount - The number of lines currently stored.
+ */
+
+    if (!canvas_active()) {
+        return;
+    }
+    if (tiledCanvas) {
+        tiles_update(lineCount, camera_view(canvasWidth, canvasHeight), canvasWidth, canvasHeight);
+        return;
+    }
+
+    // The camera moved since the canvas was drawn
+    if (!camera_view_equal(canvasView, camera_view(canvasWidth, canvasHeight))) {
+        rebuild_canvas(canvasWidth, canvasHeight);
+        damage_all();
+    }
+
+    if (!canvasNeedsClear && canvasLineCount == lineCount) {
+        return;
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, canvasFBO);
+
+    // Fewer lines than rasterized means lines were undone, so start again from a checkpoint or from scratch
+    const int drawnBefore = canvasLineCount;
+    const bool cleared = canvasNeedsClear;
+    restore_checkpoint(lineCount);
+    const bool restarted = cleared || canvasLineCount != drawnBefore;
+    if (restarted) {
+        damage_all();
+    }
+
+    // A full replay only draws what is in view, new lines since the last update are drawn as they are
+    glDisable(GL_TEXTURE_2D);
+    if (canvasLineCount <= line_store_first()) {
+        draw_visible_lines(canvasView.minX, canvasView.minY, canvasView.maxX, canvasView.maxY);
+        damage_all();
+    } else if (canvasLineCount < lineCount) {
+        draw_line_range(canvasLineCount, lineCount - canvasLineCount);
+        if (!restarted) {
+            damage_lines(canvasLineCount, lineCount);
+        }
+    }
+    canvasLineCount = lineCount;
+    if (checkpoint_due()) {
+        take_checkpoint();
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    checkOpenGLError("canvas_update");
+}
+
+
+void canvas_draw(void) {
+/*
+ * canvas_draw - Draws the canvas texture over the part of the drawing it shows.
+ *
+ * After canvas_update the canvas shows the camera's view, so the texture covers the whole window.
+ */
+
+    if (!canvas_active()) {
+        return;
+    }
+    if (tiledCanvas) {
+        tiles_draw();
+        return;
+    }
+
+    draw_texture(canvasTextureID, canvasView);
+    checkOpenGLError("canvas_draw");
+}
+
+
+bool canvas_pending(void) {
+/*
+ * canvas_pending - Reports whether the canvas still has lines in view to rasterize on a later frame.
+ *
+ * Only the tiled canvas spreads its work over frames; the window-sized one is always complete.
+ */
+
+    return tiledCanvas && tiles_pending();
+}
+
+
+void canvas_shutdown(void) {
+/*
+ * canvas_shutdown - Releases the canvas texture and framebuffer object.
+ *
+ * This function must be called while the OpenGL context is still current.
+ */
+
+    if (tiledCanvas) {
+        tiles_shutdown();
+        return;
+    }
+    destroy_canvas();
+    canvasLineCount = 0;
+    canvasNeedsClear = true;
+}
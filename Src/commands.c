@@ -0,0 +1,1493 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * commands.c - The turtle command language: a compiler to bytecode and the interpreter that runs it.
+ *
+ * Programs are written in a small Logo dialect made of whitespace-separated words. '#' starts a comment
+ * that runs to the end of the line, and several commands may share a line.
+ *
+ *    forward N (fd)     Move N units along the heading, drawing a line if the pen is down.
+ *    back N (bk)        Move N units backward.
+ *    left D (lt)        Turn D degrees counterclockwise.
+ *    right D (rt)       Turn D degrees clockwise.
+ *    penup (pu)         Stop drawing.
+ *    pendown (pd)       Start drawing.
+ *    color N            Select preset color N, 1 (Black) to 5 (Yellow), as the number keys do.
+ *    rgb R G B          Select a color from components between 0 and 1.
+ *    setxy X Y          Move to a position, drawing a line if the pen is down.
+ *    setheading D (seth) Face D degrees counterclockwise from east.
+ *    home               Return to the home position facing east, without drawing.
+ *    repeat N [ ... ]   Run the bracketed commands N times; repcount is the current round, from 1.
+ *    if C [ ... ]       Run the bracketed commands if C is not zero.
+ *    ifelse C [ ... ] [ ... ]
+ *                       Run the first or the second bracketed commands.
+ *    to NAME :A :B ... end
+ *                       Define a procedure with parameters, called as NAME followed by its arguments.
+ *    stop               Return from the current procedure, or end the program at the top level.
+ *    tell N             Send the commands that follow to turtle N. Turtle 0 is the one the program starts
+ *                       with; a new turtle hatches at turtle 0's home, facing east with the pen down in black.
+ *
+ * Arguments are expressions made of numbers, parameters, repcount, who (the number of the turtle being
+ * told), parentheses, + - * / and the comparisons < > =, which give 1 or 0. As in Logo, a '-' with a
+ * space before it and none after it negates the next value, so "setxy 10 -5" takes two arguments.
+ * Headings follow the interactive turtle: 0 degrees faces east and y grows downward on screen.
+ *
+ * A program is tokenized, its procedure headers are collected so that procedures can be called before
+ * they are defined, and it is compiled in one pass to bytecode for a stack machine. Instructions are eight
+ * bytes, an opcode and one operand, with expressions of constants folded at compile time. The interpreter
+ * keeps the turtle in local variables and queues its moves: turns only change the heading, and runs of
+ * up to MOVE_BATCH_SIZE moves are turned into positions together by movement_batch (see movement.c)
+ * before the lines are handed straight to the sink. Anything that reads the position, the pen or the
+ * color computes the queued moves first, so recursive drawings of millions of lines run in a fraction of
+ * the time it takes to draw them. Turtles other than turtle 0 wait in a swarm while another one is told;
+ * tell writes the running turtle back and loads the next one, so one turtle costs nothing extra.
+ *
+ * Key functions:
+ *    - turtle_reset: Sets up a turtle at its home position.
+ *    - commands_compile / commands_load: Compile a program from a string or a stream.
+ *    - commands_decode: Builds a program from commands in their binary form.
+ *    - commands_run / commands_run_swarm: Run a compiled program with one turtle or with a swarm.
+ *    - swarm_free: Releases the turtles of a swarm.
+ *    - commands_free: Releases a compiled program.
+ *    - run_command_stream: Compiles and runs a stream.
+ */
+
+
+//==================== Header Files ====================
+#include "commands.h"
+#include "movement.h"
+#include "sprite.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define READ_CHUNK_SIZE 65536       // Bytes read from a stream at a time
+#define MAX_PARAMETERS 16           // Most parameters of a procedure
+#define VALUE_STACK_SIZE 65536      // Most values held at once by expressions and procedure parameters
+#define CALL_STACK_SIZE 4096        // Deepest nesting of procedure calls
+#define LOOP_STACK_SIZE 4096        // Deepest nesting of running repeat loops
+#define MOVE_BATCH_SIZE 256         // Most moves queued before their positions are computed
+#define MAX_TURTLES 65536           // Most turtles a program can tell, turtle 0 included
+#define CANCEL_CHECK_INTERVAL 65536 // Instructions run between two looks at the cancel flag
+
+
+//==================== Structure ====================
+typedef enum {  // Kind of a token
+    TOKEN_WORD,               // A command, keyword or procedure name
+    TOKEN_NUMBER,             // A numeric literal
+    TOKEN_VARIABLE,           // A parameter reference, ":name" without the colon
+    TOKEN_SYMBOL,             // One of [ ] ( ) + - * / < > =
+    TOKEN_END                 // The end of the program
+} TokenType;
+
+typedef struct {  // Token of a program
+    TokenType type;
+    const char* text;         // Start of the token in the source
+    int length;               // Length of the token in the source
+    float number;             // Value of a number token
+    bool prefix;              // Whether a '-' negates the next value instead of subtracting
+    int line;                 // Line of the source the token is on
+} Token;
+
+typedef enum {  // Operation performed by an instruction
+    OP_PUSH,                  // Push `value`
+    OP_LOAD,                  // Push parameter `index` of the running procedure
+    OP_REPCOUNT,              // Push the round of the innermost repeat loop
+    OP_WHO,                   // Push the number of the turtle being told
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_NEGATE,
+    OP_LESS,
+    OP_GREATER,
+    OP_EQUAL,
+    OP_FORWARD,
+    OP_BACK,
+    OP_LEFT,
+    OP_RIGHT,
+    OP_PENUP,
+    OP_PENDOWN,
+    OP_COLOR,
+    OP_RGB,
+    OP_SETXY,
+    OP_SETHEADING,
+    OP_HOME,
+    OP_TELL,
+    OP_JUMP,                  // Continue at `index`
+    OP_JUMP_IF_FALSE,         // Pop a value and continue at `index` if it is zero
+    OP_REPEAT,                // Pop a count and start a loop, or continue at `index` if it is below one
+    OP_LOOP,                  // End a round of the innermost loop, continuing at `index` if rounds remain
+    OP_CALL,                  // Call procedure `index` with its arguments on the stack
+    OP_RETURN,                // Return from the running procedure
+    OP_HALT                   // End the program
+} Opcode;
+
+typedef struct {  // Bytecode instruction
+    uint32_t op;              // The Opcode
+    union {
+        float value;          // Operand of OP_PUSH
+        int32_t index;        // Operand of the other instructions that take one
+    };
+} Instruction;
+
+typedef struct {  // Compiled procedure
+    int entry;                // Index of the first instruction of the body
+    int parameterCount;       // Number of parameters, popped from the stack by the call
+} Procedure;
+
+struct CommandProgram {
+    char* name;               // Name of the source, used in error messages
+    Instruction* code;        // Instructions, starting with the top level
+    int* lines;               // Source line of each instruction, for error messages
+    int length;               // Number of instructions
+    int capacity;             // Number of instructions allocated
+    Procedure* procedures;    // Procedures, indexed by OP_CALL
+    int procedureCount;       // Number of procedures
+};
+
+typedef struct {  // Entry of the command table
+    const char* name;         // Full name of the command
+    const char* alias;        // Short name, or NULL
+    Opcode op;                // Instruction performing the command
+    int argCount;             // Number of arguments
+} CommandInfo;
+
+typedef struct {  // State of the compiler
+    const char* name;         // Name of the source, used in error messages
+    const Token* tokens;      // Tokens of the source, ending with TOKEN_END
+    int position;             // Index of the next token
+    CommandProgram* program;  // Program being compiled
+    const Token** procedureNames; // Name token of each procedure, parallel to program->procedures
+    int procedureCapacity;    // Number of procedures allocated
+    int procedure;            // Procedure being compiled, -1 at the top level
+    const Token* parameters[MAX_PARAMETERS]; // Parameters of the procedure being compiled
+    int parameterCount;       // Number of parameters of the procedure being compiled
+    int blockDepth;           // Nesting of bracketed blocks around the current statement
+    int loopDepth;            // Nesting of repeat loops around the current statement
+} Compiler;
+
+typedef struct {  // Running procedure call
+    int returnAddress;        // Instruction following the call
+    int base;                 // Stack index of the first parameter of the callee
+    int callerBase;           // Stack index of the first parameter of the caller
+    int loopDepth;            // Running loops of the caller
+} CallFrame;
+
+typedef struct {  // Running repeat loop
+    int remaining;            // Rounds left, including the current one
+    int total;                // Rounds in all
+} LoopFrame;
+
+typedef struct {  // Moves queued by the interpreter until their positions are needed
+    float headings[MOVE_BATCH_SIZE];
+    float distances[MOVE_BATCH_SIZE];   // Negative for moves backward
+    float xs[MOVE_BATCH_SIZE];          // Position after each move, filled by flush_moves
+    float ys[MOVE_BATCH_SIZE];
+    int count;
+    bool overflowed;                    // Whether a move led to a position that is not a finite number
+} MoveBatch;
+
+
+//==================== Global Variables ====================
+static const CommandInfo commandTable[] = {
+    {"forward", "fd", OP_FORWARD, 1},
+    {"back", "bk", OP_BACK, 1},
+    {"left", "lt", OP_LEFT, 1},
+    {"right", "rt", OP_RIGHT, 1},
+    {"penup", "pu", OP_PENUP, 0},
+    {"pendown", "pd", OP_PENDOWN, 0},
+    {"color", NULL, OP_COLOR, 1},
+    {"rgb", NULL, OP_RGB, 3},
+    {"setxy", NULL, OP_SETXY, 2},
+    {"setheading", "seth", OP_SETHEADING, 1},
+    {"home", NULL, OP_HOME, 0},
+    {"tell", NULL, OP_TELL, 1}
+};
+
+// Words that cannot name a procedure
+static const char* const keywords[] = {"to", "end", "repeat", "if", "ifelse", "stop", "repcount", "who"};
+
+
+//==================== Function Definitions ====================
+void turtle_reset(Turtle* turtle, const float homeX, const float homeY) {
+/*
+ * turtle_reset - Places a turtle at its home position, facing east with the pen down in black.
+ *
+ * Unlike the interactive turtle, a command-driven turtle starts with the pen down, as in Logo.
+ *
+ * Parameters:
+ *    turtle       - The turtle to reset.
+ *    homeX, homeY - The home position in drawing coordinates.
+ */
+
+    *turtle = (Turtle){homeX, homeY, 0.0f, true, 0.0f, 0.0f, 0.0f, homeX, homeY};
+}
+
+
+static bool token_is(const Token* token, const char* word) {
+/*
+ * token_is - Tells whether a token is the given word.
+ */
+
+    return token->type == TOKEN_WORD && (int)strlen(word) == token->length &&
+           strncmp(token->text, word, (size_t)token->length) == 0;
+}
+
+
+static bool symbol_is(const Token* token, const char symbol) {
+/*
+ * symbol_is - Tells whether a token is the given symbol.
+ */
+
+    return token->type == TOKEN_SYMBOL && token->text[0] == symbol;
+}
+
+
+static bool is_delimiter(const char c) {
+/*
+ * is_delimiter - Tells whether a character ends a word, a number or a parameter reference.
+ */
+
+    return c == '\0' || c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#' || strchr("[]()+-*/<>=", c);
+}
+
+
+static bool report(const char* name, const int line, const char* format, ...) {
+/*
+ * report - Prints an error located at a line of a source.
+ *
+ * Returns:
+ *    false, so that callers can report and fail in one statement.
+ */
+
+    va_list args;
+    va_start(args, format);
+    printf("%s:%d: ", name, line);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    return false;
+}
+
+
+static Token* tokenize(const char* source, const char* name, int* count) {
+/*
+ * tokenize - Splits a source into tokens.
+ *
+ * Parameters:
+ *    source - The NUL-terminated source.
+ *    name   - The name of the source, used in error messages.
+ *    count  - Receives the number of tokens, not counting the final TOKEN_END.
+ *
+ * Returns:
+ *    The tokens, ending with a TOKEN_END token, to be freed by the caller, or NULL after reporting an
+ *    invalid token.
+ */
+
+    int capacity = 1024;
+    int length = 0;
+    Token* tokens = malloc((size_t)capacity * sizeof(Token));
+    if (!tokens) {
+        printf("Error allocating memory for program tokens!\n");
+        exit(1);
+    }
+
+    const char* p = source;
+    int line = 1;
+    for (;;) {
+        // Skip whitespace and comments
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '#') {
+            if (*p == '#') {
+                p += strcspn(p, "\n");
+            } else {
+                line += *p == '\n';
+                p++;
+            }
+        }
+
+        if (length == capacity) {
+            capacity *= 2;
+            Token* newTokens = realloc(tokens, (size_t)capacity * sizeof(Token));
+            if (!newTokens) {
+                printf("Error reallocating memory for program tokens!\n");
+                exit(1);
+            }
+            tokens = newTokens;
+        }
+
+        Token* token = &tokens[length];
+        *token = (Token){TOKEN_END, p, 0, 0.0f, false, line};
+        if (*p == '\0') {
+            break;
+        }
+
+        if (strchr("[]()+-*/<>=", *p)) {
+            token->type = TOKEN_SYMBOL;
+            token->length = 1;
+            if (*p == '-') {
+                const bool spaceBefore = p == source || strchr(" \t\r\n[(", p[-1]);
+                token->prefix = spaceBefore && !is_delimiter(p[1]);
+            }
+        } else if ((*p >= '0' && *p <= '9') || (*p == '.' && p[1] >= '0' && p[1] <= '9')) {
+            char* end = NULL;
+            token->type = TOKEN_NUMBER;
+            token->number = strtof(p, &end);
+            token->length = (int)(end - p);
+            if (!is_delimiter(*end)) {
+                const int wordLength = (int)(end - p) + (int)strcspn(end, " \t\r\n#[]()+-*/<>=");
+                report(name, line, "invalid number '%.*s'", wordLength, p);
+                free(tokens);
+                return NULL;
+            }
+            if (!isfinite(token->number)) {
+                report(name, line, "number '%.*s' is too large", token->length, p);
+                free(tokens);
+                return NULL;
+            }
+        } else if (*p == ':') {
+            token->type = TOKEN_VARIABLE;
+            token->text = p + 1;
+            while (!is_delimiter(token->text[token->length])) {
+                token->length++;
+            }
+            if (token->length == 0) {
+                report(name, line, "':' must be followed by a parameter name");
+                free(tokens);
+                return NULL;
+            }
+            p++;
+        } else {
+            token->type = TOKEN_WORD;
+            while (!is_delimiter(p[token->length])) {
+                token->length++;
+            }
+        }
+
+        p += token->length;
+        length++;
+    }
+
+    *count = length;
+    return tokens;
+}
+
+
+static const CommandInfo* find_command(const Token* token) {
+/*
+ * find_command - Looks up a built-in command by its name or alias.
+ */
+
+    for (size_t i = 0; i < sizeof(commandTable) / sizeof(commandTable[0]); i++) {
+        if (token_is(token, commandTable[i].name) ||
+            (commandTable[i].alias && token_is(token, commandTable[i].alias))) {
+            return &commandTable[i];
+        }
+    }
+    return NULL;
+}
+
+
+static int find_procedure(const Compiler* compiler, const Token* token) {
+/*
+ * find_procedure - Looks up a procedure by name.
+ *
+ * Returns:
+ *    The index of the procedure, or -1 if there is none with this name.
+ */
+
+    for (int i = 0; i < compiler->program->procedureCount; i++) {
+        const Token* name = compiler->procedureNames[i];
+        if (name->length == token->length && strncmp(name->text, token->text, (size_t)token->length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static bool declare_procedures(Compiler* compiler) {
+/*
+ * declare_procedures - Collects the name and parameter count of every procedure before compiling.
+ *
+ * Calls take as many arguments as the procedure has parameters, so the count must be known wherever a
+ * call appears, even before the definition.
+ *
+ * Returns:
+ *    true if every header is valid, false after reporting the first invalid one.
+ */
+
+    CommandProgram* program = compiler->program;
+    for (const Token* token = compiler->tokens; token->type != TOKEN_END; token++) {
+        if (!token_is(token, "to")) {
+            continue;
+        }
+
+        const Token* name = ++token;
+        if (name->type != TOKEN_WORD) {
+            return report(compiler->name, name->line, "'to' must be followed by a procedure name");
+        }
+        for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+            if (token_is(name, keywords[i])) {
+                return report(compiler->name, name->line, "'%s' cannot name a procedure", keywords[i]);
+            }
+        }
+        if (find_command(name) || find_procedure(compiler, name) >= 0) {
+            return report(compiler->name, name->line, "'%.*s' is already defined", name->length, name->text);
+        }
+
+        int parameterCount = 0;
+        while (token[1].type == TOKEN_VARIABLE) {
+            token++;
+            parameterCount++;
+        }
+        if (parameterCount > MAX_PARAMETERS) {
+            return report(compiler->name, name->line, "'%.*s' has more than %d parameters", name->length,
+                          name->text, MAX_PARAMETERS);
+        }
+
+        if (program->procedureCount == compiler->procedureCapacity) {
+            compiler->procedureCapacity = compiler->procedureCapacity ? compiler->procedureCapacity * 2 : 16;
+            Procedure* newProcedures = realloc(program->procedures,
+                                               (size_t)compiler->procedureCapacity * sizeof(Procedure));
+            const Token** newNames = realloc(compiler->procedureNames,
+                                             (size_t)compiler->procedureCapacity * sizeof(Token*));
+            if (!newProcedures || !newNames) {
+                printf("Error reallocating memory for procedures!\n");
+                exit(1);
+            }
+            program->procedures = newProcedures;
+            compiler->procedureNames = newNames;
+        }
+        program->procedures[program->procedureCount] = (Procedure){-1, parameterCount};
+        compiler->procedureNames[program->procedureCount] = name;
+        program->procedureCount++;
+    }
+    return true;
+}
+
+
+static int emit(Compiler* compiler, const Opcode op, const int32_t index, const int line) {
+/*
+ * emit - Appends an instruction with an index operand to the program.
+ *
+ * Returns:
+ *    The position of the instruction, for jumps that are patched once their target is known.
+ */
+
+    CommandProgram* program = compiler->program;
+    if (program->length == program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 256;
+        Instruction* newCode = realloc(program->code, (size_t)program->capacity * sizeof(Instruction));
+        int* newLines = realloc(program->lines, (size_t)program->capacity * sizeof(int));
+        if (!newCode || !newLines) {
+            printf("Error reallocating memory for program code!\n");
+            exit(1);
+        }
+        program->code = newCode;
+        program->lines = newLines;
+    }
+
+    program->code[program->length].op = op;
+    program->code[program->length].index = index;
+    program->lines[program->length] = line;
+    return program->length++;
+}
+
+
+static void emit_value(Compiler* compiler, const float value, const int line) {
+/*
+ * emit_value - Appends an instruction pushing a constant.
+ */
+
+    const int position = emit(compiler, OP_PUSH, 0, line);
+    compiler->program->code[position].value = value;
+}
+
+
+static void emit_operator(Compiler* compiler, const Opcode op, const int line) {
+/*
+ * emit_operator - Appends an arithmetic or comparison instruction, folding it if its operands are constants.
+ *
+ * Jump targets only fall on statement boundaries, so the constants of an expression can be merged
+ * without moving a target.
+ */
+
+    CommandProgram* program = compiler->program;
+    Instruction* code = program->code;
+    const int length = program->length;
+
+    if (op == OP_NEGATE && length >= 1 && code[length - 1].op == OP_PUSH) {
+        code[length - 1].value = -code[length - 1].value;
+        return;
+    }
+    if (op != OP_NEGATE && length >= 2 && code[length - 2].op == OP_PUSH && code[length - 1].op == OP_PUSH) {
+        const float a = code[length - 2].value;
+        const float b = code[length - 1].value;
+        float result = 0.0f;
+        switch (op) {
+            case OP_ADD: result = a + b; break;
+            case OP_SUBTRACT: result = a - b; break;
+            case OP_MULTIPLY: result = a * b; break;
+            case OP_DIVIDE: result = a / b; break;
+            case OP_LESS: result = a < b ? 1.0f : 0.0f; break;
+            case OP_GREATER: result = a > b ? 1.0f : 0.0f; break;
+            default: result = a == b ? 1.0f : 0.0f; break;
+        }
+        code[length - 2].value = result;
+        program->length--;
+        return;
+    }
+
+    emit(compiler, op, 0, line);
+}
+
+
+static bool compile_expression(Compiler* compiler);
+
+
+static bool compile_primary(Compiler* compiler) {
+/*
+ * compile_primary - Compiles a number, a parameter, repcount, who, a negated value or a parenthesized expression.
+ */
+
+    const Token* token = &compiler->tokens[compiler->position];
+    if (token->type == TOKEN_END) {
+        return report(compiler->name, token->line, "expected a value before the end of the program");
+    }
+    compiler->position++;
+
+    if (token->type == TOKEN_NUMBER) {
+        emit_value(compiler, token->number, token->line);
+        return true;
+    }
+
+    if (token->type == TOKEN_VARIABLE) {
+        for (int i = 0; i < compiler->parameterCount; i++) {
+            const Token* parameter = compiler->parameters[i];
+            if (parameter->length == token->length &&
+                strncmp(parameter->text, token->text, (size_t)token->length) == 0) {
+                emit(compiler, OP_LOAD, i, token->line);
+                return true;
+            }
+        }
+        return report(compiler->name, token->line, "unknown parameter ':%.*s'", token->length, token->text);
+    }
+
+    if (token_is(token, "repcount")) {
+        if (compiler->loopDepth == 0) {
+            return report(compiler->name, token->line, "'repcount' used outside of 'repeat'");
+        }
+        emit(compiler, OP_REPCOUNT, 0, token->line);
+        return true;
+    }
+
+    if (token_is(token, "who")) {
+        emit(compiler, OP_WHO, 0, token->line);
+        return true;
+    }
+
+    if (symbol_is(token, '-')) {
+        if (!compile_primary(compiler)) {
+            return false;
+        }
+        emit_operator(compiler, OP_NEGATE, token->line);
+        return true;
+    }
+
+    if (symbol_is(token, '(')) {
+        if (!compile_expression(compiler)) {
+            return false;
+        }
+        const Token* close = &compiler->tokens[compiler->position];
+        if (!symbol_is(close, ')')) {
+            return report(compiler->name, close->line, "missing ')'");
+        }
+        compiler->position++;
+        return true;
+    }
+
+    return report(compiler->name, token->line, "expected a value, found '%.*s'", token->length, token->text);
+}
+
+
+static bool compile_term(Compiler* compiler) {
+/*
+ * compile_term - Compiles a product or quotient of values.
+ */
+
+    if (!compile_primary(compiler)) {
+        return false;
+    }
+
+    for (;;) {
+        const Token* token = &compiler->tokens[compiler->position];
+        if (!symbol_is(token, '*') && !symbol_is(token, '/')) {
+            return true;
+        }
+        compiler->position++;
+        if (!compile_primary(compiler)) {
+            return false;
+        }
+        emit_operator(compiler, token->text[0] == '*' ? OP_MULTIPLY : OP_DIVIDE, token->line);
+    }
+}
+
+
+static bool compile_sum(Compiler* compiler) {
+/*
+ * compile_sum - Compiles a sum or difference of terms.
+ *
+ * A prefix '-' starts the next argument rather than continuing this one.
+ */
+
+    if (!compile_term(compiler)) {
+        return false;
+    }
+
+    for (;;) {
+        const Token* token = &compiler->tokens[compiler->position];
+        if (!symbol_is(token, '+') && !(symbol_is(token, '-') && !token->prefix)) {
+            return true;
+        }
+        compiler->position++;
+        if (!compile_term(compiler)) {
+            return false;
+        }
+        emit_operator(compiler, token->text[0] == '+' ? OP_ADD : OP_SUBTRACT, token->line);
+    }
+}
+
+
+static bool compile_expression(Compiler* compiler) {
+/*
+ * compile_expression - Compiles an expression, optionally made of two sums compared with each other.
+ *
+ * Returns:
+ *    true with code pushing the value of the expression emitted, false after reporting an error.
+ */
+
+    if (!compile_sum(compiler)) {
+        return false;
+    }
+
+    const Token* token = &compiler->tokens[compiler->position];
+    if (symbol_is(token, '<') || symbol_is(token, '>') || symbol_is(token, '=')) {
+        compiler->position++;
+        if (!compile_sum(compiler)) {
+            return false;
+        }
+        emit_operator(compiler, token->text[0] == '<' ? OP_LESS : token->text[0] == '>' ? OP_GREATER : OP_EQUAL,
+                      token->line);
+    }
+    return true;
+}
+
+
+static bool compile_statement(Compiler* compiler);
+
+
+static bool compile_block(Compiler* compiler, const Token* owner) {
+/*
+ * compile_block - Compiles the bracketed commands following repeat, if or ifelse.
+ *
+ * Parameters:
+ *    compiler - The compiler.
+ *    owner    - The keyword owning the block, used in error messages.
+ */
+
+    const Token* open = &compiler->tokens[compiler->position];
+    if (!symbol_is(open, '[')) {
+        return report(compiler->name, open->line, "expected '[' after '%.*s'", owner->length, owner->text);
+    }
+    compiler->position++;
+    compiler->blockDepth++;
+
+    while (!symbol_is(&compiler->tokens[compiler->position], ']')) {
+        if (compiler->tokens[compiler->position].type == TOKEN_END) {
+            return report(compiler->name, open->line, "missing ']' for '%.*s'", owner->length, owner->text);
+        }
+        if (!compile_statement(compiler)) {
+            return false;
+        }
+    }
+
+    compiler->position++;
+    compiler->blockDepth--;
+    return true;
+}
+
+
+static bool compile_procedure(Compiler* compiler, const Token* to) {
+/*
+ * compile_procedure - Compiles a procedure definition, from after 'to' through 'end'.
+ *
+ * The body is placed where the definition appears, behind a jump so that the top level flows past it.
+ */
+
+    if (compiler->procedure >= 0 || compiler->blockDepth > 0) {
+        return report(compiler->name, to->line, "procedures can only be defined at the top level");
+    }
+
+    // The header was validated by declare_procedures
+    const Token* name = &compiler->tokens[compiler->position++];
+    const int index = find_procedure(compiler, name);
+    const int skip = emit(compiler, OP_JUMP, 0, to->line);
+    compiler->program->procedures[index].entry = compiler->program->length;
+
+    compiler->procedure = index;
+    compiler->parameterCount = 0;
+    while (compiler->tokens[compiler->position].type == TOKEN_VARIABLE) {
+        compiler->parameters[compiler->parameterCount++] = &compiler->tokens[compiler->position++];
+    }
+
+    while (!token_is(&compiler->tokens[compiler->position], "end")) {
+        if (compiler->tokens[compiler->position].type == TOKEN_END) {
+            return report(compiler->name, to->line, "missing 'end' for '%.*s'", name->length, name->text);
+        }
+        if (!compile_statement(compiler)) {
+            return false;
+        }
+    }
+    const Token* end = &compiler->tokens[compiler->position++];
+
+    emit(compiler, OP_RETURN, 0, end->line);
+    compiler->program->code[skip].index = compiler->program->length;
+    compiler->procedure = -1;
+    compiler->parameterCount = 0;
+    return true;
+}
+
+
+static bool compile_statement(Compiler* compiler) {
+/*
+ * compile_statement - Compiles one command with its arguments, a control structure or a definition.
+ *
+ * Returns:
+ *    true on success, false after reporting an error.
+ */
+
+    const Token* token = &compiler->tokens[compiler->position++];
+    if (token->type != TOKEN_WORD) {
+        return report(compiler->name, token->line, "expected a command, found '%.*s'", token->length, token->text);
+    }
+
+    if (token_is(token, "to")) {
+        return compile_procedure(compiler, token);
+    }
+
+    if (token_is(token, "end")) {
+        return report(compiler->name, token->line, "'end' without 'to'");
+    }
+
+    if (token_is(token, "stop")) {
+        emit(compiler, compiler->procedure >= 0 ? OP_RETURN : OP_HALT, 0, token->line);
+        return true;
+    }
+
+    if (token_is(token, "repeat")) {
+        if (!compile_expression(compiler)) {
+            return false;
+        }
+        const int start = emit(compiler, OP_REPEAT, 0, token->line);
+        compiler->loopDepth++;
+        if (!compile_block(compiler, token)) {
+            return false;
+        }
+        compiler->loopDepth--;
+        emit(compiler, OP_LOOP, start + 1, token->line);
+        compiler->program->code[start].index = compiler->program->length;
+        return true;
+    }
+
+    if (token_is(token, "if") || token_is(token, "ifelse")) {
+        if (!compile_expression(compiler)) {
+            return false;
+        }
+        const int branch = emit(compiler, OP_JUMP_IF_FALSE, 0, token->line);
+        if (!compile_block(compiler, token)) {
+            return false;
+        }
+        if (token_is(token, "ifelse")) {
+            const int skip = emit(compiler, OP_JUMP, 0, token->line);
+            compiler->program->code[branch].index = compiler->program->length;
+            if (!compile_block(compiler, token)) {
+                return false;
+            }
+            compiler->program->code[skip].index = compiler->program->length;
+        } else {
+            compiler->program->code[branch].index = compiler->program->length;
+        }
+        return true;
+    }
+
+    const CommandInfo* command = find_command(token);
+    if (command) {
+        for (int i = 0; i < command->argCount; i++) {
+            if (!compile_expression(compiler)) {
+                return false;
+            }
+        }
+        emit(compiler, command->op, 0, token->line);
+        return true;
+    }
+
+    const int procedure = find_procedure(compiler, token);
+    if (procedure >= 0) {
+        for (int i = 0; i < compiler->program->procedures[procedure].parameterCount; i++) {
+            if (!compile_expression(compiler)) {
+                return false;
+            }
+        }
+        emit(compiler, OP_CALL, procedure, token->line);
+        return true;
+    }
+
+    return report(compiler->name, token->line, "unknown command '%.*s'", token->length, token->text);
+}
+
+
+static CommandProgram* create_program(const char* name) {
+/*
+ * create_program - Allocates an empty program named after its source.
+ */
+
+    CommandProgram* program = calloc(1, sizeof(CommandProgram));
+    const size_t nameLength = strlen(name);
+    if (!program || !(program->name = malloc(nameLength + 1))) {
+        printf("Error allocating memory for a program!\n");
+        exit(1);
+    }
+    memcpy(program->name, name, nameLength + 1);
+    return program;
+}
+
+
+CommandProgram* commands_compile(const char* source, const char* name) {
+/*
+ * commands_compile - Compiles a program to bytecode.
+ *
+ * Parameters:
+ *    source - The NUL-terminated program text.
+ *    name   - The name of the source, used in error messages when compiling and running.
+ *
+ * Returns:
+ *    The compiled program, to be released with commands_free, or NULL after reporting the first error.
+ */
+
+    int tokenCount = 0;
+    Token* tokens = tokenize(source, name, &tokenCount);
+    if (!tokens) {
+        return NULL;
+    }
+
+    CommandProgram* program = create_program(name);
+
+    Compiler compiler = {0};
+    compiler.name = name;
+    compiler.tokens = tokens;
+    compiler.program = program;
+    compiler.procedure = -1;
+
+    bool compiled = declare_procedures(&compiler);
+    while (compiled && tokens[compiler.position].type != TOKEN_END) {
+        compiled = compile_statement(&compiler);
+    }
+    if (compiled) {
+        emit(&compiler, OP_HALT, 0, tokens[tokenCount].line);
+    }
+
+    free(compiler.procedureNames);
+    free(tokens);
+    if (!compiled) {
+        commands_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+
+CommandProgram* commands_decode(const unsigned char* data, const size_t length, const char* name) {
+/*
+ * commands_decode - Builds a program from commands in their binary form, as the command server receives them.
+ *
+ * Each command is one byte, its position in the command table counting from 1 (1 forward, 2 back, 3 left,
+ * 4 right, 5 penup, 6 pendown, 7 color, 8 rgb, 9 setxy, 10 setheading, 11 home, 12 tell), followed by its
+ * arguments as little-endian 32-bit floats. There are no procedures, loops or expressions; the sender
+ * batches the commands instead. Errors are located by the position of the command, counting from 1.
+ * Arguments that are infinite or NaN are rejected like unknown codes, since they come from the network.
+ *
+ * Parameters:
+ *    data   - The encoded commands.
+ *    length - The number of bytes.
+ *    name   - The name of the sender, used in error messages when decoding and running.
+ *
+ * Returns:
+ *    The program, to be released with commands_free, or NULL after reporting the first malformed command.
+ */
+
+    CommandProgram* program = create_program(name);
+    Compiler compiler = {0};
+    compiler.name = name;
+    compiler.program = program;
+    compiler.procedure = -1;
+
+    const int commandCount = (int)(sizeof(commandTable) / sizeof(commandTable[0]));
+    size_t position = 0;
+    int index = 0;
+    while (position < length) {
+        index++;
+        const int code = data[position++];
+        if (code < 1 || code > commandCount) {
+            report(name, index, "unknown command code %d", code);
+            commands_free(program);
+            return NULL;
+        }
+
+        const CommandInfo* command = &commandTable[code - 1];
+        if (length - position < (size_t)command->argCount * 4) {
+            report(name, index, "'%s' is cut short, expected %d arguments", command->name, command->argCount);
+            commands_free(program);
+            return NULL;
+        }
+        for (int i = 0; i < command->argCount; i++) {
+            const uint32_t bits = (uint32_t)data[position] | (uint32_t)data[position + 1] << 8 |
+                                  (uint32_t)data[position + 2] << 16 | (uint32_t)data[position + 3] << 24;
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            if (!isfinite(value)) {
+                report(name, index, "'%s' argument %d is not a finite number", command->name, i + 1);
+                commands_free(program);
+                return NULL;
+            }
+            emit_value(&compiler, value, index);
+            position += 4;
+        }
+        emit(&compiler, command->op, 0, index);
+    }
+    emit(&compiler, OP_HALT, 0, index);
+    return program;
+}
+
+
+CommandProgram* commands_load(FILE* input, const char* name) {
+/*
+ * commands_load - Reads a whole stream and compiles it.
+ *
+ * Procedures may be called before they are defined, so the stream is read completely before compiling.
+ *
+ * Parameters:
+ *    input - The stream to read.
+ *    name  - The name of the stream, used in error messages.
+ *
+ * Returns:
+ *    The compiled program, to be released with commands_free, or NULL after reporting an error.
+ */
+
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t length = 0;
+    char* source = malloc(capacity + 1);
+    if (!source) {
+        printf("Error allocating memory for a program source!\n");
+        exit(1);
+    }
+
+    size_t read;
+    while ((read = fread(source + length, 1, capacity - length, input)) > 0) {
+        length += read;
+        if (length == capacity) {
+            capacity *= 2;
+            char* newSource = realloc(source, capacity + 1);
+            if (!newSource) {
+                printf("Error reallocating memory for a program source!\n");
+                exit(1);
+            }
+            source = newSource;
+        }
+    }
+
+    if (ferror(input)) {
+        printf("Could not read %s\n", name);
+        free(source);
+        return NULL;
+    }
+
+    source[length] = '\0';
+    CommandProgram* program = commands_compile(source, name);
+    free(source);
+    return program;
+}
+
+
+void commands_free(CommandProgram* program) {
+/*
+ * commands_free - Releases a compiled program.
+ *
+ * Parameters:
+ *    program - The program, or NULL.
+ */
+
+    if (!program) {
+        return;
+    }
+    free(program->code);
+    free(program->lines);
+    free(program->procedures);
+    free(program->name);
+    free(program);
+}
+
+
+static void flush_moves(MoveBatch* batch, float* x, float* y, const bool pen, const GLfloat r, const GLfloat g,
+                        const GLfloat b, const LineSink sink, void* context) {
+/*
+ * flush_moves - Computes the positions of the queued moves and draws their lines.
+ *
+ * A move that leads to an infinite or NaN position, after a huge distance or a heading that is not a
+ * number, sets `overflowed` and is dropped with the moves after it, so no such line reaches the sink.
+ *
+ * Parameters:
+ *    batch   - The queued moves, emptied on return.
+ *    x, y    - The position before the first move, updated to the position after the last.
+ *    pen     - Whether the pen is down.
+ *    r, g, b - The pen color.
+ *    sink    - Receives the lines, or NULL.
+ *    context - Passed to `sink` unchanged.
+ */
+
+    if (batch->count == 0) {
+        return;
+    }
+    movement_batch(batch->headings, batch->distances, batch->count, *x, *y, batch->xs, batch->ys);
+
+    int count = batch->count;
+    for (int i = 0; i < count; i++) {
+        if (!isfinite(batch->xs[i]) || !isfinite(batch->ys[i])) {
+            batch->overflowed = true;
+            count = i;
+        }
+    }
+
+    if (pen && sink) {
+        float fromX = *x, fromY = *y;
+        for (int i = 0; i < count; i++) {
+            const float toX = batch->xs[i], toY = batch->ys[i];
+            if (toX != fromX || toY != fromY) {
+                const Line line = {fromX, fromY, toX, toY, r, g, b};
+                sink(&line, context);
+            }
+            fromX = toX;
+            fromY = toY;
+        }
+    }
+
+    if (count > 0) {
+        *x = batch->xs[count - 1];
+        *y = batch->ys[count - 1];
+    }
+    batch->count = 0;
+}
+
+
+static Turtle* swarm_turtle(Turtle* turtle, TurtleSwarm* swarm, const int number) {
+/*
+ * swarm_turtle - Finds turtle `number`, hatching it and any missing turtle below it at turtle 0's home.
+ *
+ * Parameters:
+ *    turtle - Turtle 0.
+ *    swarm  - The other turtles, grown as needed.
+ *    number - The turtle wanted, from 0 to MAX_TURTLES - 1.
+ *
+ * Returns:
+ *    The turtle, valid until the swarm grows again.
+ */
+
+    if (number == 0) {
+        return turtle;
+    }
+    if (number > swarm->count) {
+        if (number > swarm->capacity) {
+            int capacity = swarm->capacity > 0 ? swarm->capacity : 16;
+            while (capacity < number) {
+                capacity *= 2;
+            }
+            Turtle* turtles = realloc(swarm->turtles, (size_t)capacity * sizeof(Turtle));
+            if (!turtles) {
+                printf("Error allocating memory for the turtles!\n");
+                exit(1);
+            }
+            swarm->turtles = turtles;
+            swarm->capacity = capacity;
+        }
+        while (swarm->count < number) {
+            turtle_reset(&swarm->turtles[swarm->count++], turtle->homeX, turtle->homeY);
+        }
+    }
+    return &swarm->turtles[number - 1];
+}
+
+
+bool commands_run(const CommandProgram* program, Turtle* turtle, const LineSink sink, void* context) {
+/*
+ * commands_run - Runs a compiled program, discarding the turtles other than turtle 0 when it ends.
+ *
+ * Parameters:
+ *    program - The program to run.
+ *    turtle  - The turtle to drive.
+ *    sink    - Receives every line drawn, or NULL to only move the turtle.
+ *    context - Passed to `sink` unchanged.
+ *
+ * Returns:
+ *    true if the program ran to the end, false after reporting a runtime error.
+ */
+
+    TurtleSwarm swarm = {NULL, 0, 0};
+    const bool ran = commands_run_swarm(program, turtle, &swarm, sink, context, NULL);
+    swarm_free(&swarm);
+    return ran;
+}
+
+
+bool commands_run_swarm(const CommandProgram* program, Turtle* turtle, TurtleSwarm* swarm, const LineSink sink,
+                        void* context, SDL_atomic_t* cancel) {
+/*
+ * commands_run_swarm - Runs a compiled program that may tell several turtles.
+ *
+ * This is the interpreter loop: one switch per instruction over a value stack, a call stack and a loop
+ * stack that are allocated once per run. The turtle being told lives in local variables while the program
+ * runs and is written back when another one is told and when the program ends, on success or on error.
+ * Every CANCEL_CHECK_INTERVAL instructions the loop looks at the cancel flag, and a program cancelled
+ * from another thread stops there as if it had halted, however long it would have run.
+ *
+ * Parameters:
+ *    program - The program to run.
+ *    turtle  - Turtle 0, which the program starts with.
+ *    swarm   - Turtles 1 and up, kept from earlier runs and grown as the program tells new ones.
+ *    sink    - Receives every line drawn, or NULL to only move the turtles.
+ *    context - Passed to `sink` unchanged.
+ *    cancel  - Set to nonzero by another thread to stop the program, or NULL.
+ *
+ * Returns:
+ *    true if the program ran to the end or was cancelled, false after reporting a runtime error.
+ */
+
+    float* values = malloc(VALUE_STACK_SIZE * sizeof(float));
+    CallFrame* calls = malloc(CALL_STACK_SIZE * sizeof(CallFrame));
+    LoopFrame* loops = malloc(LOOP_STACK_SIZE * sizeof(LoopFrame));
+    if (!values || !calls || !loops) {
+        printf("Error allocating memory for the command interpreter!\n");
+        exit(1);
+    }
+
+    Turtle* current = turtle;
+    int who = 0;
+    float x = current->x;
+    float y = current->y;
+    float angle = current->angle;
+    bool pen = current->pen;
+    GLfloat r = current->r, g = current->g, b = current->b;
+    MoveBatch moves;
+    moves.count = 0;
+    moves.overflowed = false;
+    movement_init();
+
+    const Instruction* code = program->code;
+    int pc = 0;               // Next instruction
+    int sp = 0;               // Number of values on the stack
+    int base = 0;             // Stack index of the first parameter of the running procedure
+    int callDepth = 0;
+    int loopDepth = 0;
+    const char* error = NULL;
+    bool running = true;
+    int untilCancelCheck = CANCEL_CHECK_INTERVAL;
+
+    while (running) {
+        if (--untilCancelCheck == 0) {
+            untilCancelCheck = CANCEL_CHECK_INTERVAL;
+            if (cancel && SDL_AtomicGet(cancel)) {
+                break;
+            }
+        }
+        const Instruction* instruction = &code[pc++];
+        switch ((Opcode)instruction->op) {
+            case OP_PUSH:
+            case OP_LOAD:
+            case OP_REPCOUNT:
+            case OP_WHO:
+                if (sp == VALUE_STACK_SIZE) {
+                    error = "too many values, procedures are nested too deeply";
+                    running = false;
+                    break;
+                }
+                if (instruction->op == OP_PUSH) {
+                    values[sp++] = instruction->value;
+                } else if (instruction->op == OP_LOAD) {
+                    values[sp++] = values[base + instruction->index];
+                } else if (instruction->op == OP_WHO) {
+                    values[sp++] = (float)who;
+                } else {
+                    const LoopFrame* loop = &loops[loopDepth - 1];
+                    values[sp++] = (float)(loop->total - loop->remaining + 1);
+                }
+                break;
+            case OP_ADD:
+                sp--;
+                values[sp - 1] += values[sp];
+                break;
+            case OP_SUBTRACT:
+                sp--;
+                values[sp - 1] -= values[sp];
+                break;
+            case OP_MULTIPLY:
+                sp--;
+                values[sp - 1] *= values[sp];
+                break;
+            case OP_DIVIDE:
+                sp--;
+                values[sp - 1] /= values[sp];
+                break;
+            case OP_NEGATE:
+                values[sp - 1] = -values[sp - 1];
+                break;
+            case OP_LESS:
+                sp--;
+                values[sp - 1] = values[sp - 1] < values[sp] ? 1.0f : 0.0f;
+                break;
+            case OP_GREATER:
+                sp--;
+                values[sp - 1] = values[sp - 1] > values[sp] ? 1.0f : 0.0f;
+                break;
+            case OP_EQUAL:
+                sp--;
+                values[sp - 1] = values[sp - 1] == values[sp] ? 1.0f : 0.0f;
+                break;
+            case OP_FORWARD:
+            case OP_BACK:
+                if (!isfinite(values[sp - 1])) {
+                    error = "invalid distance, expected a finite number";
+                    running = false;
+                    break;
+                }
+                moves.headings[moves.count] = angle;
+                moves.distances[moves.count] = instruction->op == OP_FORWARD ? values[--sp] : -values[--sp];
+                if (++moves.count == MOVE_BATCH_SIZE) {
+                    flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                }
+                break;
+            case OP_SETXY: {
+                flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                sp -= 2;
+                const float newX = values[sp];
+                const float newY = values[sp + 1];
+                if (!isfinite(newX) || !isfinite(newY)) {
+                    error = "invalid position, expected finite coordinates";
+                    running = false;
+                    break;
+                }
+                if (pen && sink && (newX != x || newY != y)) {
+                    const Line line = {x, y, newX, newY, r, g, b};
+                    sink(&line, context);
+                }
+                x = newX;
+                y = newY;
+                break;
+            }
+            case OP_LEFT:
+            case OP_RIGHT:
+            case OP_SETHEADING:
+            case OP_HOME: {
+                if (instruction->op == OP_HOME) {
+                    flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                    x = current->homeX;
+                    y = current->homeY;
+                    angle = 0.0f;
+                } else if (instruction->op == OP_SETHEADING) {
+                    angle = fmodf(values[--sp], 360.0f);
+                } else {
+                    const float turn = instruction->op == OP_LEFT ? values[--sp] : -values[--sp];
+                    angle = fmodf(angle + turn, 360.0f);
+                }
+                break;
+            }
+            case OP_PENUP:
+            case OP_PENDOWN:
+                if (pen != (instruction->op == OP_PENDOWN)) {
+                    flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                    pen = !pen;
+                }
+                break;
+            case OP_COLOR:
+                flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                if (!preset_color((int)values[--sp], &r, &g, &b)) {
+                    error = "invalid color, expected 1 to 5";
+                    running = false;
+                }
+                break;
+            case OP_RGB:
+                flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                sp -= 3;
+                r = values[sp];
+                g = values[sp + 1];
+                b = values[sp + 2];
+                break;
+            case OP_TELL: {
+                const float number = values[--sp];
+                if (!(number >= 0.0f && number < (float)MAX_TURTLES) || number != floorf(number)) {
+                    error = "invalid turtle, expected a whole number from 0 to 65535";
+                    running = false;
+                    break;
+                }
+                flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+                *current = (Turtle){x, y, angle, pen, r, g, b, current->homeX, current->homeY};
+                who = (int)number;
+                current = swarm_turtle(turtle, swarm, who);
+                x = current->x;
+                y = current->y;
+                angle = current->angle;
+                pen = current->pen;
+                r = current->r;
+                g = current->g;
+                b = current->b;
+                break;
+            }
+            case OP_JUMP:
+                pc = instruction->index;
+                break;
+            case OP_JUMP_IF_FALSE:
+                if (values[--sp] == 0.0f) {
+                    pc = instruction->index;
+                }
+                break;
+            case OP_REPEAT: {
+                const float rounds = values[--sp];
+                if (!(rounds >= 1.0f)) {
+                    pc = instruction->index;
+                } else if (loopDepth == LOOP_STACK_SIZE) {
+                    error = "repeat loops nested too deeply";
+                    running = false;
+                } else {
+                    const int count = rounds >= (float)INT_MAX ? INT_MAX : (int)rounds;
+                    loops[loopDepth++] = (LoopFrame){count, count};
+                }
+                break;
+            }
+            case OP_LOOP:
+                if (--loops[loopDepth - 1].remaining > 0) {
+                    pc = instruction->index;
+                } else {
+                    loopDepth--;
+                }
+                break;
+            case OP_CALL: {
+                if (callDepth == CALL_STACK_SIZE) {
+                    error = "procedures nested too deeply";
+                    running = false;
+                    break;
+                }
+                const Procedure* procedure = &program->procedures[instruction->index];
+                const int calleeBase = sp - procedure->parameterCount;
+                calls[callDepth++] = (CallFrame){pc, calleeBase, base, loopDepth};
+                base = calleeBase;
+                pc = procedure->entry;
+                break;
+            }
+            case OP_RETURN: {
+                const CallFrame* frame = &calls[--callDepth];
+                pc = frame->returnAddress;
+                sp = frame->base;
+                base = frame->callerBase;
+                loopDepth = frame->loopDepth;
+                break;
+            }
+            case OP_HALT:
+                running = false;
+                break;
+        }
+
+        if (moves.overflowed && !error) {
+            error = "the turtle moved beyond the largest coordinate";
+            running = false;
+        }
+    }
+
+    // Moves queued before the end, or before an error, still happened
+    flush_moves(&moves, &x, &y, pen, r, g, b, sink, context);
+    if (moves.overflowed && !error) {
+        error = "the turtle moved beyond the largest coordinate";
+    }
+    if (error) {
+        report(program->name, program->lines[pc - 1], "%s", error);
+    }
+
+    current->x = x;
+    current->y = y;
+    current->angle = angle;
+    current->pen = pen;
+    current->r = r;
+    current->g = g;
+    current->b = b;
+
+    free(values);
+    free(calls);
+    free(loops);
+    return error == NULL;
+}
+
+
+void swarm_free(TurtleSwarm* swarm) {
+/*
+ * swarm_free - Releases the turtles of a swarm and leaves it empty.
+ */
+
+    free(swarm->turtles);
+    *swarm = (TurtleSwarm){NULL, 0, 0};
+}
+
+
+bool run_command_stream(FILE* input, const char* name, Turtle* turtle, const LineSink sink, void* context) {
+/*
+ * run_command_stream - Compiles and runs every command of a stream.
+ *
+ * Parameters:
+ *    input   - The stream to read.
+ *    name    - The name of the stream, used in error messages.
+ *    turtle  - The turtle to drive.
+ *    sink    - Receives every line drawn, or NULL to only move the turtle.
+ *    context - Passed to `sink` unchanged.
+ *
+ * Returns:
+ *    true if the whole program ran, false after reporting the first error.
+ */
+
+    CommandProgram* program = commands_load(input, name);
+    if (!program) {
+        return false;
+    }
+
+    const bool ran = commands_run(program, turtle, sink, context);
+    commands_free(program);
+    return ran;
+}
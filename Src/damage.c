@@ -0,0 +1,246 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * damage.c - Tracking the parts of the window that change, for partial redraws.
+ *
+ * With the persistent canvas (see canvas.c), a frame of a turtle at work differs from the previous one in
+ * a few small places: where the sprite was and now is, where the newest lines were added, and the status
+ * text. Redrawing only those rectangles, with the scissor test, saves most of the fill cost of blitting the
+ * canvas over a large window every frame.
+ *
+ * The renderer reports what changed as it happens, in window pixels or in drawing coordinates, and
+ * damage_frame turns that into the rectangles to redraw. Those depend on the back buffer: after a swap it
+ * holds the frame from `bufferAge` frames ago (see gl_buffer_age), so the frame must redraw everything that
+ * changed in the frames since. The damage of the last DAMAGE_HISTORY frames is kept for that. A back buffer
+ * of unknown age, an older one, a resize or a damage_all call redraw the whole window.
+ *
+ * A frame keeps at most DAMAGE_MAX_RECTS rectangles. Overlapping rectangles are merged as they are
+ * added, and when there are too many all of them are merged into their bounding box.
+ *
+ * Everything here runs on the render thread.
+ *
+ * Key functions:
+ *    - damage_configure: Turns partial redraws on or off.
+ *    - damage_all / damage_window_rect / damage_drawing_rect: Report what changed.
+ *    - damage_frame: Returns the rectangles the next frame must redraw.
+ */
+
+
+//==================== Header Files ====================
+#include "damage.h"
+
+#include <math.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define DAMAGE_HISTORY 4          // Frames of damage kept, the oldest back buffer redrawn in part
+
+
+//==================== Structure ====================
+typedef struct {  // Rectangles that changed in one frame
+    bool full;                // Whether the whole window changed
+    int count;                // Number of rectangles
+    DamageRect rects[DAMAGE_MAX_RECTS];
+} FrameDamage;
+
+
+//==================== Global Variables ====================
+static bool enabled = false;              // Whether partial redraws are on
+static FrameDamage pending = {true, 0, {{0}}}; // What changed since the last frame
+static FrameDamage history[DAMAGE_HISTORY]; // Damage of the last frames, the newest first
+static int historyCount = 0;              // Number of frames in `history`
+static int historyWidth = 0;              // Size of the window the history applies to
+static int historyHeight = 0;
+static FrameDamage redraw;                // Rectangles returned by the last damage_frame
+
+
+//==================== Function Definitions ====================
+void damage_configure(const bool enable) {
+/*
+ * damage_configure - Turns partial redraws on or off; when off, damage_frame always asks for whole frames.
+ */
+
+    enabled = enable;
+    pending.full = true;
+    historyCount = 0;
+}
+
+
+bool damage_enabled(void) {
+/*
+ * damage_enabled - Reports whether partial redraws are on.
+ */
+
+    return enabled;
+}
+
+
+void damage_all(void) {
+/*
+ * damage_all - Marks the whole window as changed, so the next frame is drawn in full.
+ */
+
+    pending.full = true;
+}
+
+
+static bool overlap(const DamageRect* a, const DamageRect* b) {
+/*
+ * overlap - Reports whether two rectangles overlap or touch.
+ */
+
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+
+static void merge(DamageRect* into, const DamageRect* rect) {
+/*
+ * merge - Grows a rectangle to the bounding box of itself and another.
+ */
+
+    into->x0 = rect->x0 < into->x0 ? rect->x0 : into->x0;
+    into->y0 = rect->y0 < into->y0 ? rect->y0 : into->y0;
+    into->x1 = rect->x1 > into->x1 ? rect->x1 : into->x1;
+    into->y1 = rect->y1 > into->y1 ? rect->y1 : into->y1;
+}
+
+
+static void add_rect(FrameDamage* damage, DamageRect rect) {
+/*
+ * add_rect - Adds a rectangle to a frame's damage, merging it with the rectangles it overlaps.
+ */
+
+    if (damage->full || rect.x1 <= rect.x0 || rect.y1 <= rect.y0) {
+        return;
+    }
+
+    // A merged rectangle may now overlap others, so merge until none does
+    for (int i = 0; i < damage->count;) {
+        if (overlap(&damage->rects[i], &rect)) {
+            merge(&rect, &damage->rects[i]);
+            damage->rects[i] = damage->rects[--damage->count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    // Past the limit, a single bounding box is cheaper to redraw than to keep apart
+    if (damage->count == DAMAGE_MAX_RECTS) {
+        for (int i = 0; i < damage->count; i++) {
+            merge(&rect, &damage->rects[i]);
+        }
+        damage->count = 0;
+    }
+    damage->rects[damage->count++] = rect;
+}
+
+
+void damage_window_rect(const float minX, const float minY, const float maxX, const float maxY) {
+/*
+ * damage_window_rect - Marks a rectangle of the window as changed, in pixels from the top-left corner.
+ *
+ * The rectangle is rounded outward to whole pixels; it is clipped to the window by damage_frame.
+ */
+
+    if (!enabled) {
+        return;
+    }
+    const float limit = 1.0e6f;
+    if (!(minX < limit && minY < limit && maxX > -limit && maxY > -limit)) {
+        return;
+    }
+    const DamageRect rect = {(int)floorf(fmaxf(minX, -limit)), (int)floorf(fmaxf(minY, -limit)),
+                             (int)ceilf(fminf(maxX, limit)), (int)ceilf(fminf(maxY, limit))};
+    add_rect(&pending, rect);
+}
+
+
+void damage_drawing_rect(const CameraView view, const int width, const int height, const float minX,
+                         const float minY, const float maxX, const float maxY, const float padding) {
+/*
+ * damage_drawing_rect - Marks a rectangle of the drawing as changed.
+ *
+ * Parameters:
+ *    view          - The part of the drawing the window shows.
+ *    width, height - The size of the window in pixels.
+ *    minX...maxY   - The rectangle in drawing coordinates.
+ *    padding       - Pixels added on every side, for line widths and filtering.
+ */
+
+    if (!enabled || view.maxX <= view.minX || view.maxY <= view.minY) {
+        return;
+    }
+    const float scaleX = (float)width / (view.maxX - view.minX);
+    const float scaleY = (float)height / (view.maxY - view.minY);
+    damage_window_rect((minX - view.minX) * scaleX - padding, (minY - view.minY) * scaleY - padding,
+                       (maxX - view.minX) * scaleX + padding, (maxY - view.minY) * scaleY + padding);
+}
+
+
+int damage_frame(const int width, const int height, const int bufferAge, const DamageRect** rects) {
+/*
+ * damage_frame - Ends the damage of a frame and returns the rectangles it must redraw.
+ *
+ * Parameters:
+ *    width, height - The size of the window in pixels.
+ *    bufferAge     - How many frames ago the back buffer was drawn, 0 when unknown.
+ *    rects         - Receives the rectangles, clipped to the window.
+ *
+ * Returns:
+ *    The number of rectangles, possibly 0 when nothing changed, or -1 to redraw the whole window.
+ */
+
+    // Clip this frame's damage to the window and put it at the front of the history
+    FrameDamage current = {pending.full || width != historyWidth || height != historyHeight, 0, {{0}}};
+    for (int i = 0; i < pending.count && !current.full; i++) {
+        DamageRect rect = pending.rects[i];
+        rect.x0 = rect.x0 > 0 ? rect.x0 : 0;
+        rect.y0 = rect.y0 > 0 ? rect.y0 : 0;
+        rect.x1 = rect.x1 < width ? rect.x1 : width;
+        rect.y1 = rect.y1 < height ? rect.y1 : height;
+        add_rect(&current, rect);
+    }
+    memmove(&history[1], &history[0], (DAMAGE_HISTORY - 1) * sizeof(FrameDamage));
+    history[0] = current;
+    historyCount = historyCount < DAMAGE_HISTORY ? historyCount + 1 : DAMAGE_HISTORY;
+    historyWidth = width;
+    historyHeight = height;
+    pending.full = false;
+    pending.count = 0;
+
+    // The back buffer misses everything that changed in the frames drawn since it
+    if (!enabled || bufferAge < 1 || bufferAge > historyCount) {
+        return -1;
+    }
+    redraw.full = false;
+    redraw.count = 0;
+    for (int frame = 0; frame < bufferAge; frame++) {
+        if (history[frame].full) {
+            return -1;
+        }
+        for (int i = 0; i < history[frame].count; i++) {
+            add_rect(&redraw, history[frame].rects[i]);
+        }
+    }
+    *rects = redraw.rects;
+    return redraw.count;
+}
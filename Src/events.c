@@ -22,20 +22,34 @@
  *
  * This function processes SDL events, such as key presses, window events, and
  * window resizing. It updates the state of the turtle (sprite) based on user input,
- * including its position, rotation, and pen state. The function also handles window
- * resizing and adjusts the OpenGL viewport and projection accordingly.
+ * including its position, rotation, and pen state. It runs on the main thread; camera
+ * moves, window resizes and new lines are sent to the render thread as messages (see
+ * render.c), which owns the OpenGL context and applies them before its next frame. Events are
+ * taken through replay.c, which records them or substitutes a recording for them.
  *
  * The function processes key events such as:
  *    - Arrow keys to rotate the turtle.
  *    - 'D' and 'U' to toggle the pen state (drawing on/off).
  *    - Number keys (1-5) to change the drawing color.
+ *    - '+' and '-' or the mouse wheel to zoom, the right or middle mouse button to pan,
+ *      and 'H' to return to the initial view.
+ *    - 'S' and 'P' to export the drawing as an SVG or a PDF file.
+ *    - Ctrl+Z to undo the last stroke or script, Ctrl+Y or Ctrl+Shift+Z to redo it.
+ *    - F3 to show or hide the profiler overlay, when profiling.
  *    - The Escape key to exit the program.
  *
- * Additionally, the function updates the turtle's position if the "Up" arrow key
- * is pressed, and if the pen is down, it adds a line to the drawing.
+ * Events are drained from the queue in batches with SDL_PeepEvents. Keys are looked up in a table binding each
+ * key, with the modifiers it needs, to an action or to a flag held while the key is down. The pan motions of
+ * a batch and its resizes are merged, so dragging the window rebuilds the projection and the canvas once per
+ * iteration instead of once per event, and the render thread is asked for one redraw per iteration. Status
+ * messages go through the logger (see logger.c), which never waits for the terminal.
+ *
+ * Key presses only record which keys are held. The turtle itself is advanced by
+ * update_simulation, which the main loop calls at a fixed rate: it turns the turtle while
+ * an arrow key is held, moves it if the "Up" arrow key is pressed, and if the pen is down,
+ * adds a line to the drawing.
  *
  * Parameters:
- *    deltaTime     - The time elapsed since the last frame, used for smooth movement.
  *    windowWidth   - Pointer to the window's width (to be updated on window resize).
  *    windowHeight  - Pointer to the window's height (to be updated on window resize).
  *
@@ -47,105 +61,392 @@
 //==================== Header Files ====================
 #include "events.h"
 #include "sprite.h"
-#include "graphics.h"
+#include "commands.h"
+#include "generate.h"
+#include "journal.h"
+#include "logger.h"
+#include "profiler.h"
+#include "render.h"
+#include "replay.h"
+#include "server.h"
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <math.h>
 
 
+//==================== Macros ====================
+// Movement and rotation increments
+#define ROTATION_INCREMENT 90.0f    // Degrees per second for rotation
+#define MOVE_INCREMENT 200.0f       // Pixels per second for movement
+
+// Camera controls
+#define ZOOM_STEP 1.25f             // Zoom factor per wheel notch or key press
+#define FOLLOW_MARGIN 50.0f         // Distance in pixels the turtle keeps from the window edges
+
+// Scripts
+#define SCRIPT_FRAME_TIME 0.008     // Seconds per main loop iteration spent sending the lines of a running script
+
+// Events
+#define EVENT_BATCH_SIZE 64         // Events taken from the queue at a time
+
+
+//==================== Structure ====================
+typedef struct {  // What a call to handle_events has seen, with the events it merges before sending them
+    int* windowWidth;
+    int* windowHeight;
+    bool resized;                   // Whether a resize to the window size is waiting to be sent
+    float panX, panY;               // Pan in window pixels waiting to be sent
+    bool changed;                   // Whether anything handled may change what is on screen
+} EventBatch;
+
+typedef bool (*KeyAction)(EventBatch* batch, int argument);  // Returns false to quit
+
+typedef struct {  // What a key does
+    SDL_Keycode key;
+    Uint16 modifiers;               // KMOD_CTRL, KMOD_SHIFT or KMOD_ALT that must be held, 0 for any state
+    bool* held;                     // Flag set while the key is held, or NULL
+    KeyAction action;               // Called when the key is pressed, or NULL
+    int argument;                   // Passed to `action`
+} KeyBinding;
+
+
 //==================== Global Variables ====================
 // Key state variables for continuous movement and rotation
 static bool keyLeftPressed = false;
 static bool keyRightPressed = false;
 static bool keyUpPressed = false;
+static bool panning = false;        // Whether the user is dragging the view with the mouse
+static GenerationJob* scriptJob = NULL; // Script being generated, or NULL
+static const char* scriptPath = NULL;   // File of the script being generated
+static int scriptLineCount = 0;         // Number of lines the script has drawn so far
+static Uint64 scriptStart = 0;          // Performance counter value when the script started
 
 
-//==================== Macros ====================
-// Movement and rotation increments
-#define ROTATION_INCREMENT 90.0f    // Degrees per second for rotation
-#define MOVE_INCREMENT 200.0f       // Pixels per second for movement
+//==================== Function Definition ====================
+static void step_journal(const bool redo) {
+/*
+ * step_journal - Undoes or redoes one stroke and puts the sprite where the journal says.
+ *
+ * A running script is stopped first, so undo takes back what it has drawn so far.
+ */
+
+    stop_script();
+    if (redo ? journal_redo(&sprite) : journal_undo(&sprite)) {
+        previousSprite = sprite;
+        render_send_follow(sprite.x, sprite.y, FOLLOW_MARGIN);
+    }
+}
 
 
-//==================== Function Definition ====================
-bool handle_events(const float deltaTime, int* windowWidth, int* windowHeight) {
-    SDL_Event evt;
-
-    // Process all pending events
-    while (SDL_PollEvent(&evt) != 0) {
-        switch (evt.type) {
-            case SDL_QUIT:
-                return false; // Exit on quit event
-            case SDL_KEYDOWN:
-                switch (evt.key.keysym.sym) {
-                    case SDLK_RIGHT:
-                        keyRightPressed = true;
-                        break;
-                    case SDLK_LEFT:
-                        keyLeftPressed = true;
-                        break;
-                    case SDLK_UP:
-                        keyUpPressed = true;
-                        break;
-                    case SDLK_d:
-                        update_pen(true);
-                        break;
-                    case SDLK_u:
-                        update_pen(false);
-                        break;
-                    case SDLK_1:
-                        change_color(1);
-                        break;
-                    case SDLK_2:
-                        change_color(2);
-                        break;
-                    case SDLK_3:
-                        change_color(3);
-                        break;
-                    case SDLK_4:
-                        change_color(4);
-                        break;
-                    case SDLK_5:
-                        change_color(5);
-                        break;
-                    case SDLK_ESCAPE:
-                        return false; // Exit on ESC key
-                    default:
-                        break;
-                }
-                break;
-            case SDL_KEYUP:
-                switch (evt.key.keysym.sym) {
-                    case SDLK_RIGHT:
-                        keyRightPressed = false;
-                        break;
-                    case SDLK_LEFT:
-                        keyLeftPressed = false;
-                        break;
-                    case SDLK_UP:
-                        keyUpPressed = false;
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case SDL_WINDOWEVENT:
-                if (evt.window.event == SDL_WINDOWEVENT_RESIZED) {
-                    *windowWidth = evt.window.data1;
-                    *windowHeight = evt.window.data2;
-                    printf("Window resized to %d x %d\n", *windowWidth, *windowHeight);
-
-                    // Update OpenGL viewport and projection
-                    glViewport(0, 0, *windowWidth, *windowHeight);
-                    glMatrixMode(GL_PROJECTION);
-                    glLoadIdentity();
-                    gluOrtho2D(0.0, *windowWidth, *windowHeight, 0.0);
-                    glMatrixMode(GL_MODELVIEW);
-                }
-                break;
-            default:
-                continue;
+static bool press_pen(EventBatch* batch, const int down) {
+/*
+ * press_pen - Puts the pen down, or lifts it and ends the stroke in the undo journal.
+ */
+
+    (void)batch;
+    update_pen(down != 0);
+    if (!down) {
+        journal_end();
+    }
+    return true;
+}
+
+
+static bool press_journal(EventBatch* batch, const int redo) {
+/*
+ * press_journal - Undoes or redoes the last stroke.
+ */
+
+    (void)batch;
+    step_journal(redo != 0);
+    return true;
+}
+
+
+static bool press_color(EventBatch* batch, const int color) {
+/*
+ * press_color - Selects a preset pen color.
+ */
+
+    (void)batch;
+    change_color(color);
+    return true;
+}
+
+
+static bool press_zoom(EventBatch* batch, const int in) {
+/*
+ * press_zoom - Zooms in or out around the center of the window.
+ */
+
+    render_send_zoom(in ? ZOOM_STEP : 1.0f / ZOOM_STEP, *batch->windowWidth / 2, *batch->windowHeight / 2);
+    return true;
+}
+
+
+static bool press_reset_view(EventBatch* batch, const int argument) {
+/*
+ * press_reset_view - Returns to the initial view.
+ */
+
+    (void)batch;
+    (void)argument;
+    render_send_reset_view();
+    return true;
+}
+
+
+static bool press_export(EventBatch* batch, const int format) {
+/*
+ * press_export - Exports the drawing, see export.c.
+ */
+
+    (void)batch;
+    render_send_export((ExportFormat)format);
+    return true;
+}
+
+
+static bool press_profiler(EventBatch* batch, const int argument) {
+/*
+ * press_profiler - Shows or hides the profiler overlay, when profiling.
+ */
+
+    (void)batch;
+    (void)argument;
+    if (profiler_enabled()) {
+        render_send_profiler_overlay();
+    }
+    return true;
+}
+
+
+static bool press_quit(EventBatch* batch, const int argument) {
+/*
+ * press_quit - Ends the program.
+ */
+
+    (void)batch;
+    (void)argument;
+    return false;
+}
+
+
+// What every key does, looked up in order so a binding with more modifiers comes before the same key with fewer
+static const KeyBinding keyBindings[] = {
+    {SDLK_RIGHT, 0, &keyRightPressed, NULL, 0},
+    {SDLK_LEFT, 0, &keyLeftPressed, NULL, 0},
+    {SDLK_UP, 0, &keyUpPressed, NULL, 0},
+    {SDLK_d, 0, NULL, press_pen, 1},
+    {SDLK_u, 0, NULL, press_pen, 0},
+    {SDLK_z, KMOD_CTRL | KMOD_SHIFT, NULL, press_journal, 1},
+    {SDLK_z, KMOD_CTRL, NULL, press_journal, 0},
+    {SDLK_y, KMOD_CTRL, NULL, press_journal, 1},
+    {SDLK_1, 0, NULL, press_color, 1},
+    {SDLK_2, 0, NULL, press_color, 2},
+    {SDLK_3, 0, NULL, press_color, 3},
+    {SDLK_4, 0, NULL, press_color, 4},
+    {SDLK_5, 0, NULL, press_color, 5},
+    {SDLK_EQUALS, 0, NULL, press_zoom, 1},
+    {SDLK_KP_PLUS, 0, NULL, press_zoom, 1},
+    {SDLK_MINUS, 0, NULL, press_zoom, 0},
+    {SDLK_KP_MINUS, 0, NULL, press_zoom, 0},
+    {SDLK_h, 0, NULL, press_reset_view, 0},
+    {SDLK_s, 0, NULL, press_export, EXPORT_SVG},
+    {SDLK_p, 0, NULL, press_export, EXPORT_PDF},
+    {SDLK_F3, 0, NULL, press_profiler, 0},
+    {SDLK_ESCAPE, 0, NULL, press_quit, 0}
+};
+
+
+static const KeyBinding* find_binding(const SDL_Keycode key, const Uint16 modifiers) {
+/*
+ * find_binding - Looks up what a key does with the modifiers held.
+ *
+ * Returns:
+ *    The first binding of the key whose modifiers are all held, or NULL if the key does nothing.
+ */
+
+    static const Uint16 groups[] = {KMOD_CTRL, KMOD_SHIFT, KMOD_ALT};
+    for (size_t i = 0; i < sizeof(keyBindings) / sizeof(keyBindings[0]); i++) {
+        const KeyBinding* binding = &keyBindings[i];
+        if (binding->key != key) {
+            continue;
+        }
+        bool held = true;
+        for (size_t j = 0; j < sizeof(groups) / sizeof(groups[0]); j++) {
+            if ((binding->modifiers & groups[j]) && !(modifiers & groups[j])) {
+                held = false;
+            }
+        }
+        if (held) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+
+static void send_pan(EventBatch* batch) {
+/*
+ * send_pan - Sends the mouse motion merged so far as one pan.
+ */
+
+    if (batch->panX != 0.0f || batch->panY != 0.0f) {
+        render_send_pan(batch->panX, batch->panY);
+        batch->panX = 0.0f;
+        batch->panY = 0.0f;
+    }
+}
+
+
+static void send_resize(EventBatch* batch) {
+/*
+ * send_resize - Sends the last of the resizes merged so far.
+ *
+ * The render thread then updates the viewport, the projection and the canvas once.
+ */
+
+    if (batch->resized) {
+        log_message("Window resized to %d x %d\n", *batch->windowWidth, *batch->windowHeight);
+        render_send_resize(*batch->windowWidth, *batch->windowHeight);
+        batch->resized = false;
+    }
+}
+
+
+static bool handle_event(EventBatch* batch, const SDL_Event* evt) {
+/*
+ * handle_event - Handles one event of a batch.
+ *
+ * A run of pan motions or of resizes is merged into one message, sent before any other event is handled,
+ * so the render thread still sees the input in order.
+ *
+ * Returns:
+ *    false if the program should exit.
+ */
+
+    const bool motion = evt->type == SDL_MOUSEMOTION;
+    const bool resize = evt->type == SDL_WINDOWEVENT && evt->window.event == SDL_WINDOWEVENT_RESIZED;
+    if (!motion) {
+        send_pan(batch);
+    }
+    if (!resize) {
+        send_resize(batch);
+    }
+
+    const KeyBinding* binding;
+    switch (evt->type) {
+        case SDL_QUIT:
+            return false; // Exit on quit event
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            binding = find_binding(evt->key.keysym.sym, evt->key.keysym.mod);
+            if (binding && binding->held) {
+                *binding->held = evt->type == SDL_KEYDOWN;
+            } else if (binding && binding->action && evt->type == SDL_KEYDOWN &&
+                       !binding->action(batch, binding->argument)) {
+                return false;
+            }
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            if (evt->button.button == SDL_BUTTON_RIGHT || evt->button.button == SDL_BUTTON_MIDDLE) {
+                panning = evt->type == SDL_MOUSEBUTTONDOWN;
+            }
+            break;
+        case SDL_MOUSEMOTION:
+            if (panning) {
+                batch->panX += (float)evt->motion.xrel;
+                batch->panY += (float)evt->motion.yrel;
+            }
+            break;
+        case SDL_MOUSEWHEEL:
+            if (evt->wheel.y != 0) {
+                int mouseX, mouseY;
+                replay_mouse_position(&mouseX, &mouseY);
+                render_send_zoom(evt->wheel.y > 0 ? ZOOM_STEP : 1.0f / ZOOM_STEP, mouseX, mouseY);
+            }
+            break;
+        case SDL_WINDOWEVENT:
+            if (resize) {
+                *batch->windowWidth = evt->window.data1;
+                *batch->windowHeight = evt->window.data2;
+                batch->resized = true;
+            }
+            break;
+        default:
+            return true;
+    }
+
+    // Any handled event may change what is on screen
+    batch->changed = true;
+    return true;
+}
+
+
+bool handle_events(int* windowWidth, int* windowHeight) {
+    EventBatch batch = {windowWidth, windowHeight, false, 0.0f, 0.0f, false};
+    SDL_Event events[EVENT_BATCH_SIZE];
+
+    // Gather the pending events once, then process them a batch at a time
+    SDL_PumpEvents();
+    int count;
+    do {
+        count = replay_peep_events(events, EVENT_BATCH_SIZE);
+        for (int i = 0; i < count; i++) {
+            if (!handle_event(&batch, &events[i])) {
+                return false;
+            }
         }
+    } while (count == EVENT_BATCH_SIZE);
+
+    send_pan(&batch);
+    send_resize(&batch);
+    if (batch.changed) {
+        render_send_redraw();
+    }
+    return true;
+}
+
+
+bool simulation_active(void) {
+/*
+ * simulation_active - Reports whether the next simulation steps may change anything.
+ *
+ * The main loop uses this to sleep until input arrives instead of stepping a turtle at rest.
+ *
+ * Returns:
+ *    true while a movement key is held, a script runs, or the sprite has not yet settled after its last
+ *    move; false otherwise.
+ */
+
+    return keyLeftPressed || keyRightPressed || keyUpPressed || scriptJob ||
+           previousSprite.x != sprite.x || previousSprite.y != sprite.y || previousSprite.angle != sprite.angle;
+}
+
+
+void update_simulation(const float deltaTime) {
+/*
+ * update_simulation - Advances the turtle by one simulation step.
+ *
+ * The turtle turns and moves according to the keys currently held, and a line is sent to the render
+ * thread when the pen is down. The lines drawn between putting the pen down and lifting it again form
+ * one stroke of the undo journal (see journal.c). The main loop calls this at a fixed rate,
+ * independently of how often frames are rendered, so the turtle's path and the number of lines it
+ * produces do not depend on the display.
+ *
+ * Parameters:
+ *    deltaTime    - The length of a simulation step in seconds.
+ */
+
+    // Remember where the turtle was so the renderer can interpolate between steps
+    save_sprite_state();
+
+    // The keyboard takes over once a running script is done with the turtle
+    if (scriptJob) {
+        return;
     }
 
     // Update rotation
@@ -158,15 +459,173 @@ bool handle_events(const float deltaTime, int* windowWidth, int* windowHeight) {
 
     // Update position
     if (keyUpPressed) {
-        const float previous_x = sprite.x;
-        const float previous_y = sprite.y;
-        update_location(deltaTime, *windowWidth, *windowHeight);
+        const Sprite before = sprite;
+        update_location(deltaTime);
+        render_send_follow(sprite.x, sprite.y, FOLLOW_MARGIN);
         if (sprite.pen) {
-            // Add line to lines array
-            extern void add_line(float x1, float y1, float x2, float y2);
-            add_line(previous_x, previous_y, sprite.x, sprite.y);
+            // The first line since the pen went down starts a new stroke in the undo journal
+            journal_begin(&before);
+
+            // Add the line to the drawing in the current color
+            const Line line = {before.x, before.y, sprite.x, sprite.y, sprite.r, sprite.g, sprite.b};
+            render_send_line(&line);
         }
     }
+}
 
-    return true;
+
+static void draw_script_line(const Line* line, void* context) {
+/*
+ * draw_script_line - Line sink sending each line drawn by a script to the render thread.
+ *
+ * The sprite follows the lines as they arrive, so a long script is seen being drawn.
+ */
+
+    (void)context;
+    sprite.x = line->x2;
+    sprite.y = line->y2;
+    sprite.r = line->r;
+    sprite.g = line->g;
+    sprite.b = line->b;
+    render_send_line(line);
+    scriptLineCount++;
+}
+
+
+void run_script(const char* path) {
+/*
+ * run_script - Starts running a command file or drawing an L-system definition with the sprite as its turtle.
+ *
+ * The script starts from the sprite's current state, with the sprite's position as its home. Its lines are
+ * generated on worker threads, see generate.c, and poll_script sends them to the render thread like the
+ * keyboard does, a slice per iteration of the main loop, so the window stays responsive while a large
+ * drawing is generated. On an error, the lines drawn before it are kept and the error is reported.
+ *
+ * Parameters:
+ *    path - The command file, see commands.c for the language, an L-system definition ending in
+ *           ".lsys", see lsystem.c, or a saved session ending in ".session", see session.c.
+ */
+
+    FILE* input = fopen(path, "r");
+    if (!input) {
+        log_message("Could not open %s\n", path);
+        return;
+    }
+
+    stop_script();
+    render_send_swarm(NULL);
+    const Turtle turtle = {sprite.x, sprite.y, sprite.angle, sprite.pen, sprite.r, sprite.g, sprite.b,
+                           sprite.x, sprite.y};
+    scriptLineCount = 0;
+    scriptStart = SDL_GetPerformanceCounter();
+    scriptPath = path;
+    scriptJob = generate_start(input, path, &turtle);
+    fclose(input);
+
+    // The whole script is undone in one step
+    journal_end();
+    if (scriptJob) {
+        journal_begin(&sprite);
+    }
+
+    // Short scripts are finished before the first simulation step
+    poll_script();
+}
+
+
+void poll_script(void) {
+/*
+ * poll_script - Sends the lines a running script has generated since the last call to the render thread.
+ *
+ * Called once per iteration of the main loop. It never waits for the workers and stops after
+ * SCRIPT_FRAME_TIME; once every line has been sent, the sprite takes the script's final state, the
+ * view follows it and the other turtles the script told are drawn where they ended.
+ */
+
+    if (!scriptJob || !generate_poll(scriptJob, draw_script_line, NULL, SCRIPT_FRAME_TIME)) {
+        return;
+    }
+
+    Turtle turtle;
+    TurtleSwarm swarm;
+    generate_end_swarm(scriptJob, &turtle, &swarm);
+    scriptJob = NULL;
+    journal_end();
+
+    const double seconds = (double)(SDL_GetPerformanceCounter() - scriptStart) / (double)SDL_GetPerformanceFrequency();
+    log_message("%s drew %d lines in %.1f ms\n", scriptPath, scriptLineCount, seconds * 1000.0);
+
+    sprite.x = turtle.x;
+    sprite.y = turtle.y;
+    sprite.angle = turtle.angle;
+    sprite.pen = turtle.pen;
+    sprite.r = turtle.r;
+    sprite.g = turtle.g;
+    sprite.b = turtle.b;
+    previousSprite = sprite;
+    render_send_follow(sprite.x, sprite.y, FOLLOW_MARGIN);
+
+    // The other turtles the script told stay where it left them, until the next script
+    render_send_swarm(&swarm);
+    swarm_free(&swarm);
+}
+
+
+void poll_remote(void) {
+/*
+ * poll_remote - Runs the command batches clients of the command server have sent since the last call.
+ *
+ * Called once per iteration of the main loop. Each batch drives the sprite from where it is, like a short
+ * script, and is undone in one step; a batch that does not decode is reported and skipped. Nothing is taken
+ * while a script runs, since that script owns the turtle until it ends, and no more batches are taken once
+ * SCRIPT_FRAME_TIME has passed, so a busy client cannot starve the window.
+ */
+
+    if (scriptJob) {
+        return;
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const Uint64 budget = (Uint64)(SCRIPT_FRAME_TIME * (double)SDL_GetPerformanceFrequency());
+    ServerBatch* batch;
+    while (SDL_GetPerformanceCounter() - start < budget && (batch = server_take_batch())) {
+        char name[32];
+        snprintf(name, sizeof(name), "client %d", batch->client);
+        CommandProgram* program = commands_decode(batch->data, batch->length, name);
+        server_free_batch(batch);
+        if (!program) {
+            continue;
+        }
+
+        journal_end();
+        journal_begin(&sprite);
+        Turtle turtle = {sprite.x, sprite.y, sprite.angle, sprite.pen, sprite.r, sprite.g, sprite.b,
+                         sprite.x, sprite.y};
+        commands_run(program, &turtle, draw_script_line, NULL);
+        commands_free(program);
+        journal_end();
+
+        sprite.x = turtle.x;
+        sprite.y = turtle.y;
+        sprite.angle = turtle.angle;
+        sprite.pen = turtle.pen;
+        sprite.r = turtle.r;
+        sprite.g = turtle.g;
+        sprite.b = turtle.b;
+        previousSprite = sprite;
+        render_send_follow(sprite.x, sprite.y, FOLLOW_MARGIN);
+    }
+}
+
+
+void stop_script(void) {
+/*
+ * stop_script - Abandons a running script, keeping the lines already added.
+ */
+
+    if (scriptJob) {
+        generate_end(scriptJob, NULL);
+        scriptJob = NULL;
+        journal_end();
+    }
 }
@@ -0,0 +1,568 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * export.c - SVG and PDF export of drawings.
+ *
+ * The exporter receives lines one at a time and collects them into chunks of EXPORT_CHUNK_LINES. Once a
+ * chunk per worker is full, the workers turn their chunks into text at the same time and the chunks are
+ * written to the file in order, so the memory held is a few chunks of lines and their text whatever the
+ * size of the drawing. Within a chunk, a line that starts where the previous one ended, in the same color,
+ * extends the current polyline: a <path> in SVG, a subpath stroked once per color in PDF. Polylines
+ * always break at chunk boundaries, which keeps the file identical with any number of workers.
+ *
+ * Coordinates are written with at most three decimals by a formatter that works on integers, much faster
+ * than printf, and colors as bytes. Lines with coordinates that are not finite are skipped.
+ *
+ * SVG keeps the drawing's coordinates, with y growing downward, in a view box around the drawing. PDF has
+ * y growing upward, so its content stream starts with a transformation that flips the page; the objects
+ * are counted as they are written and the cross-reference table is written at the end, after the length
+ * of the content stream is known.
+ *
+ * Key functions:
+ *    - export_open / export_line / export_close: Write a vector file from a stream of lines.
+ *    - export_line_store: Exports the line store.
+ */
+
+
+//==================== Header Files ====================
+#include "export.h"
+#include "generate.h"
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define EXPORT_CHUNK_LINES 8192           // Lines formatted by a worker at a time
+#define EXPORT_MARGIN 2.0f                // Space left around the drawing, in drawing units
+#define LINE_TEXT_MAX 256                 // Most characters of text a line may add to its chunk
+#define NUMBER_TEXT_MAX 48                // Most characters of a formatted number
+#define FIXED_LIMIT 1e9                   // Larger coordinates are written without decimals
+#define PDF_OBJECT_COUNT 5                // Catalog, page tree, page, content stream and its length
+
+
+//==================== Structure ====================
+typedef struct {  // Text of a formatted chunk
+    char* data;
+    size_t used;
+    size_t capacity;
+    int paths;                // Number of polylines in the chunk
+} TextBuffer;
+
+typedef struct {  // Chunk given to a formatting worker
+    ExportFormat format;
+    const Line* lines;
+    int count;
+    TextBuffer* text;
+} ChunkTask;
+
+struct ExportWriter {
+    FILE* file;
+    char* path;                       // Path of the file, used in messages
+    ExportFormat format;
+    bool failed;                      // Whether a write failed, after which nothing more is written
+    int threads;                      // Workers formatting the chunks
+    Line* lines;                      // A chunk of lines per worker
+    int pending;                      // Lines waiting in `lines`
+    TextBuffer* texts;                // Text of each chunk
+    ChunkTask* tasks;                 // Work of each worker
+    SDL_Thread** workers;             // Worker formatting each chunk, NULL for the calling thread
+    long long bytes;                  // Bytes written to the file so far
+    long long lineCount;              // Lines exported
+    long long pathCount;              // Polylines written
+    long long objectOffsets[PDF_OBJECT_COUNT + 1]; // Offset of each PDF object, from 1
+    long long contentStart;           // Offset of the PDF content stream's first byte
+};
+
+
+//==================== Function Definitions ====================
+static void text_reserve(TextBuffer* text, const size_t extra) {
+/*
+ * text_reserve - Makes room for `extra` more characters in a text buffer.
+ */
+
+    if (text->used + extra <= text->capacity) {
+        return;
+    }
+    size_t capacity = text->capacity ? text->capacity : 65536;
+    while (capacity < text->used + extra) {
+        capacity *= 2;
+    }
+    char* data = realloc(text->data, capacity);
+    if (!data) {
+        printf("Error reallocating memory for an export!\n");
+        exit(1);
+    }
+    text->data = data;
+    text->capacity = capacity;
+}
+
+
+static void text_append(TextBuffer* text, const char* string) {
+/*
+ * text_append - Appends a string to a text buffer that has room for it.
+ */
+
+    const size_t length = strlen(string);
+    memcpy(text->data + text->used, string, length);
+    text->used += length;
+}
+
+
+static void text_number(TextBuffer* text, const float value) {
+/*
+ * text_number - Appends a number with at most three decimals and no trailing zeros.
+ *
+ * The digits are produced from the number scaled to thousandths and rounded to an integer. Numbers too
+ * large for that are written without decimals. Both forms are valid in SVG and in PDF, which does not
+ * accept exponents.
+ */
+
+    char* out = text->data + text->used;
+    if (!(fabs(value) < FIXED_LIMIT)) {
+        text->used += (size_t)snprintf(out, NUMBER_TEXT_MAX, "%.0f", (double)value);
+        return;
+    }
+
+    long long scaled = llround((double)value * 1000.0);
+    if (scaled < 0) {
+        *out++ = '-';
+        scaled = -scaled;
+    }
+    long long whole = scaled / 1000;
+    int fraction = (int)(scaled % 1000);
+
+    char digits[NUMBER_TEXT_MAX];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+
+    if (fraction) {
+        *out++ = '.';
+        int divisor = 100;
+        while (fraction) {
+            *out++ = (char)('0' + fraction / divisor);
+            fraction %= divisor;
+            divisor /= 10;
+        }
+    }
+    text->used = (size_t)(out - text->data);
+}
+
+
+static void text_point(TextBuffer* text, const float x, const float y, const char* suffix) {
+/*
+ * text_point - Appends a pair of coordinates followed by a suffix.
+ */
+
+    text_number(text, x);
+    text->data[text->used++] = ' ';
+    text_number(text, y);
+    text_append(text, suffix);
+}
+
+
+static int color_byte(const GLfloat component) {
+/*
+ * color_byte - Converts a color component between 0 and 1 to a byte.
+ */
+
+    const float scaled = component * 255.0f + 0.5f;
+    return scaled <= 0.0f ? 0 : scaled >= 255.0f ? 255 : (int)scaled;
+}
+
+
+static bool finite_line(const Line* line) {
+/*
+ * finite_line - Tells whether every coordinate of a line is a finite number.
+ */
+
+    return isfinite(line->x1) && isfinite(line->y1) && isfinite(line->x2) && isfinite(line->y2);
+}
+
+
+static void format_chunk(const ChunkTask* task) {
+/*
+ * format_chunk - Turns a chunk of lines into SVG elements or PDF operators.
+ *
+ * Each polyline starts with a move to the start of its first line and continues with a line to the end of
+ * every line that follows on. In SVG, a new color or a break starts a new <path>. In PDF, a break starts a
+ * new subpath of the same path, and the path is only stroked before a new color and at the end.
+ */
+
+    TextBuffer* text = task->text;
+    text->used = 0;
+    text->paths = 0;
+
+    bool open = false;
+    int red = -1, green = -1, blue = -1;
+    float lastX = 0.0f, lastY = 0.0f;
+    char buffer[LINE_TEXT_MAX];
+
+    for (int i = 0; i < task->count; i++) {
+        const Line* line = &task->lines[i];
+        text_reserve(text, LINE_TEXT_MAX);
+
+        const int r = color_byte(line->r), g = color_byte(line->g), b = color_byte(line->b);
+        const bool sameColor = r == red && g == green && b == blue;
+        const bool continues = open && sameColor && line->x1 == lastX && line->y1 == lastY;
+
+        if (task->format == EXPORT_SVG) {
+            if (continues) {
+                text->data[text->used++] = ' ';
+            } else {
+                if (open) {
+                    text_append(text, "\"/>\n");
+                }
+                snprintf(buffer, sizeof(buffer), "<path stroke=\"#%02x%02x%02x\" d=\"M", r, g, b);
+                text_append(text, buffer);
+                text_point(text, line->x1, line->y1, "L");
+                text->paths++;
+            }
+            text_point(text, line->x2, line->y2, "");
+        } else {
+            if (!sameColor) {
+                if (open) {
+                    text_append(text, "S\n");
+                }
+                snprintf(buffer, sizeof(buffer), "%.3f %.3f %.3f RG\n", r / 255.0, g / 255.0, b / 255.0);
+                text_append(text, buffer);
+            }
+            if (!continues) {
+                text_point(text, line->x1, line->y1, " m ");
+                text->paths++;
+            }
+            text_point(text, line->x2, line->y2, " l\n");
+        }
+
+        open = true;
+        red = r;
+        green = g;
+        blue = b;
+        lastX = line->x2;
+        lastY = line->y2;
+    }
+
+    if (open) {
+        text_reserve(text, LINE_TEXT_MAX);
+        text_append(text, task->format == EXPORT_SVG ? "\"/>\n" : "S\n");
+    }
+}
+
+
+static int format_worker(void* data) {
+/*
+ * format_worker - Thread body formatting one chunk.
+ *
+ * Returns:
+ *    0, as SDL threads report a status.
+ */
+
+    format_chunk(data);
+    return 0;
+}
+
+
+static void write_bytes(ExportWriter* writer, const void* data, const size_t size) {
+/*
+ * write_bytes - Writes bytes to the file and counts them, unless a write already failed.
+ */
+
+    if (writer->failed) {
+        return;
+    }
+    if (fwrite(data, 1, size, writer->file) != size) {
+        printf("Error writing %s\n", writer->path);
+        writer->failed = true;
+        return;
+    }
+    writer->bytes += (long long)size;
+}
+
+
+static void write_text(ExportWriter* writer, const char* format, ...) {
+/*
+ * write_text - Writes formatted text to the file, for the short parts around the lines.
+ */
+
+    char text[512];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    if (length > 0) {
+        write_bytes(writer, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    }
+}
+
+
+static void flush_chunks(ExportWriter* writer) {
+/*
+ * flush_chunks - Formats the pending lines, a chunk per worker, and writes the chunks in order.
+ *
+ * The calling thread formats the first chunk itself. A chunk whose worker cannot be started is formatted
+ * on the calling thread too.
+ */
+
+    if (writer->pending == 0) {
+        return;
+    }
+
+    const int chunkCount = (writer->pending + EXPORT_CHUNK_LINES - 1) / EXPORT_CHUNK_LINES;
+    ChunkTask* tasks = writer->tasks;
+    SDL_Thread** threads = writer->workers;
+    for (int i = 0; i < chunkCount; i++) {
+        const int first = i * EXPORT_CHUNK_LINES;
+        const int count = writer->pending - first < EXPORT_CHUNK_LINES ? writer->pending - first : EXPORT_CHUNK_LINES;
+        tasks[i] = (ChunkTask){writer->format, &writer->lines[first], count, &writer->texts[i]};
+        threads[i] = i == 0 ? NULL : SDL_CreateThread(format_worker, "export", &tasks[i]);
+        if (i > 0 && !threads[i]) {
+            format_chunk(&tasks[i]);
+        }
+    }
+    format_chunk(&tasks[0]);
+
+    for (int i = 0; i < chunkCount; i++) {
+        if (threads[i]) {
+            SDL_WaitThread(threads[i], NULL);
+        }
+        write_bytes(writer, writer->texts[i].data, writer->texts[i].used);
+        writer->pathCount += writer->texts[i].paths;
+    }
+    writer->pending = 0;
+}
+
+
+ExportWriter* export_open(const char* path, const ExportFormat format, const float minX, const float minY,
+                          const float maxX, const float maxY) {
+/*
+ * export_open - Creates a vector file showing a rectangle of the drawing.
+ *
+ * Parameters:
+ *    path       - The path of the file, replaced if it exists.
+ *    format     - The format of the file.
+ *    minX, minY - The top left corner of the rectangle, in drawing coordinates.
+ *    maxX, maxY - Its bottom right corner.
+ *
+ * Returns:
+ *    The writer, to be closed with export_close, or NULL after reporting an error.
+ */
+
+    ExportWriter* writer = calloc(1, sizeof(ExportWriter));
+    const size_t pathLength = strlen(path);
+    if (!writer || !(writer->path = malloc(pathLength + 1))) {
+        printf("Error allocating memory for an export!\n");
+        exit(1);
+    }
+    memcpy(writer->path, path, pathLength + 1);
+    writer->format = format;
+    writer->threads = generate_thread_count();
+    writer->lines = malloc((size_t)writer->threads * EXPORT_CHUNK_LINES * sizeof(Line));
+    writer->texts = calloc((size_t)writer->threads, sizeof(TextBuffer));
+    writer->tasks = malloc((size_t)writer->threads * sizeof(ChunkTask));
+    writer->workers = malloc((size_t)writer->threads * sizeof(SDL_Thread*));
+    if (!writer->lines || !writer->texts || !writer->tasks || !writer->workers) {
+        printf("Error allocating memory for an export!\n");
+        exit(1);
+    }
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        printf("Could not create %s\n", path);
+        free(writer->lines);
+        free(writer->texts);
+        free(writer->tasks);
+        free(writer->workers);
+        free(writer->path);
+        free(writer);
+        return NULL;
+    }
+
+    const double width = (double)maxX - (double)minX;
+    const double height = (double)maxY - (double)minY;
+    if (format == EXPORT_SVG) {
+        write_text(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                           "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"%.3f\" height=\"%.3f\" "
+                           "viewBox=\"%.3f %.3f %.3f %.3f\">\n",
+                   width, height, (double)minX, (double)minY, width, height);
+        write_text(writer, "<rect x=\"%.3f\" y=\"%.3f\" width=\"%.3f\" height=\"%.3f\" fill=\"#ffffff\"/>\n",
+                   (double)minX, (double)minY, width, height);
+        write_text(writer, "<g fill=\"none\" stroke-width=\"1\" stroke-linecap=\"round\" stroke-linejoin=\"round\">\n");
+    } else {
+        write_text(writer, "%%PDF-1.4\n");
+        writer->objectOffsets[1] = writer->bytes;
+        write_text(writer, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+        writer->objectOffsets[2] = writer->bytes;
+        write_text(writer, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+        writer->objectOffsets[3] = writer->bytes;
+        write_text(writer, "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.3f %.3f] "
+                           "/Contents 4 0 R >>\nendobj\n", width, height);
+        writer->objectOffsets[4] = writer->bytes;
+        write_text(writer, "4 0 obj\n<< /Length 5 0 R >>\nstream\n");
+        writer->contentStart = writer->bytes;
+
+        // Flip the page so that drawing coordinates, with y growing downward, can be written as they are
+        write_text(writer, "1 0 0 -1 %.3f %.3f cm\n1 w 1 J 1 j\n", 0.0 - (double)minX, (double)maxY);
+    }
+    return writer;
+}
+
+
+void export_line(ExportWriter* writer, const Line* line) {
+/*
+ * export_line - Adds a line to a vector file.
+ *
+ * Parameters:
+ *    writer - The file.
+ *    line   - The line to add.
+ */
+
+    if (!finite_line(line)) {
+        return;
+    }
+    writer->lines[writer->pending++] = *line;
+    writer->lineCount++;
+    if (writer->pending == writer->threads * EXPORT_CHUNK_LINES) {
+        flush_chunks(writer);
+    }
+}
+
+
+bool export_close(ExportWriter* writer) {
+/*
+ * export_close - Writes the remaining lines and the end of a vector file, and closes it.
+ *
+ * Parameters:
+ *    writer - The file.
+ *
+ * Returns:
+ *    true if the whole file was written, false otherwise.
+ */
+
+    flush_chunks(writer);
+
+    if (writer->format == EXPORT_SVG) {
+        write_text(writer, "</g>\n</svg>\n");
+    } else {
+        const long long contentLength = writer->bytes - writer->contentStart;
+        write_text(writer, "\nendstream\nendobj\n");
+        writer->objectOffsets[5] = writer->bytes;
+        write_text(writer, "5 0 obj\n%lld\nendobj\n", contentLength);
+
+        const long long xrefOffset = writer->bytes;
+        write_text(writer, "xref\n0 %d\n0000000000 65535 f \n", PDF_OBJECT_COUNT + 1);
+        for (int i = 1; i <= PDF_OBJECT_COUNT; i++) {
+            write_text(writer, "%010lld 00000 n \n", writer->objectOffsets[i]);
+        }
+        write_text(writer, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%lld\n%%%%EOF\n", PDF_OBJECT_COUNT + 1,
+                   xrefOffset);
+    }
+
+    bool succeeded = !writer->failed;
+    if (fclose(writer->file) != 0 && succeeded) {
+        printf("Error writing %s\n", writer->path);
+        succeeded = false;
+    }
+
+    for (int i = 0; i < writer->threads; i++) {
+        free(writer->texts[i].data);
+    }
+    free(writer->texts);
+    free(writer->tasks);
+    free(writer->workers);
+    free(writer->lines);
+    free(writer->path);
+    free(writer);
+    return succeeded;
+}
+
+
+bool export_line_store(const char* path, const ExportFormat format) {
+/*
+ * export_line_store - Exports every readable line of the line store, framed by the drawing's bounds.
+ *
+ * The store is read twice, once for the bounds and once for the lines. Lines the store has already
+ * flattened into the canvas cannot be read and are left out, with a warning.
+ *
+ * Parameters:
+ *    path   - The path of the file, replaced if it exists.
+ *    format - The format of the file.
+ *
+ * Returns:
+ *    true if the file was written, false after reporting an error.
+ */
+
+    static LineIterator it;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const int first = line_store_first();
+    const int count = line_store_count() - first;
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    line_store_iterate(&it, first, count);
+    while (line_store_next_block(&it)) {
+        for (int i = 0; i < it.count; i++) {
+            const Line* line = &it.lines[i];
+            if (finite_line(line)) {
+                minX = fminf(minX, fminf(line->x1, line->x2));
+                minY = fminf(minY, fminf(line->y1, line->y2));
+                maxX = fmaxf(maxX, fmaxf(line->x1, line->x2));
+                maxY = fmaxf(maxY, fmaxf(line->y1, line->y2));
+            }
+        }
+    }
+    if (minX > maxX) {
+        printf("Nothing to export to %s\n", path);
+        return false;
+    }
+    if (first > 0) {
+        printf("%d lines flattened into the canvas are not exported\n", first);
+    }
+
+    ExportWriter* writer = export_open(path, format, minX - EXPORT_MARGIN, minY - EXPORT_MARGIN, maxX + EXPORT_MARGIN,
+                                       maxY + EXPORT_MARGIN);
+    if (!writer) {
+        return false;
+    }
+    line_store_iterate(&it, first, count);
+    while (line_store_next_block(&it)) {
+        for (int i = 0; i < it.count; i++) {
+            export_line(writer, &it.lines[i]);
+        }
+    }
+
+    flush_chunks(writer);
+    const long long lineCount = writer->lineCount;
+    const long long pathCount = writer->pathCount;
+    if (!export_close(writer)) {
+        return false;
+    }
+    const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    printf("Exported %lld lines as %lld polylines to %s in %.1f ms\n", lineCount, pathCount, path, seconds * 1000.0);
+    return true;
+}
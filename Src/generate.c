@@ -0,0 +1,541 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * generate.c - Geometry generation on worker threads.
+ *
+ * A job produces its lines as a sequence of outputs, each a buffer of lines owned by the worker that fills
+ * it. The outputs sit in a ring of slots: output k goes to slot k modulo the ring size, and a worker only
+ * claims output k once output k - ring size has been delivered, which bounds the memory held by a job to
+ * the ring however large the drawing is. The consumer delivers outputs strictly in order, so the lines
+ * reach the line store in the same order whatever the number of workers and however they are scheduled.
+ *
+ * An L-system that lsystem_plan can split is drawn by several workers, each claiming the next part of the
+ * plan as soon as it is free, with the part's output sized up front from the plan. Command programs,
+ * L-systems that cannot be split and saved sessions run on a single worker that publishes its lines in
+ * fixed-size chunks, which still takes the work off the caller's thread.
+ *
+ * The lock only guards the ring bookkeeping and is never held while lines are generated or delivered.
+ * generate_poll only tries the lock and stops at a deadline, so a render loop can poll every frame without
+ * ever waiting for a worker.
+ *
+ * Key functions:
+ *    - generate_start: Starts the workers of a job.
+ *    - generate_poll / generate_wait: Deliver lines in order.
+ *    - generate_end / generate_end_swarm: Join the workers and release the job.
+ */
+
+
+//==================== Header Files ====================
+#include "generate.h"
+#include "lsystem.h"
+#include "session.h"
+
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define GENERATION_MAX_THREADS 64     // Most workers of a job
+#define SLOTS_PER_THREAD 4            // Outputs per worker that may wait for the consumer
+#define CHUNK_LINES 16384             // Lines per output of a single-worker job
+#define DELIVERY_BATCH 1024           // Lines delivered between two checks of the poll deadline
+
+
+//==================== Structure ====================
+typedef struct {  // Output waiting in the ring
+    Line* lines;              // Lines of the output, owned by the slot while it is ready
+    int count;                // Number of lines
+    bool ready;               // Whether the output is complete
+} Slot;
+
+typedef struct {  // Buffer filled by a worker drawing a part
+    Line* lines;
+    int count;
+} PartBuffer;
+
+struct GenerationJob {
+    char* name;               // Name of the source, used in messages
+    CommandProgram* program;  // Program run by a single worker, or NULL for an L-system or a session
+    SessionReader* session;   // Session read by a single worker, or NULL
+    LSystem system;           // Definition drawn, when there is no program
+    LSystemPlan* plan;        // Parts drawn by several workers, or NULL for a single worker
+    Turtle turtle;            // Starting turtle, then the final turtle of a single worker
+    TurtleSwarm swarm;        // Other turtles told by a program, filled by its worker
+    Turtle lastPartEnd;       // Where the last part of the plan ended
+    bool truncated;           // Whether a single worker stopped at the L-system budget
+
+    SDL_Thread* threads[GENERATION_MAX_THREADS]; // Workers
+    int threadCount;          // Number of workers started
+    SDL_mutex* lock;          // Guards the fields below
+    SDL_cond* changed;        // Signaled when an output is published or delivered, or the job is cancelled
+    Slot* slots;              // Ring of outputs
+    int slotCount;            // Size of the ring
+    int nextOutput;           // Index of the next output to be claimed
+    int totalOutputs;         // Number of outputs of the drawing, -1 until known
+    int consumed;             // Number of outputs delivered
+    int runningThreads;       // Number of workers that have not finished
+    bool succeeded;           // Whether a single worker's program ran without error
+    bool cancelled;           // Whether the job is being ended before it is complete
+    SDL_atomic_t stop;        // Set with `cancelled`, read by a running program without the lock
+
+    int delivered;            // Lines of the current output already delivered, used by the consumer only
+    Line* chunk;              // Chunk filled by a single worker, used by that worker only
+    int chunkCount;           // Lines in the chunk
+};
+
+
+//==================== Global Variables ====================
+static int workerCount = 0;   // Workers used to draw a split L-system, 0 for one per CPU
+
+
+//==================== Function Definitions ====================
+void generate_set_threads(const int threads) {
+/*
+ * generate_set_threads - Selects how many workers draw an L-system that can be split.
+ *
+ * Parameters:
+ *    threads - The number of workers, 0 for one per CPU.
+ */
+
+    workerCount = threads < 0 ? 0 : threads > GENERATION_MAX_THREADS ? GENERATION_MAX_THREADS : threads;
+}
+
+
+int generate_thread_count(void) {
+/*
+ * generate_thread_count - Returns how many workers a job that can be split uses, at most.
+ *
+ * Other parallel work, such as exporting a drawing, follows the same setting.
+ */
+
+    const int threads = workerCount ? workerCount : SDL_GetCPUCount();
+    return threads > GENERATION_MAX_THREADS ? GENERATION_MAX_THREADS : threads < 1 ? 1 : threads;
+}
+
+
+static void append_line(const Line* line, void* context) {
+/*
+ * append_line - Line sink filling the buffer of a part, which was sized from the plan.
+ */
+
+    PartBuffer* buffer = context;
+    buffer->lines[buffer->count++] = *line;
+}
+
+
+static int part_worker(void* data) {
+/*
+ * part_worker - Draws parts of a plan until none are left.
+ *
+ * Returns:
+ *    0, as SDL threads report a status.
+ */
+
+    GenerationJob* job = data;
+    const int partCount = lsystem_plan_parts(job->plan);
+
+    SDL_LockMutex(job->lock);
+    for (;;) {
+        // Claim the next part once the slot it goes to has been delivered
+        while (!job->cancelled && job->nextOutput < partCount && job->nextOutput >= job->consumed + job->slotCount) {
+            SDL_CondWait(job->changed, job->lock);
+        }
+        if (job->cancelled || job->nextOutput >= partCount) {
+            break;
+        }
+        const int part = job->nextOutput++;
+        SDL_UnlockMutex(job->lock);
+
+        PartBuffer buffer = {malloc((size_t)lsystem_part_lines(job->plan, part) * sizeof(Line)), 0};
+        if (!buffer.lines) {
+            printf("Error allocating memory for generated lines!\n");
+            exit(1);
+        }
+        Turtle end;
+        lsystem_run_part(&job->system, job->plan, part, append_line, &buffer, &end);
+
+        SDL_LockMutex(job->lock);
+        job->slots[part % job->slotCount] = (Slot){buffer.lines, buffer.count, true};
+        if (part == partCount - 1) {
+            job->lastPartEnd = end;
+        }
+        SDL_CondBroadcast(job->changed);
+    }
+
+    job->runningThreads--;
+    SDL_CondBroadcast(job->changed);
+    SDL_UnlockMutex(job->lock);
+    return 0;
+}
+
+
+static void publish_chunk(GenerationJob* job) {
+/*
+ * publish_chunk - Hands the chunk of a single worker to the consumer, waiting for a free slot.
+ *
+ * Once the job is cancelled the lines are dropped instead, so the worker finishes without waiting: a
+ * program stops at its next look at the cancel flag, an L-system or a session at the end of its lines.
+ */
+
+    SDL_LockMutex(job->lock);
+    while (!job->cancelled && job->nextOutput >= job->consumed + job->slotCount) {
+        SDL_CondWait(job->changed, job->lock);
+    }
+    if (!job->cancelled) {
+        job->slots[job->nextOutput % job->slotCount] = (Slot){job->chunk, job->chunkCount, true};
+        job->nextOutput++;
+        SDL_CondBroadcast(job->changed);
+        job->chunk = NULL;
+    }
+    SDL_UnlockMutex(job->lock);
+
+    if (!job->chunk) {
+        job->chunk = malloc(CHUNK_LINES * sizeof(Line));
+        if (!job->chunk) {
+            printf("Error allocating memory for generated lines!\n");
+            exit(1);
+        }
+    }
+    job->chunkCount = 0;
+}
+
+
+static void collect_line(const Line* line, void* context) {
+/*
+ * collect_line - Line sink of a single worker, adding each line to its chunk.
+ */
+
+    GenerationJob* job = context;
+    if (job->chunkCount == CHUNK_LINES) {
+        publish_chunk(job);
+    }
+    job->chunk[job->chunkCount++] = *line;
+}
+
+
+static int single_worker(void* data) {
+/*
+ * single_worker - Runs a program or walks an L-system that cannot be split, publishing its lines in chunks.
+ *
+ * Returns:
+ *    0, as SDL threads report a status.
+ */
+
+    GenerationJob* job = data;
+    bool succeeded = true;
+    if (job->program) {
+        succeeded = commands_run_swarm(job->program, &job->turtle, &job->swarm, collect_line, job, &job->stop);
+    } else if (job->session) {
+        succeeded = session_run(job->session, &job->turtle, collect_line, job);
+    } else {
+        lsystem_run(&job->system, &job->turtle, collect_line, job, &job->truncated);
+    }
+    if (job->chunkCount > 0) {
+        publish_chunk(job);
+    }
+
+    SDL_LockMutex(job->lock);
+    job->totalOutputs = job->nextOutput;
+    job->succeeded = succeeded;
+    job->runningThreads--;
+    SDL_CondBroadcast(job->changed);
+    SDL_UnlockMutex(job->lock);
+    return 0;
+}
+
+
+static void free_job(GenerationJob* job) {
+/*
+ * free_job - Releases a job whose workers have all finished.
+ */
+
+    if (job->slots) {
+        for (int i = 0; i < job->slotCount; i++) {
+            free(job->slots[i].lines);
+        }
+    }
+    free(job->slots);
+    free(job->chunk);
+    if (job->lock) {
+        SDL_DestroyMutex(job->lock);
+    }
+    if (job->changed) {
+        SDL_DestroyCond(job->changed);
+    }
+    commands_free(job->program);
+    swarm_free(&job->swarm);
+    session_free(job->session);
+    lsystem_plan_free(job->plan);
+    lsystem_free(&job->system);
+    free(job->name);
+    free(job);
+}
+
+
+GenerationJob* generate_start(FILE* input, const char* name, const Turtle* turtle) {
+/*
+ * generate_start - Reads a command file, an L-system definition or a session and starts generating its lines.
+ *
+ * The source is read and compiled, or a session mapped into memory, on the calling thread, which only
+ * takes a moment; the geometry is generated or decoded on the workers.
+ *
+ * Parameters:
+ *    input  - The stream to read.
+ *    name   - The name of the stream, ending in ".lsys" for an L-system definition or ".session" for a saved
+ *             session; used in messages.
+ *    turtle - The turtle the drawing starts from.
+ *
+ * Returns:
+ *    The job, to be ended with generate_end, or NULL after reporting an error.
+ */
+
+    GenerationJob* job = calloc(1, sizeof(GenerationJob));
+    const size_t nameLength = strlen(name);
+    if (!job || !(job->name = malloc(nameLength + 1))) {
+        printf("Error allocating memory for a generation job!\n");
+        exit(1);
+    }
+    memcpy(job->name, name, nameLength + 1);
+    job->turtle = *turtle;
+    job->totalOutputs = -1;
+    job->succeeded = true;
+
+    if (session_file(name)) {
+        if (!(job->session = session_open(input, name))) {
+            free_job(job);
+            return NULL;
+        }
+    } else if (lsystem_file(name)) {
+        if (!lsystem_parse(input, name, &job->system)) {
+            free_job(job);
+            return NULL;
+        }
+        job->plan = lsystem_plan(&job->system, turtle);
+    } else if (!(job->program = commands_load(input, name))) {
+        free_job(job);
+        return NULL;
+    }
+
+    // Split drawings use as many workers as asked for, but never more than they have parts
+    int threads = 1;
+    if (job->plan) {
+        const int partCount = lsystem_plan_parts(job->plan);
+        threads = generate_thread_count();
+        threads = threads > partCount ? partCount : threads;
+        threads = threads < 1 ? 1 : threads;
+        job->totalOutputs = partCount;
+    } else {
+        job->chunk = malloc(CHUNK_LINES * sizeof(Line));
+    }
+
+    job->slotCount = threads * SLOTS_PER_THREAD;
+    job->slots = calloc((size_t)job->slotCount, sizeof(Slot));
+    job->lock = SDL_CreateMutex();
+    job->changed = SDL_CreateCond();
+    if (!job->slots || (!job->plan && !job->chunk)) {
+        printf("Error allocating memory for a generation job!\n");
+        exit(1);
+    }
+    if (!job->lock || !job->changed) {
+        printf("Error creating the generation lock: %s\n", SDL_GetError());
+        free_job(job);
+        return NULL;
+    }
+
+    // The count is raised before each start so a worker that finishes at once cannot see it reach zero early
+    SDL_LockMutex(job->lock);
+    for (int i = 0; i < threads; i++) {
+        job->runningThreads++;
+        SDL_Thread* thread = SDL_CreateThread(job->plan ? part_worker : single_worker, "generate", job);
+        if (!thread) {
+            job->runningThreads--;
+            break;
+        }
+        job->threads[job->threadCount++] = thread;
+    }
+    SDL_UnlockMutex(job->lock);
+
+    if (job->threadCount == 0) {
+        printf("Error starting a generation thread: %s\n", SDL_GetError());
+        free_job(job);
+        return NULL;
+    }
+    return job;
+}
+
+
+static bool deliver(GenerationJob* job, const LineSink sink, void* context, const Uint64 deadline, const bool block) {
+/*
+ * deliver - Hands completed outputs to a sink in drawing order.
+ *
+ * Parameters:
+ *    job      - The job.
+ *    sink     - Receives every line delivered.
+ *    context  - Passed to `sink` unchanged.
+ *    deadline - Performance counter value at which to stop delivering, 0 for none.
+ *    block    - Whether to wait for outputs that are not complete yet.
+ *
+ * Returns:
+ *    true once every line of the job has been delivered, false otherwise.
+ */
+
+    for (;;) {
+        if (block) {
+            SDL_LockMutex(job->lock);
+        } else if (SDL_TryLockMutex(job->lock) != 0) {
+            return false;
+        }
+
+        Slot* slot = &job->slots[job->consumed % job->slotCount];
+        while (block && !slot->ready && job->consumed != job->totalOutputs && job->runningThreads > 0) {
+            SDL_CondWait(job->changed, job->lock);
+        }
+        if (!slot->ready) {
+            const bool complete = job->consumed == job->totalOutputs || job->runningThreads == 0;
+            SDL_UnlockMutex(job->lock);
+            return complete;
+        }
+        const Line* lines = slot->lines;
+        const int count = slot->count;
+        SDL_UnlockMutex(job->lock);
+
+        // The output is not touched by workers again until it is delivered, so no lock is needed here
+        while (job->delivered < count) {
+            const int end = count - job->delivered > DELIVERY_BATCH ? job->delivered + DELIVERY_BATCH : count;
+            for (int i = job->delivered; i < end; i++) {
+                sink(&lines[i], context);
+            }
+            job->delivered = end;
+            if (deadline && end < count && SDL_GetPerformanceCounter() >= deadline) {
+                return false;
+            }
+        }
+
+        SDL_LockMutex(job->lock);
+        free(slot->lines);
+        *slot = (Slot){NULL, 0, false};
+        job->consumed++;
+        job->delivered = 0;
+        SDL_CondBroadcast(job->changed);
+        SDL_UnlockMutex(job->lock);
+
+        if (deadline && SDL_GetPerformanceCounter() >= deadline) {
+            return false;
+        }
+    }
+}
+
+
+bool generate_poll(GenerationJob* job, const LineSink sink, void* context, const double seconds) {
+/*
+ * generate_poll - Delivers the lines generated so far, without waiting for the workers.
+ *
+ * Parameters:
+ *    job     - The job.
+ *    sink    - Receives every line delivered, in drawing order.
+ *    context - Passed to `sink` unchanged.
+ *    seconds - Longest time spent delivering, so that a frame is not held up by a large drawing.
+ *
+ * Returns:
+ *    true once every line of the job has been delivered, false otherwise.
+ */
+
+    const Uint64 deadline = SDL_GetPerformanceCounter() + (Uint64)(seconds * (double)SDL_GetPerformanceFrequency());
+    return deliver(job, sink, context, deadline > 0 ? deadline : 1, false);
+}
+
+
+void generate_wait(GenerationJob* job, const LineSink sink, void* context) {
+/*
+ * generate_wait - Delivers every line of a job, waiting for the workers as needed.
+ *
+ * Parameters:
+ *    job     - The job.
+ *    sink    - Receives every line, in drawing order.
+ *    context - Passed to `sink` unchanged.
+ */
+
+    deliver(job, sink, context, 0, true);
+}
+
+
+bool generate_end(GenerationJob* job, Turtle* turtle) {
+/*
+ * generate_end - Stops a job, waits for its workers and releases it, discarding any other turtles.
+ *
+ * Parameters:
+ *    job    - The job.
+ *    turtle - Receives the turtle where the drawing ends, or NULL.
+ *
+ * Returns:
+ *    true if the drawing was generated without error, false if its program failed.
+ */
+
+    return generate_end_swarm(job, turtle, NULL);
+}
+
+
+bool generate_end_swarm(GenerationJob* job, Turtle* turtle, TurtleSwarm* swarm) {
+/*
+ * generate_end_swarm - Stops a job, waits for its workers and releases it.
+ *
+ * A job that has not been fully delivered is cancelled: lines not delivered yet are discarded, and a
+ * program still running stops within CANCEL_CHECK_INTERVAL instructions (see commands_run_swarm).
+ *
+ * Parameters:
+ *    job    - The job.
+ *    turtle - Receives the turtle where the drawing ends, or NULL.
+ *    swarm  - Receives the other turtles a program told, to be released with swarm_free, or NULL. It is
+ *             empty for L-systems and sessions.
+ *
+ * Returns:
+ *    true if the drawing was generated without error, false if its program failed.
+ */
+
+    SDL_LockMutex(job->lock);
+    job->cancelled = true;
+    SDL_AtomicSet(&job->stop, 1);
+    SDL_CondBroadcast(job->changed);
+    SDL_UnlockMutex(job->lock);
+    for (int i = 0; i < job->threadCount; i++) {
+        SDL_WaitThread(job->threads[i], NULL);
+    }
+
+    bool truncated = job->truncated;
+    Turtle end = job->turtle;
+    if (job->plan) {
+        truncated = lsystem_plan_end(&job->system, job->plan, &job->lastPartEnd, &end);
+    }
+    if (truncated) {
+        printf("%s: stopped at the budget of %d lines\n", job->name, job->system.budget);
+    }
+    if (turtle) {
+        *turtle = end;
+    }
+    if (swarm) {
+        *swarm = job->swarm;
+        job->swarm = (TurtleSwarm){NULL, 0, 0};
+    }
+
+    const bool succeeded = job->succeeded;
+    free_job(job);
+    return succeeded;
+}
@@ -0,0 +1,461 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * glcore.c - The shader backend drawing on OpenGL 3.3 core profile contexts.
+ *
+ * A core profile has no fixed-function pipeline: no matrix stacks, no client-side arrays, no quads and
+ * no glLineWidth above one pixel. This backend replaces what the legacy renderer relies on with two tiny
+ * programs and a vertex array object that stays bound while it draws.
+ *
+ * Lines are drawn from the same buffers as the legacy path, which hold each line as two LineVertex
+ * records. The line program reads a line's two records as per-instance attributes and draws one
+ * four-vertex triangle strip per instance. The vertex shader places the strip's corners around the
+ * segment in window pixels, so lines keep their width at any zoom, and the fragment shader fades the
+ * outermost pixel of each side for anti-aliasing. A whole range of the line buffer therefore takes one
+ * glDrawArraysInstanced call. Lines that are not in a buffer object, such as the simplified levels of
+ * detail or the result of a spatial query, are copied into a stream buffer first.
+ *
+ * Sprites and text are quads with positions and texture coordinates in separate arrays, as written by
+ * swarm.c and build_text_quads. They are copied into a stream buffer and drawn as indexed triangles from a
+ * shared element buffer, six indices per quad, with the texture modulated by a uniform color.
+ *
+ * The projection of the fixed-function path becomes a scale and an offset per axis, set by glcore_set_view
+ * for the camera's view of the drawing or for the window when drawing the status text.
+ *
+ * Key functions:
+ *    - glcore_init / glcore_shutdown: Build and release the programs and buffers.
+ *    - glcore_set_view: Sets the mapping of drawing coordinates onto the window.
+ *    - glcore_set_line_width: Sets the line width.
+ *    - glcore_draw_line_buffer / glcore_stream_lines: Draw lines.
+ *    - glcore_draw_quads: Draws textured quads.
+ */
+
+
+//==================== Header Files ====================
+#include "glcore.h"
+#include "glproc.h"
+#include "stats.h"
+#include "utilities.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define LINE_STRIDE ((GLsizei)(2 * sizeof(LineVertex)))   // Bytes per line in a line buffer
+#define SHADER_LOG_SIZE 1024                              // Bytes of compile and link logs printed
+#define MAX_LINE_WIDTH 64.0f                              // Widest line accepted, in pixels
+
+// Attribute locations of the line program
+#define ATTRIB_START 0
+#define ATTRIB_COLOR 1
+#define ATTRIB_END 2
+
+// Attribute locations of the quad program
+#define ATTRIB_POSITION 0
+#define ATTRIB_TEXCOORD 1
+
+
+//==================== Global Variables ====================
+static const char* const lineVertexSource =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 start;\n"
+    "layout(location = 1) in vec4 color;\n"
+    "layout(location = 2) in vec2 end;\n"
+    "uniform vec4 transform;\n"          // Drawing to clip coordinates: scale in xy, offset in zw
+    "uniform vec2 halfViewport;\n"       // Half the window size in pixels
+    "uniform float halfWidth;\n"         // Half the line width plus half a pixel of fade, in pixels
+    "out vec4 lineColor;\n"
+    "out float across;\n"                // Distance from the middle of the line, in pixels
+    "void main() {\n"
+    "    vec2 corner = vec2(float(gl_VertexID >> 1), float(gl_VertexID & 1) * 2.0 - 1.0);\n"
+    "    vec2 a = (start * transform.xy + transform.zw) * halfViewport;\n"
+    "    vec2 b = (end * transform.xy + transform.zw) * halfViewport;\n"
+    "    float len = length(b - a);\n"
+    "    vec2 along = len > 0.0 ? (b - a) / len : vec2(1.0, 0.0);\n"
+    "    vec2 normal = vec2(-along.y, along.x);\n"
+    "    vec2 position = mix(a, b, corner.x) + ((corner.x * 2.0 - 1.0) * along + corner.y * normal) * halfWidth;\n"
+    "    gl_Position = vec4(position / halfViewport, 0.0, 1.0);\n"
+    "    lineColor = color;\n"
+    "    across = corner.y * halfWidth;\n"
+    "}\n";
+
+static const char* const lineFragmentSource =
+    "#version 330 core\n"
+    "uniform float halfWidth;\n"
+    "in vec4 lineColor;\n"
+    "in float across;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = vec4(lineColor.rgb, lineColor.a * clamp(halfWidth - abs(across), 0.0, 1.0));\n"
+    "}\n";
+
+static const char* const quadVertexSource =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 position;\n"
+    "layout(location = 1) in vec2 texCoord;\n"
+    "uniform vec4 transform;\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(position * transform.xy + transform.zw, 0.0, 1.0);\n"
+    "    uv = texCoord;\n"
+    "}\n";
+
+static const char* const quadFragmentSource =
+    "#version 330 core\n"
+    "uniform sampler2D image;\n"
+    "uniform vec4 tint;\n"
+    "in vec2 uv;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = texture(image, uv) * tint;\n"
+    "}\n";
+
+static GLuint lineProgram = 0;            // Program drawing instanced lines
+static GLint lineTransform = -1;          // Uniform locations of the line program
+static GLint lineHalfViewport = -1;
+static GLint lineHalfWidth = -1;
+
+static GLuint quadProgram = 0;            // Program drawing textured quads
+static GLint quadTransform = -1;          // Uniform locations of the quad program
+static GLint quadTint = -1;
+
+static GLuint vertexArray = 0;            // Vertex array object bound while the backend draws
+static GLuint streamBuffer = 0;           // Buffer refilled with lines or quads before each draw
+static GLuint quadElements = 0;           // Element buffer listing two triangles per quad
+static int quadElementCapacity = 0;       // Number of quads the element buffer covers
+
+static GLfloat transform[4] = {1.0f, 1.0f, 0.0f, 0.0f}; // Scale and offset set by glcore_set_view
+static GLfloat halfViewport[2] = {1.0f, 1.0f};           // Half the window size set by glcore_set_view
+static GLfloat lineWidth = 1.0f;                          // Line width in pixels
+
+
+//==================== Function Definitions ====================
+static GLuint compile_shader(const GLenum type, const char* source) {
+/*
+ * compile_shader - Compiles one shader stage.
+ *
+ * Returns:
+ *    The shader, or 0 after printing the compiler's log.
+ */
+
+    const GLuint shader = pglCreateShader(type);
+    pglShaderSource(shader, 1, &source, NULL);
+    pglCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[SHADER_LOG_SIZE];
+        pglGetShaderInfoLog(shader, SHADER_LOG_SIZE, NULL, log);
+        printf("Error compiling a %s shader: %s\n", type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+        pglDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+
+static GLuint build_program(const char* vertexSource, const char* fragmentSource) {
+/*
+ * build_program - Compiles and links a program from its two stages.
+ *
+ * Returns:
+ *    The program, or 0 after printing the compiler's or the linker's log.
+ */
+
+    const GLuint vertexShader = compile_shader(GL_VERTEX_SHADER, vertexSource);
+    const GLuint fragmentShader = compile_shader(GL_FRAGMENT_SHADER, fragmentSource);
+    GLuint program = 0;
+    if (vertexShader && fragmentShader) {
+        program = pglCreateProgram();
+        pglAttachShader(program, vertexShader);
+        pglAttachShader(program, fragmentShader);
+        pglLinkProgram(program);
+
+        GLint linked = GL_FALSE;
+        pglGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[SHADER_LOG_SIZE];
+            pglGetProgramInfoLog(program, SHADER_LOG_SIZE, NULL, log);
+            printf("Error linking a shader program: %s\n", log);
+            pglDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps what it needs from its stages
+    if (vertexShader) {
+        pglDeleteShader(vertexShader);
+    }
+    if (fragmentShader) {
+        pglDeleteShader(fragmentShader);
+    }
+    return program;
+}
+
+
+bool glcore_init(void) {
+/*
+ * glcore_init - Builds the shader programs, the vertex array object and the stream buffers.
+ *
+ * Must be called on a core profile context after load_gl_procs.
+ *
+ * Returns:
+ *    true if the backend can draw, false after reporting why not.
+ */
+
+    lineProgram = build_program(lineVertexSource, lineFragmentSource);
+    quadProgram = build_program(quadVertexSource, quadFragmentSource);
+    if (!lineProgram || !quadProgram) {
+        glcore_shutdown();
+        return false;
+    }
+    lineTransform = pglGetUniformLocation(lineProgram, "transform");
+    lineHalfViewport = pglGetUniformLocation(lineProgram, "halfViewport");
+    lineHalfWidth = pglGetUniformLocation(lineProgram, "halfWidth");
+    quadTransform = pglGetUniformLocation(quadProgram, "transform");
+    quadTint = pglGetUniformLocation(quadProgram, "tint");
+
+    // Every draw of the backend goes through this vertex array object, which a core profile requires
+    pglGenVertexArrays(1, &vertexArray);
+    pglBindVertexArray(vertexArray);
+    pglGenBuffers(1, &streamBuffer);
+    pglGenBuffers(1, &quadElements);
+    checkOpenGLError("glcore_init");
+    return true;
+}
+
+
+void glcore_shutdown(void) {
+/*
+ * glcore_shutdown - Releases the programs and buffers of the backend.
+ *
+ * Must be called while the OpenGL context is still current; does nothing if glcore_init never ran.
+ */
+
+    if (lineProgram) {
+        pglDeleteProgram(lineProgram);
+        lineProgram = 0;
+    }
+    if (quadProgram) {
+        pglDeleteProgram(quadProgram);
+        quadProgram = 0;
+    }
+    if (streamBuffer) {
+        pglDeleteBuffers(1, &streamBuffer);
+        streamBuffer = 0;
+    }
+    if (quadElements) {
+        pglDeleteBuffers(1, &quadElements);
+        quadElements = 0;
+    }
+    quadElementCapacity = 0;
+    if (vertexArray) {
+        pglBindVertexArray(0);
+        pglDeleteVertexArrays(1, &vertexArray);
+        vertexArray = 0;
+    }
+}
+
+
+void glcore_set_view(const CameraView view, const int windowWidth, const int windowHeight) {
+/*
+ * glcore_set_view - Maps a rectangle onto the window for the draws that follow.
+ *
+ * This is the projection gluOrtho2D(minX, maxX, maxY, minY) sets up on the legacy path, with y growing
+ * downward, written as a scale and an offset per axis.
+ *
+ * Parameters:
+ *    view         - The rectangle shown, the camera's view of the drawing or the window itself in pixels.
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ */
+
+    transform[0] = 2.0f / (view.maxX - view.minX);
+    transform[1] = -2.0f / (view.maxY - view.minY);
+    transform[2] = -(view.maxX + view.minX) / (view.maxX - view.minX);
+    transform[3] = (view.maxY + view.minY) / (view.maxY - view.minY);
+    halfViewport[0] = (GLfloat)windowWidth / 2.0f;
+    halfViewport[1] = (GLfloat)windowHeight / 2.0f;
+}
+
+
+void glcore_set_line_width(const float width) {
+/*
+ * glcore_set_line_width - Sets the width lines are drawn with, in pixels, from 1 to MAX_LINE_WIDTH.
+ */
+
+    lineWidth = width < 1.0f ? 1.0f : width > MAX_LINE_WIDTH ? MAX_LINE_WIDTH : width;
+}
+
+
+static void draw_line_instances(const GLuint buffer, const GLintptr offset, const int count) {
+/*
+ * draw_line_instances - Draws `count` lines stored as LineVertex pairs from `offset` bytes into a buffer.
+ */
+
+    pglUseProgram(lineProgram);
+    pglUniform4f(lineTransform, transform[0], transform[1], transform[2], transform[3]);
+    pglUniform2f(lineHalfViewport, halfViewport[0], halfViewport[1]);
+    pglUniform1f(lineHalfWidth, lineWidth / 2.0f + 0.5f);
+
+    // Each instance reads its line's start vertex, its color and its end vertex
+    pglBindBuffer(GL_ARRAY_BUFFER, buffer);
+    pglVertexAttribPointer(ATTRIB_START, 2, GL_FLOAT, GL_FALSE, LINE_STRIDE,
+                           (const GLvoid*)(offset + offsetof(LineVertex, x)));
+    pglVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, LINE_STRIDE,
+                           (const GLvoid*)(offset + offsetof(LineVertex, r)));
+    pglVertexAttribPointer(ATTRIB_END, 2, GL_FLOAT, GL_FALSE, LINE_STRIDE,
+                           (const GLvoid*)(offset + sizeof(LineVertex) + offsetof(LineVertex, x)));
+    for (GLuint attribute = ATTRIB_START; attribute <= ATTRIB_END; attribute++) {
+        pglEnableVertexAttribArray(attribute);
+        pglVertexAttribDivisor(attribute, 1);
+    }
+
+    pglDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void glcore_draw_line_buffer(const GLuint buffer, const int first, const int count) {
+/*
+ * glcore_draw_line_buffer - Draws a range of the lines held in a buffer object, in one call.
+ *
+ * Parameters:
+ *    buffer - The buffer object, holding each line as two LineVertex records.
+ *    first  - The index of the first line to draw in the buffer.
+ *    count  - The number of lines to draw.
+ */
+
+    if (count <= 0) {
+        return;
+    }
+    draw_line_instances(buffer, (GLintptr)first * LINE_STRIDE, count);
+    checkOpenGLError("Drawing instanced lines");
+}
+
+
+void glcore_stream_lines(const LineVertex* vertices, const int count) {
+/*
+ * glcore_stream_lines - Uploads lines to the stream buffer and draws them.
+ *
+ * The buffer is orphaned before each upload, so the driver never waits for the previous draw to finish.
+ *
+ * Parameters:
+ *    vertices - The lines, two LineVertex records each.
+ *    count    - The number of lines.
+ */
+
+    if (count <= 0) {
+        return;
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)count * LINE_STRIDE, vertices, GL_STREAM_DRAW);
+    stats_add(STAT_UPLOAD_BYTES, (long long)count * LINE_STRIDE);
+    draw_line_instances(streamBuffer, 0, count);
+    checkOpenGLError("Drawing streamed lines");
+}
+
+
+static void grow_quad_elements(const int quadCount) {
+/*
+ * grow_quad_elements - Extends the element buffer to cover `quadCount` quads.
+ *
+ * Quad i lists corners 4i, 4i + 1, 4i + 2 and 4i, 4i + 2, 4i + 3, in the corner order of GL_QUADS.
+ */
+
+    if (quadCount <= quadElementCapacity) {
+        return;
+    }
+    int capacity = quadElementCapacity > 0 ? quadElementCapacity : 256;
+    while (capacity < quadCount) {
+        capacity *= 2;
+    }
+    GLuint* indices = malloc((size_t)capacity * 6 * sizeof(GLuint));
+    if (!indices) {
+        printf("Error allocating memory for quad elements!\n");
+        exit(1);
+    }
+    for (int i = 0; i < capacity; i++) {
+        const GLuint corner = (GLuint)i * 4;
+        GLuint* quad = &indices[i * 6];
+        quad[0] = corner;
+        quad[1] = corner + 1;
+        quad[2] = corner + 2;
+        quad[3] = corner;
+        quad[4] = corner + 2;
+        quad[5] = corner + 3;
+    }
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadElements);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)capacity * 6 * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    stats_add(STAT_UPLOAD_BYTES, (long long)capacity * 6 * sizeof(GLuint));
+    free(indices);
+    quadElementCapacity = capacity;
+}
+
+
+void glcore_draw_quads(const GLfloat* vertices, const GLfloat* texCoords, const int quadCount, const GLuint texture,
+                       const GLfloat color[4]) {
+/*
+ * glcore_draw_quads - Draws textured quads in one call, with the texture modulated by a color.
+ *
+ * Parameters:
+ *    vertices  - Four corners of two floats per quad, in the order GL_QUADS takes them.
+ *    texCoords - The texture coordinates of the corners, in the same layout.
+ *    quadCount - The number of quads.
+ *    texture   - The texture sampled.
+ *    color     - The color the texture is multiplied by, as red, green, blue and alpha.
+ */
+
+    if (quadCount <= 0) {
+        return;
+    }
+    grow_quad_elements(quadCount);
+
+    // Positions first, then texture coordinates, in one upload
+    const GLsizeiptr half = (GLsizeiptr)quadCount * 8 * sizeof(GLfloat);
+    pglBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, half * 2, NULL, GL_STREAM_DRAW);
+    pglBufferSubData(GL_ARRAY_BUFFER, 0, half, vertices);
+    pglBufferSubData(GL_ARRAY_BUFFER, half, half, texCoords);
+    stats_add(STAT_UPLOAD_BYTES, (long long)half * 2);
+
+    pglUseProgram(quadProgram);
+    pglUniform4f(quadTransform, transform[0], transform[1], transform[2], transform[3]);
+    pglUniform4f(quadTint, color[0], color[1], color[2], color[3]);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // The line program's instanced attributes share locations 0 and 1, so their divisors are reset, and its
+    // end points are not read
+    pglVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+    pglVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)half);
+    for (GLuint attribute = ATTRIB_POSITION; attribute <= ATTRIB_TEXCOORD; attribute++) {
+        pglEnableVertexAttribArray(attribute);
+        pglVertexAttribDivisor(attribute, 0);
+    }
+    pglDisableVertexAttribArray(ATTRIB_END);
+
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadElements);
+    glDrawElements(GL_TRIANGLES, quadCount * 6, GL_UNSIGNED_INT, (const GLvoid*)0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    checkOpenGLError("Drawing textured quads");
+}
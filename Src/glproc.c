@@ -0,0 +1,438 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * glproc.c - Runtime loading of optional OpenGL entry points.
+ *
+ * The system OpenGL library only guarantees the GL 1.1 ABI, so anything newer has to be
+ * looked up through SDL_GL_GetProcAddress once a context exists. This file resolves those
+ * entry points and records which features the current context supports, so the renderer
+ * can choose between its fast paths and the immediate-mode fallbacks. On a core profile context the
+ * fixed-function pipeline is gone, so the shader entry points are loaded and glCoreProfile tells every
+ * drawing path to use the shader backend (see glcore.c) instead.
+ *
+ * Partial redraws (see damage.c) need to know what the back buffer holds after a swap, which only the window
+ * system can tell, through GLX_EXT_buffer_age or EGL_EXT_buffer_age. SDL does not expose either, so the GLX
+ * and EGL functions are looked up in the libraries SDL has already loaded, whichever owns the current context.
+ *
+ * A GPU reset (a driver crash or a hung GPU being recovered) destroys everything a context holds. SDL reports
+ * nothing for a context made with SDL_GL_CreateContext, so the context itself is asked, through
+ * glGetGraphicsResetStatus. It only tells when it was created with the lose-context-on-reset strategy,
+ * which main.c requests; the render thread then builds a new context (see render.c).
+ *
+ * Key functions:
+ *    - load_gl_procs: Resolves the optional entry points and sets the feature flags.
+ *    - gl_buffer_age: Reports how many frames ago the back buffer was drawn.
+ *    - gl_context_lost: Reports whether a GPU reset has made the context lose its objects.
+ */
+
+
+//==================== Header Files ====================
+#include "glproc.h"
+
+#include <SDL2/SDL.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define EGL_LIBRARY "libEGL.so.1"         // Window system libraries, as loaded by SDL
+#define GLX_LIBRARY "libGL.so.1"
+#define GLX_SCREEN_ATTRIBUTE 0x800C       // GLX_SCREEN, the screen of a GLX context
+#define GLX_BACK_BUFFER_AGE 0x20F4        // GLX_BACK_BUFFER_AGE_EXT
+#define EGL_DRAW_SURFACE 0x3059           // EGL_DRAW, the surface drawn to
+#define EGL_EXTENSION_LIST 0x3055         // EGL_EXTENSIONS
+#define EGL_BUFFER_AGE 0x313D             // EGL_BUFFER_AGE_EXT
+
+
+//==================== Structure ====================
+typedef enum {  // Window system able to report the back buffer age of the current context
+    BUFFER_AGE_NONE,
+    BUFFER_AGE_GLX,
+    BUFFER_AGE_EGL
+} BufferAgeSource;
+
+// GLX and EGL functions, declared here as their headers are not needed otherwise
+typedef void* (*CurrentObjectProc)(void);
+typedef unsigned long (*GLXCurrentDrawableProc)(void);
+typedef int (*GLXQueryContextProc)(void* display, void* context, int attribute, int* value);
+typedef const char* (*GLXQueryExtensionsStringProc)(void* display, int screen);
+typedef void (*GLXQueryDrawableProc)(void* display, unsigned long drawable, int attribute, unsigned int* value);
+typedef void* (*EGLCurrentSurfaceProc)(int readDraw);
+typedef const char* (*EGLQueryStringProc)(void* display, int name);
+typedef unsigned int (*EGLQuerySurfaceProc)(void* display, void* surface, int attribute, int* value);
+
+
+//==================== Global Variables ====================
+bool glHasBufferObjects = false;
+bool glHasFramebufferObjects = false;
+bool glHasTimerQueries = false;
+bool glCoreProfile = false;
+bool glHasBufferAge = false;
+bool glHasResetStatus = false;
+
+PFNGLGENBUFFERSPROC pglGenBuffers = NULL;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers = NULL;
+PFNGLBINDBUFFERPROC pglBindBuffer = NULL;
+PFNGLBUFFERDATAPROC pglBufferData = NULL;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData = NULL;
+
+PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus = NULL;
+PFNGLGENERATEMIPMAPPROC pglGenerateMipmap = NULL;
+
+PFNGLGENQUERIESPROC pglGenQueries = NULL;
+PFNGLDELETEQUERIESPROC pglDeleteQueries = NULL;
+PFNGLBEGINQUERYPROC pglBeginQuery = NULL;
+PFNGLENDQUERYPROC pglEndQuery = NULL;
+PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v = NULL;
+
+PFNGLCREATESHADERPROC pglCreateShader = NULL;
+PFNGLSHADERSOURCEPROC pglShaderSource = NULL;
+PFNGLCOMPILESHADERPROC pglCompileShader = NULL;
+PFNGLGETSHADERIVPROC pglGetShaderiv = NULL;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog = NULL;
+PFNGLDELETESHADERPROC pglDeleteShader = NULL;
+PFNGLCREATEPROGRAMPROC pglCreateProgram = NULL;
+PFNGLATTACHSHADERPROC pglAttachShader = NULL;
+PFNGLLINKPROGRAMPROC pglLinkProgram = NULL;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv = NULL;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog = NULL;
+PFNGLDELETEPROGRAMPROC pglDeleteProgram = NULL;
+PFNGLUSEPROGRAMPROC pglUseProgram = NULL;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation = NULL;
+PFNGLUNIFORM1FPROC pglUniform1f = NULL;
+PFNGLUNIFORM2FPROC pglUniform2f = NULL;
+PFNGLUNIFORM4FPROC pglUniform4f = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = NULL;
+PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor = NULL;
+PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced = NULL;
+PFNGLGENVERTEXARRAYSPROC pglGenVertexArrays = NULL;
+PFNGLBINDVERTEXARRAYPROC pglBindVertexArray = NULL;
+PFNGLDELETEVERTEXARRAYSPROC pglDeleteVertexArrays = NULL;
+
+PFNGLGETGRAPHICSRESETSTATUSPROC pglGetGraphicsResetStatus = NULL;
+
+static BufferAgeSource bufferAgeSource = BUFFER_AGE_NONE;
+static void* bufferAgeDisplay = NULL;     // Display of the current context
+static GLXCurrentDrawableProc pglXGetCurrentDrawable = NULL;
+static GLXQueryDrawableProc pglXQueryDrawable = NULL;
+static EGLCurrentSurfaceProc peglGetCurrentSurface = NULL;
+static EGLQuerySurfaceProc peglQuerySurface = NULL;
+
+
+//==================== Function Definitions ====================
+static void* get_proc(const char* coreName, const char* extName) {
+/*
+ * get_proc - Looks up an OpenGL entry point by its core name, then by its extension name.
+ *
+ * Parameters:
+ *    coreName - The name of the function in core OpenGL (e.g. "glGenBuffers").
+ *    extName  - The name of the equivalent extension function, or NULL if there is none.
+ *
+ * Returns:
+ *    The function address, or NULL if the context provides neither name.
+ */
+
+    void* proc = SDL_GL_GetProcAddress(coreName);
+    if (!proc && extName) {
+        proc = SDL_GL_GetProcAddress(extName);
+    }
+    return proc;
+}
+
+
+static bool gl_version_at_least(const int major, const int minor) {
+/*
+ * gl_version_at_least - Checks the version reported by the current OpenGL context.
+ *
+ * Parameters:
+ *    major - The required major version.
+ *    minor - The required minor version.
+ *
+ * Returns:
+ *    true if the context version is at least major.minor, false otherwise.
+ */
+
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int ctxMajor = 0, ctxMinor = 0;
+    if (!version || sscanf(version, "%d.%d", &ctxMajor, &ctxMinor) != 2) {
+        return false;
+    }
+    return ctxMajor > major || (ctxMajor == major && ctxMinor >= minor);
+}
+
+
+static void* window_system_proc(const char* library, const char* name) {
+/*
+ * window_system_proc - Looks up a function of a window system library, only if it is already loaded.
+ *
+ * The library stays loaded by SDL, so the reference taken here is released right away.
+ *
+ * Returns:
+ *    The function address, or NULL when the library is not loaded or has no such function.
+ */
+
+    void* handle = dlopen(library, RTLD_LAZY | RTLD_NOLOAD);
+    if (!handle) {
+        return NULL;
+    }
+    void* proc = dlsym(handle, name);
+    dlclose(handle);
+    return proc;
+}
+
+
+static bool has_extension(const char* list, const char* name) {
+/*
+ * has_extension - Reports whether a space-separated extension list contains a name.
+ */
+
+    const size_t length = strlen(name);
+    for (const char* found = list ? strstr(list, name) : NULL; found; found = strstr(found + length, name)) {
+        if ((found == list || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void load_buffer_age(void) {
+/*
+ * load_buffer_age - Finds out whether the window system reports the age of the current context's back buffer.
+ */
+
+    bufferAgeSource = BUFFER_AGE_NONE;
+
+    // An EGL context, as SDL creates on Wayland
+    const CurrentObjectProc eglContext = (CurrentObjectProc)window_system_proc(EGL_LIBRARY, "eglGetCurrentContext");
+    if (eglContext && eglContext()) {
+        const CurrentObjectProc eglDisplay = (CurrentObjectProc)window_system_proc(EGL_LIBRARY, "eglGetCurrentDisplay");
+        const EGLQueryStringProc eglExtensions = (EGLQueryStringProc)window_system_proc(EGL_LIBRARY, "eglQueryString");
+        peglGetCurrentSurface = (EGLCurrentSurfaceProc)window_system_proc(EGL_LIBRARY, "eglGetCurrentSurface");
+        peglQuerySurface = (EGLQuerySurfaceProc)window_system_proc(EGL_LIBRARY, "eglQuerySurface");
+        if (eglDisplay && eglExtensions && peglGetCurrentSurface && peglQuerySurface) {
+            bufferAgeDisplay = eglDisplay();
+            if (has_extension(eglExtensions(bufferAgeDisplay, EGL_EXTENSION_LIST), "EGL_EXT_buffer_age")) {
+                bufferAgeSource = BUFFER_AGE_EGL;
+            }
+        }
+    } else {
+        // Otherwise a GLX context, as SDL creates on X11
+        const CurrentObjectProc glxContext = (CurrentObjectProc)window_system_proc(GLX_LIBRARY, "glXGetCurrentContext");
+        const CurrentObjectProc glxDisplay = (CurrentObjectProc)window_system_proc(GLX_LIBRARY, "glXGetCurrentDisplay");
+        const GLXQueryContextProc glxQueryContext =
+            (GLXQueryContextProc)window_system_proc(GLX_LIBRARY, "glXQueryContext");
+        const GLXQueryExtensionsStringProc glxExtensions =
+            (GLXQueryExtensionsStringProc)window_system_proc(GLX_LIBRARY, "glXQueryExtensionsString");
+        pglXGetCurrentDrawable = (GLXCurrentDrawableProc)window_system_proc(GLX_LIBRARY, "glXGetCurrentDrawable");
+        pglXQueryDrawable = (GLXQueryDrawableProc)window_system_proc(GLX_LIBRARY, "glXQueryDrawable");
+        void* context = glxContext ? glxContext() : NULL;
+        int screen = 0;
+        if (context && glxDisplay && glxQueryContext && glxExtensions && pglXGetCurrentDrawable && pglXQueryDrawable) {
+            bufferAgeDisplay = glxDisplay();
+            glxQueryContext(bufferAgeDisplay, context, GLX_SCREEN_ATTRIBUTE, &screen);
+            if (has_extension(glxExtensions(bufferAgeDisplay, screen), "GLX_EXT_buffer_age")) {
+                bufferAgeSource = BUFFER_AGE_GLX;
+            }
+        }
+    }
+    glHasBufferAge = bufferAgeSource != BUFFER_AGE_NONE;
+}
+
+
+bool load_gl_procs(void) {
+/*
+ * load_gl_procs - Resolves optional OpenGL entry points for the current context.
+ *
+ * This function must be called after an OpenGL context has been created and made current.
+ * Missing features are not an error: the corresponding flag is left false and the caller
+ * is expected to use its fallback path.
+ *
+ * Returns:
+ *    true if the buffer and framebuffer objects the renderer relies on were loaded, false if at least
+ *    one is unavailable.
+ */
+
+    // Buffer objects are core in GL 1.5 and available through ARB_vertex_buffer_object before that
+    if (gl_version_at_least(1, 5) || SDL_GL_ExtensionSupported("GL_ARB_vertex_buffer_object")) {
+        pglGenBuffers = (PFNGLGENBUFFERSPROC)get_proc("glGenBuffers", "glGenBuffersARB");
+        pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)get_proc("glDeleteBuffers", "glDeleteBuffersARB");
+        pglBindBuffer = (PFNGLBINDBUFFERPROC)get_proc("glBindBuffer", "glBindBufferARB");
+        pglBufferData = (PFNGLBUFFERDATAPROC)get_proc("glBufferData", "glBufferDataARB");
+        pglBufferSubData = (PFNGLBUFFERSUBDATAPROC)get_proc("glBufferSubData", "glBufferSubDataARB");
+    }
+
+    glHasBufferObjects = pglGenBuffers && pglDeleteBuffers && pglBindBuffer &&
+                         pglBufferData && pglBufferSubData;
+    if (!glHasBufferObjects) {
+        printf("Vertex buffer objects unavailable, using immediate mode for lines\n");
+    }
+
+    // Framebuffer objects share entry point names between GL 3.0 and ARB_framebuffer_object,
+    // and EXT_framebuffer_object uses the same enum values with an EXT suffix on the functions
+    if (gl_version_at_least(3, 0) || SDL_GL_ExtensionSupported("GL_ARB_framebuffer_object")) {
+        pglGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)get_proc("glGenFramebuffers", NULL);
+        pglDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)get_proc("glDeleteFramebuffers", NULL);
+        pglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)get_proc("glBindFramebuffer", NULL);
+        pglFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)get_proc("glFramebufferTexture2D", NULL);
+        pglCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)get_proc("glCheckFramebufferStatus", NULL);
+        pglGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)get_proc("glGenerateMipmap", NULL);
+    } else if (SDL_GL_ExtensionSupported("GL_EXT_framebuffer_object")) {
+        pglGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)get_proc("glGenFramebuffersEXT", NULL);
+        pglDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)get_proc("glDeleteFramebuffersEXT", NULL);
+        pglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)get_proc("glBindFramebufferEXT", NULL);
+        pglFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)get_proc("glFramebufferTexture2DEXT", NULL);
+        pglCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)get_proc("glCheckFramebufferStatusEXT", NULL);
+        pglGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)get_proc("glGenerateMipmapEXT", NULL);
+    }
+
+    glHasFramebufferObjects = pglGenFramebuffers && pglDeleteFramebuffers && pglBindFramebuffer &&
+                              pglFramebufferTexture2D && pglCheckFramebufferStatus;
+    if (!glHasFramebufferObjects) {
+        printf("Framebuffer objects unavailable, redrawing lines every frame\n");
+    }
+
+    // GL_TIME_ELAPSED queries use the GL 1.5 query functions, plus a 64-bit result getter that
+    // EXT_timer_query provides under an EXT suffix with the same signature and enum values
+    const bool coreTimer = gl_version_at_least(3, 3) || SDL_GL_ExtensionSupported("GL_ARB_timer_query");
+    if (gl_version_at_least(1, 5) && (coreTimer || SDL_GL_ExtensionSupported("GL_EXT_timer_query"))) {
+        pglGenQueries = (PFNGLGENQUERIESPROC)get_proc("glGenQueries", NULL);
+        pglDeleteQueries = (PFNGLDELETEQUERIESPROC)get_proc("glDeleteQueries", NULL);
+        pglBeginQuery = (PFNGLBEGINQUERYPROC)get_proc("glBeginQuery", NULL);
+        pglEndQuery = (PFNGLENDQUERYPROC)get_proc("glEndQuery", NULL);
+        pglGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)get_proc("glGetQueryObjectiv", NULL);
+        pglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)get_proc(
+            coreTimer ? "glGetQueryObjectui64v" : "glGetQueryObjectui64vEXT", NULL);
+    }
+
+    // Only the profiler uses these, so their absence is not worth a message
+    glHasTimerQueries = pglGenQueries && pglDeleteQueries && pglBeginQuery && pglEndQuery &&
+                        pglGetQueryObjectiv && pglGetQueryObjectui64v;
+
+    // A core profile context, which main.c only requests with --gl core, is drawn through shaders
+    GLint profileMask = 0;
+    if (gl_version_at_least(3, 3)) {
+        glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profileMask);
+    }
+    if (profileMask & GL_CONTEXT_CORE_PROFILE_BIT) {
+        pglCreateShader = (PFNGLCREATESHADERPROC)get_proc("glCreateShader", NULL);
+        pglShaderSource = (PFNGLSHADERSOURCEPROC)get_proc("glShaderSource", NULL);
+        pglCompileShader = (PFNGLCOMPILESHADERPROC)get_proc("glCompileShader", NULL);
+        pglGetShaderiv = (PFNGLGETSHADERIVPROC)get_proc("glGetShaderiv", NULL);
+        pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)get_proc("glGetShaderInfoLog", NULL);
+        pglDeleteShader = (PFNGLDELETESHADERPROC)get_proc("glDeleteShader", NULL);
+        pglCreateProgram = (PFNGLCREATEPROGRAMPROC)get_proc("glCreateProgram", NULL);
+        pglAttachShader = (PFNGLATTACHSHADERPROC)get_proc("glAttachShader", NULL);
+        pglLinkProgram = (PFNGLLINKPROGRAMPROC)get_proc("glLinkProgram", NULL);
+        pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)get_proc("glGetProgramiv", NULL);
+        pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)get_proc("glGetProgramInfoLog", NULL);
+        pglDeleteProgram = (PFNGLDELETEPROGRAMPROC)get_proc("glDeleteProgram", NULL);
+        pglUseProgram = (PFNGLUSEPROGRAMPROC)get_proc("glUseProgram", NULL);
+        pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)get_proc("glGetUniformLocation", NULL);
+        pglUniform1f = (PFNGLUNIFORM1FPROC)get_proc("glUniform1f", NULL);
+        pglUniform2f = (PFNGLUNIFORM2FPROC)get_proc("glUniform2f", NULL);
+        pglUniform4f = (PFNGLUNIFORM4FPROC)get_proc("glUniform4f", NULL);
+        pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)get_proc("glVertexAttribPointer", NULL);
+        pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)get_proc("glEnableVertexAttribArray", NULL);
+        pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)get_proc("glDisableVertexAttribArray", NULL);
+        pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)get_proc("glVertexAttribDivisor", NULL);
+        pglDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)get_proc("glDrawArraysInstanced", NULL);
+        pglGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)get_proc("glGenVertexArrays", NULL);
+        pglBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)get_proc("glBindVertexArray", NULL);
+        pglDeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)get_proc("glDeleteVertexArrays", NULL);
+
+        glCoreProfile = pglCreateShader && pglShaderSource && pglCompileShader && pglGetShaderiv &&
+                        pglGetShaderInfoLog && pglDeleteShader && pglCreateProgram && pglAttachShader &&
+                        pglLinkProgram && pglGetProgramiv && pglGetProgramInfoLog && pglDeleteProgram &&
+                        pglUseProgram && pglGetUniformLocation && pglUniform1f && pglUniform2f && pglUniform4f &&
+                        pglVertexAttribPointer && pglEnableVertexAttribArray && pglDisableVertexAttribArray &&
+                        pglVertexAttribDivisor && pglDrawArraysInstanced && pglGenVertexArrays && pglBindVertexArray &&
+                        pglDeleteVertexArrays;
+        if (!glCoreProfile) {
+            printf("Core profile context without the shader entry points, nothing can be drawn\n");
+        }
+    }
+
+    // Only partial redraws use the back buffer age, and they report its absence themselves
+    load_buffer_age();
+
+    // Resets are only reported by contexts that lose themselves on one, as main.c asks for where it can
+    pglGetGraphicsResetStatus = NULL;
+    if (gl_version_at_least(4, 5) || SDL_GL_ExtensionSupported("GL_KHR_robustness")) {
+        pglGetGraphicsResetStatus = (PFNGLGETGRAPHICSRESETSTATUSPROC)get_proc("glGetGraphicsResetStatus", NULL);
+    } else if (SDL_GL_ExtensionSupported("GL_ARB_robustness")) {
+        pglGetGraphicsResetStatus = (PFNGLGETGRAPHICSRESETSTATUSPROC)get_proc("glGetGraphicsResetStatusARB", NULL);
+    }
+    GLint resetStrategy = 0;
+    if (pglGetGraphicsResetStatus) {
+        glGetIntegerv(GL_RESET_NOTIFICATION_STRATEGY, &resetStrategy);
+    }
+    glHasResetStatus = pglGetGraphicsResetStatus && resetStrategy == GL_LOSE_CONTEXT_ON_RESET;
+
+    return glHasBufferObjects && glHasFramebufferObjects;
+}
+
+
+int gl_buffer_age(void) {
+/*
+ * gl_buffer_age - Returns how many frames ago the back buffer of the current context was drawn.
+ *
+ * Returns:
+ *    1 when it holds the previous frame, 2 for the one before, and so on; 0 when its contents are undefined
+ *    or the window system cannot tell.
+ */
+
+    if (bufferAgeSource == BUFFER_AGE_EGL) {
+        int age = 0;
+        if (!peglQuerySurface(bufferAgeDisplay, peglGetCurrentSurface(EGL_DRAW_SURFACE), EGL_BUFFER_AGE, &age)) {
+            age = 0;
+        }
+        return age;
+    }
+    if (bufferAgeSource == BUFFER_AGE_GLX) {
+        unsigned int age = 0;
+        pglXQueryDrawable(bufferAgeDisplay, pglXGetCurrentDrawable(), GLX_BACK_BUFFER_AGE, &age);
+        return (int)age;
+    }
+    return 0;
+}
+
+
+bool gl_context_lost(void) {
+/*
+ * gl_context_lost - Reports whether a GPU reset has made the current context lose its objects.
+ *
+ * Once it has, every OpenGL call but this one does nothing, and the context has to be replaced. A reset
+ * caused by another program is reported too, since it destroys this context all the same.
+ *
+ * Returns:
+ *    true if the context was lost, false if it is usable or cannot tell (see glHasResetStatus).
+ */
+
+    return glHasResetStatus && pglGetGraphicsResetStatus() != GL_NO_ERROR;
+}
@@ -21,17 +21,45 @@
  * graphics.c - Handles the OpenGL rendering logic for the C-TurtleGraphics program.
  *
  * This file is responsible for setting up and managing OpenGL rendering contexts,
- * loading and rendering sprites, drawing lines, and displaying real-time status information.
- * It includes the necessary setup for 2D rendering with OpenGL, using orthographic projection
- * and transformations for sprite rotation, as well as handling dynamic line drawing based on
+ * rendering sprites, drawing lines, and displaying real-time status information.
+ * It includes the necessary setup for 2D rendering with OpenGL, using orthographic projection,
+ * as well as handling dynamic line drawing based on
  * user input. Additionally, text rendering and updating the graphical display for the turtle's
  * movement and actions are managed in this file.
  *
  * Key functions:
  *    - setup_opengl: Initializes OpenGL settings, including projection matrix and blending.
- *    - load_sprite: Loads an image as a sprite and prepares it for rendering.
- *    - render_scene: Clears the screen and renders lines, sprites, and status text.
- *    - add_line: Adds a new line to the array, dynamically reallocating memory when necessary.
+ *    - render_scene: Clears the screen and renders lines, the turtles (see swarm.c), and status text.
+ *    - add_line: Adds a new line to the line store, or extends the last line when the new one continues
+ *      it in a straight line.
+ *    - draw_line_range: Draws a contiguous range of lines from the VBO or in immediate mode.
+ *    - draw_visible_lines / draw_box_lines: Draw only the lines crossing a rectangle, found through the
+ *      spatial index.
+ *    - mark_lines / undo_lines / redo_lines: Follow the undo journal of the main thread (see journal.c).
+ *    - cleanup_graphics: Releases the OpenGL objects owned by the renderer.
+ *
+ * On a core profile context every draw below goes through the shader backend instead (see glcore.c), which
+ * draws the same buffers as instanced, anti-aliased lines of any width; the canvas is not used there, so
+ * lines are drawn from the buffer object every frame.
+ *
+ * Lines are kept in a vertex buffer object when the context supports buffer objects. New lines
+ * are uploaded incrementally at the start of each frame and the whole drawing is issued with a
+ * single glDrawArrays call. Contexts without buffer objects fall back to immediate mode.
+ * When framebuffer objects are available, lines are instead rasterized once into the persistent
+ * canvas (see canvas.c), or into the tiles of the tiled canvas (see tiles.c), and each frame only
+ * blits those textures under the sprite and status text.
+ * Every stored line is also entered in a spatial index (see spatial.c), which lets the direct paths
+ * skip lines outside the view. The view is set by the camera (see camera.c); zoomed out, the lines
+ * are drawn from their precomputed simplified versions (see lod.c).
+ *
+ * Undo only lowers the number of lines the store reports, so every path above simply draws a shorter
+ * range: the buffer object keeps the lines undone and redo shows them again without uploading anything.
+ * They are only dropped, from the store, the spatial index, the levels of detail and the canvas, when a
+ * new line is added in their place.
+ *
+ * Everything here runs on the render thread (see render.c), which owns the OpenGL context; the sprite
+ * is drawn from the snapshot the simulation last sent rather than from the live `sprite`. When profiling,
+ * render_scene times the lines, the sprite and the status text as separate stages (see profiler.c).
  *
  * Libraries Used:
  *    - SDL2 for window management and image loading.
@@ -41,62 +69,133 @@
 
 //==================== Header Files ====================
 #include "graphics.h"
+#include "camera.h"
+#include "canvas.h"
+#include "damage.h"
+#include "glcore.h"
+#include "glproc.h"
+#include "journal.h"
+#include "linestore.h"
+#include "lod.h"
+#include "profiler.h"
+#include "spatial.h"
 #include "sprite.h"
+#include "stats.h"
+#include "swarm.h"
 #include "text.h"
 #include "utilities.h"
 
-#include <SDL2/SDL_image.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 //==================== Macros ====================
-#define IMG_W 50.0f
-#define IMG_H 50.0f
+#define LINE_UPLOAD_BATCH 1024   // Lines converted per glBufferSubData call
+#define HUD_MAX_QUADS 768         // Glyph quads reserved for the status text and the profiler overlay
+#define HUD_X 10.0f               // Left edge of the status text
+#define HUD_Y 10.0f               // Top edge of the status text
+#define LINE_MERGE_MAX_LENGTH 1024.0f // Longest line a merge may produce, so re-indexing it stays cheap
 
 
 //==================== Structure ====================
-typedef struct {  // Line array structure
-    GLfloat x1, y1, x2, y2;   // Coordinates of the line
-    GLfloat r, g, b;          // Color of the line (RGB components)
-} Line;
+typedef struct {  // Cached geometry of the status text
+    bool valid;               // Whether the geometry matches the state below
+    float x, y, angle;        // Sprite position and angle the geometry was built for
+    bool pen;                 // Sprite pen state the geometry was built for
+    GLfloat r, g, b;          // Sprite color the geometry was built for
+    unsigned int profile;     // Profiler overlay serial the geometry was built for
+    int quadCount;            // Number of glyph quads in the geometry
+    float minX, minY, maxX, maxY; // Window rectangle the quads cover
+    GLfloat vertices[HUD_MAX_QUADS * 8];
+    GLfloat texCoords[HUD_MAX_QUADS * 8];
+} HudCache;
+
+typedef struct {  // Lines of one entry of the undo journal
+    int first;                // Number of lines when the entry started
+    int end;                  // Number of lines when the entry was undone
+} LineMark;
 
 
 //==================== Global Variables ====================
-GLuint spriteTextureID = 0; // Texture ID
+bool lineMergeEnabled = true;       // Whether add_line extends collinear lines instead of appending
+float lineMergeTolerance = 0.5f;    // Maximum heading difference, in degrees, for two lines to merge
+int lineMergeCount = 0;             // Number of lines absorbed into their predecessor so far
+float lineWidth = 1.0f;             // Width of the lines on screen in pixels
+
+static GLuint lineVBO = 0;          // Buffer object holding the uploaded lines
+static int lineVBOCapacity = 0;     // Number of lines the buffer object can hold
+static int lineUploadCount = 0;     // Index one past the last line resident in the buffer object
+static int lineVBOBase = 0;         // Index of the line stored at the start of the buffer object
 
-Line* lines = NULL;
-int lineCapacity = 50;
-int lineCount = 0;
+static HudCache hud = {0};          // Status text geometry, rebuilt only when the sprite changes
+
+static int regionCount = -1;        // Rectangles the current frame redraws, -1 for the whole window
+static const DamageRect* regions = NULL; // Those rectangles, in window pixels
+static int regionWindowHeight = 0;  // Height of the window the rectangles are in
+static DamageRect drawnTurtle = {0, 0, 0, 0}; // Window rectangle the interactive turtle was last drawn in
+
+static LineMark lineMarks[JOURNAL_ENTRIES]; // Line ranges matching the main thread's journal entries
+static int markUndoCount = 0;       // Number of marks that can be undone
+static int markRedoCount = 0;       // Number of marks after them that can be redone
+static int lineMergeFloor = 0;      // Lines before this index belong to an earlier entry and are never extended
 
 
 //==================== Function Definitions ====================
-void setup_opengl(int const windowWidth, int const windowHeight) {
+static int flatten_lines(void) {
+/*
+ * flatten_lines - Line store hook that persists every line into the canvas before old lines are freed.
+ *
+ * Returns:
+ *    The number of leading lines held by the canvas, which the store may discard.
+ */
+
+    canvas_update(line_store_count());
+    return canvas_line_count();
+}
+
+
+bool setup_opengl(int const windowWidth, int const windowHeight) {
 /*
  * setup_opengl - Initializes OpenGL settings for 2D rendering.
  *
  * This function configures the OpenGL context for rendering 2D graphics within a window,
  * including setting up the viewport, projection matrix, and model-view matrix.
- * It also initializes OpenGL blending for transparency effects and allocates memory
- * for the array of lines to be drawn by the turtle. The function prepares OpenGL
+ * It also initializes OpenGL blending for transparency effects and creates the buffer
+ * object and canvas used to draw the turtle's lines. The function prepares OpenGL
  * for rendering operations such as drawing sprites and lines with proper transformations
  * and blending.
  *
+ * On a core profile context, the shader backend is built instead of setting up the fixed-function matrices.
+ *
  * Parameters:
  *    windowWidth   - The width of the window to set the viewport and projection matrix.
  *    windowHeight  - The height of the window to set the viewport and projection matrix.
+ *
+ * Returns:
+ *    true if the renderer is ready, false if the shader backend could not be built.
  */
 
+    // Resolve the optional OpenGL features used by the fast rendering paths, and find out which backend draws
+    load_gl_procs();
+
     // Set the viewport
     glViewport(0, 0, windowWidth, windowHeight);
 
-    // Set up the projection matrix for orthographic 2D rendering
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0.0, windowWidth, windowHeight, 0.0);
-
-    // Set up the model-view matrix
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    // Set up the projection matrix for the camera's view of the drawing, or the shader backend
+    if (glCoreProfile) {
+        if (!glcore_init()) {
+            return false;
+        }
+        glcore_set_line_width(lineWidth);
+    } else {
+        camera_apply(windowWidth, windowHeight);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glLineWidth(lineWidth);
+    }
 
     // Set the clear color to white background
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
@@ -105,203 +204,605 @@ void setup_opengl(int const windowWidth, int const windowHeight) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Allocate memory for lines array
-    lines = malloc(lineCapacity * sizeof(Line));
-    if (!lines) {
-        printf("Error allocating memory for lines!\n");
-        exit(1);
+    // Create the line buffer object if the context supports it
+    if (glHasBufferObjects) {
+        pglGenBuffers(1, &lineVBO);
+        checkOpenGLError("glGenBuffers");
+    }
+
+    // Create the persistent canvas if the context supports framebuffer objects
+    canvas_init(windowWidth, windowHeight);
+    if (damage_enabled() && (!canvas_active() || !glHasBufferAge)) {
+        printf("Partial redraws need a canvas and the buffer age of the window; redrawing whole frames\n");
     }
+
+    // Create the GPU timer queries when profiling
+    profiler_init_gpu();
+
+    // Let the line store free lines that are already on the canvas when it reaches its memory cap
+    line_store_set_flatten_hook(flatten_lines);
+    return true;
 }
 
 
-bool load_sprite(const char* bmp) {
+static LineVertex make_vertex(const GLfloat x, const GLfloat y, const Line* line) {
 /*
- * load_sprite - Loads an image and converts it into an OpenGL texture.
+ * make_vertex - Builds a VBO vertex at (x, y) with the color of a line.
+ */
+
+    return (LineVertex){
+        x, y,
+        (GLubyte)(line->r * 255.0f + 0.5f),
+        (GLubyte)(line->g * 255.0f + 0.5f),
+        (GLubyte)(line->b * 255.0f + 0.5f),
+        255
+    };
+}
+
+
+static void upload_lines(void) {
+/*
+ * upload_lines - Copies lines added since the last frame into the line buffer object.
  *
- * This function loads an image file (BMP format) using SDL_image, converts it into
- * a format suitable for OpenGL, and uploads it as a texture. The texture is then
- * used to render the sprite. The function performs error checking during each step
- * to ensure the image is loaded and converted properly. It also configures OpenGL texture
- * parameters, such as wrapping and filtering modes, before uploading the texture data.
+ * Only the lines in the range [lineUploadCount, lineCount) are read from the line store, converted
+ * to packed vertices and sent with glBufferSubData. When the buffer object is too small it is
+ * reallocated with geometric growth, which discards its contents, so every readable line is uploaded
+ * again. The buffer starts at `lineVBOBase`, the first readable line at the time of the reallocation,
+ * so lines the store has flattened do not keep occupying video memory.
+ */
+
+    static LineVertex staging[LINE_UPLOAD_BATCH * 2];
+    static LineIterator it;
+    const int lineCount = line_store_count();
+
+    if (lineVBO == 0 || lineUploadCount >= lineCount) {
+        return;
+    }
+
+    pglBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+
+    // Grow the buffer object when the new lines do not fit
+    if (lineCount - lineVBOBase > lineVBOCapacity) {
+        lineVBOBase = line_store_first();
+        int newCapacity = lineVBOCapacity > 0 ? lineVBOCapacity : LINE_UPLOAD_BATCH;
+        while (newCapacity < lineCount - lineVBOBase) {
+            newCapacity *= 2;
+        }
+        pglBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)newCapacity * 2 * sizeof(LineVertex), NULL, GL_DYNAMIC_DRAW);
+        checkOpenGLError("glBufferData");
+        lineVBOCapacity = newCapacity;
+        lineUploadCount = lineVBOBase;
+    }
+
+    // Convert and upload the pending lines in batches
+    line_store_iterate(&it, lineUploadCount, lineCount - lineUploadCount);
+    while (line_store_next_block(&it)) {
+        for (int done = 0; done < it.count; done += LINE_UPLOAD_BATCH) {
+            const int batch = it.count - done < LINE_UPLOAD_BATCH ? it.count - done : LINE_UPLOAD_BATCH;
+
+            for (int i = 0; i < batch; i++) {
+                const Line* line = &it.lines[done + i];
+                staging[i * 2] = make_vertex(line->x1, line->y1, line);
+                staging[i * 2 + 1] = make_vertex(line->x2, line->y2, line);
+            }
+
+            pglBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(it.first + done - lineVBOBase) * 2 * sizeof(LineVertex),
+                             (GLsizeiptr)batch * 2 * sizeof(LineVertex), staging);
+            stats_add(STAT_UPLOAD_BYTES, (long long)batch * 2 * sizeof(LineVertex));
+        }
+        lineUploadCount = it.first + it.count;
+    }
+    checkOpenGLError("glBufferSubData");
+
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void draw_line_range(int first, int count) {
+/*
+ * draw_line_range - Draws a contiguous range of stored lines with the fastest path available.
  *
- * Parameters:
- *    bmp - The file path to the BMP image to be loaded and used as a sprite texture.
+ * With buffer objects the pending lines are uploaded and the range is issued as one glDrawArrays
+ * call, or one instanced call on the shader backend. Otherwise the lines are sent through immediate
+ * mode. Lines the store has already flattened are skipped. Texturing must be disabled by the caller.
  *
- * Returns:
- *    true if the image was loaded and converted successfully, false otherwise.
+ * Parameters:
+ *    first - Index of the first line to draw.
+ *    count - Number of lines to draw.
  */
 
-    // Load the image using SDL_image
-    SDL_Surface* tempSurface = IMG_Load(bmp);
-    if (!tempSurface) {
-        printf("Error loading image %s: %s\n", bmp, IMG_GetError());
-        return false;
+    if (count <= 0 || first < 0 || first + count > line_store_count()) {
+        return;
     }
 
-    // Convert the surface to a format suitable for OpenGL texture
-    SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat(tempSurface, SDL_PIXELFORMAT_RGBA32, 0);
-    SDL_FreeSurface(tempSurface);
-
-    if (!formattedSurface) {
-        printf("Error converting surface: %s\n", SDL_GetError());
-        return false;
+    // Lines before the first readable one only exist on the canvas
+    if (first < line_store_first()) {
+        count -= line_store_first() - first;
+        first = line_store_first();
+        if (count <= 0) {
+            return;
+        }
     }
 
-    // Generate a texture ID and bind it
-    glGenTextures(1, &spriteTextureID);
-    glBindTexture(GL_TEXTURE_2D, spriteTextureID);
+    if (lineVBO != 0) {
+        upload_lines();
 
-    // Set pixel storage mode
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (first < lineVBOBase) {
+            count -= lineVBOBase - first;
+            first = lineVBOBase;
+            if (count <= 0) {
+                return;
+            }
+        }
 
-    // Set texture parameters after binding the texture
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (glCoreProfile) {
+            glcore_draw_line_buffer(lineVBO, first - lineVBOBase, count);
+            return;
+        }
 
-    // Upload the texture data to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, formattedSurface->w, formattedSurface->h, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, formattedSurface->pixels);
-    checkOpenGLError("glTexImage2D");
+        pglBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
 
-    // Free the surface as we no longer need it
-    SDL_FreeSurface(formattedSurface);
+        glVertexPointer(2, GL_FLOAT, sizeof(LineVertex), (const GLvoid*)offsetof(LineVertex, x));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LineVertex), (const GLvoid*)offsetof(LineVertex, r));
 
-    return true;
+        glDrawArrays(GL_LINES, (first - lineVBOBase) * 2, count * 2);
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        static LineIterator it;
+        glBegin(GL_LINES);
+        line_store_iterate(&it, first, count);
+        while (line_store_next_block(&it)) {
+            for (int i = 0; i < it.count; i++) {
+                const Line* line = &it.lines[i];
+                glColor3f(line->r, line->g, line->b);  // Set line color
+                glVertex2f(line->x1, line->y1);        // Start point
+                glVertex2f(line->x2, line->y2);        // End point
+            }
+        }
+        glEnd();
+    }
+    checkOpenGLError("Drawing lines");
 }
 
 
-void render_scene(int const windowWidth, int const windowHeight) {
+static void draw_line_list(const int* indices, const int count) {
 /*
- * render_scene - Clears the screen and renders all graphical elements, including lines, the sprite, and text.
+ * draw_line_list - Draws a sorted list of stored lines, such as the result of a spatial query.
  *
- * This function is responsible for rendering the entire scene in the OpenGL window. It first clears the screen,
- * then renders all previously drawn lines, followed by rendering the sprite and displaying text. The function
- * also manages the OpenGL state, including enabling/disabling features such as texturing and blending, and applies
- * necessary transformations (translation, rotation) to the sprite. The text is rendered as textured quads, with the
- * sprite being drawn in a 2D orthographic projection system. Real-time status information, such as the turtle's
- * position, angle, pen state, and line color, is displayed on the screen.
+ * With buffer objects the lines are drawn from the VBO through a client-side element array, so only
+ * the listed lines are sent to the GPU. The shader backend has no client-side arrays and no way to pick
+ * instances by index, so there the listed lines are streamed in batches. Otherwise they are sent through
+ * immediate mode.
  *
  * Parameters:
- *    windowWidth - The width of the window in pixels.
- *    windowHeight - The height of the window in pixels.
+ *    indices - Indices of the lines to draw, in increasing order.
+ *    count   - Number of indices.
  */
 
-    // Clear the screen
-    glClear(GL_COLOR_BUFFER_BIT);
-    checkOpenGLError("glClear");
+    static GLuint* elements = NULL;
+    static int elementCapacity = 0;
 
-    // Reset OpenGL state before rendering
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_CULL_FACE);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (count <= 0) {
+        return;
+    }
 
-    // **Line Rendering**
+    if (glCoreProfile) {
+        static LineVertex staging[LINE_UPLOAD_BATCH * 2];
+        int batch = 0;
+        Line line;
+        for (int i = 0; i < count; i++) {
+            if (line_store_get(indices[i], &line)) {
+                staging[batch * 2] = make_vertex(line.x1, line.y1, &line);
+                staging[batch * 2 + 1] = make_vertex(line.x2, line.y2, &line);
+                batch++;
+            }
+            if (batch == LINE_UPLOAD_BATCH || (i == count - 1 && batch > 0)) {
+                glcore_stream_lines(staging, batch);
+                batch = 0;
+            }
+        }
+        return;
+    }
 
-    // Disable texturing for line rendering
-    glDisable(GL_TEXTURE_2D);
+    if (lineVBO != 0) {
+        upload_lines();
+
+        if (count * 2 > elementCapacity) {
+            int newCapacity = elementCapacity > 0 ? elementCapacity : LINE_UPLOAD_BATCH;
+            while (newCapacity < count * 2) {
+                newCapacity *= 2;
+            }
+            GLuint* newElements = realloc(elements, (size_t)newCapacity * sizeof(GLuint));
+            if (!newElements) {
+                printf("Error reallocating memory for line elements!\n");
+                exit(1);
+            }
+            elements = newElements;
+            elementCapacity = newCapacity;
+        }
+
+        int elementCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (indices[i] >= lineVBOBase && indices[i] < lineUploadCount) {
+                elements[elementCount++] = (GLuint)(indices[i] - lineVBOBase) * 2;
+                elements[elementCount++] = (GLuint)(indices[i] - lineVBOBase) * 2 + 1;
+            }
+        }
 
-    // Draw all previously drawn lines
-    if (lineCount > 0) {
+        pglBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+
+        glVertexPointer(2, GL_FLOAT, sizeof(LineVertex), (const GLvoid*)offsetof(LineVertex, x));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LineVertex), (const GLvoid*)offsetof(LineVertex, r));
+
+        glDrawElements(GL_LINES, elementCount, GL_UNSIGNED_INT, elements);
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else {
+        Line line;
         glBegin(GL_LINES);
-        for (int i = 0; i < lineCount; i++) {
-            glColor3f(lines[i].r, lines[i].g, lines[i].b);  // Set line color
-            glVertex2f(lines[i].x1, lines[i].y1);           // Start point
-            glVertex2f(lines[i].x2, lines[i].y2);           // End point
+        for (int i = 0; i < count; i++) {
+            if (line_store_get(indices[i], &line)) {
+                glColor3f(line.r, line.g, line.b);  // Set line color
+                glVertex2f(line.x1, line.y1);       // Start point
+                glVertex2f(line.x2, line.y2);       // End point
+            }
         }
         glEnd();
-        checkOpenGLError("Drawing lines");
     }
+    checkOpenGLError("Drawing line list");
+}
 
-    // **Sprite Rendering**
 
-    // Enable texturing for sprite rendering
-    glEnable(GL_TEXTURE_2D);
+static void draw_line_array(const Line* lines, const int count) {
+/*
+ * draw_line_array - Draws lines that are not in the line store, such as simplified level-of-detail lines.
+ *
+ * The lines are converted to packed vertices and drawn from a client-side vertex array in batches, or
+ * streamed to the shader backend.
+ *
+ * Parameters:
+ *    lines - The lines to draw.
+ *    count - Number of lines.
+ */
 
-    // Reset color to white to avoid tinting the sprite
-    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    static LineVertex staging[LINE_UPLOAD_BATCH * 2];
 
-    // Bind the texture before drawing
-    glBindTexture(GL_TEXTURE_2D, spriteTextureID);
+    if (count <= 0) {
+        return;
+    }
 
-    // Calculate sprite corners
-    const float halfWidth = IMG_W / 2.0f;
-    const float halfHeight = IMG_H / 2.0f;
+    if (!glCoreProfile) {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(LineVertex), &staging[0].x);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LineVertex), &staging[0].r);
+    }
 
-    const float x = sprite.x;
-    const float y = sprite.y;
+    for (int done = 0; done < count; done += LINE_UPLOAD_BATCH) {
+        const int batch = count - done < LINE_UPLOAD_BATCH ? count - done : LINE_UPLOAD_BATCH;
+        for (int i = 0; i < batch; i++) {
+            const Line* line = &lines[done + i];
+            staging[i * 2] = make_vertex(line->x1, line->y1, line);
+            staging[i * 2 + 1] = make_vertex(line->x2, line->y2, line);
+        }
+        if (glCoreProfile) {
+            glcore_stream_lines(staging, batch);
+        } else {
+            glDrawArrays(GL_LINES, 0, batch * 2);
+        }
+    }
 
-    // Set up vertices
-    const GLfloat vertices[] = {
-        x - halfWidth, y - halfHeight,
-        x + halfWidth, y - halfHeight,
-        x + halfWidth, y + halfHeight,
-        x - halfWidth, y + halfHeight
-    };
+    if (!glCoreProfile) {
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    checkOpenGLError("Drawing simplified lines");
+}
 
-    // Standard texture coordinates without flipping
-    const GLfloat texCoords[] = {
-        0.0f, 0.0f,  // Bottom-left
-        1.0f, 0.0f,  // Bottom-right
-        1.0f, 1.0f,  // Top-right
-        0.0f, 1.0f   // Top-left
-    };
 
-    // Apply rotation around the sprite's center
-    glPushMatrix();
-    glTranslatef(x, y, 0);
-    glRotatef(-sprite.angle, 0, 0, 1);  // Negative because OpenGL rotates counterclockwise
-    glTranslatef(-x, -y, 0);
+void draw_visible_lines(const float minX, const float minY, const float maxX, const float maxY) {
+/*
+ * draw_visible_lines - Draws the stored lines that cross a view rectangle.
+ *
+ * The rectangle is drawn at the camera's zoom (see draw_box_lines). Texturing must be disabled by the caller.
+ *
+ * Parameters:
+ *    minX, minY, maxX, maxY - The corners of the view rectangle in drawing coordinates.
+ */
+
+    draw_box_lines(minX, minY, maxX, maxY, camera_zoom(), 0);
+}
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    glVertexPointer(2, GL_FLOAT, 0, vertices);
-    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+void draw_box_lines(const float minX, const float minY, const float maxX, const float maxY, const float zoom,
+                    const int first) {
+/*
+ * draw_box_lines - Draws the stored lines from index `first` onward that cross a rectangle.
+ *
+ * When the rectangle is drawn zoomed out far enough, the precomputed simplified lines of the matching level
+ * of detail are drawn instead (see lod.c), with only the newest lines drawn as stored. Otherwise, when the
+ * whole drawing fits in the rectangle every line is drawn as one range, and when it does not the spatial
+ * index lists the visible lines, so the cost depends on what is on screen rather than on the number of
+ * lines stored. Lines added after the first ones, such as the ones a tile of the canvas has not drawn yet
+ * (see tiles.c), are always drawn as stored. Texturing must be disabled by the caller.
+ *
+ * Parameters:
+ *    minX, minY, maxX, maxY - The corners of the rectangle in drawing coordinates.
+ *    zoom                   - The pixels per drawing unit the rectangle is drawn at.
+ *    first                  - Index of the first line to draw, 0 for the whole drawing.
+ */
 
-    glDrawArrays(GL_QUADS, 0, 4);
-    checkOpenGLError("glDrawArrays for sprite");
+    float boundsMinX, boundsMinY, boundsMaxX, boundsMaxY;
+    if (!spatial_bounds(&boundsMinX, &boundsMinY, &boundsMaxX, &boundsMaxY)) {
+        return;
+    }
 
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    const int level = first == 0 ? lod_level(zoom) : 0;
+    if (level > 0) {
+        const Line* simplified = NULL;
+        int fullDetailFirst = 0;
+        const int count = lod_collect(level, (CameraView){minX, minY, maxX, maxY}, &simplified, &fullDetailFirst);
+        draw_line_array(simplified, count);
 
-    glPopMatrix();
+        if (fullDetailFirst < line_store_first()) {
+            fullDetailFirst = line_store_first();
+        }
+        draw_line_range(fullDetailFirst, line_store_count() - fullDetailFirst);
+        return;
+    }
+
+    if (boundsMinX >= minX && boundsMinY >= minY && boundsMaxX <= maxX && boundsMaxY <= maxY) {
+        draw_line_range(first, line_store_count() - first);
+        return;
+    }
+
+    // The indices come in drawing order, so the lines before `first` are a prefix of them
+    const int* indices = NULL;
+    const int count = spatial_query_box(minX, minY, maxX, maxY, &indices);
+    int skipped = 0;
+    for (int step = count; step > 0; step /= 2) {
+        while (skipped + step <= count && indices[skipped + step - 1] < first) {
+            skipped += step;
+        }
+    }
+    draw_line_list(indices + skipped, count - skipped);
+}
+
+
+static void update_hud(const Sprite* shown) {
+/*
+ * update_hud - Rebuilds the status text geometry when the sprite state it shows has changed.
+ *
+ * The status text reports the sprite position, angle, pen state and color. This function compares those
+ * fields with the ones the cached geometry was built for and, only if one of them differs, formats the
+ * text again and lays it out as glyph atlas quads. While the turtle is idle the cached quads are reused.
+ * The profiler overlay, when shown, follows the status lines and rebuilds the geometry when it changes.
+ * A rebuild reports the rectangles of the old and the new text to the partial redraw.
+ *
+ * Parameters:
+ *    shown - The sprite state to report.
+ */
+
+    unsigned int profile;
+    const char* profileText = profiler_overlay_text(&profile);
+    if (hud.valid && hud.x == shown->x && hud.y == shown->y && hud.angle == shown->angle &&
+        hud.pen == shown->pen && hud.r == shown->r && hud.g == shown->g && hud.b == shown->b &&
+        hud.profile == profile) {
+        return;
+    }
+
+    // Construct the status string, followed by the profiler overlay
+    char statusText[768];
+    describe_sprite(shown, statusText, sizeof(statusText));
+    const size_t statusLength = strlen(statusText);
+    snprintf(statusText + statusLength, sizeof(statusText) - statusLength, "%s", profileText);
+
+    hud.quadCount = build_text_quads(statusText, HUD_X, HUD_Y, hud.vertices, hud.texCoords, HUD_MAX_QUADS);
+
+    // A partial redraw repaints the rectangle of the old text and the one of the new text
+    damage_window_rect(hud.minX, hud.minY, hud.maxX, hud.maxY);
+    hud.minX = hud.minY = HUGE_VALF;
+    hud.maxX = hud.maxY = -HUGE_VALF;
+    for (int i = 0; i < hud.quadCount * 4; i++) {
+        hud.minX = fminf(hud.minX, hud.vertices[i * 2]);
+        hud.minY = fminf(hud.minY, hud.vertices[i * 2 + 1]);
+        hud.maxX = fmaxf(hud.maxX, hud.vertices[i * 2]);
+        hud.maxY = fmaxf(hud.maxY, hud.vertices[i * 2 + 1]);
+    }
+    damage_window_rect(hud.minX, hud.minY, hud.maxX, hud.maxY);
+
+    hud.x = shown->x;
+    hud.y = shown->y;
+    hud.angle = shown->angle;
+    hud.pen = shown->pen;
+    hud.r = shown->r;
+    hud.g = shown->g;
+    hud.b = shown->b;
+    hud.profile = profile;
+    hud.valid = true;
+}
 
-    // **Text Rendering**
 
-    // Construct the status string
-    char statusText[256];
-    sprintf(
-        statusText,
-        "Position: (%.1f, %.1f)\nAngle: %.1f degrees\nPen: %s\nLine Color: %s",
-        sprite.x, sprite.y, sprite.angle,
-        sprite.pen ? "Down" : "Up",
-        (sprite.r == 0.0f && sprite.g == 0.0f && sprite.b == 0.0f) ? "Black" :
-        (sprite.r == 0.0f && sprite.g == 0.0f && sprite.b == 1.0f) ? "Blue" :
-        (sprite.r == 1.0f && sprite.g == 0.0f && sprite.b == 0.0f) ? "Red" :
-        (sprite.r == 0.0f && sprite.g == 1.0f && sprite.b == 0.0f) ? "Green" :
-        (sprite.r == 1.0f && sprite.g == 1.0f && sprite.b == 0.0f) ? "Yellow" :
-        "Custom"
-    );
-
-    // Split the statusText into lines
-    char* linesText[10];
-    int lineCountText = 0;
-
-    char* token = strtok(statusText, "\n");
-    while (token != NULL && lineCountText < 10) {
-        linesText[lineCountText++] = token;
-        token = strtok(NULL, "\n");
+static void plan_regions(const int windowWidth, const int windowHeight, const CameraView view, const float x,
+                         const float y) {
+/*
+ * plan_regions - Works out the rectangles of the window this frame redraws.
+ *
+ * Without partial redraws, or when the canvas or the back buffer age is missing, the whole window is
+ * redrawn. Otherwise the frame reports the sprite's old and new rectangles, and damage_frame combines them
+ * with the lines and status text reported as they changed, over the frames the back buffer missed.
+ *
+ * Parameters:
+ *    windowWidth, windowHeight - The size of the window in pixels.
+ *    view                      - The part of the drawing the window shows.
+ *    x, y                      - The position of the interactive turtle this frame, in drawing coordinates.
+ */
+
+    regionCount = -1;
+    if (!damage_enabled()) {
+        return;
+    }
+
+    // The damage history must see every frame, including the ones drawn whole
+    if (!canvas_active() || !glHasBufferAge) {
+        damage_all();
+        damage_frame(windowWidth, windowHeight, 0, &regions);
+        return;
+    }
+
+    // The sprite covers pixels on both its previous and its current rectangle
+    const float scaleX = (float)windowWidth / (view.maxX - view.minX);
+    const float scaleY = (float)windowHeight / (view.maxY - view.minY);
+    const float radius = turtle_radius() + 1.0f;
+    const float screenX = (x - view.minX) * scaleX;
+    const float screenY = (y - view.minY) * scaleY;
+    const DamageRect turtle = {(int)floorf(screenX - radius), (int)floorf(screenY - radius),
+                               (int)ceilf(screenX + radius), (int)ceilf(screenY + radius)};
+    if (memcmp(&turtle, &drawnTurtle, sizeof(DamageRect)) != 0) {
+        damage_window_rect((float)drawnTurtle.x0, (float)drawnTurtle.y0, (float)drawnTurtle.x1, (float)drawnTurtle.y1);
+        damage_window_rect((float)turtle.x0, (float)turtle.y0, (float)turtle.x1, (float)turtle.y1);
+        drawnTurtle = turtle;
+    }
+
+    regionCount = damage_frame(windowWidth, windowHeight, gl_buffer_age(), &regions);
+    regionWindowHeight = windowHeight;
+    if (regionCount >= 0) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+}
+
+
+static bool begin_region(const int region) {
+/*
+ * begin_region - Restricts drawing to a rectangle planned for this frame.
+ *
+ * Each stage of render_scene draws once per rectangle, counting from 0 until this returns false. A frame
+ * redrawn whole has a single region, drawn without the scissor test.
+ */
+
+    if (regionCount < 0) {
+        return region == 0;
+    }
+    if (region >= regionCount) {
+        return false;
     }
 
+    // The scissor box counts rows from the bottom of the window
+    const DamageRect* rect = &regions[region];
+    glScissor(rect->x0, regionWindowHeight - rect->y1, rect->x1 - rect->x0, rect->y1 - rect->y0);
+    return true;
+}
+
+
+void render_scene(int const windowWidth, int const windowHeight, const Sprite* current, const Sprite* previous,
+                  float const alpha) {
+/*
+ * render_scene - Clears the screen and renders all graphical elements, including lines, the sprite, and text.
+ *
+ * This function is responsible for rendering the entire scene in the OpenGL window. It first clears the screen,
+ * then renders all previously drawn lines, followed by rendering the sprites and displaying text. The function
+ * also manages the OpenGL state, including enabling/disabling features such as texturing and blending. The
+ * sprite and the turtles a script told are drawn as one batch of rotated quads (see swarm.c), and the text is
+ * rendered as textured quads in a 2D orthographic projection system. Real-time status information, such as the turtle's
+ * position, angle, pen state, and line color, is displayed on the screen.
+ *
+ * With partial redraws, each stage is drawn once per damaged rectangle under the scissor test instead
+ * (see plan_regions), over the rest of the previous frames kept in the back buffer.
+ *
+ * Parameters:
+ *    windowWidth - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ *    current - The sprite after the last simulation step, also reported by the status text.
+ *    previous - The sprite before the last simulation step.
+ *    alpha - The fraction of a simulation step elapsed since the last one, used to place the sprite
+ *            between its last two simulated poses.
+ */
+
+    // Reset OpenGL state before rendering; the shader backend has no fixed-function state and sets what it uses
+    const CameraView view = camera_view(windowWidth, windowHeight);
+    if (glCoreProfile) {
+        glcore_set_view(view, windowWidth, windowHeight);
+    } else {
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_CULL_FACE);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+    }
+
+    // Place the sprite between its last two simulation steps, and rebuild the status text geometry only when
+    // the displayed sprite state changed
+    float x, y, angle;
+    interpolate_sprite(previous, current, alpha, &x, &y, &angle);
+    update_hud(current);
+
+    // **Line Rendering**
+
+    profiler_begin(PROFILE_LINES);
+
+    // Disable texturing for line rendering
+    if (!glCoreProfile) {
+        glDisable(GL_TEXTURE_2D);
+    }
+
+    // Rasterize the new lines into the canvas first, since the scissor test would clip them
+    if (canvas_active()) {
+        canvas_update(line_store_count());
+    }
+    plan_regions(windowWidth, windowHeight, view, x, y);
+
+    // Draw all previously drawn lines, either from the canvas or the ones inside the window
+    for (int region = 0; begin_region(region); region++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (canvas_active()) {
+            canvas_draw();
+        } else {
+            draw_visible_lines(view.minX, view.minY, view.maxX, view.maxY);
+        }
+    }
+    checkOpenGLError("glClear");
+    profiler_end(PROFILE_LINES);
+
+    // **Sprite Rendering**
+
+    profiler_begin(PROFILE_SPRITE);
+
+    // Enable texturing for sprite rendering, and reset color to white to avoid tinting the sprites
+    if (!glCoreProfile) {
+        glEnable(GL_TEXTURE_2D);
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    // Draw the sprite together with the turtles of the last script
+    prepare_turtles(x, y, angle, view, camera_zoom());
+    for (int region = 0; begin_region(region); region++) {
+        draw_turtles();
+    }
+    profiler_end(PROFILE_SPRITE);
+
+    // **Text Rendering**
+
+    profiler_begin(PROFILE_HUD);
+
     // Set text color (black)
     const SDL_Color textColor = {0, 0, 0, 255};
 
-    // Variables for text position
-    float textY = 10.0f;
+    // The status text is laid out in window pixels, with the top-left corner at (0,0)
+    if (glCoreProfile) {
+        glcore_set_view((CameraView){0.0f, 0.0f, (float)windowWidth, (float)windowHeight}, windowWidth, windowHeight);
+        draw_text_quads(hud.vertices, hud.texCoords, hud.quadCount, textColor);
+        profiler_end(PROFILE_HUD);
+        return;
+    }
 
     // Set up orthographic projection for text rendering
     glMatrixMode(GL_PROJECTION);
@@ -317,99 +818,229 @@ void render_scene(int const windowWidth, int const windowHeight) {
     glEnable(GL_BLEND);
     glEnable(GL_TEXTURE_2D);
 
-    // Render each line
-    for (int i = 0; i < lineCountText; i++) {
-        int lineWidth = 0, lineHeight = 0;
-        GLuint lineTextureID = render_text(linesText[i], textColor, &lineWidth, &lineHeight);
+    // Render every line of the status text from the glyph atlas in one call
+    for (int region = 0; begin_region(region); region++) {
+        draw_text_quads(hud.vertices, hud.texCoords, hud.quadCount, textColor);
+    }
+    glDisable(GL_SCISSOR_TEST);
 
-        if (lineTextureID != 0) {
-            const float textX = 10.0f;
-            // Bind the text texture
-            glBindTexture(GL_TEXTURE_2D, lineTextureID);
+    // Restore matrices
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    profiler_end(PROFILE_HUD);
+}
 
-            // Set up vertices and texture coordinates
-            const GLfloat textVertices[] = {
-                textX, textY + (float)lineHeight,
-                textX + (float)lineWidth, textY + (float)lineHeight,
-                textX + (float)lineWidth, textY,
-                textX, textY
-            };
 
-            const GLfloat textTexCoords[] = {
-                0.0f, 1.0f,  // Bottom-left
-                1.0f, 1.0f,  // Bottom-right
-                1.0f, 0.0f,  // Top-right
-                0.0f, 0.0f   // Top-left
-            };
+static void discard_undone_lines(void) {
+/*
+ * discard_undone_lines - Frees the lines hidden by undo everywhere they are kept.
+ *
+ * The spatial index, the levels of detail, the canvas and the buffer object forget them before new lines
+ * take their indices.
+ */
 
-            // Render the textured quad
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    const int lineCount = line_store_count();
+    line_store_discard_undone();
+    spatial_truncate(lineCount);
+    lod_truncate(lineCount);
+    canvas_truncate(lineCount);
+    if (lineUploadCount > lineCount) {
+        lineUploadCount = lineCount;
+    }
+    markRedoCount = 0;
+}
 
-            glVertexPointer(2, GL_FLOAT, 0, textVertices);
-            glTexCoordPointer(2, GL_FLOAT, 0, textTexCoords);
 
-            glDrawArrays(GL_QUADS, 0, 4);
+void mark_lines(void) {
+/*
+ * mark_lines - Starts the line range of a new journal entry at the current end of the drawing.
+ *
+ * The marks mirror the main thread's journal entry for entry: the same capacity, the oldest forgotten
+ * first, and the entries that could be redone dropped.
+ */
+
+    if (markUndoCount == JOURNAL_ENTRIES) {
+        memmove(&lineMarks[0], &lineMarks[1], (JOURNAL_ENTRIES - 1) * sizeof(LineMark));
+        markUndoCount--;
+    }
+    lineMarks[markUndoCount++] = (LineMark){line_store_count(), 0};
+    markRedoCount = 0;
+    lineMergeFloor = line_store_count();
+}
 
-            glDisableClientState(GL_VERTEX_ARRAY);
-            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 
-            // Update textY for the next line
-            textY += (float)lineHeight + 2; // Add some spacing between lines
+void undo_lines(void) {
+/*
+ * undo_lines - Hides the lines of the last journal entry.
+ *
+ * This only lowers the line count, so it takes constant time, and every renderer draws the shorter
+ * drawing from the next frame on. Lines the store has flattened live in the canvas and cannot be taken
+ * back, so the drawing stops short of them.
+ */
 
-            // Delete the texture after rendering
-            glDeleteTextures(1, &lineTextureID);
-        }
+    if (markUndoCount == 0) {
+        return;
     }
 
-    // Restore matrices
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+    LineMark* mark = &lineMarks[--markUndoCount];
+    markRedoCount++;
+    mark->end = line_store_count();
+
+    const int limit = canvas_undo_floor();
+    if (mark->first < limit) {
+        printf("Lines flattened into the canvas cannot be undone\n");
+    }
+    line_store_truncate(mark->first > limit ? mark->first : limit);
+    lineMergeFloor = line_store_count();
 }
 
 
-void add_line(const float x1, const float y1, const float x2, const float y2) {
+void redo_lines(void) {
 /*
- * add_line - Adds a new line to the lines array with the current color from the sprite.
+ * redo_lines - Shows the lines of the last journal entry undone again.
+ */
+
+    if (markRedoCount == 0) {
+        return;
+    }
+
+    const LineMark* mark = &lineMarks[markUndoCount++];
+    markRedoCount--;
+    line_store_restore(mark->end);
+    lineMergeFloor = line_store_count();
+}
+
+
+static bool try_merge_line(const Line* line) {
+/*
+ * try_merge_line - Extends the last line instead of appending a new one when they are collinear.
  *
- * This function is responsible for adding a new line to the array of lines. The line is defined by two
- * points, (x1, y1) and (x2, y2), and is assigned the current color of the sprite. If the array is full,
- * it dynamically reallocates memory to accommodate more lines. The function increases the `lineCount` and
- * ensures that memory is properly allocated and freed to avoid memory leaks.
+ * Holding the up arrow emits one very short line per frame, and a straight stroke would otherwise
+ * be stored as hundreds of nearly identical records. The new line is merged when it starts exactly
+ * where the last line ends, has the same color, and its heading differs from the heading of the
+ * whole last line by at most `lineMergeTolerance` degrees. Comparing against the whole last line
+ * rather than its latest piece keeps slow turns from drifting away from the path actually drawn. The
+ * last line of an earlier journal entry is never extended, so undo takes back exactly what was drawn.
+ * Each merge indexes the whole line again (see spatial_insert), so a merge that would make the line
+ * longer than LINE_MERGE_MAX_LENGTH starts a new line instead, and a long stroke costs the same per
+ * piece as a short one.
  *
  * Parameters:
- *    x1, y1 - The starting coordinates of the line.
- *    x2, y2 - The ending coordinates of the line.
+ *    line - The new line.
+ *
+ * Returns:
+ *    true if the new line was absorbed into the last line, false if it must be appended.
  */
 
-    if (lineCount >= lineCapacity) {
-        lineCapacity *= 2;
+    const int lineCount = line_store_count();
+    if (!lineMergeEnabled || lineCount == 0 || lineCount - 1 < lineMergeFloor) {
+        return false;
+    }
+
+    Line last;
+    if (!line_store_get(lineCount - 1, &last)) {
+        return false;
+    }
+    if (last.x2 != line->x1 || last.y2 != line->y1 ||
+        last.r != line->r || last.g != line->g || last.b != line->b) {
+        return false;
+    }
+
+    const float lastDX = last.x2 - last.x1;
+    const float lastDY = last.y2 - last.y1;
+    const float newDX = line->x2 - line->x1;
+    const float newDY = line->y2 - line->y1;
 
-        // Use a temporary pointer to hold the result to prevent memory leaks if failure
-        Line* temp = realloc(lines, lineCapacity * sizeof(Line));
+    // A zero-length line (e.g. the turtle pushing against the window edge) adds nothing
+    if (newDX == 0.0f && newDY == 0.0f) {
+        lineMergeCount++;
+        stats_add(STAT_LINES_MERGED, 1);
+        return true;
+    }
 
-        if (!temp) {
-            printf("Error reallocating memory for lines!\n");
-            free(lines);  // Free the original buffer if it fails
-            exit(1);
-        }
+    // Angle between the two headings, from their cross and dot products
+    const float cross = lastDX * newDY - lastDY * newDX;
+    const float dot = lastDX * newDX + lastDY * newDY;
+    const float degrees = atan2f(fabsf(cross), dot) * (float)(180.0 / M_PI);
+    if ((lastDX != 0.0f || lastDY != 0.0f) && degrees > lineMergeTolerance) {
+        return false;
+    }
+    if (hypotf(line->x2 - last.x1, line->y2 - last.y1) > LINE_MERGE_MAX_LENGTH) {
+        return false;
+    }
+
+    line_store_set_last_end(line->x2, line->y2);
+    last.x2 = line->x2;
+    last.y2 = line->y2;
+    spatial_insert(lineCount - 1, &last);
 
-        // Assign the new buffer to lines only if it succeeded
-        lines = temp;
+    // The last line is already on the GPU and the canvas, so it has to be sent again
+    if (lineUploadCount > lineCount - 1) {
+        lineUploadCount = lineCount - 1;
     }
+    canvas_rewind(lineCount - 1);
+
+    lineMergeCount++;
+    stats_add(STAT_LINES_MERGED, 1);
+    return true;
+}
 
-    // Set line coordinates
-    lines[lineCount].x1 = x1;
-    lines[lineCount].y1 = y1;
-    lines[lineCount].x2 = x2;
-    lines[lineCount].y2 = y2;
 
-    // Set line color from current sprite color
-    lines[lineCount].r = sprite.r;
-    lines[lineCount].g = sprite.g;
-    lines[lineCount].b = sprite.b;
+void add_line(const Line* line) {
+/*
+ * add_line - Adds a new line to the line store.
+ *
+ * This function is responsible for adding a new line to the line store. The line carries the color the
+ * sprite had when it was drawn. The store grows as needed and lays the line out according to the mode
+ * selected at startup (see linestore.c). Once the store reaches its memory cap, the line may be dropped
+ * depending on the configured policy. It runs on the render thread, which receives the lines drawn by the
+ * simulation as messages (see render.c).
+ *
+ * When `lineMergeEnabled` is set, a line that continues the last one in the same color and within
+ * `lineMergeTolerance` degrees of its heading extends that line instead, and `lineMergeCount` grows.
+ *
+ * Parameters:
+ *    line - The line to add.
+ */
+
+    // A new line replaces the lines undone, which can no longer be redone
+    if (line_store_undone() > 0) {
+        discard_undone_lines();
+    }
+
+    if (try_merge_line(line)) {
+        return;
+    }
+
+    if (line_store_append(line)) {
+        spatial_insert(line_store_count() - 1, line);
+        lod_update();
+    }
+}
+
+
+void cleanup_graphics(void) {
+/*
+ * cleanup_graphics - Releases the resources owned by the renderer.
+ *
+ * This function deletes the canvas, the line buffer object and the sprite atlas. It must be called
+ * while the OpenGL context is still current. The lines themselves are owned by the line store.
+ */
+
+    canvas_shutdown();
+    profiler_shutdown_gpu();
+    glcore_shutdown();
+
+    if (lineVBO != 0) {
+        pglDeleteBuffers(1, &lineVBO);
+        lineVBO = 0;
+    }
+    lineVBOCapacity = 0;
+    lineUploadCount = 0;
+    lineVBOBase = 0;
+    line_store_set_flatten_hook(NULL);
 
-    lineCount++;
+    release_sprites();
 }
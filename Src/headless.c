@@ -0,0 +1,187 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * headless.c - Batch rendering of command streams to PNG, SVG or PDF files.
+ *
+ * Headless mode is meant for generating drawings on servers. Nothing here touches the windowing system or
+ * OpenGL: each drawing is rendered by the software rasterizer into an image allocated once for the whole
+ * batch, and lines go straight from the turtle to the image without being stored, so rendering a drawing
+ * costs only the time to run its program and step its pixels. The font and the sprite image are never
+ * loaded.
+ *
+ * With --format svg or pdf, the lines are streamed to the vector exporter instead (see export.c), framed
+ * by the image size, so a batch of arbitrarily large drawings still runs in constant memory.
+ *
+ * An input is a command program, an L-system definition when its name ends in ".lsys", or a session
+ * saved from the window when its name ends in ".session". An input
+ * "dir/name.txt" is written to "<output>/name.png"; standard input is read as commands and written to
+ * "stdin.png". L-systems that can be split are drawn by several workers, see generate.c; their parts reach
+ * the rasterizer in order, so the image does not depend on the number of workers.
+ *
+ * Key functions:
+ *    - run_headless: Renders a batch.
+ */
+
+
+//==================== Header Files ====================
+#include "headless.h"
+#include "commands.h"
+#include "export.h"
+#include "generate.h"
+#include "raster.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define OUTPUT_PATH_LENGTH 4096   // Longest path of an output file
+
+
+//==================== Function Definitions ====================
+static void draw_to_raster(const Line* line, void* context) {
+/*
+ * draw_to_raster - Line sink drawing each line of the turtle into a Raster.
+ */
+
+    raster_line(context, line);
+}
+
+
+static void draw_to_export(const Line* line, void* context) {
+/*
+ * draw_to_export - Line sink adding each line of the turtle to a vector file.
+ */
+
+    export_line(context, line);
+}
+
+
+static bool output_path(const char* outputDir, const char* input, const char* extension, char* path,
+                        const size_t size) {
+/*
+ * output_path - Builds the output path for an input: the output directory, the input's base name, the extension.
+ *
+ * Returns:
+ *    true if the path fits in `size` bytes, false otherwise.
+ */
+
+    const char* base = strcmp(input, "-") == 0 ? "stdin" : input;
+    const char* slash = strrchr(base, '/');
+    if (slash) {
+        base = slash + 1;
+    }
+
+    // Drop the extension of the input, if any
+    const char* dot = strrchr(base, '.');
+    const int baseLength = dot && dot != base ? (int)(dot - base) : (int)strlen(base);
+
+    const int written = snprintf(path, size, "%s/%.*s.%s", outputDir, baseLength, base, extension);
+    return written > 0 && (size_t)written < size;
+}
+
+
+int run_headless(const HeadlessConfig* config) {
+/*
+ * run_headless - Renders every command stream of a batch to a PNG, SVG or PDF file.
+ *
+ * Each drawing starts from a white image and a turtle at the center, facing east with the pen down. A
+ * failing input is reported and skipped, and the remaining inputs are still rendered.
+ *
+ * Parameters:
+ *    config - The batch to render.
+ *
+ * Returns:
+ *    0 if every drawing was written, 1 otherwise, to be used as the exit status.
+ */
+
+    static const char* const extensions[] = {"png", "svg", "pdf"};
+    Raster raster;
+    if (config->output == HEADLESS_PNG && !raster_init(&raster, config->width, config->height)) {
+        return 1;
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    int rendered = 0;
+
+    for (int i = 0; i < config->inputCount; i++) {
+        const char* input = config->inputs[i];
+        char path[OUTPUT_PATH_LENGTH];
+        if (!output_path(config->outputDir, input, extensions[config->output], path, sizeof(path))) {
+            printf("Output path too long for %s\n", input);
+            continue;
+        }
+
+        FILE* stream = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+        if (!stream) {
+            printf("Could not open %s\n", input);
+            continue;
+        }
+
+        Turtle turtle;
+        turtle_reset(&turtle, (float)config->width / 2.0f, (float)config->height / 2.0f);
+        if (config->output == HEADLESS_PNG) {
+            raster_clear(&raster, 1.0f, 1.0f, 1.0f);
+        }
+
+        // The input is read before the job starts, so the stream can be closed right away
+        GenerationJob* job = generate_start(stream, input, &turtle);
+        if (stream != stdin) {
+            fclose(stream);
+        }
+        if (!job) {
+            continue;
+        }
+
+        if (config->output == HEADLESS_PNG) {
+            generate_wait(job, draw_to_raster, &raster);
+            const bool executed = generate_end(job, &turtle);
+            if (executed && raster_save_png(&raster, path)) {
+                rendered++;
+            }
+            continue;
+        }
+
+        // Vector files are written while the drawing is generated, and removed if it fails
+        const ExportFormat format = config->output == HEADLESS_SVG ? EXPORT_SVG : EXPORT_PDF;
+        ExportWriter* writer = export_open(path, format, 0.0f, 0.0f, (float)config->width, (float)config->height);
+        if (!writer) {
+            generate_end(job, NULL);
+            continue;
+        }
+        generate_wait(job, draw_to_export, writer);
+        const bool executed = generate_end(job, &turtle);
+        if (export_close(writer) && executed) {
+            rendered++;
+        } else {
+            remove(path);
+        }
+    }
+
+    const double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    printf("Rendered %d of %d drawings in %.3f s (%.1f drawings/s)\n", rendered, config->inputCount, seconds,
+           seconds > 0.0 ? (double)rendered / seconds : 0.0);
+
+    if (config->output == HEADLESS_PNG) {
+        raster_free(&raster);
+    }
+    return rendered == config->inputCount ? 0 : 1;
+}
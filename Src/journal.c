@@ -0,0 +1,144 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * journal.c - Undo and redo of whole strokes.
+ *
+ * The journal lists the strokes drawn so far, oldest first. The entries before `undoCount` are on the
+ * drawing and can be undone; the `redoCount` entries after them were undone and can be redone, most
+ * recent first. Drawing anything new after an undo forgets the entries that could be redone, as in any
+ * editor. When the journal is full, the oldest entry is forgotten and its lines stay for good.
+ *
+ * An entry holds the sprite before its first line, to put the turtle back where the stroke started, and
+ * once undone the sprite at that moment, to put it back on redo. The lines are not copied: the render
+ * thread only hides them from the line store on undo and shows them again on redo (see linestore.c).
+ *
+ * Key functions:
+ *    - journal_begin / journal_end: Delimit an entry.
+ *    - journal_undo / journal_redo: Move through the entries.
+ */
+
+
+//==================== Header Files ====================
+#include "journal.h"
+#include "render.h"
+
+#include <string.h>
+
+
+//==================== Structure ====================
+typedef struct {  // Stroke recorded by the journal
+    Sprite before;            // Sprite before the stroke's first line
+    Sprite after;             // Sprite when the stroke was undone
+} JournalEntry;
+
+
+//==================== Global Variables ====================
+static JournalEntry entries[JOURNAL_ENTRIES];
+static int undoCount = 0;           // Number of entries that can be undone
+static int redoCount = 0;           // Number of entries after them that can be redone
+static bool entryOpen = false;      // Whether lines still go to the last entry
+
+
+//==================== Function Definitions ====================
+void journal_begin(const Sprite* before) {
+/*
+ * journal_begin - Opens a new entry, unless one is already open.
+ *
+ * Called before the first line of a stroke is sent to the render thread, which is told to start a new
+ * line range in order with the lines.
+ *
+ * Parameters:
+ *    before - The sprite before the stroke's first line.
+ */
+
+    if (entryOpen) {
+        return;
+    }
+
+    if (undoCount == JOURNAL_ENTRIES) {
+        memmove(&entries[0], &entries[1], (JOURNAL_ENTRIES - 1) * sizeof(JournalEntry));
+        undoCount--;
+    }
+    entries[undoCount++].before = *before;
+    redoCount = 0;
+    entryOpen = true;
+
+    render_send_mark();
+}
+
+
+void journal_end(void) {
+/*
+ * journal_end - Closes the open entry, so the next line starts a new one.
+ */
+
+    entryOpen = false;
+}
+
+
+bool journal_undo(Sprite* sprite) {
+/*
+ * journal_undo - Undoes the most recent entry.
+ *
+ * Parameters:
+ *    sprite - The sprite, moved back to where the entry started.
+ *
+ * Returns:
+ *    true if an entry was undone, false if there was none.
+ */
+
+    entryOpen = false;
+    if (undoCount == 0) {
+        return false;
+    }
+
+    JournalEntry* entry = &entries[--undoCount];
+    redoCount++;
+    entry->after = *sprite;
+    *sprite = entry->before;
+
+    render_send_undo();
+    return true;
+}
+
+
+bool journal_redo(Sprite* sprite) {
+/*
+ * journal_redo - Redoes the most recently undone entry.
+ *
+ * Parameters:
+ *    sprite - The sprite, moved to where it was when the entry was undone.
+ *
+ * Returns:
+ *    true if an entry was redone, false if there was none.
+ */
+
+    entryOpen = false;
+    if (redoCount == 0) {
+        return false;
+    }
+
+    const JournalEntry* entry = &entries[undoCount++];
+    redoCount--;
+    *sprite = entry->after;
+
+    render_send_redo();
+    return true;
+}
@@ -0,0 +1,785 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * linestore.c - Storage for the lines drawn by the turtle.
+ *
+ * This file owns every line the turtle has drawn and hides how they are laid out in memory. Two layouts
+ * are available and selected once at startup:
+ *
+ *    - Full: an array of Line records, 28 bytes per line. Random access is a plain index.
+ *    - Compact: separate position and color streams. Positions form shared-vertex polylines ("strips"):
+ *      a line that starts where the previous one ended only appends its end point, 8 bytes. Colors are a
+ *      run-length table of indices into a small palette, so a run of same-colored lines costs one entry.
+ *      Random access binary-searches the strip and color tables, and range reads walk them sequentially.
+ *
+ * Turtle strokes are long chains of connected lines in one of five preset colors, so the compact layout
+ * costs a little over 8 bytes per line, against 28 bytes for the full one.
+ *
+ * Every stream is an arena (see arena.c): growing the store allocates a new fixed-size chunk instead of
+ * reallocating and copying everything. An optional memory cap bounds the bytes held by the store. When
+ * an append would exceed it, the configured policy either drops the line, discards the oldest chunks
+ * once the canvas has rasterized them (flatten), or writes the oldest chunks to a temporary file (spill).
+ * After flattening, lines before line_store_first() can no longer be read.
+ *
+ * Undo hides the newest lines instead of freeing them: line_store_truncate lowers the count every reader
+ * sees, and line_store_restore raises it again for redo, both without touching the streams. The hidden
+ * lines are only freed once the drawing moves on without them, by the next append or extension.
+ *
+ * Key functions:
+ *    - line_store_init / line_store_free: Set up and release the store.
+ *    - line_store_append / line_store_set_last_end: Add a line or extend the last one.
+ *    - line_store_get / line_store_read: Decode lines back into Line records.
+ *    - line_store_iterate / line_store_next_block: Walk a range of lines block by block.
+ *    - line_store_set_limit: Sets the memory cap and the policy applied when it is reached.
+ *    - line_store_truncate / line_store_restore: Hide the newest lines and show them again.
+ */
+
+
+//==================== Header Files ====================
+#include "linestore.h"
+#include "arena.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define CHUNK_SHIFT 11            // Arena chunks hold 2048 elements
+#define PALETTE_SIZE 256          // Maximum number of distinct colors in the compact layout
+
+
+//==================== Structure ====================
+typedef struct {  // Vertex of the compact position stream
+    GLfloat x, y;
+} Vertex;
+
+typedef struct {  // Polyline of connected lines in the compact position stream
+    int firstLine;            // Index of the first line of the polyline
+    int firstVertex;          // Index of the start point of that line in the vertex stream
+} Strip;
+
+typedef struct {  // Run of consecutive lines sharing a color in the compact color stream
+    int firstLine;            // Index of the first line of the run
+    int palette;              // Index of the color in the palette
+} ColorRun;
+
+
+//==================== Global Variables ====================
+static LineStoreMode storeMode = LINE_STORE_FULL;
+static int storeCount = 0;                  // Number of lines in the store
+static int storeEnd = 0;                    // Number of lines in the streams, including those hidden by undo
+static int storeFirst = 0;                  // Index of the first line that can still be read
+static int droppedCount = 0;                // Number of lines rejected because of the memory cap
+static int publishedChunks = 0;             // Chunks of all arenas when the counters were last published
+
+static size_t limitBytes = 0;               // Memory cap in bytes, 0 for none
+static LineLimitPolicy limitPolicy = LINE_LIMIT_STOP;
+static int (*flattenHook)(void) = NULL;     // Rasterizes pending lines and returns how many are persisted
+
+// Full layout
+static Arena lines;                         // Line records
+
+// Compact layout
+static Arena vertices;                      // Vertex stream
+static Arena strips;                        // Strip table
+static Arena runs;                          // Color run table
+
+static GLfloat palette[PALETTE_SIZE][3];
+static int paletteCount = 0;
+
+
+//==================== Function Definitions ====================
+static Arena* bulk_arena(void) {
+/*
+ * bulk_arena - Returns the arena that grows with every line, the one the memory cap acts on.
+ */
+
+    return storeMode == LINE_STORE_FULL ? &lines : &vertices;
+}
+
+
+static int palette_index(const GLfloat r, const GLfloat g, const GLfloat b) {
+/*
+ * palette_index - Finds or adds a color in the compact layout's palette.
+ *
+ * When the palette is full the closest existing color is used instead.
+ *
+ * Parameters:
+ *    r, g, b - The RGB components of the color.
+ *
+ * Returns:
+ *    The index of the color in the palette.
+ */
+
+    int closest = 0;
+    GLfloat closestDistance = 4.0f;
+
+    for (int i = 0; i < paletteCount; i++) {
+        const GLfloat dr = palette[i][0] - r;
+        const GLfloat dg = palette[i][1] - g;
+        const GLfloat db = palette[i][2] - b;
+        const GLfloat distance = dr * dr + dg * dg + db * db;
+        if (distance == 0.0f) {
+            return i;
+        }
+        if (distance < closestDistance) {
+            closestDistance = distance;
+            closest = i;
+        }
+    }
+
+    if (paletteCount == PALETTE_SIZE) {
+        return closest;
+    }
+
+    palette[paletteCount][0] = r;
+    palette[paletteCount][1] = g;
+    palette[paletteCount][2] = b;
+    return paletteCount++;
+}
+
+
+static const Strip* strip_at(const int index) {
+/*
+ * strip_at - Returns an entry of the strip table.
+ */
+
+    return arena_at(&strips, index);
+}
+
+
+static const ColorRun* run_at(const int index) {
+/*
+ * run_at - Returns an entry of the color run table.
+ */
+
+    return arena_at(&runs, index);
+}
+
+
+static int find_strip(const int index) {
+/*
+ * find_strip - Binary-searches the strip containing a line in the compact layout.
+ */
+
+    int low = 0, high = strips.count - 1;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        if (strip_at(mid)->firstLine <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+
+static int find_run(const int index) {
+/*
+ * find_run - Binary-searches the color run containing a line in the compact layout.
+ */
+
+    int low = 0, high = runs.count - 1;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        if (run_at(mid)->firstLine <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+
+static int first_line_from_vertex(const int vertex) {
+/*
+ * first_line_from_vertex - Finds the first line whose points all lie at or after `vertex`.
+ *
+ * This is the first line that can still be read once the vertex chunks before `vertex` are discarded.
+ */
+
+    int low = 0, high = strips.count - 1;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        if (strip_at(mid)->firstVertex <= vertex) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    const Strip* strip = strip_at(low);
+    const int nextFirstLine = low + 1 < strips.count ? strip_at(low + 1)->firstLine : storeEnd;
+
+    // Lines of a strip start on consecutive vertices, from its first vertex onward
+    const int line = strip->firstLine + (vertex - strip->firstVertex);
+    return line < nextFirstLine ? line : nextFirstLine;
+}
+
+
+static void decode_line(const int index, int strip, int run, Line* line) {
+/*
+ * decode_line - Rebuilds a line of the compact layout from its strip and color run.
+ */
+
+    const Strip* s = strip_at(strip);
+    const int start = s->firstVertex + (index - s->firstLine);
+    const Vertex v1 = *(const Vertex*)arena_at(&vertices, start);
+    const Vertex v2 = *(const Vertex*)arena_at(&vertices, start + 1);
+    const GLfloat* color = palette[run_at(run)->palette];
+
+    *line = (Line){v1.x, v1.y, v2.x, v2.y, color[0], color[1], color[2]};
+}
+
+
+static void publish_stats(void) {
+/*
+ * publish_stats - Publishes the size of the store to the telemetry counters.
+ *
+ * Every chunk gained since the last call counts as an allocation; chunks freed by an undo are allocated
+ * again when the store grows back, and count again. The capacity is in elements of the arena that grows
+ * with every line: lines in the full layout, vertices in the compact one.
+ */
+
+    const int chunks = lines.chunkCount + vertices.chunkCount + strips.chunkCount + runs.chunkCount;
+    if (chunks > publishedChunks) {
+        stats_add(STAT_LINE_ALLOCATIONS, chunks - publishedChunks);
+    }
+    publishedChunks = chunks;
+
+    stats_set(STAT_LINE_COUNT, storeCount);
+    stats_set(STAT_LINE_CAPACITY, (long long)bulk_arena()->chunkCount << CHUNK_SHIFT);
+    stats_set(STAT_LINE_BYTES, (long long)line_store_bytes());
+}
+
+
+bool line_store_init(const LineStoreMode mode) {
+/*
+ * line_store_init - Sets up an empty line store in the requested layout.
+ *
+ * Parameters:
+ *    mode - LINE_STORE_FULL for one record per line, LINE_STORE_COMPACT for the packed streams.
+ *
+ * Returns:
+ *    true if the store is ready, false otherwise.
+ */
+
+    line_store_free();
+    storeMode = mode;
+
+    arena_init(&lines, sizeof(Line), CHUNK_SHIFT);
+    arena_init(&vertices, sizeof(Vertex), CHUNK_SHIFT);
+    arena_init(&strips, sizeof(Strip), CHUNK_SHIFT);
+    arena_init(&runs, sizeof(ColorRun), CHUNK_SHIFT);
+
+    return true;
+}
+
+
+void line_store_free(void) {
+/*
+ * line_store_free - Releases all memory held by the store and empties it.
+ */
+
+    arena_free(&lines);
+    arena_free(&vertices);
+    arena_free(&strips);
+    arena_free(&runs);
+
+    paletteCount = 0;
+    storeCount = 0;
+    storeEnd = 0;
+    storeFirst = 0;
+    droppedCount = 0;
+    publishedChunks = 0;
+    publish_stats();
+}
+
+
+void line_store_set_limit(const size_t maxBytes, const LineLimitPolicy policy) {
+/*
+ * line_store_set_limit - Sets the memory cap of the store and what happens when it is reached.
+ *
+ * Parameters:
+ *    maxBytes - The maximum number of bytes the store may hold in memory, or 0 for no cap.
+ *    policy   - LINE_LIMIT_STOP to drop further lines, LINE_LIMIT_FLATTEN to discard the oldest lines
+ *               once they are on the canvas, LINE_LIMIT_SPILL to move the oldest lines to disk.
+ *
+ * The cap is checked before each append, so the store may exceed it by at most one arena chunk.
+ */
+
+    limitBytes = maxBytes;
+    limitPolicy = policy;
+}
+
+
+void line_store_set_flatten_hook(int (*hook)(void)) {
+/*
+ * line_store_set_flatten_hook - Registers the function used by the flatten policy.
+ *
+ * The hook must make every stored line persistent elsewhere, normally by rasterizing it into the
+ * canvas, and return the number of leading lines that are. Without a hook, flattening cannot free
+ * anything and the store behaves as with LINE_LIMIT_STOP.
+ *
+ * Parameters:
+ *    hook - The function to call, or NULL.
+ */
+
+    flattenHook = hook;
+}
+
+
+LineStoreMode line_store_mode(void) {
+/*
+ * line_store_mode - Returns the layout selected in line_store_init.
+ */
+
+    return storeMode;
+}
+
+
+int line_store_count(void) {
+/*
+ * line_store_count - Returns the number of lines added to the store.
+ */
+
+    return storeCount;
+}
+
+
+int line_store_first(void) {
+/*
+ * line_store_first - Returns the index of the first line that can still be read.
+ *
+ * This is 0 unless the flatten policy discarded the oldest lines.
+ */
+
+    return storeFirst;
+}
+
+
+int line_store_dropped(void) {
+/*
+ * line_store_dropped - Returns the number of lines rejected because the memory cap was reached.
+ */
+
+    return droppedCount;
+}
+
+
+size_t line_store_bytes(void) {
+/*
+ * line_store_bytes - Returns the number of bytes the store currently holds in memory.
+ */
+
+    if (storeMode == LINE_STORE_FULL) {
+        return arena_resident_bytes(&lines);
+    }
+    return arena_resident_bytes(&vertices) + arena_resident_bytes(&strips) +
+           arena_resident_bytes(&runs) + sizeof(palette);
+}
+
+
+static void flatten_chunks(void) {
+/*
+ * flatten_chunks - Discards the oldest chunks whose lines are all persisted by the flatten hook.
+ */
+
+    if (!flattenHook) {
+        return;
+    }
+
+    const int persisted = flattenHook();
+    Arena* arena = bulk_arena();
+    const int chunkSize = arena_chunk_size(arena);
+
+    for (int chunk = 0; chunk < arena->chunkCount - 1; chunk++) {
+        if (arena->states[chunk] == CHUNK_DISCARDED) {
+            continue;
+        }
+
+        // First line that can still be read without this chunk
+        const int boundary = (chunk + 1) * chunkSize;
+        const int first = storeMode == LINE_STORE_FULL ? boundary : first_line_from_vertex(boundary);
+        if (first > persisted) {
+            break;
+        }
+
+        arena_discard_chunk(arena, chunk);
+        storeFirst = first;
+        if (line_store_bytes() <= limitBytes) {
+            break;
+        }
+    }
+}
+
+
+static void spill_chunks(void) {
+/*
+ * spill_chunks - Writes the oldest resident chunks to disk until the store fits under its cap.
+ */
+
+    Arena* arena = bulk_arena();
+    for (int chunk = 0; chunk < arena->chunkCount - 1 && line_store_bytes() > limitBytes; chunk++) {
+        if (arena->states[chunk] == CHUNK_RESIDENT && !arena_spill_chunk(arena, chunk)) {
+            break;
+        }
+    }
+}
+
+
+static bool make_room(void) {
+/*
+ * make_room - Applies the limit policy when the store is at its memory cap.
+ *
+ * Returns:
+ *    true if another line may be appended, false if it must be dropped.
+ */
+
+    if (limitBytes == 0 || line_store_bytes() < limitBytes) {
+        return true;
+    }
+
+    if (limitPolicy == LINE_LIMIT_FLATTEN) {
+        flatten_chunks();
+    } else if (limitPolicy == LINE_LIMIT_SPILL) {
+        spill_chunks();
+    }
+
+    return line_store_bytes() < limitBytes;
+}
+
+
+bool line_store_append(const Line* line) {
+/*
+ * line_store_append - Appends a line to the store.
+ *
+ * In the compact layout the line shares its start point with the previous line when they touch,
+ * and extends the current color run when the color is unchanged.
+ *
+ * Parameters:
+ *    line - The line to append.
+ *
+ * Returns:
+ *    true if the line was stored, false if it was dropped because of the memory cap.
+ */
+
+    line_store_discard_undone();
+    if (!make_room()) {
+        droppedCount++;
+        stats_add(STAT_LINES_DROPPED, 1);
+        publish_stats();
+        return false;
+    }
+
+    if (storeMode == LINE_STORE_FULL) {
+        *(Line*)arena_push(&lines) = *line;
+        storeEnd = ++storeCount;
+        publish_stats();
+        return true;
+    }
+
+    // Start a new strip unless the line continues the previous one
+    const Vertex* last = vertices.count > 0 ? arena_at(&vertices, vertices.count - 1) : NULL;
+    const bool connected = last && last->x == line->x1 && last->y == line->y1;
+    if (!connected) {
+        *(Strip*)arena_push(&strips) = (Strip){storeCount, vertices.count};
+        *(Vertex*)arena_push(&vertices) = (Vertex){line->x1, line->y1};
+    }
+    *(Vertex*)arena_push(&vertices) = (Vertex){line->x2, line->y2};
+
+    // Start a new color run unless the color is unchanged
+    const int color = palette_index(line->r, line->g, line->b);
+    if (runs.count == 0 || run_at(runs.count - 1)->palette != color) {
+        *(ColorRun*)arena_push(&runs) = (ColorRun){storeCount, color};
+    }
+
+    storeEnd = ++storeCount;
+    publish_stats();
+    return true;
+}
+
+
+bool line_store_get(const int index, Line* line) {
+/*
+ * line_store_get - Decodes a single line.
+ *
+ * Parameters:
+ *    index - Index of the line, between line_store_first() and line_store_count() - 1.
+ *    line  - Receives the decoded line.
+ *
+ * Returns:
+ *    true if the line was decoded, false if the index is out of range or the line was flattened.
+ */
+
+    if (index < storeFirst || index >= storeCount) {
+        return false;
+    }
+
+    if (storeMode == LINE_STORE_FULL) {
+        const Line* stored = arena_at(&lines, index);
+        if (!stored) {
+            return false;
+        }
+        *line = *stored;
+        return true;
+    }
+
+    decode_line(index, find_strip(index), find_run(index), line);
+    return true;
+}
+
+
+int line_store_read(int first, int count, Line* out) {
+/*
+ * line_store_read - Decodes a contiguous range of lines.
+ *
+ * This is the fast path for consumers that walk the store in order: in the compact layout the strip and
+ * color run of the first line are searched once, then both tables are walked forward.
+ *
+ * Parameters:
+ *    first - Index of the first line to read; raised to line_store_first() if it is lower.
+ *    count - Number of lines to read; clamped to the end of the store.
+ *    out   - Receives the decoded lines.
+ *
+ * Returns:
+ *    The number of lines written to `out`.
+ */
+
+    if (first < storeFirst) {
+        count -= storeFirst - first;
+        first = storeFirst;
+    }
+    if (first >= storeCount || count <= 0) {
+        return 0;
+    }
+    if (count > storeCount - first) {
+        count = storeCount - first;
+    }
+
+    if (storeMode == LINE_STORE_FULL) {
+        int done = 0;
+        while (done < count) {
+            void* span = NULL;
+            int length = arena_span(&lines, first + done, &span);
+            if (!span) {
+                break;
+            }
+            if (length > count - done) {
+                length = count - done;
+            }
+            for (int i = 0; i < length; i++) {
+                out[done + i] = ((const Line*)span)[i];
+            }
+            done += length;
+        }
+        return done;
+    }
+
+    int strip = find_strip(first);
+    int run = find_run(first);
+
+    for (int i = 0; i < count; i++) {
+        const int index = first + i;
+
+        // Advance to the next strip or color run when the line belongs to it
+        while (strip + 1 < strips.count && strip_at(strip + 1)->firstLine <= index) {
+            strip++;
+        }
+        while (run + 1 < runs.count && run_at(run + 1)->firstLine <= index) {
+            run++;
+        }
+
+        decode_line(index, strip, run, &out[i]);
+    }
+
+    return count;
+}
+
+
+void line_store_iterate(LineIterator* it, const int first, const int count) {
+/*
+ * line_store_iterate - Starts walking the lines in [first, first + count) block by block.
+ *
+ * Parameters:
+ *    it    - The iterator to initialize.
+ *    first - Index of the first line to visit.
+ *    count - Number of lines to visit.
+ */
+
+    it->next = first > storeFirst ? first : storeFirst;
+    it->end = first + count < storeCount ? first + count : storeCount;
+    it->first = it->next;
+    it->count = 0;
+    it->lines = NULL;
+}
+
+
+bool line_store_next_block(LineIterator* it) {
+/*
+ * line_store_next_block - Advances an iterator to its next block of lines.
+ *
+ * In the full layout a block points straight into an arena chunk, so no line is copied. In the compact
+ * layout up to LINE_BLOCK_SIZE lines are decoded into the iterator's scratch buffer. The block stays valid
+ * until the next call or until the store is modified.
+ *
+ * Parameters:
+ *    it - The iterator to advance.
+ *
+ * Returns:
+ *    true if `it->first`, `it->count` and `it->lines` describe a new block, false once the range is done.
+ */
+
+    if (it->next >= it->end) {
+        return false;
+    }
+
+    it->first = it->next;
+    if (storeMode == LINE_STORE_FULL) {
+        void* span = NULL;
+        int length = arena_span(&lines, it->next, &span);
+        if (length > it->end - it->next) {
+            length = it->end - it->next;
+        }
+        if (!span || length <= 0) {
+            return false;
+        }
+        it->lines = span;
+        it->count = length;
+    } else {
+        const int length = it->end - it->next < LINE_BLOCK_SIZE ? it->end - it->next : LINE_BLOCK_SIZE;
+        it->count = line_store_read(it->next, length, it->scratch);
+        it->lines = it->scratch;
+        if (it->count <= 0) {
+            return false;
+        }
+    }
+
+    it->next += it->count;
+    return true;
+}
+
+
+void line_store_set_last_end(const GLfloat x2, const GLfloat y2) {
+/*
+ * line_store_set_last_end - Moves the end point of the last line.
+ *
+ * In the compact layout the end point of the last line is the last vertex and is not shared with
+ * any other line, so it can be overwritten in place. The last chunk of an arena is always resident.
+ *
+ * Parameters:
+ *    x2, y2 - The new end point of the last line.
+ */
+
+    line_store_discard_undone();
+    if (storeCount == 0) {
+        return;
+    }
+
+    if (storeMode == LINE_STORE_FULL) {
+        Line* last = arena_at(&lines, storeCount - 1);
+        last->x2 = x2;
+        last->y2 = y2;
+    } else {
+        *(Vertex*)arena_at(&vertices, vertices.count - 1) = (Vertex){x2, y2};
+    }
+}
+
+
+void line_store_truncate(int count) {
+/*
+ * line_store_truncate - Hides the lines from `count` onward, as if they had never been added.
+ *
+ * The lines stay in the streams, so line_store_restore can show them again in constant time, until the
+ * next append or extension frees them. Lines that were flattened cannot be hidden.
+ *
+ * Parameters:
+ *    count - The number of lines to keep; raised to line_store_first() if it is lower.
+ */
+
+    if (count < storeFirst) {
+        count = storeFirst;
+    }
+    if (count < storeCount) {
+        storeCount = count;
+        publish_stats();
+    }
+}
+
+
+int line_store_restore(const int count) {
+/*
+ * line_store_restore - Shows lines hidden by line_store_truncate again.
+ *
+ * Parameters:
+ *    count - The number of lines wanted; clamped to the lines still held in the streams.
+ *
+ * Returns:
+ *    The new number of lines.
+ */
+
+    if (count > storeCount) {
+        storeCount = count < storeEnd ? count : storeEnd;
+        publish_stats();
+    }
+    return storeCount;
+}
+
+
+int line_store_undone(void) {
+/*
+ * line_store_undone - Returns the number of lines hidden by line_store_truncate and not yet freed.
+ */
+
+    return storeEnd - storeCount;
+}
+
+
+void line_store_discard_undone(void) {
+/*
+ * line_store_discard_undone - Frees the lines hidden by line_store_truncate.
+ *
+ * In the compact layout the streams are cut after the end point, strip and color run of the last
+ * line kept; the palette keeps its colors, which later lines may reuse.
+ */
+
+    if (storeEnd == storeCount) {
+        return;
+    }
+
+    if (storeMode == LINE_STORE_FULL) {
+        arena_truncate(&lines, storeCount);
+    } else if (storeCount == 0) {
+        arena_truncate(&vertices, 0);
+        arena_truncate(&strips, 0);
+        arena_truncate(&runs, 0);
+    } else {
+        const int strip = find_strip(storeCount - 1);
+        const Strip* s = strip_at(strip);
+        arena_truncate(&vertices, s->firstVertex + (storeCount - 1 - s->firstLine) + 2);
+        arena_truncate(&strips, strip + 1);
+        arena_truncate(&runs, find_run(storeCount - 1) + 1);
+    }
+    storeEnd = storeCount;
+    publish_stats();
+}
@@ -0,0 +1,401 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * lod.c - Precomputed simplified versions of the drawing for zoomed-out views.
+ *
+ * Lines are grouped in chunks of LOD_CHUNK_LINES consecutive lines. Once a chunk is complete, meaning its
+ * last line is no longer the last stored line and so can no longer be extended, its polylines (runs of
+ * connected lines of one color) are simplified with Douglas-Peucker at every level and the result is
+ * appended to that level's arena. Level 1 allows an error of LOD_BASE_TOLERANCE drawing units, and every
+ * following level doubles it. Each chunk also records its bounding box, so zoomed-out frames skip chunks
+ * outside the view without looking at their lines.
+ *
+ * Lines of the last, incomplete chunk are not simplified; lod_collect tells the caller where they start so
+ * they can be drawn at full detail. Chunks the line store has partly flattened are returned at full detail
+ * for their remaining lines, and fully flattened chunks are skipped, since the canvas already shows them.
+ * Chunks reaching into lines hidden by undo are left out, and dropped with lod_truncate once the store
+ * frees those lines; until then redo only has to show them again.
+ *
+ * Key functions:
+ *    - lod_update: Simplifies newly completed chunks.
+ *    - lod_level: Maps a zoom factor to a level.
+ *    - lod_collect: Lists the simplified lines visible in a view.
+ *    - lod_truncate: Drops the chunks that no longer match the stored lines.
+ */
+
+
+//==================== Header Files ====================
+#include "lod.h"
+#include "arena.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define LOD_CHUNK_LINES 256       // Lines simplified together
+#define LOD_LEVELS 5              // Number of simplified levels
+#define LOD_BASE_TOLERANCE 2.0f   // Error allowed by level 1, in drawing units
+#define LOD_PIXEL_ERROR 1.0f      // Error a level may show on screen, in pixels
+#define LOD_CHUNK_SHIFT 10        // Arena chunks hold 1024 elements
+
+
+//==================== Structure ====================
+typedef struct {  // Simplified copy of one chunk of lines
+    int firstLine;                // Index of the first line of the chunk
+    float minX, minY, maxX, maxY; // Bounding box of the chunk's lines
+    int offset[LOD_LEVELS];       // Index of the chunk's first simplified line in each level
+    int count[LOD_LEVELS];        // Number of simplified lines in each level
+} LodChunk;
+
+
+//==================== Global Variables ====================
+static Arena chunks;                // LodChunk records, one per completed chunk
+static Arena levels[LOD_LEVELS];    // Simplified lines of each level
+static bool lodReady = false;       // Whether the arenas are initialized
+
+static Line* collected = NULL;      // Buffer returned by lod_collect
+static int collectedCapacity = 0;
+
+
+//==================== Function Definitions ====================
+void lod_init(void) {
+/*
+ * lod_init - Sets up empty levels, releasing any previous ones.
+ */
+
+    lod_free();
+
+    arena_init(&chunks, sizeof(LodChunk), LOD_CHUNK_SHIFT);
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        arena_init(&levels[level], sizeof(Line), LOD_CHUNK_SHIFT);
+    }
+    lodReady = true;
+}
+
+
+void lod_free(void) {
+/*
+ * lod_free - Releases all memory held by the levels.
+ */
+
+    if (lodReady) {
+        arena_free(&chunks);
+        for (int level = 0; level < LOD_LEVELS; level++) {
+            arena_free(&levels[level]);
+        }
+        lodReady = false;
+    }
+
+    free(collected);
+    collected = NULL;
+    collectedCapacity = 0;
+}
+
+
+static float point_segment_distance(const float px, const float py, const float ax, const float ay,
+                                    const float bx, const float by) {
+/*
+ * point_segment_distance - Returns the distance from a point to the segment from a to b.
+ */
+
+    const float dx = bx - ax;
+    const float dy = by - ay;
+    const float lengthSquared = dx * dx + dy * dy;
+
+    float t = 0.0f;
+    if (lengthSquared > 0.0f) {
+        t = ((px - ax) * dx + (py - ay) * dy) / lengthSquared;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    }
+
+    const float ex = ax + t * dx - px;
+    const float ey = ay + t * dy - py;
+    return sqrtf(ex * ex + ey * ey);
+}
+
+
+static void simplify_polyline(const Line* lines, const int count, const float tolerance, Arena* level) {
+/*
+ * simplify_polyline - Appends the Douglas-Peucker simplification of a polyline to a level.
+ *
+ * Point i of the polyline is the start of lines[i], and the last point is the end of the last line. The
+ * recursion is replaced by an explicit stack of spans so long polylines cannot overflow the call stack.
+ *
+ * Parameters:
+ *    lines     - The connected lines of the polyline, all of one color.
+ *    count     - Number of lines, at most LOD_CHUNK_LINES.
+ *    tolerance - The largest distance a dropped point may lie from the simplified polyline.
+ *    level     - The arena receiving the simplified lines.
+ */
+
+    float xs[LOD_CHUNK_LINES + 1], ys[LOD_CHUNK_LINES + 1];
+    bool keep[LOD_CHUNK_LINES + 1] = {false};
+    int stack[LOD_CHUNK_LINES * 2 + 2];
+    int top = 0;
+
+    for (int i = 0; i < count; i++) {
+        xs[i] = lines[i].x1;
+        ys[i] = lines[i].y1;
+    }
+    xs[count] = lines[count - 1].x2;
+    ys[count] = lines[count - 1].y2;
+
+    keep[0] = keep[count] = true;
+    stack[top++] = 0;
+    stack[top++] = count;
+
+    while (top > 0) {
+        const int last = stack[--top];
+        const int first = stack[--top];
+
+        // Find the point farthest from the chord of the span
+        int farthest = -1;
+        float farthestDistance = tolerance;
+        for (int i = first + 1; i < last; i++) {
+            const float d = point_segment_distance(xs[i], ys[i], xs[first], ys[first], xs[last], ys[last]);
+            if (d > farthestDistance) {
+                farthestDistance = d;
+                farthest = i;
+            }
+        }
+
+        // Keep it and simplify both halves, or drop every point in between
+        if (farthest >= 0) {
+            keep[farthest] = true;
+            stack[top++] = first;
+            stack[top++] = farthest;
+            stack[top++] = farthest;
+            stack[top++] = last;
+        }
+    }
+
+    int previous = 0;
+    for (int i = 1; i <= count; i++) {
+        if (keep[i]) {
+            *(Line*)arena_push(level) = (Line){xs[previous], ys[previous], xs[i], ys[i],
+                                               lines[0].r, lines[0].g, lines[0].b};
+            previous = i;
+        }
+    }
+}
+
+
+static void build_chunk(const int firstLine) {
+/*
+ * build_chunk - Simplifies one completed chunk at every level and records it.
+ */
+
+    static Line source[LOD_CHUNK_LINES];
+    const int count = line_store_read(firstLine, LOD_CHUNK_LINES, source);
+
+    LodChunk* chunk = arena_push(&chunks);
+    chunk->firstLine = firstLine;
+    chunk->minX = chunk->minY = INFINITY;
+    chunk->maxX = chunk->maxY = -INFINITY;
+
+    for (int i = 0; i < count; i++) {
+        chunk->minX = fminf(chunk->minX, fminf(source[i].x1, source[i].x2));
+        chunk->minY = fminf(chunk->minY, fminf(source[i].y1, source[i].y2));
+        chunk->maxX = fmaxf(chunk->maxX, fmaxf(source[i].x1, source[i].x2));
+        chunk->maxY = fmaxf(chunk->maxY, fmaxf(source[i].y1, source[i].y2));
+    }
+
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        const float tolerance = LOD_BASE_TOLERANCE * (float)(1 << level);
+        chunk->offset[level] = levels[level].count;
+
+        // Split the chunk into polylines of connected, same-colored lines
+        int start = 0;
+        for (int i = 1; i <= count; i++) {
+            const bool continues = i < count &&
+                source[i].x1 == source[i - 1].x2 && source[i].y1 == source[i - 1].y2 &&
+                source[i].r == source[i - 1].r && source[i].g == source[i - 1].g && source[i].b == source[i - 1].b;
+            if (!continues) {
+                simplify_polyline(&source[start], i - start, tolerance, &levels[level]);
+                start = i;
+            }
+        }
+
+        chunk->count[level] = levels[level].count - chunk->offset[level];
+    }
+}
+
+
+void lod_update(void) {
+/*
+ * lod_update - Simplifies every chunk completed since the last call.
+ *
+ * This is called after each stored line, so a chunk is simplified as soon as the line after it exists
+ * and the cost is spread over the drawing instead of landing on the first zoomed-out frame. Chunks that
+ * start before the first readable line are recorded without being simplified.
+ */
+
+    if (!lodReady) {
+        return;
+    }
+
+    // Only the last line can still change, so a chunk is final once a line follows it
+    while ((chunks.count + 1) * LOD_CHUNK_LINES < line_store_count()) {
+        const int firstLine = chunks.count * LOD_CHUNK_LINES;
+        if (firstLine < line_store_first()) {
+            LodChunk* chunk = arena_push(&chunks);
+            *chunk = (LodChunk){0};
+            chunk->firstLine = firstLine;
+            chunk->minX = chunk->minY = -INFINITY;
+            chunk->maxX = chunk->maxY = INFINITY;
+            for (int level = 0; level < LOD_LEVELS; level++) {
+                chunk->offset[level] = levels[level].count;
+            }
+        } else {
+            build_chunk(firstLine);
+        }
+    }
+}
+
+
+int lod_level(const float zoom) {
+/*
+ * lod_level - Picks the coarsest level whose error stays under LOD_PIXEL_ERROR at a zoom.
+ *
+ * Parameters:
+ *    zoom - The camera zoom, in window pixels per drawing unit.
+ *
+ * Returns:
+ *    The level to draw, or 0 for the full drawing.
+ */
+
+    const float allowed = LOD_PIXEL_ERROR / zoom;
+    int level = 0;
+    while (level < LOD_LEVELS && LOD_BASE_TOLERANCE * (float)(1 << level) <= allowed) {
+        level++;
+    }
+    return level;
+}
+
+
+static void collect_line(const Line* line, int* count) {
+/*
+ * collect_line - Appends a line to the lod_collect buffer.
+ */
+
+    if (*count == collectedCapacity) {
+        const int newCapacity = collectedCapacity > 0 ? collectedCapacity * 2 : 4096;
+        Line* newCollected = realloc(collected, (size_t)newCapacity * sizeof(Line));
+        if (!newCollected) {
+            printf("Error reallocating memory for simplified lines!\n");
+            exit(1);
+        }
+        collected = newCollected;
+        collectedCapacity = newCapacity;
+    }
+    collected[(*count)++] = *line;
+}
+
+
+int lod_collect(const int level, const CameraView view, const Line** lines, int* fullDetailFirst) {
+/*
+ * lod_collect - Gathers the simplified lines of a level in the chunks crossing a view.
+ *
+ * Parameters:
+ *    level           - The level to use, between 1 and the value returned by lod_level.
+ *    view            - The visible rectangle of the drawing.
+ *    lines           - Receives a pointer to the collected lines, valid until the next call.
+ *    fullDetailFirst - Receives the index of the first line not covered by any chunk; the caller draws
+ *                      the lines from there to the end of the store at full detail.
+ *
+ * Returns:
+ *    The number of collected lines.
+ */
+
+    const int first = line_store_first();
+    int count = 0;
+
+    *lines = collected;
+    *fullDetailFirst = 0;
+    if (!lodReady || level <= 0) {
+        return 0;
+    }
+
+    // Chunks reaching into lines hidden by undo wait for redo
+    int visibleChunks = line_store_count() / LOD_CHUNK_LINES;
+    if (visibleChunks > chunks.count) {
+        visibleChunks = chunks.count;
+    }
+    *fullDetailFirst = visibleChunks * LOD_CHUNK_LINES;
+
+    Arena* simplified = &levels[level - 1];
+    for (int c = 0; c < visibleChunks; c++) {
+        const LodChunk* chunk = arena_at(&chunks, c);
+        if (chunk->firstLine + LOD_CHUNK_LINES <= first) {
+            continue;
+        }
+        if (chunk->maxX < view.minX || chunk->minX > view.maxX ||
+            chunk->maxY < view.minY || chunk->minY > view.maxY) {
+            continue;
+        }
+
+        // A partly flattened chunk only has its remaining lines, drawn as stored
+        if (chunk->firstLine < first) {
+            Line line;
+            for (int i = first; i < chunk->firstLine + LOD_CHUNK_LINES; i++) {
+                if (line_store_get(i, &line)) {
+                    collect_line(&line, &count);
+                }
+            }
+            continue;
+        }
+
+        for (int i = 0; i < chunk->count[level - 1]; i++) {
+            collect_line(arena_at(simplified, chunk->offset[level - 1] + i), &count);
+        }
+    }
+
+    *lines = collected;
+    return count;
+}
+
+
+void lod_truncate(const int count) {
+/*
+ * lod_truncate - Drops the chunks that lod_update would not have completed with `count` lines stored.
+ *
+ * This is used when the line store frees lines hidden by undo, before new lines take their indices.
+ *
+ * Parameters:
+ *    count - The number of lines the store keeps.
+ */
+
+    if (!lodReady) {
+        return;
+    }
+
+    const int keep = count > 0 ? (count - 1) / LOD_CHUNK_LINES : 0;
+    if (keep >= chunks.count) {
+        return;
+    }
+
+    const LodChunk* first = arena_at(&chunks, keep);
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        arena_truncate(&levels[level], first->offset[level]);
+    }
+    arena_truncate(&chunks, keep);
+}
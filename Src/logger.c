@@ -0,0 +1,270 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * logger.c - Status messages printed by a writer thread, under a rate limit.
+ *
+ * printf to a terminal can block for as long as the terminal takes to scroll, and the interactive paths
+ * used to print from the main thread: a color change, a resize, a client connecting. log_message formats
+ * the message into a ring of fixed-size slots instead and wakes a writer thread, which prints every queued
+ * message and flushes stdout once. The slots are taken under a spin lock, since the main thread and the
+ * command server's I/O thread both log, and the lock is never held across any I/O.
+ *
+ * The rate limit is a token bucket: LOGGER_BURST messages may be logged at once, and LOGGER_RATE more per
+ * second after that. A message past the limit, or finding the ring full, is only counted; the count is
+ * logged as one line before the next message that gets through, or when the logger stops. Before
+ * logger_start and after logger_stop, messages are printed directly, still under the limit, so code
+ * shared with the benchmark suite can log without a writer thread.
+ *
+ * Other threads are already logging when the logger starts and stops, so whether the writer thread runs
+ * is an atomic flag, read with acquire semantics under the spin lock. log_message also posts the writer's
+ * semaphore with the lock held, and logger_stop clears the flag under the lock before it destroys the
+ * semaphore, so no thread can post it once it is gone.
+ *
+ * Errors that end the program are still printed directly, so they are out before it exits.
+ *
+ * Key functions:
+ *    - logger_start / logger_stop: Start the writer thread, and print what is left and stop it.
+ *    - log_message: Format a message and queue it.
+ */
+
+
+//==================== Header Files ====================
+#include "logger.h"
+
+#include <SDL2/SDL.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define LOGGER_SLOTS 256          // Messages the ring holds, a power of two
+#define LOGGER_LINE 256           // Longest message kept, longer ones are cut
+#define LOGGER_RATE 20.0          // Messages per second let through once the burst is spent
+#define LOGGER_BURST 40.0         // Messages let through at once
+
+
+//==================== Global Variables ====================
+static SDL_Thread* writerThread = NULL;  // Thread printing the messages, only used by logger_start and logger_stop
+static SDL_sem* wakeUp = NULL;           // Posted when a message is queued or the logger stops
+static SDL_atomic_t writerRunning;       // Whether messages go to the writer thread, changed under the lock
+static SDL_atomic_t quitRequested;       // Whether the writer thread must stop
+static SDL_SpinLock lock = 0;            // Guards everything below
+
+static char slots[LOGGER_SLOTS][LOGGER_LINE]; // Ring of messages
+static int head = 0;                     // Slot the next message goes to
+static int tail = 0;                     // Slot of the next message to print
+static double tokens = LOGGER_BURST;     // Messages that may be logged now
+static Uint64 lastRefill = 0;            // Performance counter value when tokens were last added
+static int suppressed = 0;               // Messages counted instead of logged since the last report
+
+
+//==================== Function Definitions ====================
+static bool take_token(void) {
+/*
+ * take_token - Refills the token bucket for the time elapsed and takes one token from it.
+ *
+ * Called with the lock held.
+ */
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (lastRefill != 0) {
+        tokens += (double)(now - lastRefill) / (double)SDL_GetPerformanceFrequency() * LOGGER_RATE;
+        if (tokens > LOGGER_BURST) {
+            tokens = LOGGER_BURST;
+        }
+    }
+    lastRefill = now;
+
+    if (tokens < 1.0) {
+        return false;
+    }
+    tokens -= 1.0;
+    return true;
+}
+
+
+static bool queue_text(const char* text) {
+/*
+ * queue_text - Copies a message into the ring, called with the lock held.
+ *
+ * Returns:
+ *    false if the ring is full.
+ */
+
+    const int next = (head + 1) & (LOGGER_SLOTS - 1);
+    if (next == tail) {
+        return false;
+    }
+    snprintf(slots[head], LOGGER_LINE, "%s", text);
+    head = next;
+    return true;
+}
+
+
+static void print_queued(void) {
+/*
+ * print_queued - Prints the queued messages and flushes stdout once.
+ *
+ * A message is copied out of its slot before it is printed, so the lock is not held while printing.
+ */
+
+    char text[LOGGER_LINE];
+    bool printed = false;
+    for (;;) {
+        SDL_AtomicLock(&lock);
+        if (tail == head) {
+            SDL_AtomicUnlock(&lock);
+            break;
+        }
+        memcpy(text, slots[tail], sizeof(text));
+        tail = (tail + 1) & (LOGGER_SLOTS - 1);
+        SDL_AtomicUnlock(&lock);
+
+        fputs(text, stdout);
+        printed = true;
+    }
+    if (printed) {
+        fflush(stdout);
+    }
+}
+
+
+static int writer_main(void* data) {
+/*
+ * writer_main - Entry point of the writer thread, printing messages as they are queued.
+ */
+
+    (void)data;
+    while (!SDL_AtomicGet(&quitRequested)) {
+        SDL_SemWait(wakeUp);
+        print_queued();
+    }
+    return 0;
+}
+
+
+bool logger_start(void) {
+/*
+ * logger_start - Starts the writer thread.
+ *
+ * Returns:
+ *    true if messages are printed by the writer thread from now on, false if they are still printed directly.
+ */
+
+    wakeUp = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&quitRequested, 0);
+    writerThread = wakeUp ? SDL_CreateThread(writer_main, "logger", NULL) : NULL;
+    if (!writerThread) {
+        printf("Error creating the logger thread, printing messages directly: %s\n", SDL_GetError());
+        if (wakeUp) {
+            SDL_DestroySemaphore(wakeUp);
+            wakeUp = NULL;
+        }
+        return false;
+    }
+
+    // The semaphore and the thread must be visible before another thread sees the flag
+    SDL_AtomicLock(&lock);
+    SDL_AtomicSet(&writerRunning, 1);
+    SDL_AtomicUnlock(&lock);
+    return true;
+}
+
+
+void log_message(const char* format, ...) {
+/*
+ * log_message - Formats a message like printf and queues it for the writer thread.
+ *
+ * Never waits for stdout. The message is dropped and counted if it is over the rate limit or finds the
+ * ring full. Safe to call from any thread.
+ *
+ * Parameters:
+ *    format - The printf format of the message, usually ending in a newline.
+ */
+
+    char text[LOGGER_LINE];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+
+    SDL_AtomicLock(&lock);
+    if (!take_token()) {
+        suppressed++;
+        SDL_AtomicUnlock(&lock);
+        return;
+    }
+
+    // Messages dropped since the last report are reported first, in the slot of the first one dropped
+    char report[64] = "";
+    if (suppressed > 0) {
+        snprintf(report, sizeof(report), "(%d messages suppressed)\n", suppressed);
+    }
+    const bool running = SDL_AtomicGet(&writerRunning) != 0;
+    SDL_MemoryBarrierAcquire();
+    if (!running) {
+        suppressed = 0;
+        SDL_AtomicUnlock(&lock);
+        fputs(report, stdout);
+        fputs(text, stdout);
+        return;
+    }
+    if (report[0] && queue_text(report)) {
+        suppressed = 0;
+    }
+    if (suppressed > 0 || !queue_text(text)) {
+        suppressed++;
+    }
+    SDL_SemPost(wakeUp);
+    SDL_AtomicUnlock(&lock);
+}
+
+
+void logger_stop(void) {
+/*
+ * logger_stop - Prints the messages still queued and stops the writer thread.
+ *
+ * Later messages are printed directly.
+ */
+
+    if (writerThread) {
+        // From here on messages are printed directly, and no thread posts the semaphore any more
+        SDL_AtomicLock(&lock);
+        SDL_AtomicSet(&writerRunning, 0);
+        SDL_AtomicUnlock(&lock);
+
+        SDL_AtomicSet(&quitRequested, 1);
+        SDL_SemPost(wakeUp);
+        SDL_WaitThread(writerThread, NULL);
+        writerThread = NULL;
+        SDL_DestroySemaphore(wakeUp);
+        wakeUp = NULL;
+    }
+    print_queued();
+
+    SDL_AtomicLock(&lock);
+    const int dropped = suppressed;
+    suppressed = 0;
+    SDL_AtomicUnlock(&lock);
+    if (dropped > 0) {
+        printf("(%d messages suppressed)\n", dropped);
+    }
+}
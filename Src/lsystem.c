@@ -0,0 +1,934 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * lsystem.c - Streaming expansion of L-systems.
+ *
+ * L-system strings grow exponentially with the depth, so a drawing of millions of lines would need a
+ * string of tens of megabytes if it were expanded first. Here the expansion is a depth-first walk: a stack
+ * holds one cursor per level of recursion, pointing into the axiom or into a rule, and each symbol either
+ * descends into its rule or is interpreted by the turtle on the spot. The stack never holds more than
+ * depth + 1 cursors, and the only other memory is the stack of states saved by '[', whose size depends on
+ * the nesting of brackets, not on the length of the drawing. A segment budget stops the walk early.
+ *
+ * A definition is a text file of directives, one per line, with '#' starting a comment:
+ *
+ *    axiom STRING       The initial string.
+ *    rule X STRING      Replace symbol X with STRING at every step, STRING may be left out to erase X.
+ *    angle D            Turn of '+' and '-' in degrees (default 90).
+ *    step N             Distance moved by a forward symbol (default 10).
+ *    depth N            Number of rewriting steps (default 4).
+ *    budget N           Stop after N lines (default no limit).
+ *    draw SYMBOLS       Symbols moving forward with the pen down (default FG).
+ *    move SYMBOLS       Symbols moving forward with the pen up (default fg).
+ *
+ * The turtle interprets '+' as a left turn, '-' as a right turn, '|' as a half turn, and '[' and ']' as
+ * saving and restoring its position and heading. Other symbols only take part in the rewriting.
+ *
+ * When 360 degrees is a whole number of turns, headings are counted in half turns of the angle and their
+ * directions are taken from a table, so no trigonometry runs during the walk and branches that come back
+ * to the same heading land on exactly the same direction. Other angles take their directions from
+ * movement_direction (see movement.c).
+ *
+ * Key functions:
+ *    - lsystem_parse: Reads a definition.
+ *    - lsystem_run: Walks the expansion, driving the turtle.
+ */
+
+
+//==================== Header Files ====================
+#include "lsystem.h"
+#include "movement.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define LSYSTEM_LINE_LENGTH 4096      // Longest line of a definition
+#define HEADING_TABLE_SIZE 4096       // Most headings kept in the direction table
+#define PART_TARGET_COUNT 16384       // Number of parts a drawing is split into, when it is large enough
+#define PART_MIN_LINES 4096           // Fewest lines worth a part of their own
+#define LINE_COUNT_MAX (LLONG_MAX / 2) // Line counts saturate here instead of overflowing
+#define DEFAULT_ANGLE 90.0f
+#define DEFAULT_STEP 10.0f
+#define DEFAULT_DEPTH 4
+
+
+//==================== Structure ====================
+typedef struct {  // Level of the expansion being walked
+    const char* cursor;       // Next symbol of the string at this level
+    int depth;                // Number of rewriting steps that produced the string
+} ExpansionFrame;
+
+typedef struct {  // Turtle state during a walk, also saved by '['
+    float x, y;               // Position
+    float angle;              // Heading in degrees, when there is no direction table
+    int heading;              // Heading in half turns of the angle from the start, with a direction table
+} WalkState;
+
+typedef struct {  // Headings of a drawing, when 360 degrees is a whole number of turns
+    int size;                 // Number of headings, 0 when there is no table
+    float (*directions)[2];   // Unit vector of each heading in drawing coordinates
+    double (*rotations)[2];   // Cosine and sine of each heading relative to the start heading
+} HeadingTable;
+
+typedef struct {  // Net result of drawing the expansion of a symbol, relative to where it starts
+    double dx, dy;            // Displacement if the expansion starts at the start heading
+    int turn;                 // Change of heading in half turns of the angle
+    long long lines;          // Number of lines drawn, saturated at LINE_COUNT_MAX
+    bool known;               // Whether the effect has been computed
+} Effect;
+
+typedef struct {  // Part of a split drawing
+    char symbol[2];           // Symbol whose expansion the part draws, as a string
+    int depth;                // Rewriting steps that produced the symbol
+    WalkState start;          // Turtle state where the part starts
+    int lineCount;            // Lines drawn by the part, once the budget is applied
+} Part;
+
+struct LSystemPlan {
+    Turtle turtle;            // Turtle the drawing starts from
+    HeadingTable headings;    // Directions of the headings
+    Part* parts;              // Parts in drawing order
+    int partCount;            // Number of parts
+    int partCapacity;         // Number of parts allocated
+    WalkState end;            // Turtle state after the last part was planned
+    bool endsInLastPart;      // Whether the budget cuts the last part, so the drawing ends where it does
+    bool truncated;           // Whether the budget cuts the drawing
+};
+
+typedef struct {  // Turtle state tracked by the planner, in double precision since it sums whole expansions
+    double x, y;              // Position
+    int heading;              // Heading in half turns of the angle from the start
+} PlanState;
+
+typedef struct {  // State of the planner
+    const LSystem* system;    // Definition being split
+    LSystemPlan* plan;        // Plan being built
+    Effect* effects;          // Effect of each symbol at each depth, computed on demand
+    long long threshold;      // Symbols drawing more lines than this are split into their rule
+    long long linesLeft;      // Lines left in the budget
+    PlanState state;          // Turtle state where the next symbol starts
+    PlanState* saved;         // States saved by top-level '['
+    int savedCount;           // Number of saved states
+    int savedCapacity;        // Number of saved states allocated
+    bool done;                // Whether the budget ended the plan
+} Planner;
+
+
+//==================== Function Definitions ====================
+static char* copy_string(const char* text) {
+/*
+ * copy_string - Allocates a copy of a string.
+ */
+
+    const size_t length = strlen(text);
+    char* copy = malloc(length + 1);
+    if (!copy) {
+        printf("Error allocating memory for an L-system!\n");
+        exit(1);
+    }
+    memcpy(copy, text, length + 1);
+    return copy;
+}
+
+
+static bool parse_number(const char* value, float* number) {
+/*
+ * parse_number - Converts a whole word to a number.
+ */
+
+    char* end = NULL;
+    *number = value ? strtof(value, &end) : 0.0f;
+    return value && end != value && *end == '\0';
+}
+
+
+static bool parse_count(const char* value, int* count) {
+/*
+ * parse_count - Converts a whole word to a count between 0 and INT_MAX.
+ */
+
+    char* end = NULL;
+    const long number = value ? strtol(value, &end, 10) : 0;
+    *count = (int)number;
+    return value && end != value && *end == '\0' && number >= 0 && number <= INT_MAX;
+}
+
+
+static void set_symbols(bool* symbols, const char* list) {
+/*
+ * set_symbols - Replaces a symbol set with the symbols of a string.
+ */
+
+    memset(symbols, 0, LSYSTEM_SYMBOLS * sizeof(bool));
+    for (const char* c = list; *c; c++) {
+        symbols[(unsigned char)*c] = true;
+    }
+}
+
+
+bool lsystem_parse(FILE* input, const char* name, LSystem* system) {
+/*
+ * lsystem_parse - Reads an L-system definition.
+ *
+ * Parameters:
+ *    input  - The stream to read.
+ *    name   - The name of the stream, used in error messages.
+ *    system - Receives the definition, to be released with lsystem_free even when parsing fails.
+ *
+ * Returns:
+ *    true if the definition is valid, false after reporting the first error.
+ */
+
+    memset(system, 0, sizeof(*system));
+    system->angle = DEFAULT_ANGLE;
+    system->step = DEFAULT_STEP;
+    system->depth = DEFAULT_DEPTH;
+    set_symbols(system->draws, "FG");
+    set_symbols(system->moves, "fg");
+
+    char text[LSYSTEM_LINE_LENGTH];
+    int lineNumber = 0;
+    while (fgets(text, sizeof(text), input)) {
+        lineNumber++;
+
+        char* comment = strchr(text, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        // A directive is a keyword followed by up to two words
+        char* words[3] = {NULL, NULL, NULL};
+        int wordCount = 0;
+        char* cursor = text;
+        while (wordCount < 3) {
+            cursor += strspn(cursor, " \t\r\n");
+            if (*cursor == '\0') {
+                break;
+            }
+            words[wordCount++] = cursor;
+            cursor += strcspn(cursor, " \t\r\n");
+            if (*cursor != '\0') {
+                *cursor++ = '\0';
+            }
+        }
+        if (wordCount == 0) {
+            continue;
+        }
+        cursor += strspn(cursor, " \t\r\n");
+        const bool extra = *cursor != '\0';
+
+        const char* keyword = words[0];
+        float number;
+        int count;
+        if (strcmp(keyword, "axiom") == 0 && wordCount == 2 && !extra) {
+            free(system->axiom);
+            system->axiom = copy_string(words[1]);
+        } else if (strcmp(keyword, "rule") == 0 && wordCount >= 2 && strlen(words[1]) == 1 && !extra) {
+            const unsigned char symbol = (unsigned char)words[1][0];
+            free(system->rules[symbol]);
+            system->rules[symbol] = copy_string(wordCount == 3 ? words[2] : "");
+        } else if (strcmp(keyword, "angle") == 0 && wordCount == 2 && !extra && parse_number(words[1], &number)) {
+            system->angle = number;
+        } else if (strcmp(keyword, "step") == 0 && wordCount == 2 && !extra && parse_number(words[1], &number)) {
+            system->step = number;
+        } else if (strcmp(keyword, "depth") == 0 && wordCount == 2 && !extra && parse_number(words[1], &number) &&
+                   number >= 0.0f && number <= LSYSTEM_MAX_DEPTH && number == floorf(number)) {
+            system->depth = (int)number;
+        } else if (strcmp(keyword, "budget") == 0 && wordCount == 2 && !extra && parse_count(words[1], &count)) {
+            system->budget = count;
+        } else if (strcmp(keyword, "draw") == 0 && wordCount <= 2 && !extra) {
+            set_symbols(system->draws, wordCount == 2 ? words[1] : "");
+        } else if (strcmp(keyword, "move") == 0 && wordCount <= 2 && !extra) {
+            set_symbols(system->moves, wordCount == 2 ? words[1] : "");
+        } else {
+            static const char* const keywords[] = {"axiom", "rule", "angle", "step", "depth", "budget", "draw", "move"};
+            bool known = false;
+            for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+                known = known || strcmp(keyword, keywords[i]) == 0;
+            }
+            printf(known ? "%s:%d: invalid arguments for '%s'\n" : "%s:%d: unknown directive '%s'\n", name,
+                   lineNumber, keyword);
+            return false;
+        }
+    }
+
+    if (ferror(input)) {
+        printf("Could not read %s\n", name);
+        return false;
+    }
+    if (!system->axiom) {
+        printf("%s: missing axiom\n", name);
+        return false;
+    }
+    return true;
+}
+
+
+void lsystem_free(LSystem* system) {
+/*
+ * lsystem_free - Releases the strings of a definition.
+ */
+
+    free(system->axiom);
+    system->axiom = NULL;
+    for (int i = 0; i < LSYSTEM_SYMBOLS; i++) {
+        free(system->rules[i]);
+        system->rules[i] = NULL;
+    }
+}
+
+
+static bool heading_table_init(HeadingTable* table, const float angle, const float startAngle) {
+/*
+ * heading_table_init - Computes the directions of every heading reachable with a turn angle.
+ *
+ * Headings are counted in half turns of the angle, so that '|' is a whole number of steps as well as '+'
+ * and '-'. There is no table if 360 degrees is not a whole number of turns, or if there would be too many
+ * headings to keep.
+ *
+ * Parameters:
+ *    table      - Receives the table, to be released with heading_table_free.
+ *    angle      - The turn angle in degrees.
+ *    startAngle - The heading the drawing starts at, in degrees.
+ *
+ * Returns:
+ *    true if there is a table, false otherwise.
+ */
+
+    table->size = 0;
+    table->directions = NULL;
+    table->rotations = NULL;
+
+    const float turns = 360.0f / fabsf(angle);
+    const float whole = roundf(turns);
+    if (!(whole >= 1.0f) || fabsf(turns - whole) > 1e-4f * whole || 2.0f * whole > HEADING_TABLE_SIZE) {
+        return false;
+    }
+
+    table->size = 2 * (int)whole;
+    table->directions = malloc((size_t)table->size * sizeof(*table->directions));
+    table->rotations = malloc((size_t)table->size * sizeof(*table->rotations));
+    if (!table->directions || !table->rotations) {
+        printf("Error allocating memory for an L-system heading table!\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < table->size; i++) {
+        const double relative = (double)i * angle / 2.0 * M_PI / 180.0;
+        const double heading = startAngle * M_PI / 180.0 + relative;
+        table->directions[i][0] = (float)cos(heading);
+        table->directions[i][1] = (float)-sin(heading);   // Negative due to coordinate system
+        table->rotations[i][0] = cos(relative);
+        table->rotations[i][1] = sin(relative);
+    }
+    return true;
+}
+
+
+static void heading_table_free(HeadingTable* table) {
+/*
+ * heading_table_free - Releases a heading table.
+ */
+
+    free(table->directions);
+    free(table->rotations);
+    table->directions = NULL;
+    table->rotations = NULL;
+    table->size = 0;
+}
+
+
+static float walk_angle(const LSystem* system, const HeadingTable* table, const float startAngle,
+                        const WalkState* state) {
+/*
+ * walk_angle - Converts the heading of a walk state to degrees.
+ */
+
+    if (!table->size) {
+        return state->angle;
+    }
+    return fmodf(startAngle + (float)state->heading * system->angle / 2.0f, 360.0f);
+}
+
+
+static int walk(const LSystem* system, const HeadingTable* table, const char* string, const int stringDepth,
+                const Turtle* turtle, WalkState* state, const int limit, const LineSink sink, void* context,
+                bool* truncated) {
+/*
+ * walk - Walks the expansion of a string, driving a turtle state.
+ *
+ * Parameters:
+ *    system      - The definition being drawn.
+ *    table       - The heading table of the drawing, empty to use movement_direction.
+ *    string      - The string to expand.
+ *    stringDepth - The number of rewriting steps that produced the string.
+ *    turtle      - The turtle drawing, for its color.
+ *    state       - The turtle state, updated as the walk goes.
+ *    limit       - Most lines drawn, 0 for no limit.
+ *    sink        - Receives every line drawn.
+ *    context     - Passed to `sink` unchanged.
+ *    truncated   - Receives whether the walk stopped at the limit.
+ *
+ * Returns:
+ *    The number of lines drawn.
+ */
+
+    movement_init();
+    ExpansionFrame frames[LSYSTEM_MAX_DEPTH + 1];
+    int top = 0;
+    frames[0] = (ExpansionFrame){string, stringDepth};
+
+    int savedCapacity = 64;
+    int savedCount = 0;
+    WalkState* saved = malloc((size_t)savedCapacity * sizeof(WalkState));
+    if (!saved) {
+        printf("Error allocating memory for an L-system walk!\n");
+        exit(1);
+    }
+
+    const int tableSize = table->size;
+    float x = state->x;
+    float y = state->y;
+    float angle = state->angle;
+    int heading = state->heading;
+    float dirX, dirY;
+    if (tableSize) {
+        dirX = table->directions[heading][0];
+        dirY = table->directions[heading][1];
+    } else {
+        movement_direction(angle, &dirX, &dirY);
+    }
+    const float step = system->step;
+    const int depth = system->depth;
+    int drawn = 0;
+    *truncated = false;
+
+    while (top >= 0) {
+        ExpansionFrame* frame = &frames[top];
+        const unsigned char symbol = (unsigned char)*frame->cursor;
+        if (symbol == '\0') {
+            top--;
+            continue;
+        }
+        frame->cursor++;
+
+        // Descend into the rule of the symbol until the expansion is deep enough
+        const char* rule = system->rules[symbol];
+        if (rule && frame->depth < depth) {
+            frames[++top] = (ExpansionFrame){rule, frame->depth + 1};
+            continue;
+        }
+
+        int turn = 0;   // Half turns of the angle made by this symbol
+        switch (symbol) {
+            case '+':
+                turn = 2;
+                break;
+            case '-':
+                turn = -2;
+                break;
+            case '|':
+                turn = tableSize / 2;
+                if (!tableSize) {
+                    angle = fmodf(angle + 180.0f, 360.0f);
+                    dirX = -dirX;
+                    dirY = -dirY;
+                }
+                break;
+            case '[':
+                if (savedCount == savedCapacity) {
+                    savedCapacity *= 2;
+                    WalkState* newSaved = realloc(saved, (size_t)savedCapacity * sizeof(WalkState));
+                    if (!newSaved) {
+                        printf("Error reallocating memory for an L-system walk!\n");
+                        exit(1);
+                    }
+                    saved = newSaved;
+                }
+                saved[savedCount++] = (WalkState){x, y, angle, heading};
+                break;
+            case ']':
+                if (savedCount > 0) {
+                    const WalkState* restored = &saved[--savedCount];
+                    x = restored->x;
+                    y = restored->y;
+                    angle = restored->angle;
+                    heading = restored->heading;
+                    if (tableSize) {
+                        dirX = table->directions[heading][0];
+                        dirY = table->directions[heading][1];
+                    } else {
+                        movement_direction(angle, &dirX, &dirY);
+                    }
+                }
+                break;
+            default:
+                if (system->draws[symbol] || system->moves[symbol]) {
+                    const float newX = x + step * dirX;
+                    const float newY = y + step * dirY;
+                    if (system->draws[symbol]) {
+                        if (limit && drawn == limit) {
+                            *truncated = true;
+                            top = -1;
+                            break;
+                        }
+                        const Line line = {x, y, newX, newY, turtle->r, turtle->g, turtle->b};
+                        sink(&line, context);
+                        drawn++;
+                    }
+                    x = newX;
+                    y = newY;
+                }
+                break;
+        }
+
+        if (turn && tableSize) {
+            heading = ((heading + turn) % tableSize + tableSize) % tableSize;
+            dirX = table->directions[heading][0];
+            dirY = table->directions[heading][1];
+        } else if (turn) {
+            angle = fmodf(angle + (float)(turn / 2) * system->angle, 360.0f);
+            movement_direction(angle, &dirX, &dirY);
+        }
+    }
+
+    *state = (WalkState){x, y, angle, heading};
+    free(saved);
+    return drawn;
+}
+
+
+int lsystem_run(const LSystem* system, Turtle* turtle, const LineSink sink, void* context, bool* truncated) {
+/*
+ * lsystem_run - Walks the expansion of an L-system, driving a turtle.
+ *
+ * The turtle draws with its own color and starts from its own position and heading. Symbols that move it
+ * forward ignore its pen state, which is left unchanged.
+ *
+ * Parameters:
+ *    system    - The definition to expand.
+ *    turtle    - The turtle to drive.
+ *    sink      - Receives every line drawn.
+ *    context   - Passed to `sink` unchanged.
+ *    truncated - Receives whether the walk stopped at the segment budget.
+ *
+ * Returns:
+ *    The number of lines drawn.
+ */
+
+    HeadingTable table;
+    heading_table_init(&table, system->angle, turtle->angle);
+
+    WalkState state = {turtle->x, turtle->y, turtle->angle, 0};
+    const int drawn = walk(system, &table, system->axiom, 0, turtle, &state, system->budget, sink, context,
+                           truncated);
+
+    turtle->x = state.x;
+    turtle->y = state.y;
+    turtle->angle = walk_angle(system, &table, turtle->angle, &state);
+    heading_table_free(&table);
+    return drawn;
+}
+
+
+static long long add_lines(const long long a, const long long b) {
+/*
+ * add_lines - Adds two line counts, saturating at LINE_COUNT_MAX.
+ */
+
+    return a > LINE_COUNT_MAX - b ? LINE_COUNT_MAX : a + b;
+}
+
+
+static void rotate(const HeadingTable* table, const int turn, const double x, const double y, double* outX,
+                   double* outY) {
+/*
+ * rotate - Turns a displacement by a number of half turns of the angle, the way the turtle turns.
+ */
+
+    const double c = table->rotations[turn][0];
+    const double s = table->rotations[turn][1];
+    *outX = x * c + y * s;
+    *outY = -x * s + y * c;
+}
+
+
+static const Effect* effect_of(Planner* planner, const unsigned char symbol, const int depth) {
+/*
+ * effect_of - Computes the net result of drawing a symbol found after `depth` rewriting steps.
+ *
+ * Effects compose: a rule's effect is the effects of its symbols, each turned by the heading reached
+ * before it. They are memoized per symbol and depth, so the work is proportional to the size of the rules
+ * times the depth, however many lines the expansion draws.
+ */
+
+    const LSystem* system = planner->system;
+    const HeadingTable* table = &planner->plan->headings;
+    Effect* effect = &planner->effects[depth * LSYSTEM_SYMBOLS + symbol];
+    if (effect->known) {
+        return effect;
+    }
+
+    Effect result = {0.0, 0.0, 0, 0, true};
+    const char* rule = system->rules[symbol];
+    if (rule && depth < system->depth) {
+        // Brackets are balanced within a rule, so a stack as deep as half the rule is enough
+        Effect* saved = malloc((strlen(rule) / 2 + 1) * sizeof(Effect));
+        int savedCount = 0;
+        if (!saved) {
+            printf("Error allocating memory for an L-system plan!\n");
+            exit(1);
+        }
+
+        for (const char* c = rule; *c; c++) {
+            if (*c == '[') {
+                saved[savedCount++] = result;
+            } else if (*c == ']') {
+                const long long lines = result.lines;
+                result = saved[--savedCount];
+                result.lines = lines;
+            } else {
+                const Effect* child = effect_of(planner, (unsigned char)*c, depth + 1);
+                double dx, dy;
+                rotate(table, result.turn, child->dx, child->dy, &dx, &dy);
+                result.dx += dx;
+                result.dy += dy;
+                result.turn = (result.turn + child->turn) % table->size;
+                result.lines = add_lines(result.lines, child->lines);
+            }
+        }
+        free(saved);
+    } else if (symbol == '+' || symbol == '-' || symbol == '|') {
+        result.turn = symbol == '+' ? 2 : symbol == '-' ? table->size - 2 : table->size / 2;
+    } else if (system->draws[symbol] || system->moves[symbol]) {
+        result.dx = system->step * table->directions[0][0];
+        result.dy = system->step * table->directions[0][1];
+        result.lines = system->draws[symbol] ? 1 : 0;
+    }
+
+    *effect = result;
+    return effect;
+}
+
+
+static void plan_symbol(Planner* planner, const unsigned char symbol, const int depth) {
+/*
+ * plan_symbol - Adds the parts drawing a symbol found after `depth` rewriting steps to the plan.
+ *
+ * A symbol drawing more lines than the threshold is split into the symbols of its rule, so parts stay
+ * small enough to balance the work between threads. The turtle state is advanced by each symbol's effect
+ * without walking it.
+ */
+
+    LSystemPlan* plan = planner->plan;
+    if (planner->done) {
+        return;
+    }
+
+    if (symbol == '[') {
+        if (planner->savedCount == planner->savedCapacity) {
+            planner->savedCapacity = planner->savedCapacity ? planner->savedCapacity * 2 : 64;
+            PlanState* newSaved = realloc(planner->saved, (size_t)planner->savedCapacity * sizeof(PlanState));
+            if (!newSaved) {
+                printf("Error reallocating memory for an L-system plan!\n");
+                exit(1);
+            }
+            planner->saved = newSaved;
+        }
+        planner->saved[planner->savedCount++] = planner->state;
+        return;
+    }
+    if (symbol == ']') {
+        if (planner->savedCount > 0) {
+            planner->state = planner->saved[--planner->savedCount];
+        }
+        return;
+    }
+
+    const Effect* effect = effect_of(planner, symbol, depth);
+    const char* rule = planner->system->rules[symbol];
+    if (effect->lines > planner->threshold && rule && depth < planner->system->depth) {
+        for (const char* c = rule; *c && !planner->done; c++) {
+            plan_symbol(planner, (unsigned char)*c, depth + 1);
+        }
+        return;
+    }
+
+    if (effect->lines > 0) {
+        // The drawing ends once the budget is spent
+        if (planner->linesLeft == 0) {
+            plan->truncated = true;
+            planner->done = true;
+            return;
+        }
+
+        if (plan->partCount == plan->partCapacity) {
+            plan->partCapacity = plan->partCapacity ? plan->partCapacity * 2 : 256;
+            Part* newParts = realloc(plan->parts, (size_t)plan->partCapacity * sizeof(Part));
+            if (!newParts) {
+                printf("Error reallocating memory for an L-system plan!\n");
+                exit(1);
+            }
+            plan->parts = newParts;
+        }
+
+        const long long lineCount = effect->lines < planner->linesLeft ? effect->lines : planner->linesLeft;
+        const WalkState start = {(float)planner->state.x, (float)planner->state.y, 0.0f, planner->state.heading};
+        plan->parts[plan->partCount++] = (Part){{(char)symbol, '\0'}, depth, start, (int)lineCount};
+        planner->linesLeft -= lineCount;
+        if (lineCount < effect->lines) {
+            plan->truncated = true;
+            plan->endsInLastPart = true;
+            planner->done = true;
+            return;
+        }
+    }
+
+    double dx, dy;
+    rotate(&plan->headings, planner->state.heading, effect->dx, effect->dy, &dx, &dy);
+    planner->state.x += dx;
+    planner->state.y += dy;
+    planner->state.heading = (planner->state.heading + effect->turn) % plan->headings.size;
+}
+
+
+static bool balanced(const char* string) {
+/*
+ * balanced - Tells whether the brackets of a string are balanced.
+ */
+
+    int depth = 0;
+    for (const char* c = string; *c && depth >= 0; c++) {
+        depth += (*c == '[') - (*c == ']');
+    }
+    return depth == 0;
+}
+
+
+LSystemPlan* lsystem_plan(const LSystem* system, const Turtle* turtle) {
+/*
+ * lsystem_plan - Splits a drawing into parts that can be drawn independently, in any order.
+ *
+ * Each part is the expansion of one symbol with the turtle state it starts from, found from the effects
+ * of the symbols before it rather than by walking them. The split only depends on the definition, so the
+ * parts and the lines they draw are the same whatever the number of threads drawing them. Positions may
+ * differ from a sequential walk by rounding, since they are reached by a different sum.
+ *
+ * A drawing can be split when its headings fit a table and its brackets are balanced within the axiom
+ * and within every rule, so that no part restores a state saved before it started.
+ *
+ * Parameters:
+ *    system - The definition to split.
+ *    turtle - The turtle the drawing starts from.
+ *
+ * Returns:
+ *    The plan, to be released with lsystem_plan_free, or NULL if the drawing cannot be split.
+ */
+
+    if (!balanced(system->axiom) || system->rules['['] || system->rules[']']) {
+        return NULL;
+    }
+    for (int i = 0; i < LSYSTEM_SYMBOLS; i++) {
+        if (system->rules[i] && !balanced(system->rules[i])) {
+            return NULL;
+        }
+    }
+
+    LSystemPlan* plan = calloc(1, sizeof(LSystemPlan));
+    if (!plan) {
+        printf("Error allocating memory for an L-system plan!\n");
+        exit(1);
+    }
+    plan->turtle = *turtle;
+    if (!heading_table_init(&plan->headings, system->angle, turtle->angle)) {
+        free(plan);
+        return NULL;
+    }
+
+    Planner planner = {0};
+    planner.system = system;
+    planner.plan = plan;
+    planner.effects = calloc((size_t)(system->depth + 1) * LSYSTEM_SYMBOLS, sizeof(Effect));
+    planner.state = (PlanState){turtle->x, turtle->y, 0};
+    if (!planner.effects) {
+        printf("Error allocating memory for an L-system plan!\n");
+        exit(1);
+    }
+
+    // Size the parts from the number of lines actually drawn
+    long long total = 0;
+    for (const char* c = system->axiom; *c; c++) {
+        total = add_lines(total, effect_of(&planner, (unsigned char)*c, 0)->lines);
+    }
+    // Line counts are ints everywhere else, so a drawing without a budget stops at INT_MAX lines
+    planner.linesLeft = system->budget ? system->budget : INT_MAX;
+    if (total > planner.linesLeft) {
+        total = planner.linesLeft;
+    }
+    planner.threshold = total / PART_TARGET_COUNT > PART_MIN_LINES ? total / PART_TARGET_COUNT : PART_MIN_LINES;
+
+    for (const char* c = system->axiom; *c && !planner.done; c++) {
+        plan_symbol(&planner, (unsigned char)*c, 0);
+    }
+    plan->end = (WalkState){(float)planner.state.x, (float)planner.state.y, 0.0f, planner.state.heading};
+
+    free(planner.effects);
+    free(planner.saved);
+    return plan;
+}
+
+
+int lsystem_plan_parts(const LSystemPlan* plan) {
+/*
+ * lsystem_plan_parts - Reports the number of parts of a plan.
+ */
+
+    return plan->partCount;
+}
+
+
+int lsystem_part_lines(const LSystemPlan* plan, const int part) {
+/*
+ * lsystem_part_lines - Reports the number of lines a part draws, so that its output can be sized up front.
+ */
+
+    return plan->parts[part].lineCount;
+}
+
+
+void lsystem_run_part(const LSystem* system, const LSystemPlan* plan, const int part, const LineSink sink,
+                      void* context, Turtle* end) {
+/*
+ * lsystem_run_part - Draws one part of a plan.
+ *
+ * Parts only read the definition and the plan, so any number of them can be drawn at once on different
+ * threads.
+ *
+ * Parameters:
+ *    system  - The definition the plan was made from.
+ *    plan    - The plan.
+ *    part    - The index of the part to draw.
+ *    sink    - Receives every line drawn.
+ *    context - Passed to `sink` unchanged.
+ *    end     - Receives the turtle where the part ends, or NULL.
+ */
+
+    const Part* drawn = &plan->parts[part];
+    WalkState state = drawn->start;
+    bool truncated;
+    walk(system, &plan->headings, drawn->symbol, drawn->depth, &plan->turtle, &state, drawn->lineCount, sink,
+         context, &truncated);
+
+    if (end) {
+        *end = plan->turtle;
+        end->x = state.x;
+        end->y = state.y;
+        end->angle = walk_angle(system, &plan->headings, plan->turtle.angle, &state);
+    }
+}
+
+
+bool lsystem_plan_end(const LSystem* system, const LSystemPlan* plan, const Turtle* lastPartEnd, Turtle* end) {
+/*
+ * lsystem_plan_end - Finds where the turtle stops once every part of a plan is drawn.
+ *
+ * Parameters:
+ *    system      - The definition the plan was made from.
+ *    plan        - The plan.
+ *    lastPartEnd - Where the last part ended, as reported by lsystem_run_part.
+ *    end         - Receives the final turtle.
+ *
+ * Returns:
+ *    true if the budget cut the drawing short, false otherwise.
+ */
+
+    if (plan->endsInLastPart) {
+        *end = *lastPartEnd;
+    } else {
+        *end = plan->turtle;
+        end->x = plan->end.x;
+        end->y = plan->end.y;
+        end->angle = walk_angle(system, &plan->headings, plan->turtle.angle, &plan->end);
+    }
+    return plan->truncated;
+}
+
+
+void lsystem_plan_free(LSystemPlan* plan) {
+/*
+ * lsystem_plan_free - Releases a plan.
+ *
+ * Parameters:
+ *    plan - The plan, or NULL.
+ */
+
+    if (!plan) {
+        return;
+    }
+    heading_table_free(&plan->headings);
+    free(plan->parts);
+    free(plan);
+}
+
+
+bool lsystem_file(const char* name) {
+/*
+ * lsystem_file - Tells whether a file holds an L-system definition rather than turtle commands.
+ *
+ * Returns:
+ *    true if the name ends in ".lsys", false otherwise.
+ */
+
+    const size_t length = strlen(name);
+    return length >= 5 && strcmp(name + length - 5, ".lsys") == 0;
+}
+
+
+bool run_lsystem_stream(FILE* input, const char* name, Turtle* turtle, const LineSink sink, void* context) {
+/*
+ * run_lsystem_stream - Reads an L-system definition and draws it.
+ *
+ * Parameters:
+ *    input   - The stream to read.
+ *    name    - The name of the stream, used in messages.
+ *    turtle  - The turtle to drive.
+ *    sink    - Receives every line drawn.
+ *    context - Passed to `sink` unchanged.
+ *
+ * Returns:
+ *    true if the definition was valid and drawn, even partly because of its budget, false otherwise.
+ */
+
+    LSystem system;
+    const bool parsed = lsystem_parse(input, name, &system);
+    if (parsed) {
+        bool truncated;
+        const int drawn = lsystem_run(&system, turtle, sink, context, &truncated);
+        if (truncated) {
+            printf("%s: stopped at the budget of %d lines\n", name, drawn);
+        }
+    }
+    lsystem_free(&system);
+    return parsed;
+}
@@ -30,9 +30,21 @@
  * along with dynamic changes to line color and pen state. The OpenGL context is set up
  * for 2D rendering, and SDL handles event management and window resizing.
  *
- * The main loop continuously handles user input, updates the scene, and renders the
- * turtle's movements and drawn lines. It also manages OpenGL context for smooth rendering
- * and provides real-time status information about the turtle's position and state.
+ * The main loop continuously handles user input and updates the turtle, while a separate
+ * render thread owns the OpenGL context and draws the turtle's movements and lines (see
+ * render.c); the two only communicate through a lock-free message queue. The turtle is
+ * simulated in fixed steps of 1/SIM_TICK_RATE seconds measured with the performance counter,
+ * so its path and the lines it draws are the same at any frame rate; frames draw the sprite
+ * interpolated between the last two steps. Between steps the main loop sleeps on the event
+ * queue, so input is handled as soon as it arrives whatever the render thread is doing. When profiling,
+ * the time spent handling events is sent to the render thread's profiler, which is written out on exit.
+ * The measured time and the events of every iteration can be recorded and played back (see replay.c),
+ * which reproduces a session exactly. The font and the sprite images are decoded on a worker thread started
+ * before the window is created, or read back from the asset cache (see assets.c), so the window opens
+ * without waiting for them. With --listen, other programs drive the turtle and receive its lines through the
+ * command server (see server.c), whose batches run between the simulation steps like a short script.
+ * With --stats, the telemetry counters of the line store and the GPU uploads are written out as JSON lines
+ * while the program runs (see stats.c).
  *
  * Key Features:
  * - Initialization of SDL, SDL_image, SDL_ttf, and OpenGL.
@@ -52,19 +64,41 @@
 //==================== Header Files ====================
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
 #include <stdio.h>
 #include <stdbool.h>
 
-#include "graphics.h"
+#include "assets.h"
+#include "camera.h"
+#include "canvas.h"
+#include "damage.h"
 #include "events.h"
+#include "generate.h"
+#include "graphics.h"
+#include "headless.h"
+#include "linestore.h"
+#include "logger.h"
+#include "lod.h"
+#include "movement.h"
+#include "options.h"
+#include "pacing.h"
+#include "profiler.h"
+#include "render.h"
+#include "replay.h"
+#include "server.h"
+#include "spatial.h"
 #include "sprite.h"
-#include "text.h"
+#include "stats.h"
 
 
 //==================== Macros ====================
 #define WINDOW_TITLE "Interactive C-Turtle Graphics"
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
+#define SIM_TICK_RATE 120                     // Simulation steps per second
+#define SIM_STEP (1.0 / SIM_TICK_RATE)        // Length of a simulation step in seconds
+#define SIM_MAX_FRAME_TIME 0.25               // Longest frame time the simulation catches up on
+#define SIM_IDLE_WAIT 1.0                     // Longest sleep while the turtle is at rest, in seconds
 
 
 //==================== Global Variables ====================
@@ -72,6 +106,34 @@ SDL_Window* window = NULL;            // SDL window pointer
 SDL_GLContext glContext;              // OpenGL context for rendering
 
 
+//==================== Function Definitions ====================
+static SDL_GLContext create_context(const int flags) {
+/*
+ * create_context - Creates the OpenGL context of the window, one that reports GPU resets if the driver can.
+ *
+ * A context that loses itself on a reset lets the render thread notice the loss and build a new one (see
+ * render.c). Drivers without robust contexts fail to create one, and get the usual context instead. The
+ * attributes of the context created are left set, so the render thread creates the same kind again.
+ *
+ * Parameters:
+ *    flags - The SDL_GL_CONTEXT_FLAGS wanted besides robustness.
+ *
+ * Returns:
+ *    The context, or NULL if none could be created.
+ */
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, flags | SDL_GL_CONTEXT_ROBUST_ACCESS_FLAG);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_RESET_NOTIFICATION, SDL_GL_CONTEXT_RESET_LOSE_CONTEXT);
+    SDL_GLContext context = SDL_GL_CreateContext(window);
+    if (!context) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, flags);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_RESET_NOTIFICATION, SDL_GL_CONTEXT_RESET_NO_NOTIFICATION);
+        context = SDL_GL_CreateContext(window);
+    }
+    return context;
+}
+
+
 //==================== Main ====================
 int main(int argc, char* argv[]) {
 
@@ -79,18 +141,59 @@ int main(int argc, char* argv[]) {
     int windowWidth = WINDOW_WIDTH;
     int windowHeight = WINDOW_HEIGHT;
 
+    // Parse command line options
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        return 1;
+    }
+
+    // Enable the profiler before the render thread starts using it
+    profiler_configure(options.profile || options.profileOut, options.profile, options.profileOut);
+
+    // Select how many workers draw the L-systems that can be split
+    generate_set_threads(options.threads);
+
+    // Headless mode renders command streams to PNG files without a window, an OpenGL context or a font
+    if (options.headless) {
+        int const imgFlags = IMG_INIT_PNG;
+        if (!(IMG_Init(imgFlags) & imgFlags)) {
+            printf("SDL_image could not initialize! IMG_Error: %s\n", IMG_GetError());
+            return 1;
+        }
+        int const status = run_headless(&options.headlessConfig);
+        IMG_Quit();
+        return status;
+    }
+
     // Initialize SDL and create window
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) > 0) {
         printf("Error initializing SDL: %s\n", SDL_GetError());
         return 1;
     }
 
-    // Request an OpenGL 2.1 context
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+    // Initialize SDL_image
+    int const imgFlags = IMG_INIT_PNG;
+    if (!(IMG_Init(imgFlags) & imgFlags)) {
+        printf("SDL_image could not initialize! IMG_Error: %s\n", IMG_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    // Initialize SDL_ttf
+    if (TTF_Init() == -1) {
+        printf("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
+        IMG_Quit();
+        SDL_Quit();
+        return 1;
+    }
 
-    // Request a compatibility profile
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+    // Decode the font and the sprite images while the window and its context are created
+    if (!assets_start(options.assetCache)) {
+        TTF_Quit();
+        IMG_Quit();
+        SDL_Quit();
+        return 1;
+    }
 
     // Create SDL window with OpenGL support and resizable flag
     window = SDL_CreateWindow(
@@ -104,55 +207,46 @@ int main(int argc, char* argv[]) {
 
     if (!window) {
         printf("Error creating window: %s\n", SDL_GetError());
+        assets_stop();
+        TTF_Quit();
+        IMG_Quit();
         SDL_Quit();
         return 1;
     }
 
-    // Create OpenGL context for rendering in the window
-    glContext = SDL_GL_CreateContext(window);
-    if (!glContext) {
-        printf("Error creating OpenGL context: %s\n", SDL_GetError());
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return 1;
-    }
-
-    // Initialize SDL_image
-    int const imgFlags = IMG_INIT_PNG;
-    if (!(IMG_Init(imgFlags) & imgFlags)) {
-        printf("SDL_image could not initialize! IMG_Error: %s\n", IMG_GetError());
-        SDL_GL_DeleteContext(glContext);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return 1;
+    // Create an OpenGL 3.3 core profile context for the shader backend when asked to
+    glContext = NULL;
+    if (options.coreProfile) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        glContext = create_context(SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+        if (!glContext) {
+            printf("OpenGL 3.3 core profile unavailable (%s), using the legacy renderer\n", SDL_GetError());
+        }
     }
 
-    // Initialize SDL_ttf
-    if (TTF_Init() == -1) {
-        printf("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
-        IMG_Quit();
-        SDL_GL_DeleteContext(glContext);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return 1;
+    // Otherwise request an OpenGL 2.1 context with a compatibility profile, drawn by the legacy renderer
+    if (!glContext) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+        glContext = create_context(0);
     }
-
-    // Initialize font
-    if (!init_font("./Fonts/DejaVuSansMNerdFont-Regular.ttf", 12)) {
+    if (!glContext) {
+        printf("Error creating OpenGL context: %s\n", SDL_GetError());
+        assets_stop();
         TTF_Quit();
         IMG_Quit();
-        SDL_GL_DeleteContext(glContext);
         SDL_DestroyWindow(window);
         SDL_Quit();
         return 1;
     }
 
-    // Initialize OpenGL
-    setup_opengl(windowWidth, windowHeight);
-
-    // Load sprite
-    if (!load_sprite("./Images/mateo.png")) {
-        close_font();
+    // Record the input, or play a recording back instead of it
+    if ((options.record && !replay_record(options.record)) ||
+        (options.replay && !replay_play(options.replay, window))) {
+        assets_stop();
         TTF_Quit();
         IMG_Quit();
         SDL_GL_DeleteContext(glContext);
@@ -161,6 +255,13 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // Initialize the line store; from here on it belongs to the render thread
+    line_store_init(options.lineStoreMode);
+    line_store_set_limit(options.lineMemoryCap, options.lineCapPolicy);
+    spatial_init();
+    lod_init();
+    camera_init(windowWidth, windowHeight);
+
     // Initialize sprite properties
     sprite.x = (float)windowWidth / 2.0f;
     sprite.y = (float)windowHeight / 2.0f;
@@ -169,28 +270,106 @@ int main(int argc, char* argv[]) {
     sprite.r = 0.0f;
     sprite.g = 0.0f;
     sprite.b = 0.0f;
+    previousSprite = sprite;
+    movement_init();
+
+    // Hand the OpenGL context to the render thread, which sets up OpenGL and uploads the assets once decoded
+    lineWidth = options.lineWidth;
+    damage_configure(options.partialRedraw);
+    canvas_configure(options.tiledCanvas, options.tileBudget);
+    if (!render_start(window, glContext, windowWidth, windowHeight, options.pacing, options.save)) {
+        replay_close();
+        line_store_free();
+        spatial_free();
+        lod_free();
+        assets_stop();
+        TTF_Quit();
+        IMG_Quit();
+        SDL_GL_DeleteContext(glContext);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+    // Status messages from now on are printed by the logger's thread, so the main loop never waits for stdout
+    logger_start();
+
+    // Start drawing the startup script, if any; its lines are sent over the first iterations as they are generated
+    if (options.script) {
+        run_script(options.script);
+    }
 
-    // Main loop
-    bool running = true;
+    // Listen for command clients and write the telemetry counters, if asked to; the program ends at once if it cannot
+    bool running = (!options.listen || server_start(options.listen)) &&
+                   (!options.stats || stats_start(options.stats, options.statsInterval));
+
+    // Main loop: the simulation advances in fixed steps and sends its results to the render thread, which
+    // draws frames at its own pace
+    const double counterFrequency = (double)SDL_GetPerformanceFrequency();
+    Uint64 lastCounter = SDL_GetPerformanceCounter();
+    double accumulator = 0.0;
     while (running) {
-        // Calculate deltaTime
-        static Uint32 lastTime = 0;
-        Uint32 const currentTime = SDL_GetTicks();
-        float const deltaTime = (float)(currentTime - lastTime) / 1000.0f; // Convert milliseconds to seconds
-        lastTime = currentTime;
+        // Measure the real time elapsed since the previous iteration, or take the recorded one
+        const Uint64 currentCounter = SDL_GetPerformanceCounter();
+        double frameTime = replay_frame_time((double)(currentCounter - lastCounter) / counterFrequency);
+        lastCounter = currentCounter;
+
+        // After a stall (dragging the window, a debugger break), drop the backlog instead of catching up
+        if (frameTime > SIM_MAX_FRAME_TIME) {
+            frameTime = SIM_MAX_FRAME_TIME;
+        }
+        accumulator += frameTime;
 
         // Handle events
-        running = handle_events(deltaTime, &windowWidth, &windowHeight);
+        running = handle_events(&windowWidth, &windowHeight);
+        if (profiler_enabled()) {
+            render_send_timing(PROFILE_EVENTS,
+                               (double)(SDL_GetPerformanceCounter() - currentCounter) / counterFrequency);
+        }
+
+        // Advance the simulation by as many fixed steps as have elapsed
+        while (accumulator >= SIM_STEP) {
+            update_simulation((float)SIM_STEP);
+            accumulator -= SIM_STEP;
+        }
+
+        // Send the lines the script's workers have generated since the previous iteration
+        poll_script();
+
+        // Run the command batches clients of the command server have sent
+        poll_remote();
 
-        // Render scene
-        render_scene(windowWidth, windowHeight);
+        // Publish this iteration to the render thread, with the time the last step stands for
+        const Uint64 stepCounter = currentCounter - (Uint64)(accumulator * counterFrequency);
+        render_send_sprite(&sprite, &previousSprite, stepCounter, (float)SIM_STEP);
+        render_flush();
+        server_flush();
 
-        // Swap buffers to display the current frame
-        SDL_GL_SwapWindow(window);
+        // Sleep until input arrives or the next step is due; a turtle at rest only wakes up for input
+        if (!running) {
+            break;
+        }
+        if (simulation_active()) {
+            pacing_wait_for_input(SIM_STEP - accumulator);
+        } else {
+            pacing_wait_for_input(SIM_IDLE_WAIT);
+            lastCounter = SDL_GetPerformanceCounter();
+            accumulator = 0.0;
+        }
     }
 
     // Cleanup
-    close_font();
+    stop_script();
+    server_stop();
+    replay_close();
+    glContext = render_stop();
+    stats_stop();
+    logger_stop();
+    profiler_dump();
+    line_store_free();
+    spatial_free();
+    lod_free();
+    assets_stop();
     TTF_Quit();
     IMG_Quit();
 
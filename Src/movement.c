@@ -0,0 +1,239 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * movement.c - Direction lookup and batched end point computation for turtle moves.
+ *
+ * Headings are in degrees, counterclockwise from east, with y growing downward on screen, so a heading
+ * h faces (cos h, -sin h). Most drawings only ever face a few headings: right angles, multiples of 60
+ * degrees, or some other whole or quarter degree. The direction of every quarter-degree heading is
+ * computed once, in double precision and folded from the first quadrant, so the axes are exact and a
+ * path of right-angle turns stays on its integer grid. Any other heading falls back to cosf and sinf.
+ *
+ * movement_batch takes a sequence of moves as separate arrays of headings and distances and writes the
+ * position after each move. It runs one of the vector kernels of movement_lanes.c, which look up and scale
+ * several directions at once and perform exactly the operations of movement_batch_scalar, kept here as the
+ * reference, so every kernel produces the same bits. The kernel is chosen once, when the table is built:
+ * builds with run-time dispatch ask the CPU for AVX2, SSE2 or NEON and take the best variant compiled, so
+ * one binary is fast on every machine, and other builds take the kernel compiled for the compiler's
+ * target. The file is compiled without floating-point contraction, like the kernels.
+ *
+ * Key functions:
+ *    - movement_init: Builds the direction table.
+ *    - movement_direction: Looks up or computes a direction.
+ *    - movement_batch / movement_batch_scalar: Compute the end points of a sequence of moves.
+ *    - movement_kernel_name: Names the kernel movement_batch runs.
+ */
+
+
+//==================== Header Files ====================
+#include "movement.h"
+#include "movement_kernels.h"
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+
+
+//==================== Macros ====================
+#define TABLE_STEPS_PER_DEGREE MOVEMENT_TABLE_STEPS_PER_DEGREE
+#define TABLE_QUADRANT (90 * TABLE_STEPS_PER_DEGREE)  // Table entries per quadrant
+#define TABLE_SIZE MOVEMENT_TABLE_SIZE
+#define DEGREES_TO_RADIANS ((float)M_PI / 180.0f)
+
+
+//==================== Global Variables ====================
+float movementTableX[TABLE_SIZE];   // Direction of each quarter-degree heading
+float movementTableY[TABLE_SIZE];
+static SDL_atomic_t tableState;     // 0 before movement_init, 1 while the table is built, 2 once it is ready
+static MovementKernel batchKernel = movement_batch_scalar; // Kernel movement_batch runs, chosen by movement_init
+static const char* kernelName = "scalar";
+
+
+//==================== Function Definitions ====================
+static void select_kernel(void) {
+/*
+ * select_kernel - Chooses the fastest movement_batch kernel the CPU runs.
+ *
+ * With run-time dispatch (MOVEMENT_HAVE_AVX2, MOVEMENT_HAVE_SSE2 or MOVEMENT_HAVE_NEON, defined by the CMake
+ * build for the variants it compiles), the CPU is asked which instruction sets it has. Otherwise the single
+ * kernel compiled for the compiler's target is used.
+ */
+
+#if defined(MOVEMENT_HAVE_AVX2) || defined(MOVEMENT_HAVE_SSE2) || defined(MOVEMENT_HAVE_NEON)
+#if defined(MOVEMENT_HAVE_AVX2)
+    if (SDL_HasAVX2()) {
+        batchKernel = movement_batch_avx2;
+        kernelName = "avx2";
+        return;
+    }
+#endif
+#if defined(MOVEMENT_HAVE_SSE2)
+    if (SDL_HasSSE2()) {
+        batchKernel = movement_batch_sse2;
+        kernelName = "sse2";
+        return;
+    }
+#endif
+#if defined(MOVEMENT_HAVE_NEON)
+    if (SDL_HasNEON()) {
+        batchKernel = movement_batch_neon;
+        kernelName = "neon";
+        return;
+    }
+#endif
+#else
+    batchKernel = movement_batch_native;
+    kernelName = "native";
+#endif
+}
+
+
+void movement_init(void) {
+/*
+ * movement_init - Builds the direction table, the first time it is called.
+ *
+ * Generation workers may call this at the same time; one of them builds the table and chooses the kernel
+ * of movement_batch, and the others wait for it.
+ */
+
+    if (SDL_AtomicGet(&tableState) == 2) {
+        return;
+    }
+    if (!SDL_AtomicCAS(&tableState, 0, 1)) {
+        while (SDL_AtomicGet(&tableState) != 2) {
+            SDL_Delay(0);
+        }
+        return;
+    }
+
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        // Fold into the first quadrant, where both components are exact at its start
+        const int step = i % TABLE_QUADRANT;
+        const double radians = (double)step / TABLE_STEPS_PER_DEGREE * (M_PI / 180.0);
+        const float c = step == 0 ? 1.0f : (float)cos(radians);
+        const float s = step == 0 ? 0.0f : (float)sin(radians);
+        const float cosines[4] = {c, -s, -c, s};
+        const float sines[4] = {s, c, -s, -c};
+        movementTableX[i] = cosines[i / TABLE_QUADRANT];
+        movementTableY[i] = -sines[i / TABLE_QUADRANT];   // Negative due to coordinate system
+    }
+    select_kernel();
+
+    SDL_AtomicSet(&tableState, 2);
+}
+
+
+static inline int table_index(const float angle) {
+/*
+ * table_index - Returns the direction table entry of a heading, or -1 when it is off the quarter-degree grid.
+ */
+
+    const float scaled = angle * TABLE_STEPS_PER_DEGREE;
+    if (!(scaled > -TABLE_SIZE && scaled < TABLE_SIZE)) {
+        return -1;
+    }
+    const int index = (int)scaled;
+    if ((float)index != scaled) {
+        return -1;
+    }
+    return index < 0 ? index + TABLE_SIZE : index;
+}
+
+
+void movement_direction(const float angle, float* dirX, float* dirY) {
+/*
+ * movement_direction - Returns the unit direction a heading faces.
+ *
+ * movement_init must have been called.
+ *
+ * Parameters:
+ *    angle      - The heading in degrees, counterclockwise from east.
+ *    dirX, dirY - Receive the direction, with y growing downward.
+ */
+
+    const int index = table_index(angle);
+    if (index >= 0) {
+        *dirX = movementTableX[index];
+        *dirY = movementTableY[index];
+    } else {
+        *dirX = cosf(angle * DEGREES_TO_RADIANS);
+        *dirY = -sinf(angle * DEGREES_TO_RADIANS);   // Negative due to coordinate system
+    }
+}
+
+
+void movement_batch_scalar(const float* headings, const float* distances, const int count, float x, float y,
+                           float* xs, float* ys) {
+/*
+ * movement_batch_scalar - Computes the end points of a sequence of moves, one move at a time.
+ *
+ * This is the reference for movement_batch, which must produce the same results.
+ *
+ * Parameters:
+ *    headings  - The heading of each move, in degrees.
+ *    distances - The length of each move, negative to move backward.
+ *    count     - The number of moves.
+ *    x, y      - The position before the first move.
+ *    xs, ys    - Receive the position after each move.
+ */
+
+    movement_init();
+    for (int i = 0; i < count; i++) {
+        float dirX, dirY;
+        movement_direction(headings[i], &dirX, &dirY);
+        const float stepX = distances[i] * dirX;
+        const float stepY = distances[i] * dirY;
+        x += stepX;
+        y += stepY;
+        xs[i] = x;
+        ys[i] = y;
+    }
+}
+
+
+void movement_batch(const float* headings, const float* distances, const int count, const float x, const float y,
+                    float* xs, float* ys) {
+/*
+ * movement_batch - Computes the end points of a sequence of moves.
+ *
+ * Runs the kernel movement_init chose for this CPU. The results are identical to those of
+ * movement_batch_scalar.
+ *
+ * Parameters:
+ *    headings  - The heading of each move, in degrees.
+ *    distances - The length of each move, negative to move backward.
+ *    count     - The number of moves.
+ *    x, y      - The position before the first move.
+ *    xs, ys    - Receive the position after each move.
+ */
+
+    movement_init();
+    batchKernel(headings, distances, count, x, y, xs, ys);
+}
+
+
+const char* movement_kernel_name(void) {
+/*
+ * movement_kernel_name - Names the kernel movement_batch runs, e.g. for the benchmark report.
+ */
+
+    movement_init();
+    return kernelName;
+}
@@ -0,0 +1,189 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * movement_lanes.c - Vector kernels computing the end points of a sequence of moves.
+ *
+ * This is movement_batch for one instruction set. It looks up the directions of four (SSE2, NEON) or
+ * eight (AVX2) moves at once and scales them by their distances; lanes with headings off the table take
+ * the scalar fallback. Positions are then summed in order, one move after the other, because summing them
+ * in a different order would round differently. Both steps perform exactly the operations of
+ * movement_batch_scalar, so every variant produces the same bits and one may replace another on any machine.
+ *
+ * The instruction set is the one the file is compiled for, and MOVEMENT_KERNEL names the function. The
+ * CMake build compiles the file once per variant, with -mavx2 as movement_batch_avx2 for instance, and
+ * movement.c dispatches between them at run time (see movement_kernels.h). Like movement.c, the file is
+ * compiled without floating-point contraction.
+ *
+ * Key functions:
+ *    - MOVEMENT_KERNEL: Computes the end points of a sequence of moves, MOVEMENT_LANES at a time.
+ */
+
+
+//==================== Header Files ====================
+#include "movement.h"
+#include "movement_kernels.h"
+
+#include <stdbool.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MOVEMENT_LANES 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MOVEMENT_LANES 4
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MOVEMENT_LANES 4
+#else
+#define MOVEMENT_LANES 1
+#endif
+
+
+//==================== Macros ====================
+#ifndef MOVEMENT_KERNEL
+#define MOVEMENT_KERNEL movement_batch_native   // Name of the variant this file defines
+#endif
+
+
+//==================== Function Definitions ====================
+#if MOVEMENT_LANES > 1
+static void lane_steps(const float* headings, const float* distances, float* stepX, float* stepY) {
+/*
+ * lane_steps - Computes the displacements of MOVEMENT_LANES moves at once.
+ *
+ * The table indices are computed for all lanes together; when every heading is on the table the
+ * directions are gathered and scaled in vector registers, otherwise each lane is finished on its own.
+ *
+ * Parameters:
+ *    headings  - The headings of the moves.
+ *    distances - The lengths of the moves.
+ *    stepX     - Receives the displacement of each move along x.
+ *    stepY     - Receives the displacement of each move along y.
+ */
+
+    int indices[MOVEMENT_LANES];
+    bool onTable;
+
+#if defined(__AVX2__)
+    const __m256 scaled = _mm256_mul_ps(_mm256_loadu_ps(headings),
+                                        _mm256_set1_ps((float)MOVEMENT_TABLE_STEPS_PER_DEGREE));
+    const __m256 limit = _mm256_set1_ps((float)MOVEMENT_TABLE_SIZE);
+    const __m256i index = _mm256_cvttps_epi32(scaled);
+    const __m256 exact = _mm256_and_ps(
+        _mm256_cmp_ps(_mm256_cvtepi32_ps(index), scaled, _CMP_EQ_OQ),
+        _mm256_and_ps(_mm256_cmp_ps(scaled, limit, _CMP_LT_OQ),
+                      _mm256_cmp_ps(scaled, _mm256_sub_ps(_mm256_setzero_ps(), limit), _CMP_GT_OQ)));
+    onTable = _mm256_movemask_ps(exact) == 0xFF;
+    const __m256i wrapped = _mm256_add_epi32(index, _mm256_and_si256(_mm256_srai_epi32(index, 31),
+                                                                    _mm256_set1_epi32(MOVEMENT_TABLE_SIZE)));
+    if (onTable) {
+        const __m256 distance = _mm256_loadu_ps(distances);
+        _mm256_storeu_ps(stepX, _mm256_mul_ps(distance, _mm256_i32gather_ps(movementTableX, wrapped, 4)));
+        _mm256_storeu_ps(stepY, _mm256_mul_ps(distance, _mm256_i32gather_ps(movementTableY, wrapped, 4)));
+        return;
+    }
+    _mm256_storeu_si256((__m256i*)indices, wrapped);
+#elif defined(__SSE2__)
+    const __m128 scaled = _mm_mul_ps(_mm_loadu_ps(headings), _mm_set1_ps((float)MOVEMENT_TABLE_STEPS_PER_DEGREE));
+    const __m128 limit = _mm_set1_ps((float)MOVEMENT_TABLE_SIZE);
+    const __m128i index = _mm_cvttps_epi32(scaled);
+    const __m128 exact = _mm_and_ps(_mm_cmpeq_ps(_mm_cvtepi32_ps(index), scaled),
+                                    _mm_and_ps(_mm_cmplt_ps(scaled, limit),
+                                               _mm_cmpgt_ps(scaled, _mm_sub_ps(_mm_setzero_ps(), limit))));
+    onTable = _mm_movemask_ps(exact) == 0xF;
+    const __m128i wrapped = _mm_add_epi32(index, _mm_and_si128(_mm_srai_epi32(index, 31),
+                                                               _mm_set1_epi32(MOVEMENT_TABLE_SIZE)));
+    _mm_storeu_si128((__m128i*)indices, wrapped);
+    if (onTable) {
+        const __m128 distance = _mm_loadu_ps(distances);
+        const __m128 dirX = _mm_setr_ps(movementTableX[indices[0]], movementTableX[indices[1]],
+                                        movementTableX[indices[2]], movementTableX[indices[3]]);
+        const __m128 dirY = _mm_setr_ps(movementTableY[indices[0]], movementTableY[indices[1]],
+                                        movementTableY[indices[2]], movementTableY[indices[3]]);
+        _mm_storeu_ps(stepX, _mm_mul_ps(distance, dirX));
+        _mm_storeu_ps(stepY, _mm_mul_ps(distance, dirY));
+        return;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t scaled = vmulq_n_f32(vld1q_f32(headings), (float)MOVEMENT_TABLE_STEPS_PER_DEGREE);
+    const float32x4_t limit = vdupq_n_f32((float)MOVEMENT_TABLE_SIZE);
+    const int32x4_t index = vcvtq_s32_f32(scaled);
+    const uint32x4_t exact = vandq_u32(vceqq_f32(vcvtq_f32_s32(index), scaled),
+                                       vandq_u32(vcltq_f32(scaled, limit), vcgtq_f32(scaled, vnegq_f32(limit))));
+    onTable = vminvq_u32(exact) != 0;
+    const int32x4_t wrapped = vaddq_s32(index, vandq_s32(vshrq_n_s32(index, 31), vdupq_n_s32(MOVEMENT_TABLE_SIZE)));
+    vst1q_s32(indices, wrapped);
+    if (onTable) {
+        const float32x4_t distance = vld1q_f32(distances);
+        const float gatheredX[4] = {movementTableX[indices[0]], movementTableX[indices[1]],
+                                    movementTableX[indices[2]], movementTableX[indices[3]]};
+        const float gatheredY[4] = {movementTableY[indices[0]], movementTableY[indices[1]],
+                                    movementTableY[indices[2]], movementTableY[indices[3]]};
+        vst1q_f32(stepX, vmulq_f32(distance, vld1q_f32(gatheredX)));
+        vst1q_f32(stepY, vmulq_f32(distance, vld1q_f32(gatheredY)));
+        return;
+    }
+#endif
+
+    // Some heading is off the table: finish lane by lane as the reference does
+    (void)indices;
+    for (int lane = 0; lane < MOVEMENT_LANES; lane++) {
+        float dirX, dirY;
+        movement_direction(headings[lane], &dirX, &dirY);
+        stepX[lane] = distances[lane] * dirX;
+        stepY[lane] = distances[lane] * dirY;
+    }
+}
+#endif
+
+
+
+void MOVEMENT_KERNEL(const float* headings, const float* distances, const int count, float x, float y,
+                     float* xs, float* ys) {
+/*
+ * MOVEMENT_KERNEL - Computes the end points of a sequence of moves, MOVEMENT_LANES moves at a time.
+ *
+ * movement_init must have been called. The results are identical to those of movement_batch_scalar.
+ *
+ * Parameters:
+ *    headings  - The heading of each move, in degrees.
+ *    distances - The length of each move, negative to move backward.
+ *    count     - The number of moves.
+ *    x, y      - The position before the first move.
+ *    xs, ys    - Receive the position after each move.
+ */
+
+    int done = 0;
+
+#if MOVEMENT_LANES > 1
+    for (; done + MOVEMENT_LANES <= count; done += MOVEMENT_LANES) {
+        float stepX[MOVEMENT_LANES], stepY[MOVEMENT_LANES];
+        lane_steps(&headings[done], &distances[done], stepX, stepY);
+        for (int lane = 0; lane < MOVEMENT_LANES; lane++) {
+            x += stepX[lane];
+            y += stepY[lane];
+            xs[done + lane] = x;
+            ys[done + lane] = y;
+        }
+    }
+#endif
+
+    movement_batch_scalar(&headings[done], &distances[done], count - done, x, y, &xs[done], &ys[done]);
+}
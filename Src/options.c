@@ -0,0 +1,367 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * options.c - Command line parsing.
+ *
+ * Every option has a default that reproduces the program's behavior without it, so running the program
+ * without arguments opens the interactive window as it always has. Arguments that are not options are the
+ * command streams rendered in headless mode.
+ *
+ * Key functions:
+ *    - parse_options: Fills an Options struct from the command line.
+ */
+
+
+//==================== Header Files ====================
+#include "options.h"
+#include "session.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define DEFAULT_IMAGE_SIZE 800    // Width and height of headless images, matching the initial window
+#define DEFAULT_ASSET_CACHE "./Cache" // Directory of the decoded font and sprites
+#define DEFAULT_TILE_BUDGET 64    // Megabytes of tiles the tiled canvas keeps
+#define DEFAULT_STATS_INTERVAL 1.0 // Seconds between two lines of telemetry counters
+
+
+//==================== Function Definitions ====================
+static void print_usage(const char* program) {
+/*
+ * print_usage - Prints the command line syntax.
+ */
+
+    printf("Usage: %s [--compact-lines] [--line-memory-cap MB] [--line-cap-policy stop|flatten|spill]\n"
+           "       [--vsync off|on|adaptive] [--fps-cap FPS] [--idle] [--script FILE]\n"
+           "       [--threads N] [--save FILE.session] [--profile] [--profile-out FILE.csv|FILE.json]\n"
+           "       [--record FILE | --replay FILE] [--gl legacy|core] [--line-width PX] [--asset-cache DIR|off]\n"
+           "       [--partial-redraw] [--canvas window|tiled] [--tile-budget MB]\n"
+           "       [--listen [HOST:]PORT|unix:PATH] [--stats FILE|-] [--stats-interval SECONDS]\n"
+           "   or: %s --headless [--size WxH] [--format png|svg|pdf] [--output DIR] [--threads N] FILE...\n",
+           program, program);
+}
+
+
+static bool has_suffix(const char* text, const char* suffix) {
+/*
+ * has_suffix - Returns whether a string ends with another.
+ */
+
+    const size_t length = strlen(text);
+    const size_t suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+
+static bool parse_choice(const char* value, const char* const* names, const int count, int* choice) {
+/*
+ * parse_choice - Finds a value in a list of accepted names.
+ *
+ * Returns:
+ *    true and the index in `choice` if the value is accepted, false otherwise.
+ */
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            *choice = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool parse_options(const int argc, char* argv[], Options* options) {
+/*
+ * parse_options - Parses the command line.
+ *
+ * Parameters:
+ *    argc, argv - The arguments passed to main.
+ *    options    - Receives the settings; options that are not given keep their default.
+ *
+ * Returns:
+ *    true if the command line is valid, false after printing the error and the usage.
+ */
+
+    static const char* const policyNames[] = {"stop", "flatten", "spill"};
+    static const LineLimitPolicy policies[] = {LINE_LIMIT_STOP, LINE_LIMIT_FLATTEN, LINE_LIMIT_SPILL};
+    static const char* const vsyncNames[] = {"off", "on", "adaptive"};
+    static const VsyncMode vsyncModes[] = {VSYNC_OFF, VSYNC_ON, VSYNC_ADAPTIVE};
+    static const char* const outputNames[] = {"png", "svg", "pdf"};
+    static const HeadlessOutput outputs[] = {HEADLESS_PNG, HEADLESS_SVG, HEADLESS_PDF};
+    static const char* const backendNames[] = {"legacy", "core"};
+    static const char* const canvasNames[] = {"window", "tiled"};
+
+    *options = (Options){
+        .lineStoreMode = LINE_STORE_FULL,
+        .lineMemoryCap = 0,
+        .lineCapPolicy = LINE_LIMIT_FLATTEN,
+        .pacing = {VSYNC_ON, 0, false},
+        .script = NULL,
+        .save = NULL,
+        .threads = 0,
+        .profile = false,
+        .profileOut = NULL,
+        .record = NULL,
+        .replay = NULL,
+        .coreProfile = false,
+        .lineWidth = 1.0f,
+        .assetCache = DEFAULT_ASSET_CACHE,
+        .partialRedraw = false,
+        .tiledCanvas = false,
+        .tileBudget = (size_t)DEFAULT_TILE_BUDGET * 1024 * 1024,
+        .listen = NULL,
+        .stats = NULL,
+        .statsInterval = DEFAULT_STATS_INTERVAL,
+        .headless = false,
+        .headlessConfig = {DEFAULT_IMAGE_SIZE, DEFAULT_IMAGE_SIZE, HEADLESS_PNG, ".", NULL, 0}
+    };
+
+    // Inputs are collected in place at the front of argv, which outlives the options
+    char** inputs = argv + 1;
+    int inputCount = 0;
+    int choice;
+    bool assetCacheGiven = false;
+    bool tileBudgetGiven = false;
+    bool statsIntervalGiven = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (strcmp(option, "--compact-lines") == 0) {
+            options->lineStoreMode = LINE_STORE_COMPACT;
+        } else if (strcmp(option, "--line-memory-cap") == 0 && hasValue && atoi(argv[i + 1]) > 0) {
+            options->lineMemoryCap = (size_t)atoi(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(option, "--line-cap-policy") == 0 && hasValue) {
+            if (!parse_choice(argv[++i], policyNames, 3, &choice)) {
+                printf("Unknown line cap policy: %s\n", argv[i]);
+                return false;
+            }
+            options->lineCapPolicy = policies[choice];
+        } else if (strcmp(option, "--vsync") == 0 && hasValue) {
+            if (!parse_choice(argv[++i], vsyncNames, 3, &choice)) {
+                printf("Unknown vsync mode: %s\n", argv[i]);
+                return false;
+            }
+            options->pacing.vsync = vsyncModes[choice];
+        } else if (strcmp(option, "--fps-cap") == 0 && hasValue && atoi(argv[i + 1]) > 0) {
+            options->pacing.fpsCap = atoi(argv[++i]);
+        } else if (strcmp(option, "--idle") == 0) {
+            options->pacing.idle = true;
+        } else if (strcmp(option, "--script") == 0 && hasValue) {
+            options->script = argv[++i];
+        } else if (strcmp(option, "--save") == 0 && hasValue) {
+            options->save = argv[++i];
+        } else if (strcmp(option, "--threads") == 0 && hasValue && atoi(argv[i + 1]) > 0) {
+            options->threads = atoi(argv[++i]);
+        } else if (strcmp(option, "--profile") == 0) {
+            options->profile = true;
+        } else if (strcmp(option, "--profile-out") == 0 && hasValue) {
+            options->profileOut = argv[++i];
+        } else if (strcmp(option, "--record") == 0 && hasValue) {
+            options->record = argv[++i];
+        } else if (strcmp(option, "--replay") == 0 && hasValue) {
+            options->replay = argv[++i];
+        } else if (strcmp(option, "--gl") == 0 && hasValue) {
+            if (!parse_choice(argv[++i], backendNames, 2, &choice)) {
+                printf("Unknown OpenGL backend: %s\n", argv[i]);
+                return false;
+            }
+            options->coreProfile = choice == 1;
+        } else if (strcmp(option, "--line-width") == 0 && hasValue) {
+            const float width = (float)atof(argv[++i]);
+            if (!(width >= 1.0f && width <= 64.0f)) {
+                printf("Line widths go from 1 to 64 pixels: %s\n", argv[i]);
+                return false;
+            }
+            options->lineWidth = width;
+        } else if (strcmp(option, "--asset-cache") == 0 && hasValue) {
+            options->assetCache = strcmp(argv[++i], "off") == 0 ? NULL : argv[i];
+            assetCacheGiven = true;
+        } else if (strcmp(option, "--partial-redraw") == 0) {
+            options->partialRedraw = true;
+        } else if (strcmp(option, "--canvas") == 0 && hasValue) {
+            if (!parse_choice(argv[++i], canvasNames, 2, &choice)) {
+                printf("Unknown canvas: %s\n", argv[i]);
+                return false;
+            }
+            options->tiledCanvas = choice == 1;
+        } else if (strcmp(option, "--tile-budget") == 0 && hasValue && atoi(argv[i + 1]) > 0) {
+            options->tileBudget = (size_t)atoi(argv[++i]) * 1024 * 1024;
+            tileBudgetGiven = true;
+        } else if (strcmp(option, "--listen") == 0 && hasValue) {
+            options->listen = argv[++i];
+        } else if (strcmp(option, "--stats") == 0 && hasValue) {
+            options->stats = argv[++i];
+        } else if (strcmp(option, "--stats-interval") == 0 && hasValue && atof(argv[i + 1]) > 0.0) {
+            options->statsInterval = atof(argv[++i]);
+            statsIntervalGiven = true;
+        } else if (strcmp(option, "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(option, "--size") == 0 && hasValue) {
+            int width, height;
+            char extra;
+            if (sscanf(argv[++i], "%dx%d%c", &width, &height, &extra) != 2 || width <= 0 || height <= 0) {
+                printf("Invalid image size: %s\n", argv[i]);
+                return false;
+            }
+            options->headlessConfig.width = width;
+            options->headlessConfig.height = height;
+        } else if (strcmp(option, "--format") == 0 && hasValue) {
+            if (!parse_choice(argv[++i], outputNames, 3, &choice)) {
+                printf("Unknown output format: %s\n", argv[i]);
+                return false;
+            }
+            options->headlessConfig.output = outputs[choice];
+        } else if (strcmp(option, "--output") == 0 && hasValue) {
+            options->headlessConfig.outputDir = argv[++i];
+        } else if (option[0] != '-' || strcmp(option, "-") == 0) {
+            inputs[inputCount++] = argv[i];
+        } else {
+            printf("Unknown option: %s\n", option);
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options->headless && inputCount == 0) {
+        printf("Headless mode needs at least one command file\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && options->script) {
+        printf("--script runs in the window; pass command files directly in headless mode\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && options->save) {
+        printf("--save records the window's drawing; headless mode only writes PNG files\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && (options->profile || options->profileOut)) {
+        printf("--profile and --profile-out time the window's frames; headless mode draws none\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && (options->record || options->replay)) {
+        printf("--record and --replay capture the window's input; headless mode reads none\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && (options->coreProfile || options->lineWidth != 1.0f)) {
+        printf("--gl and --line-width select how the window draws; headless mode rasterizes on the CPU\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && assetCacheGiven) {
+        printf("--asset-cache keeps the window's font and sprites; headless mode loads neither\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && options->partialRedraw) {
+        printf("--partial-redraw limits what the window redraws; headless mode draws each image once\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->coreProfile && options->partialRedraw) {
+        printf("--partial-redraw redraws over the canvas of --gl legacy; --gl core has none\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && (options->tiledCanvas || tileBudgetGiven)) {
+        printf("--canvas and --tile-budget select how the window keeps lines; headless mode rasterizes on the CPU\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (tileBudgetGiven && !options->tiledCanvas) {
+        printf("--tile-budget sizes the tiled canvas; add --canvas tiled\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->coreProfile && options->tiledCanvas) {
+        printf("--canvas tiled rasterizes through --gl legacy; --gl core draws without a canvas\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->tiledCanvas && options->lineMemoryCap > 0 && options->lineCapPolicy == LINE_LIMIT_FLATTEN) {
+        printf("--canvas tiled draws tiles again from the stored lines; choose --line-cap-policy stop or spill\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->coreProfile && options->lineMemoryCap > 0 && options->lineCapPolicy == LINE_LIMIT_FLATTEN) {
+        printf("--gl core draws without a canvas to flatten lines into; choose --line-cap-policy stop or spill\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && options->listen) {
+        printf("--listen drives the window's turtle; headless mode has none\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->listen && (options->record || options->replay)) {
+        printf("--record and --replay capture the window's input only; commands from clients would not be replayed\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->headless && options->stats) {
+        printf("--stats reports the window's line store and GPU uploads; headless mode uses neither\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (statsIntervalGiven && !options->stats) {
+        printf("--stats-interval paces the telemetry lines; add --stats\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->record && options->replay) {
+        printf("--record and --replay cannot be combined; copy the recording instead\n");
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->profileOut && !has_suffix(options->profileOut, ".csv") && !has_suffix(options->profileOut, ".json")) {
+        printf("Profile files end in .csv or .json, which selects their format: %s\n", options->profileOut);
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->save && !session_file(options->save)) {
+        printf("Session files end in .session, so they can be loaded back with --script: %s\n", options->save);
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options->script && options->save && strcmp(options->script, options->save) == 0) {
+        printf("--save would overwrite the session the script loads: %s\n", options->save);
+        print_usage(argv[0]);
+        return false;
+    }
+    if (!options->headless && inputCount > 0) {
+        printf("Command files are only read in headless mode, use --script in the window: %s\n", inputs[0]);
+        print_usage(argv[0]);
+        return false;
+    }
+
+    options->headlessConfig.inputs = inputs;
+    options->headlessConfig.inputCount = inputCount;
+    return true;
+}
@@ -0,0 +1,149 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * pacing.c - Frame pacing for the render thread and the main loop.
+ *
+ * Three independent mechanisms decide when frames are produced:
+ *
+ *    - Vertical sync: the swap interval makes SDL_GL_SwapWindow wait for the display. Adaptive vsync
+ *      (-1) is not supported by every driver, in which case regular vsync is used instead.
+ *    - Frame rate cap: after each frame, the loop sleeps until the next frame is due. SDL_Delay only has
+ *      millisecond resolution and may oversleep, so it is used for all but the last couple of milliseconds,
+ *      which are waited out on the performance counter. Frame deadlines advance by a fixed period, so
+ *      small oversleeps do not accumulate into a lower frame rate.
+ *    - Idle mode: when nothing changed, the render thread sleeps instead of rendering (see render.c).
+ *
+ * The first two and the idle flag belong to the render thread. The main loop, which no longer waits for
+ * frames, paces itself with pacing_wait_for_input: it blocks on the event queue until input arrives or the
+ * next simulation step is due.
+ *
+ * Key functions:
+ *    - pacing_init: Applies the vsync mode.
+ *    - pacing_end_frame / pacing_restart: Enforce the frame rate cap, and restart it after a pause.
+ *    - pacing_wait_for_input: Blocks until input arrives or a timeout expires.
+ */
+
+
+//==================== Header Files ====================
+#include "pacing.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+
+//==================== Macros ====================
+#define SPIN_MARGIN 0.002         // Seconds before a deadline where sleeping stops and spinning starts
+
+
+//==================== Global Variables ====================
+static PacingConfig pacing = {VSYNC_ON, 0, false};
+static Uint64 nextFrameCounter = 0;  // Performance counter value at which the next capped frame is due
+
+
+//==================== Function Definitions ====================
+void pacing_init(const PacingConfig config) {
+/*
+ * pacing_init - Applies the pacing options to the current OpenGL context.
+ *
+ * Parameters:
+ *    config - The vsync mode, frame rate cap and idle mode to use.
+ */
+
+    pacing = config;
+    nextFrameCounter = 0;
+
+    if (SDL_GL_SetSwapInterval(pacing.vsync) != 0) {
+        if (pacing.vsync == VSYNC_ADAPTIVE) {
+            printf("Adaptive vsync not supported, using vsync: %s\n", SDL_GetError());
+            pacing.vsync = VSYNC_ON;
+            if (SDL_GL_SetSwapInterval(VSYNC_ON) == 0) {
+                return;
+            }
+        }
+        printf("Could not set the swap interval: %s\n", SDL_GetError());
+    }
+}
+
+
+void pacing_end_frame(void) {
+/*
+ * pacing_end_frame - Waits until the next frame is due when a frame rate cap is set.
+ *
+ * This function must be called once per rendered frame, after the buffers are swapped.
+ */
+
+    if (pacing.fpsCap <= 0) {
+        return;
+    }
+
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    const Uint64 period = frequency / (Uint64)pacing.fpsCap;
+    const Uint64 now = SDL_GetPerformanceCounter();
+
+    // Start a new schedule on the first frame or when a frame ran late by more than a period
+    if (nextFrameCounter == 0 || now > nextFrameCounter + period) {
+        nextFrameCounter = now + period;
+        return;
+    }
+
+    // Sleep coarsely, then spin for the last stretch
+    const Uint64 spinMargin = (Uint64)(SPIN_MARGIN * (double)frequency);
+    if (nextFrameCounter > now + spinMargin) {
+        SDL_Delay((Uint32)((nextFrameCounter - now - spinMargin) * 1000 / frequency));
+    }
+    while (SDL_GetPerformanceCounter() < nextFrameCounter) {
+    }
+
+    nextFrameCounter += period;
+}
+
+
+bool pacing_idle(void) {
+/*
+ * pacing_idle - Reports whether frames are skipped while nothing changes.
+ */
+
+    return pacing.idle;
+}
+
+
+void pacing_restart(void) {
+/*
+ * pacing_restart - Restarts the frame rate cap schedule, since the time spent not rendering is not a late frame.
+ */
+
+    nextFrameCounter = 0;
+}
+
+
+void pacing_wait_for_input(const double seconds) {
+/*
+ * pacing_wait_for_input - Blocks until an event is queued, or for at most the given time.
+ *
+ * The event is left in the queue for the event handler.
+ *
+ * Parameters:
+ *    seconds - The longest time to wait, rounded up to a millisecond; nothing is waited for below zero.
+ */
+
+    if (seconds > 0.0) {
+        SDL_WaitEventTimeout(NULL, (int)(seconds * 1000.0) + 1);
+    }
+}
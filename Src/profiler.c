@@ -0,0 +1,539 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * profiler.c - Frame-time profiler with CPU and GPU stage timers.
+ *
+ * When profiling is enabled on the command line, every frame is split into stages: event handling on the
+ * main thread, then drawing the lines, the sprite and the status text on the render thread, and the time
+ * between two presented frames. Each stage is timed on the performance counter and, for the three drawing
+ * stages, on the GPU with GL_TIME_ELAPSED queries. The GPU runs behind the CPU, so a query's result is only
+ * read once the driver reports it available, a few frames later; the queries of PROFILE_QUERY_FRAMES frames
+ * rotate, and a stage whose query from that many frames ago is still pending is not measured on the GPU
+ * that frame, so the profiler never waits for the GPU.
+ *
+ * Samples go into histograms of logarithmic buckets, PROFILE_BUCKETS_PER_OCTAVE per doubling from one
+ * microsecond, which keep percentiles within a few percent without storing the samples. One histogram per
+ * series covers the last PROFILE_WINDOW samples and feeds the overlay; another covers the whole run and is
+ * written by profiler_dump.
+ *
+ * All the state belongs to the render thread while it runs: the main thread measures its event handling and
+ * sends the time as a RENDER_TIMING message. profiler_configure runs before the render thread starts and
+ * profiler_dump after it stopped.
+ *
+ * Key functions:
+ *    - profiler_configure: Enables profiling, the overlay and the dump file.
+ *    - profiler_begin / profiler_end / profiler_add: Record stage times.
+ *    - profiler_frame / profiler_restart: Close a frame, or forget the gap after a pause.
+ *    - profiler_overlay_text: Returns the overlay lines.
+ *    - profiler_dump: Writes the whole-run statistics as CSV or JSON.
+ */
+
+
+//==================== Header Files ====================
+#include "profiler.h"
+#include "glproc.h"
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define PROFILE_BUCKETS 160               // Histogram buckets, from 1 microsecond to about 1 second
+#define PROFILE_BUCKETS_PER_OCTAVE 8      // Buckets per doubling of the time
+#define PROFILE_WINDOW 1024               // Samples in the rolling histograms
+#define PROFILE_QUERY_FRAMES 4            // Frames of GPU queries in flight
+#define PROFILE_OVERLAY_PERIOD 0.25       // Seconds between two updates of the overlay text
+#define PROFILE_OVERLAY_SIZE 512          // Capacity of the overlay text
+
+
+//==================== Structure ====================
+typedef struct {  // Statistics of one stage on one clock
+    unsigned int window[PROFILE_BUCKETS]; // Bucket counts of the last PROFILE_WINDOW samples
+    unsigned char recent[PROFILE_WINDOW]; // Buckets of the last PROFILE_WINDOW samples, as a ring
+    int recentCount;                      // Number of samples in the ring
+    int recentNext;                       // Slot of the next sample in the ring
+    unsigned long long total[PROFILE_BUCKETS]; // Bucket counts of the whole run
+    unsigned long long count;             // Samples in the whole run
+    double sum;                           // Sum of the samples, in seconds
+    double max;                           // Longest sample, in seconds
+} ProfileSeries;
+
+
+//==================== Global Variables ====================
+static bool profiling = false;            // Whether the stages are timed
+static bool overlayShown = false;         // Whether the overlay is part of the status text
+static const char* dumpFile = NULL;       // File written by profiler_dump, or NULL
+
+static ProfileSeries cpuSeries[PROFILE_STAGES];
+static ProfileSeries gpuSeries[PROFILE_STAGES];
+static Uint64 stageStart[PROFILE_STAGES]; // Performance counter value when each stage began
+static Uint64 lastFrame = 0;              // Performance counter value of the last presented frame, 0 after a pause
+
+static bool gpuTimers = false;            // Whether the drawing stages are timed on the GPU
+static GLuint queries[PROFILE_QUERY_FRAMES][PROFILE_STAGES];
+static bool queryPending[PROFILE_QUERY_FRAMES][PROFILE_STAGES];
+static bool queryOpen[PROFILE_STAGES];    // Whether a query was begun for the stage in this frame
+static int queryFrame = 0;                // Row of `queries` used by this frame
+
+static char overlayText[PROFILE_OVERLAY_SIZE];
+static unsigned int overlaySerial = 0;    // Incremented whenever overlayText changes
+static Uint64 lastOverlay = 0;            // Performance counter value of the last overlay update
+
+static const char* stageNames[PROFILE_STAGES] = {"events", "lines", "sprite", "hud", "frame"};
+
+
+//==================== Function Definitions ====================
+static bool gpu_stage(const ProfileStage stage) {
+/*
+ * gpu_stage - Returns whether a stage issues OpenGL commands, and so is timed on the GPU.
+ */
+
+    return stage == PROFILE_LINES || stage == PROFILE_SPRITE || stage == PROFILE_HUD;
+}
+
+
+static int bucket_of(const double seconds) {
+/*
+ * bucket_of - Returns the histogram bucket of a time.
+ */
+
+    const double micro = seconds * 1e6;
+    if (micro <= 1.0) {
+        return 0;
+    }
+    const int bucket = (int)(log2(micro) * PROFILE_BUCKETS_PER_OCTAVE);
+    return bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1;
+}
+
+
+static double bucket_time(const int bucket) {
+/*
+ * bucket_time - Returns the time a bucket stands for, the geometric middle of its range, in seconds.
+ */
+
+    return exp2((bucket + 0.5) / PROFILE_BUCKETS_PER_OCTAVE) * 1e-6;
+}
+
+
+static void series_add(ProfileSeries* series, const double seconds) {
+/*
+ * series_add - Adds a sample to the rolling and whole-run histograms of a series.
+ */
+
+    const int bucket = bucket_of(seconds);
+
+    // The sample leaving the ring leaves the rolling histogram
+    if (series->recentCount == PROFILE_WINDOW) {
+        series->window[series->recent[series->recentNext]]--;
+    } else {
+        series->recentCount++;
+    }
+    series->recent[series->recentNext] = (unsigned char)bucket;
+    series->recentNext = (series->recentNext + 1) % PROFILE_WINDOW;
+    series->window[bucket]++;
+
+    series->total[bucket]++;
+    series->count++;
+    series->sum += seconds;
+    if (seconds > series->max) {
+        series->max = seconds;
+    }
+}
+
+
+static double window_percentile(const ProfileSeries* series, const double fraction) {
+/*
+ * window_percentile - Returns a percentile of the last PROFILE_WINDOW samples, in seconds.
+ *
+ * Parameters:
+ *    series - The series to read.
+ *    fraction - The percentile as a fraction, 0.99 for p99.
+ */
+
+    const unsigned int rank = (unsigned int)ceil(fraction * series->recentCount);
+    unsigned int seen = 0;
+    for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        seen += series->window[bucket];
+        if (seen >= rank && seen > 0) {
+            return bucket_time(bucket);
+        }
+    }
+    return 0.0;
+}
+
+
+static double total_percentile(const ProfileSeries* series, const double fraction) {
+/*
+ * total_percentile - Returns a percentile of the whole run, in seconds, never above the longest sample.
+ */
+
+    const unsigned long long rank = (unsigned long long)ceil(fraction * (double)series->count);
+    unsigned long long seen = 0;
+    for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        seen += series->total[bucket];
+        if (seen >= rank && seen > 0) {
+            const double time = bucket_time(bucket);
+            return time < series->max ? time : series->max;
+        }
+    }
+    return 0.0;
+}
+
+
+static double seconds_since(const Uint64 start) {
+/*
+ * seconds_since - Returns the seconds elapsed since a performance counter value.
+ */
+
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+
+void profiler_configure(const bool enabled, const bool overlay, const char* dumpPath) {
+/*
+ * profiler_configure - Selects what the profiler does; called once, before the render thread starts.
+ *
+ * Parameters:
+ *    enabled - Whether to time the stages at all.
+ *    overlay - Whether the overlay is shown from the start; F3 toggles it later.
+ *    dumpPath - File profiler_dump writes, ending in .csv or .json, or NULL for none.
+ */
+
+    profiling = enabled;
+    overlayShown = enabled && overlay;
+    dumpFile = enabled ? dumpPath : NULL;
+}
+
+
+bool profiler_enabled(void) {
+/*
+ * profiler_enabled - Returns whether the stages are timed.
+ */
+
+    return profiling;
+}
+
+
+void profiler_init_gpu(void) {
+/*
+ * profiler_init_gpu - Creates the GPU timer queries on the current context, if it supports them.
+ */
+
+    gpuTimers = false;
+    if (!profiling || !glHasTimerQueries) {
+        return;
+    }
+
+    pglGenQueries(PROFILE_QUERY_FRAMES * PROFILE_STAGES, &queries[0][0]);
+    memset(queryPending, 0, sizeof(queryPending));
+    memset(queryOpen, 0, sizeof(queryOpen));
+    queryFrame = 0;
+    gpuTimers = true;
+}
+
+
+void profiler_shutdown_gpu(void) {
+/*
+ * profiler_shutdown_gpu - Deletes the GPU timer queries; the context must still be current.
+ */
+
+    if (gpuTimers) {
+        pglDeleteQueries(PROFILE_QUERY_FRAMES * PROFILE_STAGES, &queries[0][0]);
+        gpuTimers = false;
+    }
+}
+
+
+void profiler_begin(const ProfileStage stage) {
+/*
+ * profiler_begin - Starts timing a stage of the frame on the render thread.
+ *
+ * A drawing stage also begins a GPU query, unless the query of the same slot is still waiting for its
+ * result. Only one GL_TIME_ELAPSED query can be active at a time, so stages must not overlap.
+ */
+
+    if (!profiling) {
+        return;
+    }
+
+    if (gpuTimers && gpu_stage(stage) && !queryPending[queryFrame][stage]) {
+        pglBeginQuery(GL_TIME_ELAPSED, queries[queryFrame][stage]);
+        queryOpen[stage] = true;
+    }
+    stageStart[stage] = SDL_GetPerformanceCounter();
+}
+
+
+void profiler_end(const ProfileStage stage) {
+/*
+ * profiler_end - Stops timing a stage started with profiler_begin and records its CPU time.
+ */
+
+    if (!profiling) {
+        return;
+    }
+
+    series_add(&cpuSeries[stage], seconds_since(stageStart[stage]));
+    if (queryOpen[stage]) {
+        pglEndQuery(GL_TIME_ELAPSED);
+        queryOpen[stage] = false;
+        queryPending[queryFrame][stage] = true;
+    }
+}
+
+
+void profiler_add(const ProfileStage stage, const double seconds) {
+/*
+ * profiler_add - Records the CPU time of a stage measured elsewhere, such as the main thread's events.
+ */
+
+    if (profiling) {
+        series_add(&cpuSeries[stage], seconds);
+    }
+}
+
+
+static void collect_queries(void) {
+/*
+ * collect_queries - Records the results of every GPU query the driver has finished, without waiting.
+ */
+
+    for (int frame = 0; frame < PROFILE_QUERY_FRAMES; frame++) {
+        for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+            if (!queryPending[frame][stage]) {
+                continue;
+            }
+            GLint available = 0;
+            pglGetQueryObjectiv(queries[frame][stage], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            GLuint64 nanoseconds = 0;
+            pglGetQueryObjectui64v(queries[frame][stage], GL_QUERY_RESULT, &nanoseconds);
+            series_add(&gpuSeries[stage], (double)nanoseconds * 1e-9);
+            queryPending[frame][stage] = false;
+        }
+    }
+}
+
+
+static void append_stage(char** cursor, const char* end, const char* label, const ProfileStage stage) {
+/*
+ * append_stage - Appends one line of the overlay: the recent p50 and p99 of a stage, in milliseconds.
+ */
+
+    const ProfileSeries* cpu = &cpuSeries[stage];
+    const ProfileSeries* gpu = &gpuSeries[stage];
+    int written = snprintf(*cursor, (size_t)(end - *cursor), "\n%s %.2f/%.2f", label,
+                           window_percentile(cpu, 0.5) * 1e3, window_percentile(cpu, 0.99) * 1e3);
+    if (written > 0 && written < end - *cursor) {
+        *cursor += written;
+    }
+    if (gpu->recentCount > 0) {
+        written = snprintf(*cursor, (size_t)(end - *cursor), " gpu %.2f/%.2f",
+                           window_percentile(gpu, 0.5) * 1e3, window_percentile(gpu, 0.99) * 1e3);
+        if (written > 0 && written < end - *cursor) {
+            *cursor += written;
+        }
+    }
+}
+
+
+static void update_overlay(void) {
+/*
+ * update_overlay - Formats the overlay text from the rolling histograms.
+ */
+
+    char* cursor = overlayText;
+    const char* end = overlayText + sizeof(overlayText);
+    const double frameP50 = window_percentile(&cpuSeries[PROFILE_FRAME], 0.5);
+    const int written = snprintf(cursor, sizeof(overlayText), "\nFrame p50/p99 ms: %.2f/%.2f (%.0f fps)",
+                                 frameP50 * 1e3, window_percentile(&cpuSeries[PROFILE_FRAME], 0.99) * 1e3,
+                                 frameP50 > 0.0 ? 1.0 / frameP50 : 0.0);
+    if (written > 0 && written < end - cursor) {
+        cursor += written;
+    }
+    append_stage(&cursor, end, "Events", PROFILE_EVENTS);
+    append_stage(&cursor, end, "Lines", PROFILE_LINES);
+    append_stage(&cursor, end, "Sprite", PROFILE_SPRITE);
+    append_stage(&cursor, end, "Text", PROFILE_HUD);
+    overlaySerial++;
+}
+
+
+void profiler_frame(void) {
+/*
+ * profiler_frame - Closes a frame after it was presented.
+ *
+ * Records the time since the previous frame, collects the GPU results that are ready, moves on to the next
+ * row of queries and refreshes the overlay text every PROFILE_OVERLAY_PERIOD seconds.
+ */
+
+    if (!profiling) {
+        return;
+    }
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (lastFrame != 0) {
+        series_add(&cpuSeries[PROFILE_FRAME], (double)(now - lastFrame) / (double)SDL_GetPerformanceFrequency());
+    }
+    lastFrame = now;
+
+    if (gpuTimers) {
+        collect_queries();
+        queryFrame = (queryFrame + 1) % PROFILE_QUERY_FRAMES;
+    }
+
+    if (overlayShown && (lastOverlay == 0 || seconds_since(lastOverlay) >= PROFILE_OVERLAY_PERIOD)) {
+        update_overlay();
+        lastOverlay = now;
+    }
+}
+
+
+void profiler_restart(void) {
+/*
+ * profiler_restart - Forgets the last frame after a deliberate pause, so the gap is not counted as a frame.
+ */
+
+    lastFrame = 0;
+}
+
+
+void profiler_toggle_overlay(void) {
+/*
+ * profiler_toggle_overlay - Shows or hides the overlay; called on the render thread.
+ */
+
+    if (!profiling) {
+        return;
+    }
+    overlayShown = !overlayShown;
+    lastOverlay = 0;
+    overlaySerial++;
+    if (overlayShown) {
+        update_overlay();
+    }
+}
+
+
+const char* profiler_overlay_text(unsigned int* serial) {
+/*
+ * profiler_overlay_text - Returns the overlay text to append to the status text.
+ *
+ * Parameters:
+ *    serial - Receives a number that changes whenever the returned text does.
+ *
+ * Returns:
+ *    The overlay lines, each starting with a newline, or an empty string while the overlay is hidden.
+ */
+
+    *serial = overlaySerial;
+    return overlayShown ? overlayText : "";
+}
+
+
+static void write_csv(FILE* file) {
+/*
+ * write_csv - Writes one row per stage and clock.
+ */
+
+    fprintf(file, "stage,clock,samples,mean_ms,p50_ms,p99_ms,max_ms,recent_p50_ms,recent_p99_ms\n");
+    for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+        for (int clock = 0; clock < 2; clock++) {
+            const ProfileSeries* series = clock == 0 ? &cpuSeries[stage] : &gpuSeries[stage];
+            if (series->count == 0) {
+                continue;
+            }
+            fprintf(file, "%s,%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", stageNames[stage], clock == 0 ? "cpu" : "gpu",
+                    series->count, series->sum / (double)series->count * 1e3, total_percentile(series, 0.5) * 1e3,
+                    total_percentile(series, 0.99) * 1e3, series->max * 1e3, window_percentile(series, 0.5) * 1e3,
+                    window_percentile(series, 0.99) * 1e3);
+        }
+    }
+}
+
+
+static void write_json(FILE* file) {
+/*
+ * write_json - Writes an array of objects, one per stage and clock.
+ */
+
+    fprintf(file, "{\n  \"stages\": [");
+    bool first = true;
+    for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+        for (int clock = 0; clock < 2; clock++) {
+            const ProfileSeries* series = clock == 0 ? &cpuSeries[stage] : &gpuSeries[stage];
+            if (series->count == 0) {
+                continue;
+            }
+            fprintf(file,
+                    "%s\n    {\"stage\": \"%s\", \"clock\": \"%s\", \"samples\": %llu, \"mean_ms\": %.4f, "
+                    "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"recent_p50_ms\": %.4f, "
+                    "\"recent_p99_ms\": %.4f}",
+                    first ? "" : ",", stageNames[stage], clock == 0 ? "cpu" : "gpu", series->count,
+                    series->sum / (double)series->count * 1e3, total_percentile(series, 0.5) * 1e3,
+                    total_percentile(series, 0.99) * 1e3, series->max * 1e3, window_percentile(series, 0.5) * 1e3,
+                    window_percentile(series, 0.99) * 1e3);
+            first = false;
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
+
+
+bool profiler_dump(void) {
+/*
+ * profiler_dump - Writes the whole-run statistics to the file given to profiler_configure.
+ *
+ * The format follows the file's extension: .json writes JSON, anything else CSV. Must not run while the
+ * render thread does.
+ *
+ * Returns:
+ *    true if there was nothing to write or the file was written, false otherwise.
+ */
+
+    if (!dumpFile) {
+        return true;
+    }
+
+    FILE* file = fopen(dumpFile, "w");
+    if (!file) {
+        printf("Error opening profile file %s!\n", dumpFile);
+        return false;
+    }
+
+    const size_t length = strlen(dumpFile);
+    if (length >= 5 && strcmp(dumpFile + length - 5, ".json") == 0) {
+        write_json(file);
+    } else {
+        write_csv(file);
+    }
+
+    const bool written = !ferror(file);
+    if (fclose(file) != 0 || !written) {
+        printf("Error writing profile file %s!\n", dumpFile);
+        return false;
+    }
+    printf("Profile written to %s\n", dumpFile);
+    return true;
+}
@@ -0,0 +1,234 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * raster.c - Software rasterizer for headless rendering.
+ *
+ * Batch rendering only needs opaque one-pixel lines on a solid background, which a CPU draws far faster
+ * than the time it takes to create a window and an OpenGL context. Lines are clipped to the image with
+ * Liang-Barsky and stepped with Bresenham's algorithm, using the same convention as the windowed renderer:
+ * drawing coordinate (x, y) falls in pixel (floor(x), floor(y)), with y growing downward.
+ *
+ * Key functions:
+ *    - raster_line: Clips and draws a line.
+ *    - raster_save_png: Saves the image through SDL_image.
+ */
+
+
+//==================== Header Files ====================
+#include "raster.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Function Definitions ====================
+bool raster_init(Raster* raster, const int width, const int height) {
+/*
+ * raster_init - Allocates an image of the given size.
+ *
+ * Parameters:
+ *    raster - The image to initialize.
+ *    width  - The width in pixels.
+ *    height - The height in pixels.
+ *
+ * Returns:
+ *    true if the image was allocated, false otherwise.
+ */
+
+    raster->width = width;
+    raster->height = height;
+    raster->pixels = malloc((size_t)width * (size_t)height * 4);
+    if (!raster->pixels) {
+        printf("Error allocating memory for a %d x %d image!\n", width, height);
+        return false;
+    }
+    return true;
+}
+
+
+void raster_free(Raster* raster) {
+/*
+ * raster_free - Releases the pixels of an image.
+ */
+
+    free(raster->pixels);
+    raster->pixels = NULL;
+    raster->width = raster->height = 0;
+}
+
+
+static unsigned char to_byte(const float component) {
+/*
+ * to_byte - Converts a color component from [0, 1] to [0, 255], like the line VBO does.
+ */
+
+    const float clamped = component < 0.0f ? 0.0f : (component > 1.0f ? 1.0f : component);
+    return (unsigned char)(clamped * 255.0f + 0.5f);
+}
+
+
+void raster_clear(Raster* raster, const float r, const float g, const float b) {
+/*
+ * raster_clear - Fills the whole image with an opaque color.
+ *
+ * Parameters:
+ *    raster  - The image to clear.
+ *    r, g, b - The RGB components of the color.
+ */
+
+    const unsigned char pixel[4] = {to_byte(r), to_byte(g), to_byte(b), 255};
+    const size_t count = (size_t)raster->width * (size_t)raster->height;
+
+    // Fill the first row, then copy it down, which is much faster than writing every pixel separately
+    for (int x = 0; x < raster->width; x++) {
+        memcpy(&raster->pixels[x * 4], pixel, 4);
+    }
+    const size_t rowBytes = (size_t)raster->width * 4;
+    for (size_t offset = rowBytes; offset < count * 4; offset += rowBytes) {
+        memcpy(&raster->pixels[offset], raster->pixels, rowBytes);
+    }
+}
+
+
+static bool clip_line(float* x1, float* y1, float* x2, float* y2, const float maxX, const float maxY) {
+/*
+ * clip_line - Clips a segment to the rectangle [0, maxX] x [0, maxY] (Liang-Barsky).
+ *
+ * Returns:
+ *    true if part of the segment lies inside the rectangle, false otherwise.
+ */
+
+    const float dx = *x2 - *x1;
+    const float dy = *y2 - *y1;
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {*x1, maxX - *x1, *y1, maxY - *y1};
+    float t0 = 0.0f, t1 = 1.0f;
+
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) {
+                return false;
+            }
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0.0f) {
+            if (t > t1) {
+                return false;
+            }
+            if (t > t0) {
+                t0 = t;
+            }
+        } else {
+            if (t < t0) {
+                return false;
+            }
+            if (t < t1) {
+                t1 = t;
+            }
+        }
+    }
+
+    // Rounding can leave a clipped end point a hair outside the rectangle, so clamp it back
+    const float startX = *x1, startY = *y1;
+    *x1 = fminf(fmaxf(startX + t0 * dx, 0.0f), maxX);
+    *y1 = fminf(fmaxf(startY + t0 * dy, 0.0f), maxY);
+    *x2 = fminf(fmaxf(startX + t1 * dx, 0.0f), maxX);
+    *y2 = fminf(fmaxf(startY + t1 * dy, 0.0f), maxY);
+    return true;
+}
+
+
+void raster_line(Raster* raster, const Line* line) {
+/*
+ * raster_line - Draws an opaque one-pixel line into the image.
+ *
+ * Parameters:
+ *    raster - The image to draw into.
+ *    line   - The line, in pixel coordinates.
+ */
+
+    float x1 = line->x1, y1 = line->y1, x2 = line->x2, y2 = line->y2;
+
+    // Clip just inside the far edges so the rounded end points stay within the image
+    const float maxX = (float)raster->width - 0.001f;
+    const float maxY = (float)raster->height - 0.001f;
+    if (!clip_line(&x1, &y1, &x2, &y2, maxX, maxY)) {
+        return;
+    }
+
+    const unsigned char pixel[4] = {to_byte(line->r), to_byte(line->g), to_byte(line->b), 255};
+
+    int x = (int)floorf(x1), y = (int)floorf(y1);
+    const int endX = (int)floorf(x2), endY = (int)floorf(y2);
+    const int dx = abs(endX - x), dy = -abs(endY - y);
+    const int stepX = x < endX ? 1 : -1, stepY = y < endY ? 1 : -1;
+    const size_t stride = (size_t)raster->width * 4;
+    int error = dx + dy;
+
+    for (;;) {
+        memcpy(&raster->pixels[(size_t)y * stride + (size_t)x * 4], pixel, 4);
+        if (x == endX && y == endY) {
+            break;
+        }
+        const int doubled = 2 * error;
+        if (doubled >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (doubled <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+}
+
+
+bool raster_save_png(const Raster* raster, const char* path) {
+/*
+ * raster_save_png - Writes the image to a PNG file.
+ *
+ * Parameters:
+ *    raster - The image to save.
+ *    path   - The path of the PNG file.
+ *
+ * Returns:
+ *    true if the file was written, false otherwise.
+ */
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(raster->pixels, raster->width, raster->height, 32,
+                                                              raster->width * 4, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) {
+        printf("Error wrapping the image in a surface: %s\n", SDL_GetError());
+        return false;
+    }
+
+    const bool saved = IMG_SavePNG(surface, path) == 0;
+    if (!saved) {
+        printf("Error saving %s: %s\n", path, IMG_GetError());
+    }
+
+    SDL_FreeSurface(surface);
+    return saved;
+}
@@ -0,0 +1,771 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * render.c - The render thread and the lock-free queue that feeds it.
+ *
+ * The main thread handles input and advances the simulation; everything that touches OpenGL runs on the
+ * render thread, which makes the context current at startup and keeps it until it stops. A slow frame
+ * therefore no longer delays input handling or the simulation, and a burst of input does not delay frames.
+ *
+ * The two threads share no state but the message ring. The simulation writes messages into the ring and
+ * publishes them in one step with render_flush, once per iteration of the main loop, so the render thread
+ * sees a whole simulation step at a time. The ring is a fixed array indexed by two atomic positions: the
+ * head is only written by the simulation and the tail only by the render thread, with memory barriers
+ * ordering the message contents against the positions, so neither side ever takes a lock. When the ring is
+ * full the simulation publishes what it has and sleeps a millisecond until the render thread catches up.
+ *
+ * The render thread is the only user of the line store, the spatial index, the levels of detail, the camera
+ * and the canvas while it runs: new lines are added to them from the RENDER_LINE messages, and the camera
+ * moves requested by input arrive as messages too, in order with the lines. The sprite is drawn from the
+ * latest snapshot of its poses before and after the last simulation step, interpolated on the render
+ * thread's own clock. The turtles a script told travel as a RENDER_SWARM message followed by one
+ * RENDER_TURTLE message per turtle, and are drawn in the same batch as the sprite (see swarm.c). In idle
+ * mode the render thread sleeps on a semaphore while no message arrives and the sprite is at rest;
+ * render_flush only posts the semaphore when the render thread is asleep.
+ *
+ * The font atlas and the sprite images are decoded on the asset thread (see assets.c) while the first
+ * frames are drawn without them; the render thread polls it each frame and uploads them once it is done.
+ *
+ * Before each frame the render thread asks the context whether a GPU reset has lost it (see gl_context_lost).
+ * It then deletes the lost context, creates a new one like it and sets the renderer up again: the assets are
+ * uploaded anew, and the canvas starts empty and replays the lines from the line store. Lines the store had
+ * already flattened only survived in the old canvas, so they are lost. If no new context can be made,
+ * the program is asked to quit.
+ *
+ * When the drawing is saved, the render thread also streams every line it receives to the session file
+ * (see session.c), before add_line merges it, so loading the session replays the same lines. The journal
+ * marks, undos and redos are recorded along with them, so strokes undone before saving are not loaded.
+ *
+ * When profiling, each presented frame is closed with profiler_frame, and the time the main thread spent
+ * on events arrives as a RENDER_TIMING message. That message alone does not count as a change on screen
+ * in idle mode, so timing the events does not keep an idle renderer drawing. Every presented frame is also
+ * closed with stats_end_frame, for the upload counters of the telemetry.
+ *
+ * Key functions:
+ *    - render_start / render_stop: Hand the OpenGL context to the render thread and take it back.
+ *    - render_send_*: Queue messages.
+ *    - render_flush: Publishes the queued messages.
+ */
+
+
+//==================== Header Files ====================
+#include "render.h"
+#include "assets.h"
+#include "camera.h"
+#include "canvas.h"
+#include "damage.h"
+#include "glproc.h"
+#include "graphics.h"
+#include "profiler.h"
+#include "server.h"
+#include "session.h"
+#include "stats.h"
+#include "swarm.h"
+#include "text.h"
+
+#include <stdio.h>
+
+
+//==================== Macros ====================
+#define RENDER_QUEUE_SIZE 65536   // Messages in the ring, a power of two; one slot always stays empty
+#define QUEUE_FULL_WAIT_MS 1      // Sleep of the simulation while the ring is full
+#define IDLE_WAIT_MS 1000         // Longest sleep of the render thread while nothing changes
+#define ASSET_WAIT_MS 5           // Longest sleep of the render thread while the assets are loading
+#define RESET_WAIT_MS 5000        // Longest wait for a GPU reset to complete before a new context is made
+#define RESET_POLL_MS 10          // Interval at which the reset status is polled meanwhile
+#define EXPORT_SVG_PATH "drawing.svg"
+#define EXPORT_PDF_PATH "drawing.pdf"
+
+
+//==================== Global Variables ====================
+// Shared between the threads
+static RenderMessage queue[RENDER_QUEUE_SIZE];  // Message ring
+static SDL_atomic_t queueHead;      // Slot after the last published message, written by the simulation
+static SDL_atomic_t queueTail;      // Slot of the next message to apply, written by the render thread
+static SDL_atomic_t renderWaiting;  // Whether the render thread sleeps until messages are published
+static SDL_sem* wakeUp = NULL;      // Posted to wake a sleeping render thread
+static SDL_sem* started = NULL;     // Posted once the render thread has set up OpenGL
+static bool startupSucceeded = false; // Whether the setup succeeded, read after `started` is posted
+
+// Used by the simulation only
+static SDL_Thread* renderThread = NULL; // The render thread, or NULL when it is not running
+static int pendingHead = 0;         // Slot of the next message to queue, published by render_flush
+static Sprite sentCurrent;          // Sprite poses of the last snapshot queued
+static Sprite sentPrevious;
+
+// Used by the render thread only, after render_start has set them
+static SDL_Window* renderWindow = NULL;
+static SDL_GLContext renderContext = NULL;
+static PacingConfig renderPacing;
+static SessionWriter* sessionWriter = NULL; // Session the lines are saved to, or NULL
+static int viewWidth = 0;           // Size of the window, as of the last message applied
+static int viewHeight = 0;
+static Sprite drawnCurrent;         // Sprite poses of the last snapshot applied
+static Sprite drawnPrevious;
+static Uint64 drawnStepCounter = 0; // Performance counter value the last snapshot's step corresponds to
+static float drawnStepSeconds = 0.0f; // Length of a simulation step, 0 until a snapshot arrives
+static bool quitRequested = false;  // Whether a RENDER_QUIT message was applied
+static bool assetsLoading = true;   // Whether the font and the sprite images are still awaited
+static bool contextReady = false;   // Whether the renderer is set up on a usable context
+
+
+//==================== Function Definitions ====================
+static bool same_pose(const Sprite* a, const Sprite* b) {
+/*
+ * same_pose - Reports whether two sprite states look the same on screen, including the status text.
+ */
+
+    return a->x == b->x && a->y == b->y && a->angle == b->angle && a->pen == b->pen &&
+           a->r == b->r && a->g == b->g && a->b == b->b;
+}
+
+
+static void queue_push(const RenderMessage* message) {
+/*
+ * queue_push - Writes a message into the ring without publishing it.
+ *
+ * When the ring is full, the messages already queued are published and the simulation sleeps until the
+ * render thread has freed a slot.
+ */
+
+    if (!renderThread) {
+        return;
+    }
+
+    const int next = (pendingHead + 1) & (RENDER_QUEUE_SIZE - 1);
+    while (next == SDL_AtomicGet(&queueTail)) {
+        render_flush();
+        SDL_Delay(QUEUE_FULL_WAIT_MS);
+    }
+    queue[pendingHead] = *message;
+    pendingHead = next;
+}
+
+
+void render_flush(void) {
+/*
+ * render_flush - Publishes the queued messages to the render thread, waking it if it sleeps.
+ */
+
+    if (!renderThread || SDL_AtomicGet(&queueHead) == pendingHead) {
+        return;
+    }
+
+    // The messages must be visible before the position that publishes them
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queueHead, pendingHead);
+
+    if (SDL_AtomicCAS(&renderWaiting, 1, 0)) {
+        SDL_SemPost(wakeUp);
+    }
+}
+
+
+void render_send_line(const Line* line) {
+/*
+ * render_send_line - Queues a line to be added to the drawing, and for the clients of the command server.
+ */
+
+    RenderMessage message = {.type = RENDER_LINE};
+    message.line = *line;
+    queue_push(&message);
+    server_publish_line(line);
+}
+
+
+void render_send_sprite(const Sprite* current, const Sprite* previous, const Uint64 stepCounter,
+                        const float stepSeconds) {
+/*
+ * render_send_sprite - Queues a snapshot of the sprite's last simulation step, unless it is unchanged.
+ *
+ * Parameters:
+ *    current     - The sprite after the last simulation step.
+ *    previous    - The sprite before the last simulation step.
+ *    stepCounter - The performance counter value the last step corresponds to.
+ *    stepSeconds - The length of a simulation step.
+ */
+
+    if (same_pose(current, &sentCurrent) && same_pose(previous, &sentPrevious)) {
+        return;
+    }
+    sentCurrent = *current;
+    sentPrevious = *previous;
+
+    RenderMessage message = {.type = RENDER_SPRITE};
+    message.sprite.current = *current;
+    message.sprite.previous = *previous;
+    message.sprite.stepCounter = stepCounter;
+    message.sprite.stepSeconds = stepSeconds;
+    queue_push(&message);
+}
+
+
+static void send_view(const RenderMessageType type, const float x, const float y, const float value) {
+/*
+ * send_view - Queues a camera move.
+ */
+
+    RenderMessage message = {.type = type};
+    message.view.x = x;
+    message.view.y = y;
+    message.view.value = value;
+    queue_push(&message);
+}
+
+
+void render_send_pan(const float dx, const float dy) {
+/*
+ * render_send_pan - Queues a pan of the view by a distance in window pixels, see camera_pan.
+ */
+
+    send_view(RENDER_PAN, dx, dy, 0.0f);
+}
+
+
+void render_send_zoom(const float factor, const int x, const int y) {
+/*
+ * render_send_zoom - Queues a zoom around a window position, see camera_zoom_at.
+ */
+
+    send_view(RENDER_ZOOM, (float)x, (float)y, factor);
+}
+
+
+void render_send_follow(const float x, const float y, const float margin) {
+/*
+ * render_send_follow - Queues a pan that keeps a point inside the view, see camera_follow.
+ */
+
+    send_view(RENDER_FOLLOW, x, y, margin);
+}
+
+
+void render_send_reset_view(void) {
+/*
+ * render_send_reset_view - Queues a return to the initial view.
+ */
+
+    send_view(RENDER_RESET_VIEW, 0.0f, 0.0f, 0.0f);
+}
+
+
+void render_send_resize(const int windowWidth, const int windowHeight) {
+/*
+ * render_send_resize - Queues a change of the window size.
+ */
+
+    RenderMessage message = {.type = RENDER_RESIZE};
+    message.size.width = windowWidth;
+    message.size.height = windowHeight;
+    queue_push(&message);
+}
+
+
+void render_send_redraw(void) {
+/*
+ * render_send_redraw - Queues a frame, for changes the render thread cannot see itself such as exposure.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_REDRAW});
+}
+
+
+void render_send_export(const ExportFormat format) {
+/*
+ * render_send_export - Queues an export of every line drawn so far to EXPORT_SVG_PATH or EXPORT_PDF_PATH.
+ *
+ * The export runs on the render thread, which owns the line store, in order with the lines queued before.
+ *
+ * Parameters:
+ *    format - The format of the file.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_EXPORT, .format = format});
+}
+
+
+void render_send_mark(void) {
+/*
+ * render_send_mark - Queues the start of a journal entry, see journal.c.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_MARK});
+}
+
+
+void render_send_undo(void) {
+/*
+ * render_send_undo - Queues the undo of the last journal entry.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_UNDO});
+}
+
+
+void render_send_redo(void) {
+/*
+ * render_send_redo - Queues the redo of the last journal entry undone.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_REDO});
+}
+
+
+void render_send_swarm(const TurtleSwarm* swarm) {
+/*
+ * render_send_swarm - Queues the turtles a script told, replacing the ones drawn so far.
+ *
+ * Parameters:
+ *    swarm - The turtles besides the sprite, or NULL to draw the sprite alone.
+ */
+
+    const int count = swarm ? swarm->count : 0;
+    queue_push(&(RenderMessage){.type = RENDER_SWARM, .turtle = {count, 0.0f, 0.0f, 0.0f}});
+    for (int i = 0; i < count; i++) {
+        const Turtle* turtle = &swarm->turtles[i];
+        queue_push(&(RenderMessage){.type = RENDER_TURTLE, .turtle = {i, turtle->x, turtle->y, turtle->angle}});
+    }
+}
+
+
+void render_send_timing(const ProfileStage stage, const double seconds) {
+/*
+ * render_send_timing - Queues a stage time measured on the main thread for the profiler.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_TIMING, .timing = {stage, seconds}});
+}
+
+
+void render_send_profiler_overlay(void) {
+/*
+ * render_send_profiler_overlay - Queues a toggle of the profiler overlay.
+ */
+
+    queue_push(&(RenderMessage){.type = RENDER_PROFILER_OVERLAY});
+}
+
+
+static void apply_message(const RenderMessage* message) {
+/*
+ * apply_message - Carries out a message on the render thread.
+ */
+
+    switch (message->type) {
+        case RENDER_LINE:
+            if (sessionWriter) {
+                session_write(sessionWriter, &message->line);
+            }
+            add_line(&message->line);
+            break;
+        case RENDER_SPRITE:
+            drawnCurrent = message->sprite.current;
+            drawnPrevious = message->sprite.previous;
+            drawnStepCounter = message->sprite.stepCounter;
+            drawnStepSeconds = message->sprite.stepSeconds;
+            break;
+        case RENDER_PAN:
+            camera_pan(message->view.x, message->view.y, viewWidth, viewHeight);
+            break;
+        case RENDER_ZOOM:
+            camera_zoom_at(message->view.value, (int)message->view.x, (int)message->view.y, viewWidth, viewHeight);
+            break;
+        case RENDER_FOLLOW:
+            camera_follow(message->view.x, message->view.y, message->view.value, viewWidth, viewHeight);
+            break;
+        case RENDER_RESET_VIEW:
+            camera_init(viewWidth, viewHeight);
+            camera_apply(viewWidth, viewHeight);
+            break;
+        case RENDER_RESIZE:
+            viewWidth = message->size.width;
+            viewHeight = message->size.height;
+            glViewport(0, 0, viewWidth, viewHeight);
+            camera_apply(viewWidth, viewHeight);
+
+            // Rebuild the canvas at the new size by replaying the lines
+            canvas_resize(viewWidth, viewHeight);
+            break;
+        case RENDER_REDRAW:
+            damage_all();
+            break;
+        case RENDER_EXPORT:
+            export_line_store(message->format == EXPORT_SVG ? EXPORT_SVG_PATH : EXPORT_PDF_PATH, message->format);
+
+            // The export took a while, which is not a late frame
+            pacing_restart();
+            profiler_restart();
+            break;
+        case RENDER_MARK:
+            if (sessionWriter) {
+                session_mark(sessionWriter);
+            }
+            mark_lines();
+            break;
+        case RENDER_UNDO:
+            if (sessionWriter) {
+                session_undo(sessionWriter);
+            }
+            undo_lines();
+            break;
+        case RENDER_REDO:
+            if (sessionWriter) {
+                session_redo(sessionWriter);
+            }
+            redo_lines();
+            break;
+        case RENDER_SWARM:
+            // The turtles of the last script may be anywhere in the window
+            set_swarm_size(message->turtle.index);
+            damage_all();
+            break;
+        case RENDER_TURTLE:
+            set_swarm_turtle(message->turtle.index, message->turtle.x, message->turtle.y, message->turtle.angle);
+            break;
+        case RENDER_TIMING:
+            profiler_add(message->timing.stage, message->timing.seconds);
+            break;
+        case RENDER_PROFILER_OVERLAY:
+            profiler_toggle_overlay();
+            break;
+        case RENDER_QUIT:
+            quitRequested = true;
+            break;
+    }
+}
+
+
+static bool apply_messages(void) {
+/*
+ * apply_messages - Applies every message published so far.
+ *
+ * Returns:
+ *    true if there was at least one message that may change the screen, false otherwise.
+ */
+
+    const int head = SDL_AtomicGet(&queueHead);
+    int tail = SDL_AtomicGet(&queueTail);
+    if (tail == head) {
+        return false;
+    }
+
+    // The messages must be read after the position that published them
+    SDL_MemoryBarrierAcquire();
+    bool changed = false;
+    while (tail != head && !quitRequested) {
+        changed = changed || queue[tail].type != RENDER_TIMING;
+        apply_message(&queue[tail]);
+        tail = (tail + 1) & (RENDER_QUEUE_SIZE - 1);
+    }
+
+    // The slots must be read before they are handed back to the simulation
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queueTail, tail);
+    return changed;
+}
+
+
+static void wait_for_messages(void) {
+/*
+ * wait_for_messages - Sleeps until messages are published, or for at most IDLE_WAIT_MS.
+ *
+ * While the assets are loading, the sleep is cut to ASSET_WAIT_MS so they are shown soon after they are ready.
+ *
+ * The flag is raised before the ring is checked, so a flush that publishes in between either is seen by
+ * the check or posts the semaphore. A post that arrives after a timeout only causes one early wake-up.
+ */
+
+    SDL_AtomicSet(&renderWaiting, 1);
+    if (SDL_AtomicGet(&queueHead) == SDL_AtomicGet(&queueTail)) {
+        SDL_SemWaitTimeout(wakeUp, assetsLoading ? ASSET_WAIT_MS : IDLE_WAIT_MS);
+    }
+    SDL_AtomicSet(&renderWaiting, 0);
+
+    // The time spent asleep is not a late frame
+    pacing_restart();
+    profiler_restart();
+}
+
+
+static float sprite_alpha(void) {
+/*
+ * sprite_alpha - Returns the fraction of a simulation step elapsed since the last snapshot's step.
+ */
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (drawnStepSeconds <= 0.0f || now <= drawnStepCounter) {
+        return drawnStepSeconds <= 0.0f ? 1.0f : 0.0f;
+    }
+
+    const double alpha = (double)(now - drawnStepCounter) / (double)SDL_GetPerformanceFrequency() / drawnStepSeconds;
+    return alpha < 1.0 ? (float)alpha : 1.0f;
+}
+
+
+static bool upload_assets(void) {
+/*
+ * upload_assets - Uploads the font atlas and the sprite images once the asset thread has decoded them.
+ *
+ * The window keeps running without them when they could not be loaded, after the error was reported.
+ *
+ * Returns:
+ *    true when the assets have just been uploaded, so the frame must be redrawn.
+ */
+
+    const AssetState state = assets_state();
+    if (state == ASSETS_LOADING) {
+        return false;
+    }
+    assetsLoading = false;
+
+    int spriteCount;
+    const AssetImage* images = assets_sprites(&spriteCount);
+    if (state == ASSETS_FAILED || !use_font_atlas(assets_font(), true) || !upload_sprites(images, spriteCount)) {
+        printf("Drawing without the turtle sprites and the text overlay\n");
+    }
+    damage_all();
+    return true;
+}
+
+
+static void release_graphics(void) {
+/*
+ * release_graphics - Deletes the OpenGL objects of the renderer and releases the context.
+ */
+
+    cleanup_graphics();
+    close_font();
+    SDL_GL_MakeCurrent(renderWindow, NULL);
+}
+
+
+static void recover_context(void) {
+/*
+ * recover_context - Replaces a context lost to a GPU reset and sets the renderer up again on the new one.
+ *
+ * The renderer's objects died with the context, so deleting them only resets the renderer's bookkeeping.
+ * On failure the program is asked to quit, and the render thread only applies messages until it stops.
+ */
+
+    printf("The GPU was reset, creating a new OpenGL context\n");
+    for (int waited = 0; gl_context_lost() && waited < RESET_WAIT_MS; waited += RESET_POLL_MS) {
+        SDL_Delay(RESET_POLL_MS);
+    }
+    release_graphics();
+    SDL_GL_DeleteContext(renderContext);
+
+    // The attributes main.c chose are still set, so the new context is of the same kind
+    renderContext = SDL_GL_CreateContext(renderWindow);
+    contextReady = renderContext && setup_opengl(viewWidth, viewHeight);
+    if (!contextReady) {
+        printf("Error creating a new OpenGL context: %s\n", SDL_GetError());
+        if (renderContext) {
+            release_graphics();
+        }
+        SDL_PushEvent(&(SDL_Event){.type = SDL_QUIT});
+        return;
+    }
+
+    pacing_init(renderPacing);
+    assetsLoading = true;
+    damage_all();
+}
+
+
+static int render_main(void* data) {
+/*
+ * render_main - Body of the render thread.
+ *
+ * Sets up OpenGL on the context handed over by render_start, then draws frames until a RENDER_QUIT
+ * message arrives. The font atlas and the sprite images are uploaded by the first frame that finds the
+ * asset thread done, so the window shows the drawing before they are decoded. In idle mode, frames are
+ * only drawn while messages arrive or the sprite is still moving between two poses.
+ *
+ * Returns:
+ *    0 after a normal stop, 1 if the setup failed.
+ */
+
+    (void)data;
+
+    startupSucceeded = SDL_GL_MakeCurrent(renderWindow, renderContext) == 0;
+    if (!startupSucceeded) {
+        printf("Error making the OpenGL context current on the render thread: %s\n", SDL_GetError());
+    } else {
+        pacing_init(renderPacing);
+        startupSucceeded = setup_opengl(viewWidth, viewHeight);
+        if (!startupSucceeded) {
+            release_graphics();
+        }
+    }
+    SDL_SemPost(started);
+    if (!startupSucceeded) {
+        return 1;
+    }
+    contextReady = true;
+
+    float lastAlpha = 1.0f;
+    bool firstFrame = true;
+    while (!quitRequested) {
+        bool changed = apply_messages() || firstFrame;
+        if (contextReady && gl_context_lost()) {
+            recover_context();
+            changed = true;
+        }
+        if (!contextReady) {
+            wait_for_messages();
+            continue;
+        }
+        if (assetsLoading) {
+            changed = upload_assets() || changed;
+        }
+        firstFrame = false;
+        if (quitRequested) {
+            break;
+        }
+        if (sessionWriter) {
+            session_sync(sessionWriter);
+        }
+
+        // The sprite keeps moving on screen until a frame has shown it at the end of its last step
+        const float alpha = sprite_alpha();
+        const bool moving = !same_pose(&drawnCurrent, &drawnPrevious) && lastAlpha < 1.0f;
+        if (pacing_idle() && !changed && !moving && !canvas_pending()) {
+            wait_for_messages();
+            continue;
+        }
+
+        render_scene(viewWidth, viewHeight, &drawnCurrent, &drawnPrevious, alpha);
+        SDL_GL_SwapWindow(renderWindow);
+        profiler_frame();
+        stats_end_frame();
+        pacing_end_frame();
+        lastAlpha = alpha;
+    }
+
+    if (contextReady) {
+        release_graphics();
+    }
+    return 0;
+}
+
+
+bool render_start(SDL_Window* window, const SDL_GLContext context, const int windowWidth, const int windowHeight,
+                  const PacingConfig pacing, const char* sessionPath) {
+/*
+ * render_start - Hands the OpenGL context to a new render thread and waits until it has set up OpenGL.
+ *
+ * The render thread applies the pacing options, sets up the renderer and starts drawing from the current
+ * `sprite` and `previousSprite`. The font and the sprite images must be loading (see assets_start); they are
+ * uploaded as soon as they are ready, without waiting for them here.
+ *
+ * Parameters:
+ *    window       - The window to draw in.
+ *    context      - Its OpenGL context, current on the calling thread; it is released here.
+ *    windowWidth  - The width of the window in pixels.
+ *    windowHeight - The height of the window in pixels.
+ *    pacing       - The vsync mode, frame rate cap and idle mode.
+ *    sessionPath  - The session file the lines are saved to, or NULL not to save them.
+ *
+ * Returns:
+ *    true if the render thread is running, false after reporting an error, in which case no OpenGL
+ *    object is left and the context is not current on any thread.
+ */
+
+    renderWindow = window;
+    renderContext = context;
+    renderPacing = pacing;
+    viewWidth = windowWidth;
+    viewHeight = windowHeight;
+    drawnCurrent = sentCurrent = sprite;
+    drawnPrevious = sentPrevious = previousSprite;
+    drawnStepSeconds = 0.0f;
+    quitRequested = false;
+    assetsLoading = true;
+    contextReady = false;
+    pendingHead = 0;
+    SDL_AtomicSet(&queueHead, 0);
+    SDL_AtomicSet(&queueTail, 0);
+    SDL_AtomicSet(&renderWaiting, 0);
+
+    if (sessionPath && !(sessionWriter = session_create(sessionPath))) {
+        render_stop();
+        return false;
+    }
+
+    wakeUp = SDL_CreateSemaphore(0);
+    started = SDL_CreateSemaphore(0);
+    if (!wakeUp || !started) {
+        printf("Error creating the render thread semaphores: %s\n", SDL_GetError());
+        render_stop();
+        return false;
+    }
+
+    // A context can only be current on one thread at a time
+    SDL_GL_MakeCurrent(window, NULL);
+    renderThread = SDL_CreateThread(render_main, "render", NULL);
+    if (!renderThread) {
+        printf("Error creating the render thread: %s\n", SDL_GetError());
+        render_stop();
+        return false;
+    }
+
+    SDL_SemWait(started);
+    if (!startupSucceeded) {
+        SDL_WaitThread(renderThread, NULL);
+        renderThread = NULL;
+        render_stop();
+        return false;
+    }
+    return true;
+}
+
+
+SDL_GLContext render_stop(void) {
+/*
+ * render_stop - Stops the render thread once it has applied every queued message.
+ *
+ * The render thread deletes the renderer's OpenGL objects and releases the context, which the caller can
+ * then delete. The session being saved, if any, receives its last lines and is closed.
+ *
+ * Returns:
+ *    The context, which is not the one given to render_start if a GPU reset made the render thread replace
+ *    it, or NULL if the replacement failed.
+ */
+
+    if (renderThread) {
+        queue_push(&(RenderMessage){.type = RENDER_QUIT});
+        render_flush();
+        SDL_WaitThread(renderThread, NULL);
+        renderThread = NULL;
+    }
+
+    session_close(sessionWriter);
+    sessionWriter = NULL;
+
+    if (wakeUp) {
+        SDL_DestroySemaphore(wakeUp);
+        wakeUp = NULL;
+    }
+    if (started) {
+        SDL_DestroySemaphore(started);
+        started = NULL;
+    }
+    return renderContext;
+}
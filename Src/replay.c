@@ -0,0 +1,466 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * replay.c - Recording the input of a session and playing it back.
+ *
+ * The main loop measures how long each iteration took and handles the events that arrived in it; the
+ * fixed-step simulation turns those into the turtle's moves and lines, so they are everything a session
+ * depends on. A recording stores them in order, and replaying it substitutes them for the clock and the
+ * event queue: the simulation takes the same steps with the same keys held and draws the same lines.
+ *
+ * A recording is a 16-byte header followed by records. All numbers are little-endian.
+ *
+ *    Header    "TRTLRPLY", the format version and the header size, 32 bits each after the magic.
+ *    Frame     RECORD_FRAME, then the iteration's measured time as the 64 bits of a double.
+ *    Event     RECORD_EVENT, then the SDL event type and four event fields, 32 bits each.
+ *
+ * The events of an iteration follow its frame record. Only the fields the event handler reads are kept:
+ * the key and modifiers, the mouse button, the motion, the wheel with the pointer position at the time,
+ * and the window event with its size. While playing, live events are drained and ignored, except for
+ * closing the window or pressing Escape, which end the program as usual; a recorded resize also resizes
+ * the window, so the view matches the recording. When the recording runs out before its quit event, the
+ * live input takes over.
+ *
+ * Scripts are generated on worker threads at their own pace, so a recording that starts with --script is
+ * only replayed exactly when the script was done before the first key was pressed.
+ *
+ * Key functions:
+ *    - replay_record / replay_play / replay_close: Open and close a recording.
+ *    - replay_frame_time: Records or replays the time of an iteration.
+ *    - replay_peep_events / replay_mouse_position: Record or replay the input.
+ */
+
+
+//==================== Header Files ====================
+#include "replay.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define REPLAY_MAGIC "TRTLRPLY"               // First bytes of a recording
+#define REPLAY_MAGIC_SIZE 8
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 16
+#define RECORD_FRAME 1                        // Record kinds
+#define RECORD_EVENT 2
+#define EVENT_FIELDS 4                        // Fields stored per event besides its type
+#define EVENT_RECORD_SIZE (1 + 4 * (1 + EVENT_FIELDS))
+
+
+//==================== Structure ====================
+typedef enum {  // What the input currently comes from
+    REPLAY_OFF,
+    REPLAY_RECORDING,
+    REPLAY_PLAYING
+} ReplayMode;
+
+
+//==================== Global Variables ====================
+static ReplayMode mode = REPLAY_OFF;
+static FILE* file = NULL;               // Recording being written or read
+static SDL_Window* replayWindow = NULL; // Window resized by recorded resize events
+static int pendingKind = 0;             // Kind of the record read ahead while playing, 0 at the end
+static long frameCount = 0;             // Frames recorded or replayed so far
+static int mouseX = 0, mouseY = 0;      // Pointer position of the last wheel event replayed
+
+
+//==================== Function Definitions ====================
+static void put_u32(unsigned char* out, const uint32_t value) {
+/*
+ * put_u32 - Stores a 32-bit number in little-endian order.
+ */
+
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+    out[2] = (unsigned char)(value >> 16);
+    out[3] = (unsigned char)(value >> 24);
+}
+
+
+static uint32_t get_u32(const unsigned char* in) {
+/*
+ * get_u32 - Reads a 32-bit number stored in little-endian order.
+ */
+
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+
+static void fail(const char* what) {
+/*
+ * fail - Reports a broken recording and falls back to the live input.
+ */
+
+    printf("%s, replay stopped after %ld frames\n", what, frameCount);
+    replay_close();
+}
+
+
+static void read_kind(void) {
+/*
+ * read_kind - Reads the kind of the next record, leaving 0 at the end of the recording.
+ */
+
+    const int kind = fgetc(file);
+    pendingKind = kind == RECORD_FRAME || kind == RECORD_EVENT ? kind : 0;
+    if (kind != EOF && pendingKind == 0) {
+        fail("Unknown record in the recording");
+    }
+}
+
+
+bool replay_record(const char* path) {
+/*
+ * replay_record - Starts recording the input to a file, replacing it.
+ *
+ * Returns:
+ *    true if the file was created, false otherwise.
+ */
+
+    file = fopen(path, "wb");
+    if (!file) {
+        printf("Error creating recording %s!\n", path);
+        return false;
+    }
+
+    unsigned char header[REPLAY_HEADER_SIZE];
+    memcpy(header, REPLAY_MAGIC, REPLAY_MAGIC_SIZE);
+    put_u32(header + REPLAY_MAGIC_SIZE, REPLAY_VERSION);
+    put_u32(header + REPLAY_MAGIC_SIZE + 4, REPLAY_HEADER_SIZE);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        printf("Error writing recording %s!\n", path);
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    mode = REPLAY_RECORDING;
+    frameCount = 0;
+    return true;
+}
+
+
+bool replay_play(const char* path, SDL_Window* window) {
+/*
+ * replay_play - Starts feeding a recording to the main loop instead of the live input.
+ *
+ * Parameters:
+ *    path - The recording to play.
+ *    window - The window, resized as the recording was.
+ *
+ * Returns:
+ *    true if the file is a recording this version can play, false otherwise.
+ */
+
+    file = fopen(path, "rb");
+    if (!file) {
+        printf("Could not open recording %s\n", path);
+        return false;
+    }
+
+    unsigned char header[REPLAY_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, REPLAY_MAGIC, REPLAY_MAGIC_SIZE) != 0 ||
+        get_u32(header + REPLAY_MAGIC_SIZE) != REPLAY_VERSION ||
+        fseek(file, (long)get_u32(header + REPLAY_MAGIC_SIZE + 4), SEEK_SET) != 0) {
+        printf("%s is not a recording of this version\n", path);
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    mode = REPLAY_PLAYING;
+    replayWindow = window;
+    frameCount = 0;
+    read_kind();
+    return true;
+}
+
+
+double replay_frame_time(const double measured) {
+/*
+ * replay_frame_time - Starts an iteration of the main loop.
+ *
+ * While recording, the measured time is saved. While playing, the recorded time replaces it, after the
+ * events left over from the previous frame record are skipped.
+ *
+ * Parameters:
+ *    measured - The time the iteration took by the clock, in seconds.
+ *
+ * Returns:
+ *    The time the simulation advances by, in seconds.
+ */
+
+    if (mode == REPLAY_RECORDING) {
+        uint64_t bits;
+        memcpy(&bits, &measured, sizeof(bits));
+        unsigned char record[9] = {RECORD_FRAME};
+        put_u32(record + 1, (uint32_t)bits);
+        put_u32(record + 5, (uint32_t)(bits >> 32));
+        if (fwrite(record, 1, sizeof(record), file) != sizeof(record)) {
+            printf("Error writing the recording, recording stopped after %ld frames\n", frameCount);
+            replay_close();
+            return measured;
+        }
+        frameCount++;
+        return measured;
+    }
+
+    if (mode != REPLAY_PLAYING) {
+        return measured;
+    }
+
+    // Events the previous iteration did not poll belong to it, not to this one
+    unsigned char skipped[EVENT_RECORD_SIZE - 1];
+    while (pendingKind == RECORD_EVENT) {
+        if (fread(skipped, 1, sizeof(skipped), file) != sizeof(skipped)) {
+            fail("Truncated recording");
+            return measured;
+        }
+        read_kind();
+    }
+
+    unsigned char record[8];
+    if (pendingKind != RECORD_FRAME || fread(record, 1, sizeof(record), file) != sizeof(record)) {
+        printf("Recording finished after %ld frames\n", frameCount);
+        replay_close();
+        return measured;
+    }
+    const uint64_t bits = (uint64_t)get_u32(record) | (uint64_t)get_u32(record + 4) << 32;
+    double recorded;
+    memcpy(&recorded, &bits, sizeof(recorded));
+    frameCount++;
+    read_kind();
+    return recorded;
+}
+
+
+static void write_event(const SDL_Event* event) {
+/*
+ * write_event - Appends the fields the event handler reads from an event to the recording.
+ */
+
+    int32_t fields[EVENT_FIELDS] = {0};
+    switch (event->type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            fields[0] = event->key.keysym.sym;
+            fields[1] = event->key.keysym.mod;
+            fields[2] = event->key.repeat;
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            fields[0] = event->button.button;
+            fields[1] = event->button.x;
+            fields[2] = event->button.y;
+            break;
+        case SDL_MOUSEMOTION:
+            fields[0] = event->motion.xrel;
+            fields[1] = event->motion.yrel;
+            fields[2] = event->motion.x;
+            fields[3] = event->motion.y;
+            break;
+        case SDL_MOUSEWHEEL:
+            fields[0] = event->wheel.y;
+            SDL_GetMouseState(&fields[1], &fields[2]);
+            fields[3] = event->wheel.x;
+            break;
+        case SDL_WINDOWEVENT:
+            fields[0] = event->window.event;
+            fields[1] = event->window.data1;
+            fields[2] = event->window.data2;
+            break;
+        case SDL_QUIT:
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            break;
+        default:
+            return;
+    }
+
+    unsigned char record[EVENT_RECORD_SIZE] = {RECORD_EVENT};
+    put_u32(record + 1, event->type);
+    for (int i = 0; i < EVENT_FIELDS; i++) {
+        put_u32(record + 5 + 4 * i, (uint32_t)fields[i]);
+    }
+    if (fwrite(record, 1, sizeof(record), file) != sizeof(record)) {
+        printf("Error writing the recording, recording stopped after %ld frames\n", frameCount);
+        replay_close();
+    }
+}
+
+
+static bool read_event(SDL_Event* event) {
+/*
+ * read_event - Rebuilds the next recorded event of the current frame.
+ *
+ * Returns:
+ *    true if an event was read, false at the end of the frame or of the recording.
+ */
+
+    if (pendingKind != RECORD_EVENT) {
+        return false;
+    }
+
+    unsigned char record[EVENT_RECORD_SIZE - 1];
+    if (fread(record, 1, sizeof(record), file) != sizeof(record)) {
+        fail("Truncated recording");
+        return false;
+    }
+    int32_t fields[EVENT_FIELDS];
+    for (int i = 0; i < EVENT_FIELDS; i++) {
+        fields[i] = (int32_t)get_u32(record + 4 + 4 * i);
+    }
+
+    memset(event, 0, sizeof(*event));
+    event->type = get_u32(record);
+    switch (event->type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            event->key.keysym.sym = fields[0];
+            event->key.keysym.mod = (Uint16)fields[1];
+            event->key.repeat = (Uint8)fields[2];
+            event->key.state = event->type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            event->button.button = (Uint8)fields[0];
+            event->button.x = fields[1];
+            event->button.y = fields[2];
+            event->button.state = event->type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+            break;
+        case SDL_MOUSEMOTION:
+            event->motion.xrel = fields[0];
+            event->motion.yrel = fields[1];
+            event->motion.x = fields[2];
+            event->motion.y = fields[3];
+            break;
+        case SDL_MOUSEWHEEL:
+            event->wheel.y = fields[0];
+            mouseX = fields[1];
+            mouseY = fields[2];
+            event->wheel.x = fields[3];
+            break;
+        case SDL_WINDOWEVENT:
+            event->window.event = (Uint8)fields[0];
+            event->window.data1 = fields[1];
+            event->window.data2 = fields[2];
+
+            // Give the window the recorded size; the resize event it sends back is ignored
+            if (event->window.event == SDL_WINDOWEVENT_RESIZED && replayWindow) {
+                SDL_SetWindowSize(replayWindow, fields[1], fields[2]);
+            }
+            break;
+        default:
+            break;
+    }
+
+    read_kind();
+    return true;
+}
+
+
+int replay_peep_events(SDL_Event* events, const int capacity) {
+/*
+ * replay_peep_events - Takes the next events of this iteration, a batch at a time, like SDL_PeepEvents.
+ *
+ * The caller pumps the event queue once per iteration with SDL_PumpEvents; this function only drains it
+ * with SDL_PeepEvents, which is cheaper than polling one event at a time. While recording, live events
+ * are saved as they are returned. While playing, live events are discarded but a request to quit, and
+ * recorded events are returned instead.
+ *
+ * Parameters:
+ *    events   - Receives the events.
+ *    capacity - The number of events `events` holds.
+ *
+ * Returns:
+ *    The number of events stored in `events`; fewer than `capacity` when none are left in this iteration.
+ */
+
+    if (mode != REPLAY_PLAYING) {
+        const int count = SDL_PeepEvents(events, capacity, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+        if (count < 0) {
+            return 0;
+        }
+        if (mode == REPLAY_RECORDING) {
+            for (int i = 0; i < count && file; i++) {
+                write_event(&events[i]);
+            }
+        }
+        return count;
+    }
+
+    // The window can still be closed during the replay
+    int live;
+    while ((live = SDL_PeepEvents(events, capacity, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) > 0) {
+        for (int i = 0; i < live; i++) {
+            if (events[i].type == SDL_QUIT ||
+                (events[i].type == SDL_KEYDOWN && events[i].key.keysym.sym == SDLK_ESCAPE)) {
+                events[0] = events[i];
+                return 1;
+            }
+        }
+    }
+
+    int count = 0;
+    while (count < capacity && read_event(&events[count])) {
+        count++;
+    }
+    return count;
+}
+
+
+void replay_mouse_position(int* x, int* y) {
+/*
+ * replay_mouse_position - Returns the pointer position, like SDL_GetMouseState.
+ *
+ * While playing, this is the position recorded with the last wheel event, the only one that reads it.
+ */
+
+    if (mode == REPLAY_PLAYING) {
+        *x = mouseX;
+        *y = mouseY;
+        return;
+    }
+    SDL_GetMouseState(x, y);
+}
+
+
+void replay_close(void) {
+/*
+ * replay_close - Finishes the recording or the replay; the live input is used from now on.
+ */
+
+    if (file) {
+        if (fclose(file) != 0 && mode == REPLAY_RECORDING) {
+            printf("Error writing the recording!\n");
+        }
+        file = NULL;
+    }
+    if (mode == REPLAY_RECORDING) {
+        printf("Recorded %ld frames\n", frameCount);
+    }
+    mode = REPLAY_OFF;
+    replayWindow = NULL;
+    pendingKind = 0;
+}
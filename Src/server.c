@@ -0,0 +1,788 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * server.c - Socket server driving the turtle remotely and streaming the lines it draws.
+ *
+ * With --listen, other programs connect over TCP or a Unix domain socket (see server.h for the frames).
+ * Every socket is non-blocking and served by one I/O thread around poll(), so a slow or stalled client
+ * never holds up the window. The I/O thread only cuts the byte stream into frames; the main thread takes
+ * the command batches (see poll_remote in events.c), decodes them with commands_decode and runs them with
+ * the sprite as its turtle, the way a script runs, so their lines reach the drawing through
+ * render_send_line like every other line.
+ *
+ * render_send_line passes each line on to server_publish_line, which queues it for the I/O thread while
+ * a client is subscribed. Both directions go through a ring written by one thread and read by the other,
+ * with atomic positions and memory barriers as in render.c. The I/O thread wakes the main thread with an
+ * SDL user event when a batch is ready, and the main thread wakes the I/O thread through a pipe when
+ * server_flush publishes lines. A full batch ring stops the I/O thread from reading more, which pushes
+ * back on the clients through TCP. A full line ring drops lines rather than stall the simulation, and
+ * the subscribers are sent a gap frame saying how many were lost.
+ *
+ * A SERVER_FRAME_LINES payload is a varint line count followed by the lines. Each line is a flags byte,
+ * bit 0 set when it starts where the previous line ended and bit 1 set when its color follows, then,
+ * unless it is joined, the start as a delta from the previous end, then the end as a delta from the start,
+ * then the color as three bytes. Coordinates are fixed point with SERVER_POSITION_STEPS steps per drawing
+ * unit, and deltas are zigzag-encoded LEB128 varints, so a turtle walking a path costs a few bytes per
+ * line. Deltas are taken between the rounded positions, so rounding errors do not add up. Each client
+ * starts from (0, 0) with no color when it subscribes and after a gap.
+ *
+ * A SERVER_FRAME_STATS request is answered by the I/O thread itself with the telemetry counters (see
+ * stats.h), which any thread may read, so monitoring a drawing never waits on the main thread.
+ *
+ * Key functions:
+ *    - server_start / server_stop: Open the listening socket and the I/O thread, and close them.
+ *    - server_take_batch / server_free_batch: Hand command batches to the main thread.
+ *    - server_publish_line / server_flush: Stream new lines to the subscribed clients.
+ */
+
+
+//==================== Header Files ====================
+#include "server.h"
+#include "logger.h"
+#include "stats.h"
+
+#include <SDL2/SDL.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+//==================== Macros ====================
+#define SERVER_DEFAULT_HOST "127.0.0.1" // Interface a TCP address without a host listens on
+#define SERVER_MAX_CLIENTS 16             // Connections served at once
+#define SERVER_MAX_FRAME (1 << 20)        // Largest payload a client may send, in bytes
+#define SERVER_MAX_BACKLOG (8 << 20)      // Bytes queued for a client before it is dropped as too slow
+#define SERVER_BATCH_SLOTS 64             // Batches in the ring to the main thread, a power of two
+#define SERVER_LINE_SLOTS 65536           // Lines in the ring to the I/O thread, a power of two
+#define SERVER_LINES_PER_FRAME 1024       // Most lines in one SERVER_FRAME_LINES frame
+#define SERVER_LINE_BYTES 44              // Most bytes an encoded line takes
+#define SERVER_POSITION_STEPS 256.0       // Fixed-point steps per drawing unit of streamed positions
+#define SERVER_POLL_MS 100                // Longest sleep of the I/O thread
+#define SERVER_HEADER_BYTES 5             // Type byte and payload length of a frame
+
+
+//==================== Structure ====================
+typedef struct {  // Connection to a client
+    int fd;                   // Socket
+    int number;               // Number of the connection since the server started
+    bool subscribed;          // Whether new lines are streamed to the client
+    unsigned char* in;        // Bytes received and not yet cut into frames
+    size_t inLength;
+    size_t inCapacity;
+    unsigned char* out;       // Bytes queued for the client, sent from outStart
+    size_t outStart;
+    size_t outLength;
+    size_t outCapacity;
+    int64_t lastX, lastY;     // End of the last line streamed, in fixed point
+    int lastColor;            // Color of the last line streamed as 0xRRGGBB, or -1 for none
+} Client;
+
+
+//==================== Global Variables ====================
+static SDL_Thread* ioThread = NULL;   // Thread serving the sockets, NULL when the server is off
+static SDL_atomic_t quitRequested;    // Whether the I/O thread must stop
+static int listenFd = -1;             // Listening socket
+static int wakePipe[2] = {-1, -1};    // Pipe the main thread writes to when lines are published
+static char unixPath[sizeof(((struct sockaddr_un*)0)->sun_path)]; // Unix socket to remove on exit, or empty
+static Uint32 wakeEvent = (Uint32)-1; // SDL event type waking the main thread when a batch arrives
+static SDL_atomic_t wakePosted;       // Whether a wake-up event is queued and not yet seen
+
+static Client clients[SERVER_MAX_CLIENTS]; // Connections, owned by the I/O thread
+static int clientCount = 0;
+static int connectionCount = 0;       // Connections accepted so far
+static SDL_atomic_t subscriberCount;  // Number of subscribed clients
+
+static ServerBatch* batches[SERVER_BATCH_SLOTS]; // Ring of batches to the main thread
+static SDL_atomic_t batchHead;        // Slot after the last batch published, written by the I/O thread
+static SDL_atomic_t batchTail;        // Slot of the next batch to take, written by the main thread
+
+static Line lines[SERVER_LINE_SLOTS]; // Ring of lines to the I/O thread
+static SDL_atomic_t lineHead;         // Slot after the last line published, written by the main thread
+static SDL_atomic_t lineTail;         // Slot of the next line to stream, written by the I/O thread
+static int pendingHead = 0;           // Slot after the last line queued and not yet published
+static int pendingLost = 0;           // Lines dropped since the last flush
+static SDL_atomic_t lostLines;        // Lines dropped and not yet reported to the subscribers
+
+
+//==================== Function Definitions ====================
+static bool set_nonblocking(const int fd) {
+/*
+ * set_nonblocking - Makes reads and writes on a descriptor return instead of waiting.
+ */
+
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+static int open_unix(const char* path) {
+/*
+ * open_unix - Listens on a Unix domain socket, replacing a socket file left by an earlier run.
+ */
+
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+        printf("Could not listen on %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    strcpy(unixPath, path);
+    return fd;
+}
+
+
+static int open_tcp(const char* address) {
+/*
+ * open_tcp - Listens on a TCP port, given as PORT or HOST:PORT.
+ */
+
+    char host[256];
+    const char* port = strrchr(address, ':');
+    if (port) {
+        const size_t length = (size_t)(port - address);
+        if (length >= sizeof(host)) {
+            printf("Host name too long: %s\n", address);
+            return -1;
+        }
+        memcpy(host, address, length);
+        host[length] = '\0';
+        port++;
+    } else {
+        strcpy(host, SERVER_DEFAULT_HOST);
+        port = address;
+    }
+
+    const struct addrinfo hints = {.ai_flags = AI_PASSIVE, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo* found = NULL;
+    const int status = getaddrinfo(host[0] ? host : NULL, port, &hints, &found);
+    if (status != 0) {
+        printf("Could not resolve %s: %s\n", address, gai_strerror(status));
+        return -1;
+    }
+
+    int fd = -1;
+    for (const struct addrinfo* candidate = found; candidate && fd < 0; candidate = candidate->ai_next) {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        const int reuse = 1;
+        if (fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+                        bind(fd, candidate->ai_addr, candidate->ai_addrlen) != 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        printf("Could not listen on %s: %s\n", address, strerror(errno));
+    }
+    return fd;
+}
+
+
+static bool reserve(unsigned char** buffer, size_t* capacity, const size_t needed) {
+/*
+ * reserve - Grows a client buffer to hold at least `needed` bytes.
+ */
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t newCapacity = *capacity > 0 ? *capacity : 4096;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    unsigned char* newBuffer = realloc(*buffer, newCapacity);
+    if (!newBuffer) {
+        printf("Error reallocating memory for a command client!\n");
+        exit(1);
+    }
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    return true;
+}
+
+
+static void drop_client(const int index, const char* reason) {
+/*
+ * drop_client - Closes a connection and forgets the client.
+ */
+
+    Client* client = &clients[index];
+    log_message("Command client %d disconnected: %s\n", client->number, reason);
+    close(client->fd);
+    if (client->subscribed) {
+        SDL_AtomicAdd(&subscriberCount, -1);
+    }
+    free(client->in);
+    free(client->out);
+    clients[index] = clients[--clientCount];
+}
+
+
+static void queue_frame(Client* client, const ServerFrameType type, const unsigned char* payload,
+                        const size_t length) {
+/*
+ * queue_frame - Appends a frame to the bytes waiting to be sent to a client.
+ */
+
+    if (client->outStart == client->outLength) {
+        client->outStart = client->outLength = 0;
+    }
+    reserve(&client->out, &client->outCapacity, client->outLength + SERVER_HEADER_BYTES + length);
+    unsigned char* header = client->out + client->outLength;
+    header[0] = (unsigned char)type;
+    for (int i = 0; i < 4; i++) {
+        header[1 + i] = (unsigned char)(length >> (8 * i));
+    }
+    memcpy(header + SERVER_HEADER_BYTES, payload, length);
+    client->outLength += SERVER_HEADER_BYTES + length;
+}
+
+
+static void reset_stream(Client* client) {
+/*
+ * reset_stream - Starts the line deltas of a client from scratch.
+ */
+
+    client->lastX = 0;
+    client->lastY = 0;
+    client->lastColor = -1;
+}
+
+
+static bool push_batch(const Client* client, const unsigned char* data, const size_t length) {
+/*
+ * push_batch - Publishes a copy of a command batch to the main thread, waking it up.
+ *
+ * Returns:
+ *    false when the ring is full, so the frame must be kept for later.
+ */
+
+    const int head = SDL_AtomicGet(&batchHead);
+    const int next = (head + 1) & (SERVER_BATCH_SLOTS - 1);
+    if (next == SDL_AtomicGet(&batchTail)) {
+        return false;
+    }
+
+    ServerBatch* batch = malloc(sizeof(ServerBatch) + length);
+    if (!batch) {
+        printf("Error allocating memory for a command batch!\n");
+        exit(1);
+    }
+    batch->client = client->number;
+    batch->length = length;
+    memcpy(batch->data, data, length);
+    batches[head] = batch;
+
+    // The batch must be complete before the main thread can see it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&batchHead, next);
+
+    if (SDL_AtomicCAS(&wakePosted, 0, 1)) {
+        SDL_Event event = {0};
+        event.type = wakeEvent;
+        SDL_PushEvent(&event);
+    }
+    return true;
+}
+
+
+static bool read_frames(const int index) {
+/*
+ * read_frames - Cuts the bytes received from a client into frames and acts on them.
+ *
+ * A frame that does not fit in the batch ring stays in the buffer until the main thread has made room.
+ *
+ * Returns:
+ *    false after dropping the client for a malformed frame.
+ */
+
+    Client* client = &clients[index];
+    size_t position = 0;
+    while (client->inLength - position >= SERVER_HEADER_BYTES) {
+        const unsigned char* header = client->in + position;
+        const size_t length = (size_t)header[1] | (size_t)header[2] << 8 | (size_t)header[3] << 16 |
+                              (size_t)header[4] << 24;
+        if (length > SERVER_MAX_FRAME) {
+            drop_client(index, "frame too large");
+            return false;
+        }
+        if (client->inLength - position < SERVER_HEADER_BYTES + length) {
+            break;
+        }
+
+        const unsigned char* payload = header + SERVER_HEADER_BYTES;
+        if (header[0] == SERVER_FRAME_COMMANDS) {
+            if (!push_batch(client, payload, length)) {
+                break;
+            }
+        } else if (header[0] == SERVER_FRAME_SUBSCRIBE) {
+            if (!client->subscribed) {
+                client->subscribed = true;
+                SDL_AtomicAdd(&subscriberCount, 1);
+            }
+            reset_stream(client);
+        } else if (header[0] == SERVER_FRAME_STATS) {
+            char json[STATS_JSON_MAX];
+            const size_t jsonLength = stats_format_json(json, sizeof(json));
+            queue_frame(client, SERVER_FRAME_STATS, (const unsigned char*)json, jsonLength);
+        } else {
+            drop_client(index, "unknown frame type");
+            return false;
+        }
+        position += SERVER_HEADER_BYTES + length;
+    }
+
+    memmove(client->in, client->in + position, client->inLength - position);
+    client->inLength -= position;
+    return true;
+}
+
+
+static unsigned char* put_varint(unsigned char* out, const int64_t value) {
+/*
+ * put_varint - Writes a signed value as a zigzag LEB128 varint.
+ */
+
+    uint64_t bits = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    while (bits >= 0x80) {
+        *out++ = (unsigned char)(bits | 0x80);
+        bits >>= 7;
+    }
+    *out++ = (unsigned char)bits;
+    return out;
+}
+
+
+static int64_t fixed_point(const float value) {
+/*
+ * fixed_point - Rounds a coordinate to the fixed point positions are streamed in.
+ */
+
+    const double steps = (double)value * SERVER_POSITION_STEPS;
+    return (int64_t)llround(fmax(fmin(steps, 4.0e18), -4.0e18));
+}
+
+
+static size_t encode_lines(Client* client, const Line* batch, const int count, unsigned char* out) {
+/*
+ * encode_lines - Delta-encodes lines for a client, after the state of the lines it was sent before.
+ *
+ * Returns:
+ *    The number of bytes written to `out`, which must hold SERVER_LINE_BYTES per line and a varint.
+ */
+
+    unsigned char* end = put_varint(out, count);
+    for (int i = 0; i < count; i++) {
+        const Line* line = &batch[i];
+        const int64_t x1 = fixed_point(line->x1), y1 = fixed_point(line->y1);
+        const int64_t x2 = fixed_point(line->x2), y2 = fixed_point(line->y2);
+        const int color = (int)lroundf(fminf(fmaxf(line->r, 0.0f), 1.0f) * 255.0f) << 16 |
+                          (int)lroundf(fminf(fmaxf(line->g, 0.0f), 1.0f) * 255.0f) << 8 |
+                          (int)lroundf(fminf(fmaxf(line->b, 0.0f), 1.0f) * 255.0f);
+
+        const bool joined = x1 == client->lastX && y1 == client->lastY;
+        const bool recolored = color != client->lastColor;
+        *end++ = (unsigned char)((joined ? 1 : 0) | (recolored ? 2 : 0));
+        if (!joined) {
+            end = put_varint(end, x1 - client->lastX);
+            end = put_varint(end, y1 - client->lastY);
+        }
+        end = put_varint(end, x2 - x1);
+        end = put_varint(end, y2 - y1);
+        if (recolored) {
+            *end++ = (unsigned char)(color >> 16);
+            *end++ = (unsigned char)(color >> 8);
+            *end++ = (unsigned char)color;
+        }
+        client->lastX = x2;
+        client->lastY = y2;
+        client->lastColor = color;
+    }
+    return (size_t)(end - out);
+}
+
+
+static void stream_lines(void) {
+/*
+ * stream_lines - Encodes the lines published by the main thread for every subscribed client.
+ */
+
+    static Line batch[SERVER_LINES_PER_FRAME];
+    static unsigned char payload[SERVER_LINES_PER_FRAME * SERVER_LINE_BYTES + 16];
+
+    // Lines dropped before the ones in the ring are reported first
+    const int lost = SDL_AtomicSet(&lostLines, 0);
+    if (lost > 0) {
+        const unsigned char count[4] = {(unsigned char)lost, (unsigned char)(lost >> 8), (unsigned char)(lost >> 16),
+                                        (unsigned char)(lost >> 24)};
+        for (int i = 0; i < clientCount; i++) {
+            if (clients[i].subscribed) {
+                queue_frame(&clients[i], SERVER_FRAME_GAP, count, sizeof(count));
+                reset_stream(&clients[i]);
+            }
+        }
+    }
+
+    const int head = SDL_AtomicGet(&lineHead);
+    int tail = SDL_AtomicGet(&lineTail);
+    SDL_MemoryBarrierAcquire();
+    while (tail != head) {
+        int count = 0;
+        while (tail != head && count < SERVER_LINES_PER_FRAME) {
+            batch[count++] = lines[tail];
+            tail = (tail + 1) & (SERVER_LINE_SLOTS - 1);
+        }
+        for (int i = 0; i < clientCount; i++) {
+            if (clients[i].subscribed) {
+                const size_t length = encode_lines(&clients[i], batch, count, payload);
+                queue_frame(&clients[i], SERVER_FRAME_LINES, payload, length);
+            }
+        }
+    }
+
+    // The slots must be read before they are handed back to the main thread
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&lineTail, tail);
+
+    for (int i = clientCount - 1; i >= 0; i--) {
+        if (clients[i].outLength - clients[i].outStart > SERVER_MAX_BACKLOG) {
+            drop_client(i, "not reading the lines streamed");
+        }
+    }
+}
+
+
+static void accept_clients(void) {
+/*
+ * accept_clients - Takes the connections waiting on the listening socket.
+ */
+
+    while (clientCount < SERVER_MAX_CLIENTS) {
+        const int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if (!set_nonblocking(fd)) {
+            close(fd);
+            continue;
+        }
+
+        // Batches are small and sent as soon as they are ready, so do not let TCP hold them back
+        const int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        Client* client = &clients[clientCount++];
+        *client = (Client){0};
+        client->fd = fd;
+        client->number = ++connectionCount;
+        reset_stream(client);
+        log_message("Command client %d connected\n", client->number);
+    }
+}
+
+
+static bool serve_client(const int index, const short events) {
+/*
+ * serve_client - Reads from and writes to a client the socket is ready for.
+ *
+ * Returns:
+ *    false if the client was dropped.
+ */
+
+    Client* client = &clients[index];
+    if (events & POLLIN) {
+        reserve(&client->in, &client->inCapacity, client->inLength + 65536);
+        const ssize_t received = recv(client->fd, client->in + client->inLength,
+                                      client->inCapacity - client->inLength, 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            drop_client(index, received == 0 ? "connection closed" : strerror(errno));
+            return false;
+        }
+        if (received > 0) {
+            client->inLength += (size_t)received;
+        }
+    } else if (events & (POLLERR | POLLHUP)) {
+        drop_client(index, "connection lost");
+        return false;
+    }
+
+    if ((events & POLLOUT) && client->outStart < client->outLength) {
+        const ssize_t sent = send(client->fd, client->out + client->outStart, client->outLength - client->outStart,
+                                  MSG_NOSIGNAL);
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            drop_client(index, strerror(errno));
+            return false;
+        }
+        if (sent > 0) {
+            client->outStart += (size_t)sent;
+        }
+    }
+    return true;
+}
+
+
+static int io_main(void* data) {
+/*
+ * io_main - Entry point of the I/O thread, serving the sockets until server_stop.
+ */
+
+    (void)data;
+    struct pollfd fds[SERVER_MAX_CLIENTS + 2];
+
+    while (!SDL_AtomicGet(&quitRequested)) {
+        // Frames left over while the batch ring was full go first
+        for (int i = clientCount - 1; i >= 0; i--) {
+            read_frames(i);
+        }
+        stream_lines();
+
+        // Only read from clients while there is room for their batches
+        const int batchHeadNow = SDL_AtomicGet(&batchHead);
+        const bool batchRoom = ((batchHeadNow + 1) & (SERVER_BATCH_SLOTS - 1)) != SDL_AtomicGet(&batchTail);
+        fds[0] = (struct pollfd){wakePipe[0], POLLIN, 0};
+        fds[1] = (struct pollfd){listenFd, clientCount < SERVER_MAX_CLIENTS ? POLLIN : 0, 0};
+        for (int i = 0; i < clientCount; i++) {
+            const short wanted = (short)((batchRoom ? POLLIN : 0) |
+                                         (clients[i].outStart < clients[i].outLength ? POLLOUT : 0));
+            fds[2 + i] = (struct pollfd){clients[i].fd, wanted, 0};
+        }
+        const int polled = clientCount;
+        if (poll(fds, (nfds_t)(polled + 2), batchRoom ? SERVER_POLL_MS : 1) <= 0) {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[256];
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        // Dropping a client moves the last one into its place, so walk the clients backward
+        for (int i = polled - 1; i >= 0; i--) {
+            if (fds[2 + i].revents) {
+                serve_client(i, fds[2 + i].revents);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_clients();
+        }
+    }
+    return 0;
+}
+
+
+bool server_start(const char* address) {
+/*
+ * server_start - Listens for command clients and starts the I/O thread.
+ *
+ * Parameters:
+ *    address - "unix:PATH" for a Unix domain socket, or "PORT" or "HOST:PORT" for TCP; a port without a
+ *              host listens on the loopback interface only.
+ *
+ * Returns:
+ *    true if the server is listening, false after reporting why not.
+ */
+
+    unixPath[0] = '\0';
+    listenFd = strncmp(address, "unix:", 5) == 0 ? open_unix(address + 5) : open_tcp(address);
+    if (listenFd < 0) {
+        return false;
+    }
+    if (listen(listenFd, SERVER_MAX_CLIENTS) != 0 || !set_nonblocking(listenFd) || pipe(wakePipe) != 0 ||
+        !set_nonblocking(wakePipe[0]) || !set_nonblocking(wakePipe[1])) {
+        printf("Could not listen on %s: %s\n", address, strerror(errno));
+        server_stop();
+        return false;
+    }
+
+    wakeEvent = SDL_RegisterEvents(1);
+    SDL_AtomicSet(&quitRequested, 0);
+    SDL_AtomicSet(&wakePosted, 0);
+    SDL_AtomicSet(&subscriberCount, 0);
+    SDL_AtomicSet(&lostLines, 0);
+    SDL_AtomicSet(&batchHead, 0);
+    SDL_AtomicSet(&batchTail, 0);
+    SDL_AtomicSet(&lineHead, 0);
+    SDL_AtomicSet(&lineTail, 0);
+    pendingHead = 0;
+    pendingLost = 0;
+
+    ioThread = SDL_CreateThread(io_main, "server", NULL);
+    if (!ioThread) {
+        printf("Error creating the command server thread: %s\n", SDL_GetError());
+        server_stop();
+        return false;
+    }
+    printf("Listening for commands on %s\n", address);
+    return true;
+}
+
+
+ServerBatch* server_take_batch(void) {
+/*
+ * server_take_batch - Takes the next command batch a client sent, without waiting.
+ *
+ * Returns:
+ *    The batch, to be released with server_free_batch, or NULL if none is waiting.
+ */
+
+    if (!ioThread) {
+        return NULL;
+    }
+
+    // Clear the wake-up flag before looking, so a batch published after the check posts a new event
+    int tail = SDL_AtomicGet(&batchTail);
+    if (tail == SDL_AtomicGet(&batchHead)) {
+        SDL_AtomicSet(&wakePosted, 0);
+        if (tail == SDL_AtomicGet(&batchHead)) {
+            return NULL;
+        }
+    }
+    SDL_MemoryBarrierAcquire();
+    ServerBatch* batch = batches[tail];
+    SDL_AtomicSet(&batchTail, (tail + 1) & (SERVER_BATCH_SLOTS - 1));
+
+    // A full ring kept the I/O thread from reading, so let it know there is room again
+    if (wakePipe[1] >= 0 && write(wakePipe[1], "", 1) < 0) {
+        errno = 0;
+    }
+    return batch;
+}
+
+
+void server_free_batch(ServerBatch* batch) {
+/*
+ * server_free_batch - Releases a batch taken with server_take_batch.
+ */
+
+    free(batch);
+}
+
+
+void server_publish_line(const Line* line) {
+/*
+ * server_publish_line - Queues a new line for the subscribed clients, until the next server_flush.
+ *
+ * Nothing is queued while no client is subscribed. When the ring is full the line is counted as lost
+ * instead, so the simulation never waits for a client.
+ */
+
+    if (!ioThread || SDL_AtomicGet(&subscriberCount) == 0) {
+        return;
+    }
+
+    const int next = (pendingHead + 1) & (SERVER_LINE_SLOTS - 1);
+    if (next == SDL_AtomicGet(&lineTail)) {
+        pendingLost++;
+        return;
+    }
+    lines[pendingHead] = *line;
+    pendingHead = next;
+}
+
+
+void server_flush(void) {
+/*
+ * server_flush - Publishes the queued lines to the I/O thread and wakes it up.
+ */
+
+    if (!ioThread || (SDL_AtomicGet(&lineHead) == pendingHead && pendingLost == 0)) {
+        return;
+    }
+
+    // The lines must be written before the I/O thread can see the new head
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&lineHead, pendingHead);
+    if (pendingLost > 0) {
+        SDL_AtomicAdd(&lostLines, pendingLost);
+        stats_add(STAT_LINES_UNSTREAMED, pendingLost);
+        pendingLost = 0;
+    }
+    if (write(wakePipe[1], "", 1) < 0) {
+        errno = 0;
+    }
+}
+
+
+void server_stop(void) {
+/*
+ * server_stop - Stops the I/O thread, closes every connection and releases the batches not taken.
+ */
+
+    if (ioThread) {
+        SDL_AtomicSet(&quitRequested, 1);
+        if (write(wakePipe[1], "", 1) < 0) {
+            errno = 0;
+        }
+        SDL_WaitThread(ioThread, NULL);
+        ioThread = NULL;
+    }
+
+    while (clientCount > 0) {
+        drop_client(clientCount - 1, "server stopped");
+    }
+    for (int tail = SDL_AtomicGet(&batchTail); tail != SDL_AtomicGet(&batchHead);
+         tail = (tail + 1) & (SERVER_BATCH_SLOTS - 1)) {
+        free(batches[tail]);
+    }
+    SDL_AtomicSet(&batchTail, SDL_AtomicGet(&batchHead));
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wakePipe[i] >= 0) {
+            close(wakePipe[i]);
+            wakePipe[i] = -1;
+        }
+    }
+    if (unixPath[0]) {
+        unlink(unixPath);
+        unixPath[0] = '\0';
+    }
+}
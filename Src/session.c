@@ -0,0 +1,922 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * session.c - Saving drawings to session files and reading them back.
+ *
+ * A session file is a 16-byte header followed by blocks of lines. All numbers are little-endian.
+ *
+ *    Header    "TRTLSESS", the format version and the header size, 32 bits each after the magic.
+ *    Block     The payload size in bytes, the number of records, the number of palette entries and the
+ *              FNV-1a checksum of the payload, 32 bits each, then the payload: the new palette entries,
+ *              three 32-bit floats each, followed by one record per line, undo or redo.
+ *
+ * The palette holds every color the drawing has used so far, up to SESSION_PALETTE_SIZE, and a block only
+ * carries the colors first used in it, so the file can be appended to without going back. A record starts
+ * with a byte of RECORD_ flags. A palette index or, once the palette is full, an RGB color follows when the
+ * color changes. The start point follows only when the line does not start where the previous one
+ * ended. The end point is stored as a difference from the start in sixteenths of a unit, on one or two
+ * bytes per axis, whenever adding that difference back gives exactly the same float, and as two floats
+ * otherwise, so decoding is lossless. A connected stroke drawn on whole or sixteenth units costs 3 bytes
+ * per line, against 28 in memory.
+ *
+ * Undo and redo are recorded too, so a session loads as the drawing was left. The writer follows the undo
+ * journal with the same marks as graphics.c, but counting the lines it wrote, and an undo record holds
+ * the number of lines the drawing is cut back to and a redo record the number it is restored to, as 32 bits
+ * after a lone RECORD_TRUNCATE or RECORD_RESTORE flag. A line recorded after an undo takes the place of the
+ * first line undone, as it does in the line store.
+ *
+ * The writer keeps the current block in memory and appends it to the file when it is full or when it has
+ * waited for SESSION_SYNC_INTERVAL, and the stream is flushed after every block. A block only counts once
+ * it is complete: the reader checks each payload against its size and checksum and stops at the first that
+ * does not match, which is where a crash cut the file.
+ *
+ * The reader maps the file into memory and decodes the records straight from the mapping, without reading
+ * or parsing the file first. Streams that cannot be mapped, such as pipes, are read into memory instead.
+ * It decodes the blocks twice. The first pass only counts: it checks the blocks and notes where each run of
+ * lines between two undo or redo records starts. A line is still in the drawing at the end when its
+ * position is below the final count and below the start of every later run, since a line written there
+ * replaced it, so the second pass hands the lines to the sink as it decodes them, skipping the others,
+ * and memory does not grow with the number of lines.
+ *
+ * Key functions:
+ *    - session_create / session_write / session_sync / session_close: Write a session.
+ *    - session_mark / session_undo / session_redo: Record the undo journal in a session.
+ *    - session_open / session_run / session_free: Read a session.
+ */
+
+
+//==================== Header Files ====================
+#include "session.h"
+#include "journal.h"
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//==================== Macros ====================
+#define SESSION_EXTENSION ".session"          // Script names ending in this are sessions
+#define SESSION_MAGIC "TRTLSESS"              // First bytes of a session file
+#define SESSION_MAGIC_SIZE 8
+#define SESSION_VERSION 2                     // Version 1 had no undo or redo records
+#define SESSION_HEADER_SIZE 16
+#define BLOCK_HEADER_SIZE 16
+#define SESSION_BLOCK_RECORDS 4096            // Most records in a block
+#define SESSION_PALETTE_SIZE 256              // Most colors in the palette
+#define SESSION_SYNC_INTERVAL 1000            // Longest time lines wait in memory, in milliseconds
+#define RECORD_MAX_SIZE 30                    // Flags, RGB color, start point and end point
+#define PALETTE_ENTRY_SIZE 12                 // Three floats
+#define DELTA_SCALE 16.0f                     // Steps per unit of a stored difference
+#define READ_CHUNK_SIZE 65536                 // Bytes read at a time from a stream that cannot be mapped
+
+// Record flags
+#define RECORD_JUMP 0x01          // The start point follows
+#define RECORD_COLOR 0x02         // A palette index follows
+#define RECORD_RGB 0x04           // An RGB color follows
+#define RECORD_DELTA8 0x10        // The end point is a difference on one byte per axis
+#define RECORD_DELTA16 0x20       // The end point is a difference on two bytes per axis
+#define RECORD_FLAGS (RECORD_JUMP | RECORD_COLOR | RECORD_RGB | RECORD_DELTA8 | RECORD_DELTA16)
+#define RECORD_TRUNCATE 0x40      // Undo: the number of lines left follows, and no line
+#define RECORD_RESTORE 0x80       // Redo: the number of lines restored follows, and no line
+#define RUN_NONE INT64_MAX        // Start of a run without lines, see SessionPlayback
+
+
+//==================== Structure ====================
+typedef struct {  // Lines of one entry of the undo journal, counted in lines written
+    uint32_t first;                   // Number of lines when the entry started
+    uint32_t end;                     // Number of lines when the entry was undone
+} SessionMark;
+
+struct SessionWriter {
+    FILE* file;
+    char* path;                       // Path of the file, used in messages
+    bool failed;                      // Whether a write failed, after which nothing more is written
+    GLfloat palette[SESSION_PALETTE_SIZE][3];
+    int paletteCount;                 // Colors in the palette, including those of the current block
+    int blockPalette;                 // Colors first used in the current block
+    bool hasColor;                    // Whether a line was written, so the color below is set
+    GLfloat r, g, b;                  // Color of the last line
+    bool hasEnd;                      // Whether a line was written, so the end point below is set
+    GLfloat endX, endY;               // End point of the last line
+    uint32_t lineCount;               // Lines in the drawing, counting those written before an undo
+    uint32_t keptCount;               // Lines written and not replaced since, the undone ones included
+    SessionMark marks[JOURNAL_ENTRIES]; // Line ranges matching the journal entries
+    int markUndoCount;                // Number of marks that can be undone
+    int markRedoCount;                // Number of marks after them that can be redone
+    int blockRecords;                 // Records in the current block
+    size_t recordBytes;               // Bytes of records in the current block
+    Uint32 blockStart;                // When the first line of the current block was written, in ticks
+    unsigned char paletteBytes[SESSION_PALETTE_SIZE * PALETTE_ENTRY_SIZE];
+    unsigned char records[SESSION_BLOCK_RECORDS * RECORD_MAX_SIZE];
+};
+
+struct SessionReader {
+    char* name;                       // Name of the file, used in messages
+    const unsigned char* data;        // Contents of the file
+    size_t size;                      // Size of the contents in bytes
+    bool mapped;                      // Whether the contents are a mapping rather than a heap copy
+};
+
+typedef struct {  // Progress of a pass over the records of a session
+    uint32_t count;                   // Lines in the drawing after the records so far
+    uint32_t restorable;              // Most lines a redo can bring back
+    int64_t* runs;                    // Start of each run of lines in the first pass, then the limit of its lines
+    int runCount;                     // Runs in the session, a new one starting at every undo or redo
+    int runCapacity;                  // Runs the array can hold
+    int run;                          // Run of the record being decoded
+    bool counting;                    // Whether this is the first pass, which draws no line
+    LineSink sink;                    // Receives the lines that stay drawn in the second pass
+    void* context;                    // Passed to `sink` unchanged
+    bool drawn;                       // Whether a line reached the sink, so the line below is set
+    Line last;                        // Last line handed to the sink
+} SessionPlayback;
+
+
+//==================== Function Definitions ====================
+static unsigned char* put_u32(unsigned char* out, const uint32_t value) {
+/*
+ * put_u32 - Stores a 32-bit number in little-endian order and returns the byte after it.
+ */
+
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+    out[2] = (unsigned char)(value >> 16);
+    out[3] = (unsigned char)(value >> 24);
+    return out + 4;
+}
+
+
+static unsigned char* put_float(unsigned char* out, const GLfloat value) {
+/*
+ * put_float - Stores a float in little-endian order and returns the byte after it.
+ */
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return put_u32(out, bits);
+}
+
+
+static uint32_t get_u32(const unsigned char* in) {
+/*
+ * get_u32 - Reads a 32-bit little-endian number.
+ */
+
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+
+static GLfloat get_float(const unsigned char* in) {
+/*
+ * get_float - Reads a little-endian float.
+ */
+
+    const uint32_t bits = get_u32(in);
+    GLfloat value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+static uint32_t checksum(uint32_t hash, const unsigned char* data, const size_t size) {
+/*
+ * checksum - Continues a 32-bit FNV-1a hash over some bytes; start from 2166136261.
+ */
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+static inline GLfloat apply_delta(const GLfloat from, const int steps) {
+/*
+ * apply_delta - Adds a stored difference to a coordinate, the same way when writing and reading.
+ */
+
+    return from + (GLfloat)steps / DELTA_SCALE;
+}
+
+
+static bool encode_delta(const GLfloat from, const GLfloat to, const int limit, int* steps) {
+/*
+ * encode_delta - Finds the difference that leads exactly from one coordinate to another.
+ *
+ * Parameters:
+ *    from, to - The coordinates.
+ *    limit    - The largest magnitude the difference may have, in steps.
+ *    steps    - Receives the difference in 1/DELTA_SCALE steps.
+ *
+ * Returns:
+ *    true if such a difference exists within the limit, false otherwise.
+ */
+
+    const float scaled = (to - from) * DELTA_SCALE;
+    if (!(fabsf(scaled) <= (float)limit)) {
+        return false;
+    }
+    *steps = (int)lrintf(scaled);
+    return *steps >= -limit && *steps <= limit && apply_delta(from, *steps) == to;
+}
+
+
+SessionWriter* session_create(const char* path) {
+/*
+ * session_create - Creates a session file, replacing any file at the path.
+ *
+ * Parameters:
+ *    path - The path of the file.
+ *
+ * Returns:
+ *    The writer, to be closed with session_close, or NULL after reporting an error.
+ */
+
+    SessionWriter* writer = calloc(1, sizeof(SessionWriter));
+    const size_t pathLength = strlen(path);
+    if (!writer || !(writer->path = malloc(pathLength + 1))) {
+        printf("Error allocating memory for a session!\n");
+        exit(1);
+    }
+    memcpy(writer->path, path, pathLength + 1);
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        printf("Could not create %s\n", path);
+        free(writer->path);
+        free(writer);
+        return NULL;
+    }
+
+    unsigned char header[SESSION_HEADER_SIZE];
+    memcpy(header, SESSION_MAGIC, SESSION_MAGIC_SIZE);
+    put_u32(put_u32(header + SESSION_MAGIC_SIZE, SESSION_VERSION), SESSION_HEADER_SIZE);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) || fflush(writer->file) != 0) {
+        printf("Error writing session %s\n", path);
+        writer->failed = true;
+    }
+    return writer;
+}
+
+
+static void write_block(SessionWriter* writer) {
+/*
+ * write_block - Appends the current block to the file and starts a new one.
+ */
+
+    if (writer->blockRecords == 0) {
+        return;
+    }
+
+    if (!writer->failed) {
+        const size_t paletteSize = (size_t)writer->blockPalette * PALETTE_ENTRY_SIZE;
+        uint32_t hash = checksum(2166136261u, writer->paletteBytes, paletteSize);
+        hash = checksum(hash, writer->records, writer->recordBytes);
+
+        unsigned char header[BLOCK_HEADER_SIZE];
+        unsigned char* out = put_u32(header, (uint32_t)(paletteSize + writer->recordBytes));
+        out = put_u32(out, (uint32_t)writer->blockRecords);
+        out = put_u32(out, (uint32_t)writer->blockPalette);
+        put_u32(out, hash);
+
+        if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+            fwrite(writer->paletteBytes, 1, paletteSize, writer->file) != paletteSize ||
+            fwrite(writer->records, 1, writer->recordBytes, writer->file) != writer->recordBytes ||
+            fflush(writer->file) != 0) {
+            printf("Error writing session %s, no further lines are saved\n", writer->path);
+            writer->failed = true;
+        }
+    }
+
+    writer->blockRecords = 0;
+    writer->blockPalette = 0;
+    writer->recordBytes = 0;
+}
+
+
+static int writer_palette_index(SessionWriter* writer, const GLfloat r, const GLfloat g, const GLfloat b) {
+/*
+ * writer_palette_index - Finds or adds a color in the palette of a session being written.
+ *
+ * Returns:
+ *    The index of the color, or -1 when it is new and the palette is full.
+ */
+
+    for (int i = 0; i < writer->paletteCount; i++) {
+        if (writer->palette[i][0] == r && writer->palette[i][1] == g && writer->palette[i][2] == b) {
+            return i;
+        }
+    }
+    if (writer->paletteCount == SESSION_PALETTE_SIZE) {
+        return -1;
+    }
+
+    writer->palette[writer->paletteCount][0] = r;
+    writer->palette[writer->paletteCount][1] = g;
+    writer->palette[writer->paletteCount][2] = b;
+    unsigned char* out = &writer->paletteBytes[writer->blockPalette++ * PALETTE_ENTRY_SIZE];
+    put_float(put_float(put_float(out, r), g), b);
+    return writer->paletteCount++;
+}
+
+
+void session_write(SessionWriter* writer, const Line* line) {
+/*
+ * session_write - Adds a line to a session.
+ *
+ * The line is encoded at once but only reaches the file with its block, see session_sync.
+ *
+ * Parameters:
+ *    writer - The session.
+ *    line   - The line to add.
+ */
+
+    if (writer->blockRecords == 0) {
+        writer->blockStart = SDL_GetTicks();
+    }
+
+    unsigned char* record = &writer->records[writer->recordBytes];
+    unsigned char* out = record + 1;
+    unsigned char flags = 0;
+
+    if (!writer->hasColor || line->r != writer->r || line->g != writer->g || line->b != writer->b) {
+        const int index = writer_palette_index(writer, line->r, line->g, line->b);
+        if (index >= 0) {
+            flags |= RECORD_COLOR;
+            *out++ = (unsigned char)index;
+        } else {
+            flags |= RECORD_RGB;
+            out = put_float(put_float(put_float(out, line->r), line->g), line->b);
+        }
+        writer->hasColor = true;
+        writer->r = line->r;
+        writer->g = line->g;
+        writer->b = line->b;
+    }
+
+    if (!writer->hasEnd || line->x1 != writer->endX || line->y1 != writer->endY) {
+        flags |= RECORD_JUMP;
+        out = put_float(put_float(out, line->x1), line->y1);
+    }
+
+    int stepsX, stepsY;
+    if (encode_delta(line->x1, line->x2, INT8_MAX, &stepsX) && encode_delta(line->y1, line->y2, INT8_MAX, &stepsY)) {
+        flags |= RECORD_DELTA8;
+        *out++ = (unsigned char)(int8_t)stepsX;
+        *out++ = (unsigned char)(int8_t)stepsY;
+    } else if (encode_delta(line->x1, line->x2, INT16_MAX, &stepsX) &&
+               encode_delta(line->y1, line->y2, INT16_MAX, &stepsY)) {
+        flags |= RECORD_DELTA16;
+        const uint16_t bitsX = (uint16_t)(int16_t)stepsX, bitsY = (uint16_t)(int16_t)stepsY;
+        *out++ = (unsigned char)bitsX;
+        *out++ = (unsigned char)(bitsX >> 8);
+        *out++ = (unsigned char)bitsY;
+        *out++ = (unsigned char)(bitsY >> 8);
+    } else {
+        out = put_float(put_float(out, line->x2), line->y2);
+    }
+
+    // Decoding rebuilds the end point from the record, so the next line is compared with the same value
+    writer->hasEnd = true;
+    writer->endX = line->x2;
+    writer->endY = line->y2;
+
+    record[0] = flags;
+    writer->recordBytes += (size_t)(out - record);
+
+    // The line takes the place of the lines undone, which can no longer be redone
+    if (writer->lineCount < writer->keptCount) {
+        writer->markRedoCount = 0;
+    }
+    writer->keptCount = ++writer->lineCount;
+    if (++writer->blockRecords == SESSION_BLOCK_RECORDS) {
+        write_block(writer);
+    }
+}
+
+
+static void write_count(SessionWriter* writer, const unsigned char flag, const uint32_t count) {
+/*
+ * write_count - Adds an undo or redo record to a session, giving the number of lines the drawing has after it.
+ *
+ * Only changes are recorded, so the reader can check that an undo lowers the count and a redo raises it.
+ */
+
+    if (writer->blockRecords == 0) {
+        writer->blockStart = SDL_GetTicks();
+    }
+
+    unsigned char* record = &writer->records[writer->recordBytes];
+    record[0] = flag;
+    writer->recordBytes += (size_t)(put_u32(record + 1, count) - record);
+    writer->lineCount = count;
+    if (++writer->blockRecords == SESSION_BLOCK_RECORDS) {
+        write_block(writer);
+    }
+}
+
+
+void session_mark(SessionWriter* writer) {
+/*
+ * session_mark - Starts the lines of a new journal entry, as mark_lines does for the line store.
+ *
+ * Parameters:
+ *    writer - The session.
+ */
+
+    if (writer->markUndoCount == JOURNAL_ENTRIES) {
+        memmove(&writer->marks[0], &writer->marks[1], (JOURNAL_ENTRIES - 1) * sizeof(SessionMark));
+        writer->markUndoCount--;
+    }
+    writer->marks[writer->markUndoCount++] = (SessionMark){writer->lineCount, 0};
+    writer->markRedoCount = 0;
+}
+
+
+void session_undo(SessionWriter* writer) {
+/*
+ * session_undo - Records the undo of the last journal entry, cutting the drawing back to where it started.
+ *
+ * Parameters:
+ *    writer - The session.
+ */
+
+    if (writer->markUndoCount == 0) {
+        return;
+    }
+
+    SessionMark* mark = &writer->marks[--writer->markUndoCount];
+    writer->markRedoCount++;
+    mark->end = writer->lineCount;
+    if (mark->first < writer->lineCount) {
+        write_count(writer, RECORD_TRUNCATE, mark->first);
+    }
+}
+
+
+void session_redo(SessionWriter* writer) {
+/*
+ * session_redo - Records the redo of the last journal entry undone, restoring its lines.
+ *
+ * Parameters:
+ *    writer - The session.
+ */
+
+    if (writer->markRedoCount == 0) {
+        return;
+    }
+
+    // Like line_store_restore, only the lines still kept come back
+    const SessionMark* mark = &writer->marks[writer->markUndoCount++];
+    writer->markRedoCount--;
+    const uint32_t count = mark->end < writer->keptCount ? mark->end : writer->keptCount;
+    if (count > writer->lineCount) {
+        write_count(writer, RECORD_RESTORE, count);
+    }
+}
+
+
+void session_sync(SessionWriter* writer) {
+/*
+ * session_sync - Writes the current block once its first record has waited SESSION_SYNC_INTERVAL.
+ *
+ * Called regularly, once per frame, so a drawing that grows slowly still reaches the file.
+ *
+ * Parameters:
+ *    writer - The session.
+ */
+
+    if (writer->blockRecords > 0 && SDL_GetTicks() - writer->blockStart >= SESSION_SYNC_INTERVAL) {
+        write_block(writer);
+    }
+}
+
+
+bool session_close(SessionWriter* writer) {
+/*
+ * session_close - Writes the remaining lines of a session and closes its file.
+ *
+ * Parameters:
+ *    writer - The session, or NULL.
+ *
+ * Returns:
+ *    true if every line reached the file, false otherwise.
+ */
+
+    if (!writer) {
+        return true;
+    }
+
+    write_block(writer);
+    bool succeeded = !writer->failed;
+    if (fclose(writer->file) != 0 && succeeded) {
+        printf("Error writing session %s\n", writer->path);
+        succeeded = false;
+    }
+    free(writer->path);
+    free(writer);
+    return succeeded;
+}
+
+
+bool session_file(const char* name) {
+/*
+ * session_file - Tells whether a script name designates a session file, from its extension.
+ */
+
+    const size_t length = strlen(name);
+    const size_t extensionLength = strlen(SESSION_EXTENSION);
+    return length > extensionLength && strcmp(name + length - extensionLength, SESSION_EXTENSION) == 0;
+}
+
+
+static unsigned char* read_stream(FILE* input, size_t* size) {
+/*
+ * read_stream - Reads the rest of a stream that cannot be mapped into a heap buffer.
+ */
+
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t used = 0;
+    unsigned char* data = malloc(capacity);
+    if (!data) {
+        printf("Error allocating memory for a session!\n");
+        exit(1);
+    }
+
+    size_t got;
+    while ((got = fread(data + used, 1, capacity - used, input)) > 0) {
+        used += got;
+        if (used == capacity) {
+            capacity *= 2;
+            unsigned char* newData = realloc(data, capacity);
+            if (!newData) {
+                printf("Error reallocating memory for a session!\n");
+                exit(1);
+            }
+            data = newData;
+        }
+    }
+    *size = used;
+    return data;
+}
+
+
+SessionReader* session_open(FILE* input, const char* name) {
+/*
+ * session_open - Maps a session file into memory and checks its header.
+ *
+ * The mapping outlives the stream, which the caller may close right away.
+ *
+ * Parameters:
+ *    input - The stream to read, positioned at its start.
+ *    name  - The name of the stream, used in messages.
+ *
+ * Returns:
+ *    The reader, to be released with session_free, or NULL after reporting an error.
+ */
+
+    SessionReader* reader = calloc(1, sizeof(SessionReader));
+    const size_t nameLength = strlen(name);
+    if (!reader || !(reader->name = malloc(nameLength + 1))) {
+        printf("Error allocating memory for a session!\n");
+        exit(1);
+    }
+    memcpy(reader->name, name, nameLength + 1);
+
+    struct stat status;
+    const int descriptor = fileno(input);
+    if (descriptor >= 0 && fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        void* mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, (size_t)status.st_size, MADV_SEQUENTIAL);
+            reader->data = mapping;
+            reader->size = (size_t)status.st_size;
+            reader->mapped = true;
+        }
+    }
+    if (!reader->mapped) {
+        reader->data = read_stream(input, &reader->size);
+    }
+
+    if (reader->size < SESSION_HEADER_SIZE || memcmp(reader->data, SESSION_MAGIC, SESSION_MAGIC_SIZE) != 0) {
+        printf("%s is not a session file\n", name);
+        session_free(reader);
+        return NULL;
+    }
+    const uint32_t version = get_u32(reader->data + SESSION_MAGIC_SIZE);
+    const uint32_t headerSize = get_u32(reader->data + SESSION_MAGIC_SIZE + 4);
+    if (version < 1 || version > SESSION_VERSION || headerSize < SESSION_HEADER_SIZE || headerSize > reader->size) {
+        printf("%s: unsupported session version %u\n", name, (unsigned)version);
+        session_free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+
+static void grow_runs(SessionPlayback* playback) {
+/*
+ * grow_runs - Starts a new run of lines in the first pass, after an undo or redo record.
+ */
+
+    if (playback->runCount == playback->runCapacity) {
+        const int capacity = playback->runCapacity * 2;
+        int64_t* newRuns = realloc(playback->runs, (size_t)capacity * sizeof(int64_t));
+        if (!newRuns) {
+            printf("Error reallocating memory for a session!\n");
+            exit(1);
+        }
+        playback->runs = newRuns;
+        playback->runCapacity = capacity;
+    }
+    playback->runs[playback->runCount++] = RUN_NONE;
+}
+
+
+static bool decode_block(const unsigned char* payload, const size_t size, const int recordCount,
+                         const int paletteAdded, GLfloat (*palette)[3], int* paletteCount, Line* current,
+                         SessionPlayback* playback) {
+/*
+ * decode_block - Decodes the records of a block and hands the lines that stay drawn to a sink.
+ *
+ * Parameters:
+ *    payload      - The payload of the block, already checked against its checksum.
+ *    size         - The size of the payload in bytes.
+ *    recordCount  - The number of records in the block.
+ *    paletteAdded - The number of palette entries at the start of the payload.
+ *    palette      - The palette, receiving the new entries.
+ *    paletteCount - The number of palette entries, updated.
+ *    current      - The last line decoded, whose color and end point the next line starts from.
+ *    playback     - The pass over the session, updated.
+ *
+ * Returns:
+ *    true if the whole block decoded, false at a malformed record or a color or coordinate that is not
+ *    a finite number.
+ */
+
+    const unsigned char* in = payload;
+    const unsigned char* end = payload + size;
+    if (paletteAdded > SESSION_PALETTE_SIZE - *paletteCount ||
+        (size_t)paletteAdded * PALETTE_ENTRY_SIZE > size) {
+        return false;
+    }
+    for (int i = 0; i < paletteAdded; i++, in += PALETTE_ENTRY_SIZE) {
+        palette[*paletteCount][0] = get_float(in);
+        palette[*paletteCount][1] = get_float(in + 4);
+        palette[*paletteCount][2] = get_float(in + 8);
+        if (!isfinite(palette[*paletteCount][0]) || !isfinite(palette[*paletteCount][1]) ||
+            !isfinite(palette[*paletteCount][2])) {
+            return false;
+        }
+        (*paletteCount)++;
+    }
+
+    Line line = *current;
+    for (int i = 0; i < recordCount; i++) {
+        if (in == end) {
+            return false;
+        }
+        const unsigned char flags = *in++;
+
+        // An undo or redo changes the number of lines drawn and starts a new run
+        if (flags == RECORD_TRUNCATE || flags == RECORD_RESTORE) {
+            if ((size_t)(end - in) < 4) {
+                return false;
+            }
+            const uint32_t count = get_u32(in);
+            in += 4;
+            if (flags == RECORD_TRUNCATE ? count > playback->count
+                                         : (count < playback->count || count > playback->restorable)) {
+                return false;
+            }
+            playback->count = count;
+            if (playback->counting) {
+                grow_runs(playback);
+            }
+            playback->run++;
+            continue;
+        }
+
+        const size_t needed = ((flags & RECORD_COLOR) ? 1 : 0) + ((flags & RECORD_RGB) ? 12 : 0) +
+                              ((flags & RECORD_JUMP) ? 8 : 0) +
+                              ((flags & RECORD_DELTA8) ? 2 : (flags & RECORD_DELTA16) ? 4 : 8);
+        if ((flags & ~RECORD_FLAGS) || (size_t)(end - in) < needed || playback->count == UINT32_MAX ||
+            ((flags & RECORD_COLOR) && (flags & RECORD_RGB)) || ((flags & RECORD_DELTA8) && (flags & RECORD_DELTA16))) {
+            return false;
+        }
+
+        if (flags & RECORD_COLOR) {
+            const int index = *in++;
+            if (index >= *paletteCount) {
+                return false;
+            }
+            line.r = palette[index][0];
+            line.g = palette[index][1];
+            line.b = palette[index][2];
+        } else if (flags & RECORD_RGB) {
+            line.r = get_float(in);
+            line.g = get_float(in + 4);
+            line.b = get_float(in + 8);
+            in += 12;
+        }
+
+        if (flags & RECORD_JUMP) {
+            line.x1 = get_float(in);
+            line.y1 = get_float(in + 4);
+            in += 8;
+        } else {
+            line.x1 = line.x2;
+            line.y1 = line.y2;
+        }
+
+        if (flags & RECORD_DELTA8) {
+            line.x2 = apply_delta(line.x1, (int8_t)in[0]);
+            line.y2 = apply_delta(line.y1, (int8_t)in[1]);
+            in += 2;
+        } else if (flags & RECORD_DELTA16) {
+            line.x2 = apply_delta(line.x1, (int16_t)(uint16_t)(in[0] | in[1] << 8));
+            line.y2 = apply_delta(line.y1, (int16_t)(uint16_t)(in[2] | in[3] << 8));
+            in += 4;
+        } else {
+            line.x2 = get_float(in);
+            line.y2 = get_float(in + 4);
+            in += 8;
+        }
+
+        // A line that is not a finite number was never drawn, so the block is damaged
+        if (!isfinite(line.x1) || !isfinite(line.y1) || !isfinite(line.x2) || !isfinite(line.y2) ||
+            !isfinite(line.r) || !isfinite(line.g) || !isfinite(line.b)) {
+            return false;
+        }
+
+        // The first pass notes where the run starts, the second keeps the lines no later line replaces
+        int64_t* run = &playback->runs[playback->run];
+        if (playback->counting) {
+            if (*run == RUN_NONE) {
+                *run = playback->count;
+            }
+        } else if (playback->count < *run) {
+            playback->sink(&line, playback->context);
+            playback->drawn = true;
+            playback->last = line;
+        }
+        playback->count++;
+        playback->restorable = playback->count;
+    }
+
+    *current = line;
+    return in == end;
+}
+
+
+static void start_pass(SessionPlayback* playback, int* paletteCount, Line* current, const Turtle* turtle) {
+/*
+ * start_pass - Resets the decoding state before a pass over the blocks.
+ */
+
+    playback->count = 0;
+    playback->restorable = 0;
+    playback->run = 0;
+    *paletteCount = 0;
+    *current = (Line){turtle->x, turtle->y, turtle->x, turtle->y, turtle->r, turtle->g, turtle->b};
+}
+
+
+bool session_run(const SessionReader* reader, Turtle* turtle, const LineSink sink, void* context) {
+/*
+ * session_run - Hands the lines of a session to a sink, in the order they were drawn, leaving out those undone.
+ *
+ * Decoding stops at the first block that is cut short or does not match its checksum, which is normal
+ * for a session whose program crashed, and the records before it are kept. The turtle ends at the end of
+ * the last line drawn, with its color; its heading and pen are left alone.
+ *
+ * Parameters:
+ *    reader  - The session.
+ *    turtle  - The turtle to move.
+ *    sink    - Receives the lines drawn.
+ *    context - Passed to `sink` unchanged.
+ *
+ * Returns:
+ *    true, a damaged block being reported but not an error.
+ */
+
+    GLfloat palette[SESSION_PALETTE_SIZE][3];
+    int paletteCount;
+    Line current;
+    SessionPlayback playback = {.counting = true, .sink = sink, .context = context};
+    playback.runCapacity = 16;
+    if (!(playback.runs = malloc((size_t)playback.runCapacity * sizeof(int64_t)))) {
+        printf("Error allocating memory for a session!\n");
+        exit(1);
+    }
+    playback.runs[0] = RUN_NONE;
+    playback.runCount = 1;
+
+    // First pass: check the blocks and find where each run of lines starts
+    start_pass(&playback, &paletteCount, &current, turtle);
+    const size_t start = get_u32(reader->data + SESSION_MAGIC_SIZE + 4);
+    size_t offset = start;
+    uint32_t validCount = 0;
+    int validRuns = 1;
+    int64_t validRunStart = RUN_NONE;
+    while (offset < reader->size) {
+        const unsigned char* header = reader->data + offset;
+        if (reader->size - offset < BLOCK_HEADER_SIZE) {
+            printf("%s: ignored a damaged block after %lu lines\n", reader->name, (unsigned long)validCount);
+            break;
+        }
+        const size_t payloadSize = get_u32(header);
+        const uint32_t blockRecords = get_u32(header + 4);
+        const uint32_t paletteAdded = get_u32(header + 8);
+        const unsigned char* payload = header + BLOCK_HEADER_SIZE;
+        if (payloadSize > reader->size - offset - BLOCK_HEADER_SIZE || blockRecords > SESSION_BLOCK_RECORDS ||
+            paletteAdded > SESSION_PALETTE_SIZE ||
+            checksum(2166136261u, payload, payloadSize) != get_u32(header + 12) ||
+            !decode_block(payload, payloadSize, (int)blockRecords, (int)paletteAdded, palette, &paletteCount, &current,
+                          &playback)) {
+            printf("%s: ignored a damaged block after %lu lines\n", reader->name, (unsigned long)validCount);
+            break;
+        }
+        offset += BLOCK_HEADER_SIZE + payloadSize;
+        validCount = playback.count;
+        validRuns = playback.runCount;
+        validRunStart = playback.runs[validRuns - 1];
+    }
+
+    // Forget what a damaged block decoded before it failed
+    playback.count = validCount;
+    playback.runCount = validRuns;
+    playback.runs[validRuns - 1] = validRunStart;
+
+    // A line stays drawn below the final count and below the start of every later run, which replaced it
+    int64_t limit = playback.count;
+    for (int i = playback.runCount - 1; i >= 0; i--) {
+        const int64_t runStart = playback.runs[i];
+        playback.runs[i] = limit;
+        if (runStart < limit) {
+            limit = runStart;
+        }
+    }
+
+    // Second pass, over the blocks the first accepted: hand the lines that stay drawn to the sink
+    const size_t validEnd = offset;
+    playback.counting = false;
+    start_pass(&playback, &paletteCount, &current, turtle);
+    for (offset = start; offset < validEnd; offset += BLOCK_HEADER_SIZE + get_u32(reader->data + offset)) {
+        const unsigned char* header = reader->data + offset;
+        decode_block(header + BLOCK_HEADER_SIZE, get_u32(header), (int)get_u32(header + 4), (int)get_u32(header + 8),
+                     palette, &paletteCount, &current, &playback);
+    }
+    free(playback.runs);
+
+    if (playback.drawn) {
+        turtle->x = playback.last.x2;
+        turtle->y = playback.last.y2;
+        turtle->r = playback.last.r;
+        turtle->g = playback.last.g;
+        turtle->b = playback.last.b;
+    }
+    return true;
+}
+
+
+void session_free(SessionReader* reader) {
+/*
+ * session_free - Unmaps a session file and releases its reader.
+ *
+ * Parameters:
+ *    reader - The reader, or NULL.
+ */
+
+    if (!reader) {
+        return;
+    }
+    if (reader->mapped) {
+        munmap((void*)reader->data, reader->size);
+    } else {
+        free((void*)reader->data);
+    }
+    free(reader->name);
+    free(reader);
+}
@@ -0,0 +1,701 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * spatial.c - Sparse uniform grid over the stored lines.
+ *
+ * The drawing is divided into square cells of SPATIAL_CELL_SIZE pixels. Each non-empty cell is an entry
+ * of an open-addressing hash table and lists the indices of the lines crossing it, so empty regions cost
+ * nothing and the grid has no fixed extent. A line is entered in the cells it passes through, found by
+ * walking the grid along it one cell boundary at a time, so it costs one entry per cell of its length
+ * however it is oriented, and turtle lines are short enough to touch one or two cells. A query visits the
+ * cells overlapping its box, or every occupied cell when its box covers more cells than are occupied, so
+ * a query of a zoomed-out view costs no more than the drawing holds.
+ *
+ * A line running through more than SPATIAL_LONG_CELLS cells is kept in a separate list of long lines that
+ * every query tests, so a single line across the whole plane costs one entry rather than millions of
+ * cells. Cell coordinates are clamped to SPATIAL_CELL_LIMIT, far beyond any drawing, so positions too large
+ * for an int still map to a cell, and lines with a non-finite coordinate are not indexed at all.
+ *
+ * Lines are only ever appended or extended at their end, so a cell list is kept in increasing index
+ * order and a line is never removed from a cell it once crossed. Extending the last line re-inserts it,
+ * and the check against the last entry of each cell keeps it from being listed twice. Entries for lines
+ * the line store has flattened are dropped from a cell the next time a query visits it. Lines hidden by
+ * undo sit at the end of the cell lists, where queries stop before them, and are cut off with
+ * spatial_truncate once the store frees them. The bounds keep covering them. The list of long lines is
+ * kept in increasing index order and pruned and truncated the same way.
+ *
+ * Key functions:
+ *    - spatial_insert: Adds a line to every cell it passes through.
+ *    - spatial_query_box: Lists the lines crossing a box, sorted by index.
+ *    - spatial_truncate: Forgets the lines from an index onward.
+ *    - spatial_nearest: Finds the closest line to a point.
+ */
+
+
+//==================== Header Files ====================
+#include "spatial.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define SPATIAL_CELL_SIZE 32.0f   // Width and height of a grid cell in pixels
+#define INITIAL_CELL_SLOTS 256    // Initial capacity of the cell hash table, a power of two
+#define INITIAL_CELL_LINES 8      // Initial capacity of a cell's line list
+#define SPATIAL_LONG_CELLS 64     // Lines crossing more cell boundaries than this go to the long line list
+#define SPATIAL_CELL_LIMIT 16777216.0f // Largest cell coordinate magnitude, 2^24 cells from the origin
+
+
+//==================== Structure ====================
+typedef struct {  // Grid cell and the lines crossing it
+    int cx, cy;               // Cell coordinates, in cells from the origin
+    int* lines;               // Indices of the lines crossing the cell, in increasing order
+    int count;                // Number of lines in the cell
+    int capacity;             // Capacity of `lines`
+} Cell;
+
+
+//==================== Global Variables ====================
+static Cell* cells = NULL;          // Open-addressing hash table of cells, empty slots have `lines == NULL`
+static int cellSlots = 0;           // Capacity of the hash table
+static int cellCount = 0;           // Number of cells in use
+
+static bool hasBounds = false;      // Whether any line was indexed
+static float boundsMinX, boundsMinY, boundsMaxX, boundsMaxY;
+
+static int* longLines = NULL;       // Indices of the lines too long to enter in cells, in increasing order
+static int longCount = 0;           // Number of long lines
+static int longCapacity = 0;        // Capacity of `longLines`
+
+static int* results = NULL;         // Buffer returned by spatial_query_box
+static int resultCapacity = 0;
+
+
+//==================== Function Definitions ====================
+static unsigned int hash_cell(const int cx, const int cy) {
+/*
+ * hash_cell - Hashes cell coordinates to a hash table slot.
+ */
+
+    return ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u);
+}
+
+
+static int cell_coordinate(const float value) {
+/*
+ * cell_coordinate - Returns the cell coordinate containing a position along one axis.
+ *
+ * Positions beyond SPATIAL_CELL_LIMIT cells share the outermost cell, and NaN maps to the lowest one, so
+ * the conversion to int is always defined.
+ */
+
+    return (int)fminf(fmaxf(floorf(value / SPATIAL_CELL_SIZE), -SPATIAL_CELL_LIMIT), SPATIAL_CELL_LIMIT);
+}
+
+
+static Cell* find_cell(const int cx, const int cy) {
+/*
+ * find_cell - Returns the cell at the given coordinates, or NULL if no line crosses it.
+ */
+
+    if (cellSlots == 0) {
+        return NULL;
+    }
+
+    for (unsigned int slot = hash_cell(cx, cy) & (cellSlots - 1);; slot = (slot + 1) & (cellSlots - 1)) {
+        Cell* cell = &cells[slot];
+        if (!cell->lines) {
+            return NULL;
+        }
+        if (cell->cx == cx && cell->cy == cy) {
+            return cell;
+        }
+    }
+}
+
+
+static void grow_cells(void) {
+/*
+ * grow_cells - Doubles the capacity of the cell hash table and rehashes every cell.
+ */
+
+    const int newSlots = cellSlots > 0 ? cellSlots * 2 : INITIAL_CELL_SLOTS;
+    Cell* newCells = calloc((size_t)newSlots, sizeof(Cell));
+    if (!newCells) {
+        printf("Error allocating memory for the spatial index!\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < cellSlots; i++) {
+        if (!cells[i].lines) {
+            continue;
+        }
+        unsigned int slot = hash_cell(cells[i].cx, cells[i].cy) & (newSlots - 1);
+        while (newCells[slot].lines) {
+            slot = (slot + 1) & (newSlots - 1);
+        }
+        newCells[slot] = cells[i];
+    }
+
+    free(cells);
+    cells = newCells;
+    cellSlots = newSlots;
+}
+
+
+static Cell* get_cell(const int cx, const int cy) {
+/*
+ * get_cell - Returns the cell at the given coordinates, creating it if needed.
+ */
+
+    Cell* cell = find_cell(cx, cy);
+    if (cell) {
+        return cell;
+    }
+
+    // Keep the table at most 70% full
+    if ((cellCount + 1) * 10 > cellSlots * 7) {
+        grow_cells();
+    }
+
+    unsigned int slot = hash_cell(cx, cy) & (cellSlots - 1);
+    while (cells[slot].lines) {
+        slot = (slot + 1) & (cellSlots - 1);
+    }
+
+    cell = &cells[slot];
+    cell->cx = cx;
+    cell->cy = cy;
+    cell->count = 0;
+    cell->capacity = INITIAL_CELL_LINES;
+    cell->lines = malloc((size_t)cell->capacity * sizeof(int));
+    if (!cell->lines) {
+        printf("Error allocating memory for the spatial index!\n");
+        exit(1);
+    }
+    cellCount++;
+    return cell;
+}
+
+
+static void add_to_cell(const int cx, const int cy, const int index) {
+/*
+ * add_to_cell - Lists a line in a cell, unless it is already its last entry.
+ */
+
+    Cell* cell = get_cell(cx, cy);
+    if (cell->count > 0 && cell->lines[cell->count - 1] == index) {
+        return;
+    }
+    if (cell->count == cell->capacity) {
+        int* newLines = realloc(cell->lines, (size_t)cell->capacity * 2 * sizeof(int));
+        if (!newLines) {
+            printf("Error reallocating memory for the spatial index!\n");
+            exit(1);
+        }
+        cell->lines = newLines;
+        cell->capacity *= 2;
+    }
+    cell->lines[cell->count++] = index;
+}
+
+
+static void add_point_cells(const double x, const double y, const int index) {
+/*
+ * add_point_cells - Lists a line in every cell touching a point of it: one, or two or four when the point
+ * lies on cell boundaries, since a cell holds the lines touching its edges as well as those crossing it.
+ */
+
+    const int cx = cell_coordinate((float)x);
+    const int cy = cell_coordinate((float)y);
+    const int fromX = (double)cx * SPATIAL_CELL_SIZE == x ? cx - 1 : cx;
+    const int fromY = (double)cy * SPATIAL_CELL_SIZE == y ? cy - 1 : cy;
+    for (int ty = fromY; ty <= cy; ty++) {
+        for (int tx = fromX; tx <= cx; tx++) {
+            add_to_cell(tx, ty, index);
+        }
+    }
+}
+
+
+static void add_long_line(const int index) {
+/*
+ * add_long_line - Lists a line among the long lines, unless it is already the last of them.
+ */
+
+    if (longCount > 0 && longLines[longCount - 1] == index) {
+        return;
+    }
+    if (longCount == longCapacity) {
+        const int newCapacity = longCapacity > 0 ? longCapacity * 2 : INITIAL_CELL_LINES;
+        int* newLines = realloc(longLines, (size_t)newCapacity * sizeof(int));
+        if (!newLines) {
+            printf("Error reallocating memory for the spatial index!\n");
+            exit(1);
+        }
+        longLines = newLines;
+        longCapacity = newCapacity;
+    }
+    longLines[longCount++] = index;
+}
+
+
+static bool segment_hits_box(const Line* line, const float minX, const float minY,
+                             const float maxX, const float maxY) {
+/*
+ * segment_hits_box - Tests whether a line crosses an axis-aligned box.
+ *
+ * The segment is clipped against the box one axis at a time (Liang-Barsky); it crosses the box if
+ * any part of it survives.
+ */
+
+    float t0 = 0.0f, t1 = 1.0f;
+    const float dx = line->x2 - line->x1;
+    const float dy = line->y2 - line->y1;
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {line->x1 - minX, maxX - line->x1, line->y1 - minY, maxY - line->y1};
+
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) {
+                return false;
+            }
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0.0f) {
+            if (t > t1) {
+                return false;
+            }
+            if (t > t0) {
+                t0 = t;
+            }
+        } else {
+            if (t < t0) {
+                return false;
+            }
+            if (t < t1) {
+                t1 = t;
+            }
+        }
+    }
+    return true;
+}
+
+
+static float segment_distance(const Line* line, const float x, const float y) {
+/*
+ * segment_distance - Returns the distance from a point to a line segment.
+ */
+
+    const float dx = line->x2 - line->x1;
+    const float dy = line->y2 - line->y1;
+    const float lengthSquared = dx * dx + dy * dy;
+
+    float t = 0.0f;
+    if (lengthSquared > 0.0f) {
+        t = ((x - line->x1) * dx + (y - line->y1) * dy) / lengthSquared;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    }
+
+    const float px = line->x1 + t * dx - x;
+    const float py = line->y1 + t * dy - y;
+    return sqrtf(px * px + py * py);
+}
+
+
+void spatial_init(void) {
+/*
+ * spatial_init - Sets up an empty index, releasing any previous one.
+ */
+
+    spatial_free();
+}
+
+
+void spatial_free(void) {
+/*
+ * spatial_free - Releases all memory held by the index and empties it.
+ */
+
+    for (int i = 0; i < cellSlots; i++) {
+        free(cells[i].lines);
+    }
+    free(cells);
+    cells = NULL;
+    cellSlots = 0;
+    cellCount = 0;
+
+    free(longLines);
+    longLines = NULL;
+    longCount = 0;
+    longCapacity = 0;
+
+    free(results);
+    results = NULL;
+    resultCapacity = 0;
+
+    hasBounds = false;
+}
+
+
+void spatial_insert(const int index, const Line* line) {
+/*
+ * spatial_insert - Adds a line to every cell it crosses, or to the long lines.
+ *
+ * Calling this again for the same line after it was extended is how the index is kept up to date: the
+ * line is only added to the cells it did not cross before, or moved to the long lines once it grows past
+ * SPATIAL_LONG_CELLS. The line must be the last one stored. A line with a non-finite coordinate, which
+ * no query could find, is left out.
+ *
+ * Parameters:
+ *    index - Index of the line in the line store.
+ *    line  - The line, with its current end point.
+ */
+
+    if (!isfinite(line->x1) || !isfinite(line->y1) || !isfinite(line->x2) || !isfinite(line->y2)) {
+        return;
+    }
+
+    const float minX = fminf(line->x1, line->x2);
+    const float minY = fminf(line->y1, line->y2);
+    const float maxX = fmaxf(line->x1, line->x2);
+    const float maxY = fmaxf(line->y1, line->y2);
+
+    if (!hasBounds) {
+        boundsMinX = minX;
+        boundsMinY = minY;
+        boundsMaxX = maxX;
+        boundsMaxY = maxY;
+        hasBounds = true;
+    } else {
+        boundsMinX = fminf(boundsMinX, minX);
+        boundsMinY = fminf(boundsMinY, minY);
+        boundsMaxX = fmaxf(boundsMaxX, maxX);
+        boundsMaxY = fmaxf(boundsMaxY, maxY);
+    }
+
+    // Walk the cells along the segment from its start (Amanatides and Woo): each step crosses the nearer
+    // of the next vertical and horizontal cell boundaries. The walk takes exactly one step per boundary
+    // between the end cells, so rounding can never carry it past the end. The ends and every crossing
+    // also enter the cells they touch, which covers a line meeting a corner or running along a boundary.
+    int cx = cell_coordinate(line->x1);
+    int cy = cell_coordinate(line->y1);
+    const int endX = cell_coordinate(line->x2);
+    const int endY = cell_coordinate(line->y2);
+    const int stepX = endX > cx ? 1 : -1;
+    const int stepY = endY > cy ? 1 : -1;
+
+    // A long line would take one step per cell, so it is listed once and tested by every query instead
+    if (abs(endX - cx) + abs(endY - cy) > SPATIAL_LONG_CELLS) {
+        add_long_line(index);
+        return;
+    }
+
+    const double dx = (double)line->x2 - line->x1;
+    const double dy = (double)line->y2 - line->y1;
+
+    // Fraction of the segment at which it crosses the next boundary on each axis, and between two of them
+    double nextX = INFINITY, nextY = INFINITY, deltaX = INFINITY, deltaY = INFINITY;
+    if (cx != endX) {
+        const double boundary = (double)(stepX > 0 ? cx + 1 : cx) * SPATIAL_CELL_SIZE;
+        nextX = (boundary - line->x1) / dx;
+        deltaX = SPATIAL_CELL_SIZE / fabs(dx);
+    }
+    if (cy != endY) {
+        const double boundary = (double)(stepY > 0 ? cy + 1 : cy) * SPATIAL_CELL_SIZE;
+        nextY = (boundary - line->y1) / dy;
+        deltaY = SPATIAL_CELL_SIZE / fabs(dy);
+    }
+
+    add_point_cells(line->x1, line->y1, index);
+    while (cx != endX || cy != endY) {
+        if (cy == endY || (cx != endX && nextX < nextY)) {
+            const double boundary = (double)(stepX > 0 ? cx + 1 : cx) * SPATIAL_CELL_SIZE;
+            add_point_cells(boundary, line->y1 + nextX * dy, index);
+            cx += stepX;
+            nextX += deltaX;
+        } else {
+            const double boundary = (double)(stepY > 0 ? cy + 1 : cy) * SPATIAL_CELL_SIZE;
+            add_point_cells(line->x1 + nextY * dx, boundary, index);
+            cy += stepY;
+            nextY += deltaY;
+        }
+        add_to_cell(cx, cy, index);
+    }
+    add_point_cells(line->x2, line->y2, index);
+}
+
+
+bool spatial_bounds(float* minX, float* minY, float* maxX, float* maxY) {
+/*
+ * spatial_bounds - Reports the bounding box of every line indexed so far.
+ *
+ * Parameters:
+ *    minX, minY, maxX, maxY - Receive the corners of the bounding box.
+ *
+ * Returns:
+ *    true if at least one line was indexed, false if the index is empty.
+ */
+
+    if (!hasBounds) {
+        return false;
+    }
+    *minX = boundsMinX;
+    *minY = boundsMinY;
+    *maxX = boundsMaxX;
+    *maxY = boundsMaxY;
+    return true;
+}
+
+
+static int compare_indices(const void* a, const void* b) {
+/*
+ * compare_indices - qsort comparator for line indices.
+ */
+
+    const int left = *(const int*)a;
+    const int right = *(const int*)b;
+    return (left > right) - (left < right);
+}
+
+
+static void add_result(const int index, int* count) {
+/*
+ * add_result - Appends a line index to the query result buffer.
+ */
+
+    if (*count == resultCapacity) {
+        const int newCapacity = resultCapacity > 0 ? resultCapacity * 2 : 1024;
+        int* newResults = realloc(results, (size_t)newCapacity * sizeof(int));
+        if (!newResults) {
+            printf("Error reallocating memory for spatial query results!\n");
+            exit(1);
+        }
+        results = newResults;
+        resultCapacity = newCapacity;
+    }
+    results[(*count)++] = index;
+}
+
+
+static void prune_lines(int* lines, int* count, const int first) {
+/*
+ * prune_lines - Drops the entries of a cell or of the long lines that refer to lines the store has flattened.
+ */
+
+    int keep = 0;
+    while (keep < *count && lines[keep] < first) {
+        keep++;
+    }
+    if (keep == 0) {
+        return;
+    }
+    for (int i = keep; i < *count; i++) {
+        lines[i - keep] = lines[i];
+    }
+    *count -= keep;
+}
+
+
+void spatial_truncate(const int count) {
+/*
+ * spatial_truncate - Drops every entry that refers to a line at or after `count`.
+ *
+ * This is used when the line store frees lines hidden by undo, before new lines take their indices.
+ * Entries are sorted in every cell, so only their tails are looked at.
+ *
+ * Parameters:
+ *    count - The number of lines the store keeps.
+ */
+
+    for (int i = 0; i < cellSlots; i++) {
+        Cell* cell = &cells[i];
+        while (cell->count > 0 && cell->lines[cell->count - 1] >= count) {
+            cell->count--;
+        }
+    }
+    while (longCount > 0 && longLines[longCount - 1] >= count) {
+        longCount--;
+    }
+}
+
+
+static void query_cell(Cell* cell, const int first, const int end, const float minX, const float minY,
+                       const float maxX, const float maxY, int* count) {
+/*
+ * query_cell - Adds the lines of a cell that cross a box to the query results.
+ *
+ * Parameters:
+ *    cell                   - A cell overlapping the box.
+ *    first, end             - The range of lines the line store can still report.
+ *    minX, minY, maxX, maxY - The corners of the box.
+ *    count                  - The number of results, increased for each line added.
+ */
+
+    prune_lines(cell->lines, &cell->count, first);
+
+    // Cells fully inside the box need no per-line test
+    const float cellX = (float)cell->cx * SPATIAL_CELL_SIZE;
+    const float cellY = (float)cell->cy * SPATIAL_CELL_SIZE;
+    const bool inside = cellX >= minX && cellY >= minY &&
+                        cellX + SPATIAL_CELL_SIZE <= maxX && cellY + SPATIAL_CELL_SIZE <= maxY;
+
+    Line line;
+    for (int i = 0; i < cell->count && cell->lines[i] < end; i++) {
+        if (inside || (line_store_get(cell->lines[i], &line) &&
+                       segment_hits_box(&line, minX, minY, maxX, maxY))) {
+            add_result(cell->lines[i], count);
+        }
+    }
+}
+
+
+int spatial_query_box(const float minX, const float minY, const float maxX, const float maxY,
+                      const int** indices) {
+/*
+ * spatial_query_box - Lists the lines crossing an axis-aligned box.
+ *
+ * The indices are sorted, so drawing them in order keeps the overlap order of the full drawing. Lines
+ * the line store has flattened or hidden are not reported.
+ *
+ * Parameters:
+ *    minX, minY, maxX, maxY - The corners of the box.
+ *    indices                - Receives a pointer to the indices, valid until the next query.
+ *
+ * Returns:
+ *    The number of lines found.
+ */
+
+    const int first = line_store_first();
+    const int end = line_store_count();
+    const int minCX = cell_coordinate(minX);
+    const int minCY = cell_coordinate(minY);
+    const int maxCX = cell_coordinate(maxX);
+    const int maxCY = cell_coordinate(maxY);
+    int count = 0;
+
+    // A box covering more cells than are occupied is answered from the occupied cells instead
+    const double boxCells = ((double)maxCX - minCX + 1.0) * ((double)maxCY - minCY + 1.0);
+    if (boxCells > (double)cellCount) {
+        for (int i = 0; i < cellSlots; i++) {
+            Cell* cell = &cells[i];
+            if (cell->lines && cell->cx >= minCX && cell->cx <= maxCX && cell->cy >= minCY && cell->cy <= maxCY) {
+                query_cell(cell, first, end, minX, minY, maxX, maxY, &count);
+            }
+        }
+    } else {
+        for (int cy = minCY; cy <= maxCY; cy++) {
+            for (int cx = minCX; cx <= maxCX; cx++) {
+                Cell* cell = find_cell(cx, cy);
+                if (cell) {
+                    query_cell(cell, first, end, minX, minY, maxX, maxY, &count);
+                }
+            }
+        }
+    }
+
+    // Long lines are not in the cells, so each is tested against the box
+    Line line;
+    prune_lines(longLines, &longCount, first);
+    for (int i = 0; i < longCount && longLines[i] < end; i++) {
+        if (line_store_get(longLines[i], &line) && segment_hits_box(&line, minX, minY, maxX, maxY)) {
+            add_result(longLines[i], &count);
+        }
+    }
+
+    // Lines crossing several cells were found once per cell
+    qsort(results, (size_t)count, sizeof(int), compare_indices);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || results[unique - 1] != results[i]) {
+            results[unique++] = results[i];
+        }
+    }
+
+    *indices = results;
+    return unique;
+}
+
+
+bool spatial_nearest(const float x, const float y, const float maxDistance, int* index, float* distance) {
+/*
+ * spatial_nearest - Finds the line closest to a point.
+ *
+ * Only the cells within `maxDistance` of the point are searched. When several lines are equally close
+ * the most recent one wins, since it is drawn on top.
+ *
+ * Parameters:
+ *    x, y        - The point.
+ *    maxDistance - The search radius in pixels.
+ *    index       - Receives the index of the closest line.
+ *    distance    - Receives its distance to the point. May be NULL.
+ *
+ * Returns:
+ *    true if a line lies within `maxDistance`, false otherwise.
+ */
+
+    const int first = line_store_first();
+    bool found = false;
+    float best = maxDistance;
+    Line line;
+
+    for (int cy = cell_coordinate(y - maxDistance); cy <= cell_coordinate(y + maxDistance); cy++) {
+        for (int cx = cell_coordinate(x - maxDistance); cx <= cell_coordinate(x + maxDistance); cx++) {
+            Cell* cell = find_cell(cx, cy);
+            if (!cell) {
+                continue;
+            }
+            prune_lines(cell->lines, &cell->count, first);
+
+            for (int i = 0; i < cell->count; i++) {
+                if (!line_store_get(cell->lines[i], &line)) {
+                    continue;
+                }
+                const float d = segment_distance(&line, x, y);
+                if (d < best || (d == best && (!found || cell->lines[i] > *index))) {
+                    best = d;
+                    *index = cell->lines[i];
+                    found = true;
+                }
+            }
+        }
+    }
+
+    prune_lines(longLines, &longCount, first);
+    for (int i = 0; i < longCount; i++) {
+        if (!line_store_get(longLines[i], &line)) {
+            continue;
+        }
+        const float d = segment_distance(&line, x, y);
+        if (d < best || (d == best && (!found || longLines[i] > *index))) {
+            best = d;
+            *index = longLines[i];
+            found = true;
+        }
+    }
+
+    if (found && distance) {
+        *distance = best;
+    }
+    return found;
+}
@@ -29,17 +29,21 @@
  * to update its position and properties in real-time.
  *
  * Functions:
- *    - update_location: Calculates and updates the sprite's position based on its current angle and speed,
- *      while ensuring the sprite stays within the window boundaries.
+ *    - update_location: Calculates and updates the sprite's position based on its current angle and speed.
+ *      The drawing is unbounded, so the sprite is not kept inside the window.
  *    - update_pen: Updates the pen state of the sprite (pen up or pen down), determining whether it draws
  *      lines as it moves.
  *    - change_color: Changes the color of the turtle's pen based on user input. Different integer options
  *      correspond to different colors.
+ *    - save_sprite_state / interpolate_sprite: Record the pose before a simulation step and blend it with
+ *      the current pose for rendering.
+ *    - describe_sprite: Formats the status text reporting the sprite's state.
  *
  * Dependencies:
  *    - sprite.h: Contains the declaration of the Sprite structure and related functions.
- *    - math.h: For trigonometric calculations to update the sprite's movement.
- *    - stdio.h: For input/output operations, including error reporting.
+ *    - movement.h: For the direction the sprite faces, shared with command streams.
+ *    - logger.h: For the messages reporting color changes, which never wait for the terminal.
+ *    - stdio.h: For formatting the status text.
  *
  * This file allows the main application to control the movement, drawing, and appearance of the sprite,
  * enabling interactive graphics where users can create drawings by controlling the turtle.
@@ -48,22 +52,37 @@
 
 //==================== Header Files ====================
 #include "sprite.h"
-#include <math.h>
+#include "movement.h"
+#include "logger.h"
 #include <stdio.h>
 
 
 //==================== Global Variables ====================
+// Preset pen colors, selected with the number keys
+static const struct {
+    const char* name;
+    GLfloat r, g, b;
+} presetColors[] = {
+    {"Black", 0.0f, 0.0f, 0.0f},
+    {"Blue", 0.0f, 0.0f, 1.0f},
+    {"Red", 1.0f, 0.0f, 0.0f},
+    {"Green", 0.0f, 1.0f, 0.0f},
+    {"Yellow", 1.0f, 1.0f, 0.0f}
+};
+
 // Global sprite variable
 Sprite sprite;
+Sprite previousSprite;      // Sprite state before the last simulation step
 
 
 //==================== Macros ====================
 // Movement and rotation increments
 #define MOVE_INCREMENT 200.0f       // Pixels per second for movement
+#define PRESET_COLOR_COUNT 5        // Number of entries in presetColors
 
 
 //==================== Function Definitions ====================
-void update_location(const float deltaTime, const int windowWidth, const int windowHeight) {
+void update_location(const float deltaTime) {
 /*
  * handle_events - Processes SDL events and updates the game state based on user input.
  *
@@ -77,8 +96,6 @@ void update_location(const float deltaTime, const int windowWidth, const int win
  * Parameters:
  *    deltaTime    - The time difference between the current and the previous frame, used to ensure
  *                   smooth and frame-independent movement.
- *    windowWidth  - Pointer to the width of the window. This is updated in case of a window resize.
- *    windowHeight - Pointer to the height of the window. This is updated in case of a window resize.
  *
  * Returns:
  *    true if the game loop should continue, false if the game loop should exit (e.g., on quitting or
@@ -86,29 +103,14 @@ void update_location(const float deltaTime, const int windowWidth, const int win
  */
 
     // Calculate potential new position
-    const float deltaX = MOVE_INCREMENT * cos(sprite.angle * M_PI / 180.0f) * deltaTime;
-    const float deltaY = -MOVE_INCREMENT * sin(sprite.angle * M_PI / 180.0f) * deltaTime;  // Negative due to coordinate system
-
-    float newX = sprite.x + deltaX;
-    float newY = sprite.y + deltaY;
-
-    // Calculate half sprite dimensions
-    const float halfWidth = 25.0f;  // IMG_W / 2.0f
-    const float halfHeight = 25.0f; // IMG_H / 2.0f
+    float dirX, dirY;
+    movement_direction(sprite.angle, &dirX, &dirY);
+    const float deltaX = MOVE_INCREMENT * dirX * deltaTime;
+    const float deltaY = MOVE_INCREMENT * dirY * deltaTime;
 
-    // Check boundaries on X-axis
-    if (newX - halfWidth < 0) {
-        newX = halfWidth;
-    } else if (newX + halfWidth > (float)windowWidth) {
-        newX = (float)windowWidth - halfWidth;
-    }
-
-    // Check boundaries on Y-axis
-    if (newY - halfHeight < 0) {
-        newY = halfHeight;
-    } else if (newY + halfHeight > (float)windowHeight) {
-        newY = (float)windowHeight - halfHeight;
-    }
+    // The drawing is unbounded, the camera follows the turtle instead of the turtle stopping at the edge
+    const float newX = sprite.x + deltaX;
+    const float newY = sprite.y + deltaY;
 
     // Update sprite position
     sprite.x = newX;
@@ -139,7 +141,7 @@ void change_color(const int color_option) {
  *
  * This function updates the color of the sprite's pen based on the provided `color_option`.
  * Each color option corresponds to a specific RGB color, and the pen color is set accordingly.
- * If an invalid color option is provided, an error message is printed. The available colors are:
+ * If an invalid color option is provided, an error message is logged. The available colors are:
  *    1 - Black
  *    2 - Blue
  *    3 - Red
@@ -151,39 +153,103 @@ void change_color(const int color_option) {
  *                   1 (Black), 2 (Blue), 3 (Red), 4 (Green), and 5 (Yellow).
  */
 
-    switch (color_option) {
-        case 1: // Black
-            sprite.r = 0.0f;
-            sprite.g = 0.0f;
-            sprite.b = 0.0f;
-            printf("Color changed to Black\n");
-            break;
-        case 2: // Blue
-            sprite.r = 0.0f;
-            sprite.g = 0.0f;
-            sprite.b = 1.0f;
-            printf("Color changed to Blue\n");
-            break;
-        case 3: // Red
-            sprite.r = 1.0f;
-            sprite.g = 0.0f;
-            sprite.b = 0.0f;
-            printf("Color changed to Red\n");
-            break;
-        case 4: // Green
-            sprite.r = 0.0f;
-            sprite.g = 1.0f;
-            sprite.b = 0.0f;
-            printf("Color changed to Green\n");
-            break;
-        case 5: // Yellow
-            sprite.r = 1.0f;
-            sprite.g = 1.0f;
-            sprite.b = 0.0f;
-            printf("Color changed to Yellow\n");
-            break;
-        default:
-            printf("Invalid color option\n");
-            break;
+    GLfloat r, g, b;
+    if (!preset_color(color_option, &r, &g, &b)) {
+        log_message("Invalid color option\n");
+        return;
     }
+
+    sprite.r = r;
+    sprite.g = g;
+    sprite.b = b;
+    log_message("Color changed to %s\n", presetColors[color_option - 1].name);
+}
+
+
+bool preset_color(const int color_option, GLfloat* r, GLfloat* g, GLfloat* b) {
+/*
+ * preset_color - Looks up one of the preset pen colors.
+ *
+ * This is the table behind change_color, also used by code that sets colors without a message, such
+ * as command streams.
+ *
+ * Parameters:
+ *    color_option - The color number, 1 (Black) to 5 (Yellow).
+ *    r, g, b      - Receive the RGB components of the color.
+ *
+ * Returns:
+ *    true if the color exists, false otherwise.
+ */
+
+    if (color_option < 1 || color_option > PRESET_COLOR_COUNT) {
+        return false;
+    }
+
+    *r = presetColors[color_option - 1].r;
+    *g = presetColors[color_option - 1].g;
+    *b = presetColors[color_option - 1].b;
+    return true;
+}
+
+
+void save_sprite_state(void) {
+/*
+ * save_sprite_state - Records the sprite's state before it is advanced by a simulation step.
+ */
+
+    previousSprite = sprite;
+}
+
+
+void interpolate_sprite(const Sprite* from, const Sprite* to, const float alpha, float* x, float* y, float* angle) {
+/*
+ * interpolate_sprite - Blends the sprite's pose before and after the last simulation step.
+ *
+ * Frames rarely fall exactly on a simulation step, so the sprite is drawn at the fraction of the step
+ * that has elapsed instead of jumping from step to step. The angle takes the shorter way around.
+ *
+ * Parameters:
+ *    from  - The sprite before the last step.
+ *    to    - The sprite after the last step.
+ *    alpha - The fraction of a step elapsed since the last one, between 0 and 1.
+ *    x, y  - Receive the interpolated position.
+ *    angle - Receives the interpolated angle in degrees.
+ */
+
+    *x = from->x + (to->x - from->x) * alpha;
+    *y = from->y + (to->y - from->y) * alpha;
+
+    float turn = to->angle - from->angle;
+    if (turn > 180.0f) {
+        turn -= 360.0f;
+    } else if (turn < -180.0f) {
+        turn += 360.0f;
+    }
+    *angle = from->angle + turn * alpha;
+}
+
+
+void describe_sprite(const Sprite* shown, char* text, const size_t size) {
+/*
+ * describe_sprite - Formats the status text: the sprite's position, angle, pen state and color.
+ *
+ * Parameters:
+ *    shown - The sprite state to report.
+ *    text  - Receives the text, one line per property.
+ *    size  - Capacity of `text` in bytes.
+ */
+
+    snprintf(
+        text,
+        size,
+        "Position: (%.1f, %.1f)\nAngle: %.1f degrees\nPen: %s\nLine Color: %s",
+        shown->x, shown->y, shown->angle,
+        shown->pen ? "Down" : "Up",
+        (shown->r == 0.0f && shown->g == 0.0f && shown->b == 0.0f) ? "Black" :
+        (shown->r == 0.0f && shown->g == 0.0f && shown->b == 1.0f) ? "Blue" :
+        (shown->r == 1.0f && shown->g == 0.0f && shown->b == 0.0f) ? "Red" :
+        (shown->r == 0.0f && shown->g == 1.0f && shown->b == 0.0f) ? "Green" :
+        (shown->r == 1.0f && shown->g == 1.0f && shown->b == 0.0f) ? "Yellow" :
+        "Custom"
+    );
 }
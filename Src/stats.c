@@ -0,0 +1,264 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * stats.c - Telemetry counters, read through the API, as periodic JSON lines or by the command server.
+ *
+ * Every counter is a 64-bit atomic integer, since byte totals outgrow the 32 bits of SDL_atomic_t.
+ * Updates use relaxed ordering: a counter is only ever read for its own value, so an update costs one
+ * atomic add or store and never a barrier, and instrumenting a hot path such as add_line stays cheap.
+ * Most counters are only written by the render thread, which owns the line store and the OpenGL context,
+ * and read by whichever thread reports them.
+ *
+ * stats_end_frame closes a frame: it counts it and derives the bytes the frame uploaded from the running
+ * total, so the upload sites only ever add to STAT_UPLOAD_BYTES.
+ *
+ * With --stats, a writer thread appends a snapshot of every counter to a file at a fixed interval, one
+ * JSON object per line with the seconds since the start under "time", and flushes it, so a log shipper
+ * can follow the file. A last line is written when the program stops.
+ *
+ * Key functions:
+ *    - stats_add / stats_set / stats_get: Update and read one counter.
+ *    - stats_snapshot / stats_format_json: Read every counter.
+ *    - stats_end_frame: Closes a frame.
+ *    - stats_start / stats_stop: Start and stop the periodic JSON lines.
+ */
+
+
+//==================== Header Files ====================
+#include "stats.h"
+
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define STATS_LINE_MAX (STATS_JSON_MAX + 32) // Longest JSON line written, the counters and the time
+
+
+//==================== Global Variables ====================
+static _Atomic long long counters[STAT_COUNT];
+
+// Names of the counters in the JSON output, in the order of StatId
+static const char* const counterNames[STAT_COUNT] = {
+    "lineCount",
+    "lineCapacity",
+    "lineBytes",
+    "lineAllocations",
+    "linesDropped",
+    "linesMerged",
+    "linesUnstreamed",
+    "texturesCreated",
+    "texturesDeleted",
+    "uploadBytes",
+    "frames",
+    "frameUploadBytes",
+    "frameUploadPeak"
+};
+
+static long long frameUploadStart = 0;    // STAT_UPLOAD_BYTES when the current frame started, render thread only
+
+static SDL_Thread* writerThread = NULL; // Thread writing the JSON lines, NULL when they are off
+static SDL_sem* stopRequested = NULL;   // Posted to stop the writer thread
+static FILE* output = NULL;             // File the JSON lines go to
+static Uint32 intervalMs = 1000;        // Time between two lines
+static Uint64 startCounter = 0;         // Performance counter value when the lines started
+
+
+//==================== Function Definitions ====================
+void stats_add(const StatId id, const long long amount) {
+/*
+ * stats_add - Adds to a counter.
+ */
+
+    atomic_fetch_add_explicit(&counters[id], amount, memory_order_relaxed);
+}
+
+
+void stats_set(const StatId id, const long long value) {
+/*
+ * stats_set - Sets a counter holding a current value.
+ */
+
+    atomic_store_explicit(&counters[id], value, memory_order_relaxed);
+}
+
+
+long long stats_get(const StatId id) {
+/*
+ * stats_get - Reads a counter.
+ */
+
+    return atomic_load_explicit(&counters[id], memory_order_relaxed);
+}
+
+
+const char* stats_name(const StatId id) {
+/*
+ * stats_name - Returns the name of a counter in the JSON output, e.g. "lineCount".
+ */
+
+    return counterNames[id];
+}
+
+
+void stats_snapshot(long long values[STAT_COUNT]) {
+/*
+ * stats_snapshot - Reads every counter.
+ *
+ * The counters are read one after the other, not at a single instant, so two related counters may be a
+ * few updates apart.
+ */
+
+    for (int i = 0; i < STAT_COUNT; i++) {
+        values[i] = stats_get((StatId)i);
+    }
+}
+
+
+size_t stats_format_json(char* buffer, const size_t size) {
+/*
+ * stats_format_json - Formats every counter as a JSON object on one line, without a newline.
+ *
+ * Parameters:
+ *    buffer - Receives the object, cut short if it does not fit.
+ *    size   - The size of `buffer` in bytes.
+ *
+ * Returns:
+ *    The length of the object, not counting the terminating null byte.
+ */
+
+    long long values[STAT_COUNT];
+    stats_snapshot(values);
+
+    size_t length = 0;
+    for (int i = 0; i < STAT_COUNT && length < size; i++) {
+        const int written = snprintf(buffer + length, size - length, "%s\"%s\":%lld", i == 0 ? "{" : ",",
+                                     counterNames[i], values[i]);
+        length += written > 0 ? (size_t)written : 0;
+    }
+    if (length < size) {
+        const int written = snprintf(buffer + length, size - length, "}");
+        length += written > 0 ? (size_t)written : 0;
+    }
+    return length < size ? length : size - 1;
+}
+
+
+void stats_end_frame(void) {
+/*
+ * stats_end_frame - Counts a frame and records the bytes it uploaded, called by the render thread after each frame.
+ */
+
+    const long long uploaded = stats_get(STAT_UPLOAD_BYTES);
+    const long long frameBytes = uploaded - frameUploadStart;
+    frameUploadStart = uploaded;
+
+    stats_add(STAT_FRAMES, 1);
+    stats_set(STAT_FRAME_UPLOAD_BYTES, frameBytes);
+    if (frameBytes > stats_get(STAT_FRAME_UPLOAD_PEAK)) {
+        stats_set(STAT_FRAME_UPLOAD_PEAK, frameBytes);
+    }
+}
+
+
+static void write_line(void) {
+/*
+ * write_line - Appends a snapshot of the counters to the output as one JSON line.
+ */
+
+    char line[STATS_LINE_MAX];
+    const double seconds = (double)(SDL_GetPerformanceCounter() - startCounter) / (double)SDL_GetPerformanceFrequency();
+    const int prefix = snprintf(line, sizeof(line), "{\"time\":%.3f,", seconds);
+
+    // The object of stats_format_json is spliced in after its opening brace
+    char object[STATS_JSON_MAX];
+    stats_format_json(object, sizeof(object));
+    snprintf(line + prefix, sizeof(line) - (size_t)prefix, "%s\n", object + 1);
+    fputs(line, output);
+    fflush(output);
+}
+
+
+static int writer_main(void* data) {
+/*
+ * writer_main - Entry point of the writer thread, writing a line per interval until stats_stop.
+ */
+
+    (void)data;
+    while (SDL_SemWaitTimeout(stopRequested, intervalMs) == SDL_MUTEX_TIMEDOUT) {
+        write_line();
+    }
+    write_line();
+    return 0;
+}
+
+
+bool stats_start(const char* path, const double interval) {
+/*
+ * stats_start - Starts writing the counters to a file as JSON lines.
+ *
+ * Parameters:
+ *    path     - The file, truncated first, or "-" for stdout.
+ *    interval - The seconds between two lines.
+ *
+ * Returns:
+ *    true if the lines are being written, false after reporting why not.
+ */
+
+    output = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!output) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+
+    intervalMs = interval * 1000.0 >= 1.0 ? (Uint32)(interval * 1000.0) : 1;
+    startCounter = SDL_GetPerformanceCounter();
+    stopRequested = SDL_CreateSemaphore(0);
+    writerThread = stopRequested ? SDL_CreateThread(writer_main, "stats", NULL) : NULL;
+    if (!writerThread) {
+        printf("Error creating the statistics thread: %s\n", SDL_GetError());
+        stats_stop();
+        return false;
+    }
+    return true;
+}
+
+
+void stats_stop(void) {
+/*
+ * stats_stop - Writes a last line of counters and closes the file, if stats_start started one.
+ */
+
+    if (writerThread) {
+        SDL_SemPost(stopRequested);
+        SDL_WaitThread(writerThread, NULL);
+        writerThread = NULL;
+    }
+    if (stopRequested) {
+        SDL_DestroySemaphore(stopRequested);
+        stopRequested = NULL;
+    }
+    if (output && output != stdout) {
+        fclose(output);
+    }
+    output = NULL;
+}
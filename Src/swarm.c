@@ -0,0 +1,353 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * swarm.c - The turtles on screen: a texture atlas of sprite images and the quads drawing every turtle at once.
+ *
+ * The sprite images are packed side by side into a single texture once the asset thread has decoded them
+ * (see assets.c), and until then no turtle is drawn. Each turtle shows the image of its number modulo the
+ * number of images. Besides the interactive turtle, the renderer
+ * keeps the poses of the turtles a script told (see commands.c), sent by the main thread when the script
+ * ends. Every frame, the corners of each turtle's quad are rotated and scaled on the CPU, turtles outside
+ * the view are skipped, and all the quads are drawn with one glDrawArrays call from one texture, so the cost
+ * of a turtle is eight multiplications and a few stores instead of a matrix push, a texture bind and a draw.
+ * The same arrays feed the shader backend's quad program on a core profile context (see glcore.c).
+ * The interactive turtle comes last in the batch, so it is drawn on top of the others.
+ *
+ * Everything here runs on the render thread, which owns the OpenGL context.
+ *
+ * Key functions:
+ *    - upload_sprites: Packs the decoded sprite images into the atlas texture.
+ *    - set_swarm_size / set_swarm_turtle: Replace the poses of the turtles told by a script.
+ *    - prepare_turtles / draw_turtles: Build the quads of every turtle in view, then draw them in one call.
+ *    - turtle_radius: Reports how far from its center a turtle can cover pixels.
+ *    - release_sprites: Releases the atlas texture and the pose and quad arrays.
+ */
+
+
+//==================== Header Files ====================
+#include "swarm.h"
+#include "glcore.h"
+#include "glproc.h"
+#include "stats.h"
+#include "utilities.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define IMG_W 50.0f               // Width of a turtle on screen, in pixels
+#define IMG_H 50.0f               // Height of a turtle on screen, in pixels
+#define SPRITE_MAX_IMAGES 16      // Most images in the atlas
+
+
+//==================== Structure ====================
+typedef struct {  // Pose of a turtle told by a script
+    float x, y;               // Position in drawing coordinates
+    float angle;              // Heading in degrees, counterclockwise from east
+} TurtlePose;
+
+typedef struct {  // Part of the atlas showing one image
+    GLfloat u0, v0;           // Texture coordinates of the image's first pixel
+    GLfloat u1, v1;           // Texture coordinates just past its last pixel
+} AtlasRect;
+
+
+//==================== Global Variables ====================
+static GLuint atlasTexture = 0;           // Texture holding every sprite image
+static AtlasRect atlasRects[SPRITE_MAX_IMAGES]; // Where each image lies in the atlas
+static int atlasImageCount = 0;           // Number of images in the atlas
+
+static TurtlePose* poses = NULL;          // Turtles told by the last script, turtle 1 first
+static int poseCount = 0;                 // Number of turtles in `poses`
+static int poseCapacity = 0;              // Number of poses allocated
+
+static GLfloat* quadVertices = NULL;      // Corners of the quads of a frame, 8 floats per turtle
+static GLfloat* quadTexCoords = NULL;     // Texture coordinates of the corners of a frame
+static int quadCapacity = 0;              // Number of quads allocated
+static int preparedCount = 0;             // Number of quads prepare_turtles built
+
+
+//==================== Function Definitions ====================
+bool upload_sprites(const AssetImage* images, const int count) {
+/*
+ * upload_sprites - Packs decoded sprite images side by side into the atlas texture.
+ *
+ * Parameters:
+ *    images - The images in the order turtles pick them, as decoded by the asset thread.
+ *    count  - The number of images, from 1 to SPRITE_MAX_IMAGES.
+ *
+ * Returns:
+ *    true if the atlas was uploaded, false after reporting an error.
+ */
+
+    if (count < 1 || count > SPRITE_MAX_IMAGES) {
+        printf("Error loading sprites: expected 1 to %d images, got %d\n", SPRITE_MAX_IMAGES, count);
+        return false;
+    }
+
+    // Size the atlas to hold every image in a row
+    int width = 0, height = 0;
+    for (int i = 0; i < count; i++) {
+        width += images[i].w;
+        height = images[i].h > height ? images[i].h : height;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (width > maxSize || height > maxSize) {
+        printf("Error packing sprites: a %dx%d atlas exceeds the texture size limit of %d\n", width, height, maxSize);
+        return false;
+    }
+
+    glGenTextures(1, &atlasTexture);
+    stats_add(STAT_TEXTURES_CREATED, 1);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Allocate the atlas, then copy each image into its column
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    int left = 0;
+    for (int i = 0; i < count; i++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, left, 0, images[i].w, images[i].h, GL_RGBA, GL_UNSIGNED_BYTE,
+                        images[i].pixels);
+        stats_add(STAT_UPLOAD_BYTES, (long long)images[i].w * images[i].h * 4);
+        atlasRects[i] = (AtlasRect){(GLfloat)left / (GLfloat)width, 0.0f,
+                                    (GLfloat)(left + images[i].w) / (GLfloat)width,
+                                    (GLfloat)images[i].h / (GLfloat)height};
+        left += images[i].w;
+    }
+    checkOpenGLError("glTexSubImage2D for the sprite atlas");
+    atlasImageCount = count;
+    return true;
+}
+
+
+void set_swarm_size(const int count) {
+/*
+ * set_swarm_size - Sets the number of turtles told by a script, keeping the poses of those that remain.
+ *
+ * New turtles stand at the origin until set_swarm_turtle places them.
+ */
+
+    if (count > poseCapacity) {
+        int capacity = poseCapacity > 0 ? poseCapacity : 64;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        TurtlePose* grown = realloc(poses, (size_t)capacity * sizeof(TurtlePose));
+        if (!grown) {
+            printf("Error allocating memory for the turtle swarm!\n");
+            exit(1);
+        }
+        poses = grown;
+        poseCapacity = capacity;
+    }
+    for (int i = poseCount; i < count; i++) {
+        poses[i] = (TurtlePose){0.0f, 0.0f, 0.0f};
+    }
+    poseCount = count < 0 ? 0 : count;
+}
+
+
+void set_swarm_turtle(const int index, const float x, const float y, const float angle) {
+/*
+ * set_swarm_turtle - Places turtle `index` + 1 of the swarm; indices past the swarm size are ignored.
+ */
+
+    if (index >= 0 && index < poseCount) {
+        poses[index] = (TurtlePose){x, y, angle};
+    }
+}
+
+
+static void grow_quads(const int count) {
+/*
+ * grow_quads - Makes room for `count` quads in the arrays drawn each frame.
+ */
+
+    if (count <= quadCapacity) {
+        return;
+    }
+    int capacity = quadCapacity > 0 ? quadCapacity : 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    GLfloat* vertices = realloc(quadVertices, (size_t)capacity * 8 * sizeof(GLfloat));
+    if (vertices) {
+        quadVertices = vertices;
+    }
+    GLfloat* texCoords = realloc(quadTexCoords, (size_t)capacity * 8 * sizeof(GLfloat));
+    if (texCoords) {
+        quadTexCoords = texCoords;
+    }
+    if (!vertices || !texCoords) {
+        printf("Error allocating memory for the turtle quads!\n");
+        exit(1);
+    }
+    quadCapacity = capacity;
+}
+
+
+static int add_quad(const int quad, const int image, const float x, const float y, const float angle,
+                    const float scale, const CameraView* view) {
+/*
+ * add_quad - Writes the rotated quad of a turtle into the frame's arrays, unless it lies outside the view.
+ *
+ * Parameters:
+ *    quad    - The index the quad is written at.
+ *    image   - The atlas image shown, a number that is wrapped to the images loaded.
+ *    x, y    - The center of the turtle in drawing coordinates.
+ *    angle   - The heading in degrees, counterclockwise from east.
+ *    scale   - The drawing units per screen pixel, so turtles keep their size at any zoom.
+ *    view    - The visible rectangle of the drawing.
+ *
+ * Returns:
+ *    The index of the next quad: `quad` + 1 if the turtle was added, `quad` if it was skipped.
+ */
+
+    // A rotated quad stays within its circumscribed circle
+    const float halfWidth = IMG_W / 2.0f * scale;
+    const float halfHeight = IMG_H / 2.0f * scale;
+    const float radius = sqrtf(halfWidth * halfWidth + halfHeight * halfHeight);
+    if (x + radius < view->minX || x - radius > view->maxX || y + radius < view->minY || y - radius > view->maxY) {
+        return quad;
+    }
+
+    // Rotate clockwise on screen, as y grows downward, with the corners in the order the image is sampled
+    const float radians = -angle * (float)M_PI / 180.0f;
+    const float c = cosf(radians);
+    const float s = sinf(radians);
+    const float cornerX[4] = {-halfWidth, halfWidth, halfWidth, -halfWidth};
+    const float cornerY[4] = {-halfHeight, -halfHeight, halfHeight, halfHeight};
+    GLfloat* vertices = &quadVertices[quad * 8];
+    for (int i = 0; i < 4; i++) {
+        vertices[i * 2] = x + cornerX[i] * c - cornerY[i] * s;
+        vertices[i * 2 + 1] = y + cornerX[i] * s + cornerY[i] * c;
+    }
+
+    const AtlasRect* rect = &atlasRects[image % atlasImageCount];
+    GLfloat* texCoords = &quadTexCoords[quad * 8];
+    texCoords[0] = rect->u0; texCoords[1] = rect->v0;
+    texCoords[2] = rect->u1; texCoords[3] = rect->v0;
+    texCoords[4] = rect->u1; texCoords[5] = rect->v1;
+    texCoords[6] = rect->u0; texCoords[7] = rect->v1;
+    return quad + 1;
+}
+
+
+float turtle_radius(void) {
+/*
+ * turtle_radius - Returns the radius in screen pixels of the circle holding a turtle at any heading.
+ */
+
+    return sqrtf(IMG_W * IMG_W + IMG_H * IMG_H) / 2.0f;
+}
+
+
+void prepare_turtles(const float x, const float y, const float angle, const CameraView view, const float zoom) {
+/*
+ * prepare_turtles - Builds the quads of the swarm and then of the interactive turtle for the next draw_turtles.
+ *
+ * Parameters:
+ *    x, y  - The position of the interactive turtle, interpolated for this frame.
+ *    angle - Its heading in degrees.
+ *    view  - The visible rectangle of the drawing, outside of which turtles are skipped.
+ *    zoom  - The camera zoom, which turtles are scaled against to keep their size on screen.
+ */
+
+    preparedCount = 0;
+    if (atlasImageCount == 0) {
+        return;
+    }
+    grow_quads(poseCount + 1);
+
+    const float scale = 1.0f / zoom;
+    for (int i = 0; i < poseCount; i++) {
+        preparedCount = add_quad(preparedCount, i + 1, poses[i].x, poses[i].y, poses[i].angle, scale, &view);
+    }
+    preparedCount = add_quad(preparedCount, 0, x, y, angle, scale, &view);
+}
+
+
+void draw_turtles(void) {
+/*
+ * draw_turtles - Draws the quads built by prepare_turtles with a single draw call.
+ *
+ * The quads can be drawn several times, once per region redrawn. The caller sets up the drawing's
+ * projection, texturing and blending; the vertex and texture coordinate arrays are enabled and disabled
+ * here. On the shader backend the quads go to glcore_draw_quads instead.
+ */
+
+    if (preparedCount == 0) {
+        return;
+    }
+
+    if (glCoreProfile) {
+        static const GLfloat white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glcore_draw_quads(quadVertices, quadTexCoords, preparedCount, atlasTexture, white);
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, quadVertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, quadTexCoords);
+
+    glDrawArrays(GL_QUADS, 0, preparedCount * 4);
+    checkOpenGLError("glDrawArrays for sprites");
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+
+void release_sprites(void) {
+/*
+ * release_sprites - Releases the atlas texture, the swarm and the quad arrays.
+ *
+ * Must be called while the OpenGL context is still current.
+ */
+
+    if (atlasTexture != 0) {
+        glDeleteTextures(1, &atlasTexture);
+        stats_add(STAT_TEXTURES_DELETED, 1);
+        atlasTexture = 0;
+    }
+    atlasImageCount = 0;
+
+    free(poses);
+    poses = NULL;
+    poseCount = 0;
+    poseCapacity = 0;
+
+    free(quadVertices);
+    free(quadTexCoords);
+    quadVertices = NULL;
+    quadTexCoords = NULL;
+    quadCapacity = 0;
+    preparedCount = 0;
+}
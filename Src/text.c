@@ -25,9 +25,20 @@
  * converting it into an OpenGL texture, and then rendering it as a textured quad.
  *
  * The key functions in this file include:
- *    - `init_font`: Loads and initializes the font for text rendering.
+ *    - `bake_font_atlas`: Bakes a font's printable glyphs into an atlas image, without OpenGL.
+ *    - `use_font_atlas`: Uploads a baked atlas and makes its metrics the ones text is laid out with.
+ *    - `free_font_atlas`: Frees the pixels of a baked atlas.
+ *    - `init_font_layout`: Loads the font's glyph metrics without creating a texture.
  *    - `close_font`: Frees the font resources.
  *    - `render_text`: Renders text to an OpenGL texture and returns its texture ID, as well as its width and height.
+ *    - `build_text_quads`: Lays out a string as textured quads that sample the glyph atlas.
+ *    - `draw_text_quads`: Draws previously built quads with a single draw call.
+ *
+ * The printable ASCII range is baked into a glyph atlas: a single texture holding every glyph, plus the
+ * metrics needed to place them. Strings drawn through the atlas cost no rasterization, texture creation
+ * or upload at draw time, which makes it the path used for text redrawn every frame. Baking and uploading
+ * are separate steps, so the window's atlas is baked on the asset thread, or read back from the asset
+ * cache, and only uploaded by the render thread (see assets.c).
  *
  * This file handles all aspects of rendering 2D text to the screen using OpenGL and ensures proper
  * initialization, error handling, and cleanup for text resources.
@@ -36,6 +47,9 @@
 
 //==================== Header Files ====================
 #include "text.h"
+#include "glcore.h"
+#include "glproc.h"
+#include "stats.h"
 #include "utilities.h"
 
 #include <SDL2/SDL.h>
@@ -44,27 +58,184 @@
 #include <GL/glu.h>  
 #include <stdbool.h>  
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//==================== Macros ====================
+#define ATLAS_WIDTH 512                     // Width of the atlas texture in pixels
+#define ATLAS_PADDING 1                     // Empty pixels between glyphs to avoid filtering bleed
+#define TEXT_LINE_SPACING 2                 // Extra pixels between lines of text
 
 
 //==================== Global Variables ====================
 static TTF_Font* font = NULL;
 
+static GLuint atlasTextureID = 0;           // Texture holding every baked glyph
+static Glyph glyphs[ATLAS_GLYPH_COUNT];     // Atlas metrics, indexed by character - ATLAS_FIRST_GLYPH
+static int glyphHeight = 0;                 // Height of a line of text in pixels
+
 
 //==================== Function Definitions ====================
-bool init_font(const char* fontPath, const int fontSize) {
+bool bake_font_atlas(TTF_Font* ttfFont, FontAtlas* atlas) {
 /*
- * init_font - Initializes the font for text rendering.
+ * bake_font_atlas - Bakes the printable ASCII glyphs of a font into an atlas image in memory.
  *
- * This function attempts to load a TrueType font from the given file path and sets the font size
- * based on the specified `fontSize`. If the font is loaded successfully, it returns true,
- * otherwise it prints an error message and returns false.
+ * Each glyph is rendered in white with TTF_RenderGlyph_Blended and packed left to right into rows
+ * of the atlas. The glyph rectangles and advances are recorded so strings can later be drawn as
+ * quads sampling the atlas, tinted to any color through glColor. No OpenGL call is made, so the
+ * atlas can be baked on any thread and uploaded later by use_font_atlas.
  *
  * Parameters:
- *    fontPath   - A string representing the file path to the TrueType font file.
- *    fontSize   - The size of the font to be loaded.
+ *    ttfFont - The opened font.
+ *    atlas   - Receives the metrics and the pixels, to be freed with free_font_atlas.
  *
  * Returns:
- *    true if the font was successfully loaded, false otherwise.
+ *    true if the atlas was baked, false otherwise.
+ */
+
+    const SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* glyphSurfaces[ATLAS_GLYPH_COUNT] = {NULL};
+
+    memset(atlas, 0, sizeof(FontAtlas));
+    atlas->glyphHeight = TTF_FontHeight(ttfFont);
+
+    // Render every glyph and lay out the atlas rows
+    int penX = 0, penY = 0;
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+        const Uint16 ch = (Uint16)(ATLAS_FIRST_GLYPH + i);
+        Glyph* glyph = &atlas->glyphs[i];
+
+        int minX, maxX, minY, maxY;
+        if (TTF_GlyphMetrics(ttfFont, ch, &minX, &maxX, &minY, &maxY, &glyph->advance) != 0) {
+            continue;
+        }
+
+        // Glyphs without pixels (such as the space) only contribute their advance
+        SDL_Surface* rendered = TTF_RenderGlyph_Blended(ttfFont, ch, white);
+        if (!rendered) {
+            continue;
+        }
+        glyphSurfaces[i] = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(rendered);
+        if (!glyphSurfaces[i]) {
+            continue;
+        }
+
+        glyph->w = glyphSurfaces[i]->w;
+        glyph->h = glyphSurfaces[i]->h;
+        if (penX + glyph->w > ATLAS_WIDTH) {
+            penX = 0;
+            penY += atlas->glyphHeight + ATLAS_PADDING;
+        }
+
+        // Temporarily store the pixel position, converted to texture coordinates below
+        glyph->u0 = (GLfloat)penX;
+        glyph->v0 = (GLfloat)penY;
+        penX += glyph->w + ATLAS_PADDING;
+    }
+    atlas->width = ATLAS_WIDTH;
+    atlas->height = penY + atlas->glyphHeight;
+
+    // Copy the glyph pixels into the atlas image
+    atlas->pixels = calloc((size_t)atlas->width * atlas->height, 4);
+    if (!atlas->pixels) {
+        printf("Error allocating memory for the glyph atlas!\n");
+        for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+            SDL_FreeSurface(glyphSurfaces[i]);
+        }
+        return false;
+    }
+
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+        SDL_Surface* surface = glyphSurfaces[i];
+        if (!surface) {
+            continue;
+        }
+
+        Glyph* glyph = &atlas->glyphs[i];
+        const int x = (int)glyph->u0;
+        const int y = (int)glyph->v0;
+        for (int row = 0; row < surface->h && y + row < atlas->height; row++) {
+            memcpy(atlas->pixels + ((size_t)(y + row) * atlas->width + x) * 4,
+                   (const Uint8*)surface->pixels + (size_t)row * surface->pitch,
+                   (size_t)surface->w * 4);
+        }
+
+        glyph->u0 = (GLfloat)x / (GLfloat)atlas->width;
+        glyph->v0 = (GLfloat)y / (GLfloat)atlas->height;
+        glyph->u1 = (GLfloat)(x + glyph->w) / (GLfloat)atlas->width;
+        glyph->v1 = (GLfloat)(y + glyph->h) / (GLfloat)atlas->height;
+        SDL_FreeSurface(surface);
+    }
+    return true;
+}
+
+
+bool use_font_atlas(const FontAtlas* atlas, const bool upload) {
+/*
+ * use_font_atlas - Makes a baked atlas the one build_text_quads and draw_text_quads use.
+ *
+ * The metrics are copied, so the atlas can be freed afterwards.
+ *
+ * Parameters:
+ *    atlas  - The atlas baked by bake_font_atlas, or read back from the asset cache.
+ *    upload - Whether to create the texture; without it only the layout metrics are kept.
+ *
+ * Returns:
+ *    true if the atlas is in use, false after reporting an error.
+ */
+
+    memcpy(glyphs, atlas->glyphs, sizeof(glyphs));
+    glyphHeight = atlas->glyphHeight;
+    if (!upload) {
+        return true;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (atlas->width > maxSize || atlas->height > maxSize) {
+        printf("Error uploading the glyph atlas: %dx%d exceeds the texture size limit of %d\n",
+               atlas->width, atlas->height, maxSize);
+        return false;
+    }
+
+    // Upload the atlas once
+    glGenTextures(1, &atlasTextureID);
+    stats_add(STAT_TEXTURES_CREATED, 1);
+    glBindTexture(GL_TEXTURE_2D, atlasTextureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas->width, atlas->height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, atlas->pixels);
+    stats_add(STAT_UPLOAD_BYTES, (long long)atlas->width * atlas->height * 4);
+    checkOpenGLError("glTexImage2D for glyph atlas");
+    return true;
+}
+
+
+void free_font_atlas(FontAtlas* atlas) {
+/*
+ * free_font_atlas - Frees the pixels of a baked atlas.
+ */
+
+    free(atlas->pixels);
+    atlas->pixels = NULL;
+}
+
+
+bool init_font_layout(const char* fontPath, const int fontSize) {
+/*
+ * init_font_layout - Loads a font for laying out text only, without an OpenGL context.
+ *
+ * The glyph atlas is baked as for the window, but no texture is created, so build_text_quads works and
+ * draw_text_quads must not be called. Used by the benchmarks, which run without a window.
+ *
+ * Returns:
+ *    true if the font was loaded, false otherwise.
  */
 
     font = TTF_OpenFont(fontPath, fontSize);
@@ -72,7 +243,15 @@ bool init_font(const char* fontPath, const int fontSize) {
         printf("Failed to load font! TTF_Error: %s\n", TTF_GetError());
         return false;
     }
-    return true; 
+
+    FontAtlas atlas;
+    const bool baked = bake_font_atlas(font, &atlas) && use_font_atlas(&atlas, false);
+    free_font_atlas(&atlas);
+    if (!baked) {
+        close_font();
+        return false;
+    }
+    return true;
 }
 
 
@@ -95,6 +274,12 @@ void close_font() {
         TTF_CloseFont(font);
         font = NULL;
     }
+
+    if (atlasTextureID != 0) {
+        glDeleteTextures(1, &atlasTextureID);
+        stats_add(STAT_TEXTURES_DELETED, 1);
+        atlasTextureID = 0;
+    }
 }
 
 
@@ -117,6 +302,12 @@ GLuint render_text(const char* text, const SDL_Color color, int* w, int* h) {
  *    GLuint - The OpenGL texture ID associated with the rendered text, or 0 if there was an error.
  */
 
+    // The window's atlas is baked from a font closed right after, so only init_font_layout leaves one open
+    if (!font) {
+        printf("Unable to render text: no font is open\n");
+        return 0;
+    }
+
     // Render text to a surface
     SDL_Surface* textSurface = TTF_RenderText_Blended(font, text, color);
     if (!textSurface) {
@@ -136,6 +327,7 @@ GLuint render_text(const char* text, const SDL_Color color, int* w, int* h) {
     // Generate a texture ID
     GLuint textureID;
     glGenTextures(1, &textureID);
+    stats_add(STAT_TEXTURES_CREATED, 1);
 
     // Bind the texture
     glBindTexture(GL_TEXTURE_2D, textureID);
@@ -150,6 +342,7 @@ GLuint render_text(const char* text, const SDL_Color color, int* w, int* h) {
     // Upload the texture data
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, formattedSurface->w, formattedSurface->h, 0,
                  GL_RGBA, GL_UNSIGNED_BYTE, formattedSurface->pixels);
+    stats_add(STAT_UPLOAD_BYTES, (long long)formattedSurface->h * formattedSurface->pitch);
 
     // Check for OpenGL errors
     const GLenum err = glGetError();
@@ -166,3 +359,104 @@ GLuint render_text(const char* text, const SDL_Color color, int* w, int* h) {
 
     return textureID;
 }
+
+
+int build_text_quads(const char* text, const float x, const float y,
+                     GLfloat* vertices, GLfloat* texCoords, const int maxQuads) {
+/*
+ * build_text_quads - Lays out a string as textured quads sampling the glyph atlas.
+ *
+ * This function walks the string, emitting one quad per visible glyph starting at (x, y), which is the
+ * top-left corner of the first line. A newline moves the pen back to x and down by one line. Each quad
+ * takes 8 floats in `vertices` and 8 floats in `texCoords`. Characters outside the atlas are skipped.
+ *
+ * Parameters:
+ *    text      - The string to lay out.
+ *    x, y      - The top-left corner of the text in window coordinates.
+ *    vertices  - Output array receiving 8 floats per quad.
+ *    texCoords - Output array receiving 8 floats per quad.
+ *    maxQuads  - The number of quads the output arrays can hold.
+ *
+ * Returns:
+ *    The number of quads written.
+ */
+
+    int quadCount = 0;
+    float penX = x;
+    float penY = y;
+
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '\n') {
+            penX = x;
+            penY += (float)(glyphHeight + TEXT_LINE_SPACING);
+            continue;
+        }
+
+        const int index = (unsigned char)*c - ATLAS_FIRST_GLYPH;
+        if (index < 0 || index >= ATLAS_GLYPH_COUNT) {
+            continue;
+        }
+
+        const Glyph* glyph = &glyphs[index];
+        if (glyph->w > 0 && quadCount < maxQuads) {
+            const float right = penX + (float)glyph->w;
+            const float bottom = penY + (float)glyph->h;
+            GLfloat* v = vertices + quadCount * 8;
+            GLfloat* t = texCoords + quadCount * 8;
+
+            // Same corner order as the per-string textures: bottom-left, bottom-right, top-right, top-left
+            v[0] = penX;  v[1] = bottom;  t[0] = glyph->u0;  t[1] = glyph->v1;
+            v[2] = right; v[3] = bottom;  t[2] = glyph->u1;  t[3] = glyph->v1;
+            v[4] = right; v[5] = penY;    t[4] = glyph->u1;  t[5] = glyph->v0;
+            v[6] = penX;  v[7] = penY;    t[6] = glyph->u0;  t[7] = glyph->v0;
+            quadCount++;
+        }
+        penX += (float)glyph->advance;
+    }
+
+    return quadCount;
+}
+
+
+void draw_text_quads(const GLfloat* vertices, const GLfloat* texCoords, const int quadCount, const SDL_Color color) {
+/*
+ * draw_text_quads - Draws quads built by build_text_quads in a single draw call.
+ *
+ * The atlas stores white glyphs, so the text color is applied by modulating with the current color.
+ * Texturing and blending must be enabled by the caller. On the shader backend the quads are drawn by
+ * glcore_draw_quads, tinted by the color.
+ *
+ * Parameters:
+ *    vertices  - Quad positions, as written by build_text_quads.
+ *    texCoords - Quad texture coordinates, as written by build_text_quads.
+ *    quadCount - The number of quads to draw.
+ *    color     - The color of the text.
+ */
+
+    if (quadCount <= 0 || atlasTextureID == 0) {
+        return;
+    }
+
+    if (glCoreProfile) {
+        const GLfloat tint[4] = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f};
+        glcore_draw_quads(vertices, texCoords, quadCount, atlasTextureID, tint);
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, atlasTextureID);
+    glColor4ub(color.r, color.g, color.b, color.a);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+
+    glDrawArrays(GL_QUADS, 0, quadCount * 4);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    // Reset the color so later textured draws are not tinted
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,684 @@
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~LICENSE~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+/*
+ * Copyright (C) 2024 Matthew A. Wilkerson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * tiles.c - Tiled, multi-resolution canvas for drawings larger than any single texture.
+ *
+ * The window-sized canvas (see canvas.c) is tied to the camera and rebuilt by replaying the visible lines
+ * whenever it moves. This canvas cuts the drawing itself into square tiles of TILE_TEXELS texels fixed in
+ * drawing coordinates. Level 0 has one texel per drawing unit and each level above halves the resolution,
+ * so the tiles of a level cover 2x2 tiles of the level below; the camera draws from the level whose texels
+ * come closest to its pixels, and each tile has mipmaps for the zoom in between.
+ *
+ * A tile is only a record until a line crosses it: its texture is allocated the first time it is in view
+ * with lines inside it, and it is rasterized from the line store through the spatial index, at the level of
+ * detail its resolution calls for (see draw_box_lines). Lines added later are drawn into the tiles they
+ * cross as they come into view. At most TILE_BUILD_LINES lines are drawn into new tiles per update; the
+ * tiles still waiting show their nearest coarser tile meanwhile, and tiles_pending asks for another frame.
+ *
+ * Textures are kept under a budget, evicting the tiles used longest ago, which are rasterized again
+ * from the store when they come back into view; the tiles of the current view are always kept.
+ * Since the store is the only source, lines it flattened could not be drawn again, and the options do
+ * not allow the flatten policy with this canvas; spilled lines are read back from the spill file.
+ *
+ * Undo makes tiles holding the lines undone start again from the store, and lines extended in place are
+ * drawn again over their previous pixels. Both are collected and applied to the tiles on the next update.
+ *
+ * For partial redraws (see damage.c), a camera move reports the whole window, and otherwise every tile
+ * drawn into or newly shown reports its rectangle.
+ *
+ * Everything here runs on the render thread.
+ *
+ * Key functions:
+ *    - tiles_init / tiles_shutdown: Create and release the framebuffer object and the tiles.
+ *    - tiles_rewind / tiles_truncate / tiles_clear: Schedule tiles to be drawn again.
+ *    - tiles_update: Rasterizes the tiles in view, evicting the oldest ones over the budget.
+ *    - tiles_draw: Draws the tiles in view as textured quads.
+ */
+
+
+//==================== Header Files ====================
+#include "tiles.h"
+#include "damage.h"
+#include "glproc.h"
+#include "graphics.h"
+#include "linestore.h"
+#include "spatial.h"
+#include "stats.h"
+#include "utilities.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+//==================== Macros ====================
+#define TILE_TEXELS 256                   // Width and height of a tile in texels
+#define TILE_BYTES (TILE_TEXELS * TILE_TEXELS * 4 * 4 / 3) // Memory a tile holds with its mipmaps
+#define TILE_LEVEL_MIN -6                 // Finest level, for the closest zoom in
+#define TILE_LEVEL_MAX 10                 // Coarsest level, for the furthest zoom out
+#define TILE_MAX_RECORDS 4096             // Tiles remembered, with or without a texture
+#define TILE_MAX_SPAN 64                  // Most tiles in a row or column of the view
+#define TILE_BUILD_LINES 200000           // Lines drawn into new tiles per update, past the first tile
+#define TILE_SCAN_LINES 2048              // New lines tested one by one instead of querying the spatial index
+#define TILE_FALLBACK_LEVELS 4            // Coarser levels searched for a tile to show while one is built
+
+
+//==================== Structure ====================
+typedef struct {  // Tile of one level of the grid
+    int level, tx, ty;        // Level and position in the grid of that level
+    GLuint textureID;         // Texture holding the tile, 0 while no line crosses it
+    int lineCount;            // Number of leading lines the tile is up to date with
+    bool built;               // Whether the tile was rasterized since it was created or reset
+    bool mipmapsStale;        // Whether lines were drawn since the mipmaps were built
+    unsigned int lastUsed;    // Update the tile was last in view
+} Tile;
+
+typedef struct {  // Tile texture drawn over the part of the drawing it covers
+    GLuint textureID;
+    CameraView box;
+} TileQuad;
+
+
+//==================== Global Variables ====================
+static GLuint tileFBO = 0;            // Framebuffer object the tiles are attached to in turn
+static Tile* tiles = NULL;            // Tiles remembered, in no particular order
+static int tileCount = 0;             // Number of tiles remembered
+static int tileCapacity = 0;          // Number of tiles allocated
+static int residentCount = 0;         // Number of tiles holding a texture
+static int budgetTiles = 0;           // Number of textures the budget allows
+static unsigned int updateSerial = 0; // Number of updates so far
+
+static TileQuad* quads = NULL;        // Textures tiles_draw draws, the coarser stand-ins first
+static int quadCount = 0;             // Number of textures to draw
+static int quadCapacity = 0;          // Number of textures allocated
+
+static CameraView shownView;          // View of the last update
+static bool hasShownView = false;     // Whether shownView is set
+static bool pending = false;          // Whether tiles of the last update are still waiting
+static int rewindFloor = INT_MAX;     // Lines from this index onward were extended in place
+static int truncateFloor = INT_MAX;   // Lines from this index onward were freed after an undo
+
+
+//==================== Function Definitions ====================
+static CameraView tile_box(const int level, const int tx, const int ty) {
+/*
+ * tile_box - Returns the part of the drawing a tile covers.
+ */
+
+    const float size = ldexpf((float)TILE_TEXELS, level);
+    return (CameraView){(float)tx * size, (float)ty * size, (float)(tx + 1) * size, (float)(ty + 1) * size};
+}
+
+
+static int floor_div(const int value, const int divisor) {
+/*
+ * floor_div - Divides rounding toward negative infinity, to find the tile holding a tile of a finer level.
+ */
+
+    const int quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+
+static int find_tile(const int level, const int tx, const int ty) {
+/*
+ * find_tile - Returns the index of a tile among those remembered, or -1.
+ */
+
+    for (int i = 0; i < tileCount; i++) {
+        if (tiles[i].tx == tx && tiles[i].ty == ty && tiles[i].level == level) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static void release_texture(Tile* tile) {
+/*
+ * release_texture - Deletes a tile's texture, leaving a record that still has to be rasterized.
+ */
+
+    if (tile->textureID != 0) {
+        glDeleteTextures(1, &tile->textureID);
+        stats_add(STAT_TEXTURES_DELETED, 1);
+        tile->textureID = 0;
+        residentCount--;
+    }
+    tile->built = false;
+    tile->mipmapsStale = false;
+    tile->lineCount = 0;
+}
+
+
+static int least_recent(const bool textured) {
+/*
+ * least_recent - Returns the tile out of view for the longest time, only among those holding a texture when
+ * `textured` is set, or -1 if every such tile is in view.
+ */
+
+    int oldest = -1;
+    for (int i = 0; i < tileCount; i++) {
+        if (tiles[i].lastUsed != updateSerial && (!textured || tiles[i].textureID != 0) &&
+            (oldest < 0 || tiles[i].lastUsed < tiles[oldest].lastUsed)) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+
+static int add_tile(const int level, const int tx, const int ty) {
+/*
+ * add_tile - Remembers a new tile, forgetting the one out of view the longest at TILE_MAX_RECORDS.
+ *
+ * Returns:
+ *    The index of the tile, or -1 when every remembered tile is in view.
+ */
+
+    if (tileCount == TILE_MAX_RECORDS) {
+        const int oldest = least_recent(false);
+        if (oldest < 0) {
+            return -1;
+        }
+        release_texture(&tiles[oldest]);
+        tiles[oldest] = tiles[--tileCount];
+    }
+
+    if (tileCount == tileCapacity) {
+        const int newCapacity = tileCapacity > 0 ? tileCapacity * 2 : 64;
+        Tile* newTiles = realloc(tiles, (size_t)newCapacity * sizeof(Tile));
+        if (!newTiles) {
+            printf("Error reallocating memory for tiles!\n");
+            exit(1);
+        }
+        tiles = newTiles;
+        tileCapacity = newCapacity;
+    }
+
+    tiles[tileCount] = (Tile){level, tx, ty, 0, 0, false, false, updateSerial};
+    return tileCount++;
+}
+
+
+static GLuint create_texture(void) {
+/*
+ * create_texture - Allocates an empty tile texture, with trilinear filtering when mipmaps can be built.
+ */
+
+    GLuint textureID = 0;
+    glGenTextures(1, &textureID);
+    stats_add(STAT_TEXTURES_CREATED, 1);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pglGenerateMipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, TILE_TEXELS, TILE_TEXELS, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return textureID;
+}
+
+
+bool tiles_init(const size_t budgetBytes) {
+/*
+ * tiles_init - Creates the framebuffer object the tiles are rasterized through.
+ *
+ * This function must be called after load_gl_procs, on a context with framebuffer objects.
+ *
+ * Parameters:
+ *    budgetBytes - The memory the tile textures may hold; the tiles in view are kept even past it.
+ *
+ * Returns:
+ *    true if tiles can be rendered to, false otherwise.
+ */
+
+    budgetTiles = (int)(budgetBytes / TILE_BYTES);
+    budgetTiles = budgetTiles > 1 ? budgetTiles : 1;
+
+    // Check once that a tile texture can be rendered to
+    const GLuint probe = create_texture();
+    pglGenFramebuffers(1, &tileFBO);
+    pglBindFramebuffer(GL_FRAMEBUFFER, tileFBO);
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, probe, 0);
+    const GLenum status = pglCheckFramebufferStatus(GL_FRAMEBUFFER);
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteTextures(1, &probe);
+    stats_add(STAT_TEXTURES_DELETED, 1);
+    checkOpenGLError("tiles_init");
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Tile framebuffer incomplete (0x%04x), redrawing lines every frame\n", status);
+        pglDeleteFramebuffers(1, &tileFBO);
+        tileFBO = 0;
+        return false;
+    }
+    return true;
+}
+
+
+bool tiles_active(void) {
+/*
+ * tiles_active - Reports whether lines are rasterized into tiles.
+ */
+
+    return tileFBO != 0;
+}
+
+
+void tiles_clear(void) {
+/*
+ * tiles_clear - Forgets every tile, which are rasterized again as they come into view.
+ */
+
+    for (int i = 0; i < tileCount; i++) {
+        release_texture(&tiles[i]);
+    }
+    tileCount = 0;
+    quadCount = 0;
+    hasShownView = false;
+    rewindFloor = INT_MAX;
+    truncateFloor = INT_MAX;
+}
+
+
+void tiles_rewind(const int firstLine) {
+/*
+ * tiles_rewind - Schedules the lines from `firstLine` onward to be drawn again into the tiles holding them.
+ *
+ * Lines are only ever extended in place, so drawing them again over their previous pixels is enough.
+ */
+
+    rewindFloor = firstLine < rewindFloor ? firstLine : rewindFloor;
+}
+
+
+void tiles_truncate(const int lineCount) {
+/*
+ * tiles_truncate - Schedules the tiles holding lines from `lineCount` onward to be rasterized again.
+ *
+ * This is called once the store freed the lines undone, before new lines take their indices.
+ */
+
+    truncateFloor = lineCount < truncateFloor ? lineCount : truncateFloor;
+}
+
+
+static void apply_floors(void) {
+/*
+ * apply_floors - Applies the rewinds and truncations collected since the last update.
+ */
+
+    if (rewindFloor == INT_MAX && truncateFloor == INT_MAX) {
+        return;
+    }
+    for (int i = 0; i < tileCount; i++) {
+        if (tiles[i].lineCount > truncateFloor) {
+            release_texture(&tiles[i]);
+        } else if (tiles[i].lineCount > rewindFloor) {
+            tiles[i].lineCount = rewindFloor > 0 ? rewindFloor : 0;
+        }
+    }
+    rewindFloor = INT_MAX;
+    truncateFloor = INT_MAX;
+}
+
+
+static bool lines_cross(const int first, const int end, const CameraView box) {
+/*
+ * lines_cross - Reports whether the bounding box of any line in [first, end) overlaps a box.
+ */
+
+    static LineIterator it;
+    line_store_iterate(&it, first, end - first);
+    while (line_store_next_block(&it)) {
+        for (int i = 0; i < it.count; i++) {
+            const Line* line = &it.lines[i];
+            if (fmaxf(line->x1, line->x2) >= box.minX && fminf(line->x1, line->x2) <= box.maxX &&
+                fmaxf(line->y1, line->y2) >= box.minY && fminf(line->y1, line->y2) <= box.maxY) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+static void begin_tile(Tile* tile, const CameraView box, const bool erase) {
+/*
+ * begin_tile - Points the framebuffer object and the projection at a tile, allocating its texture first.
+ *
+ * A new texture is always erased; `erase` also erases one the tile already had.
+ */
+
+    const bool allocate = tile->textureID == 0;
+    if (allocate) {
+        // Make room under the budget, never from the tiles in view
+        while (residentCount >= budgetTiles) {
+            const int oldest = least_recent(true);
+            if (oldest < 0) {
+                break;
+            }
+            release_texture(&tiles[oldest]);
+        }
+        tile->textureID = create_texture();
+        residentCount++;
+    }
+
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tile->textureID, 0);
+    glLoadIdentity();
+    gluOrtho2D(box.minX, box.maxX, box.maxY, box.minY);
+    if (allocate || erase) {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    tile->mipmapsStale = pglGenerateMipmap != NULL;
+}
+
+
+static bool update_tile(const int index, const int lineCount, int* budgetLines) {
+/*
+ * update_tile - Brings a tile in view up to date with the lines stored.
+ *
+ * The framebuffer object must be bound, with the tile's viewport and the projection matrix selected.
+ *
+ * Parameters:
+ *    index       - The tile.
+ *    lineCount   - The number of lines stored.
+ *    budgetLines - The lines new tiles may still draw this update, lowered by what this tile draws.
+ *
+ * Returns:
+ *    true if what the tile shows changed.
+ */
+
+    Tile* tile = &tiles[index];
+    if (tile->lineCount > lineCount) {
+        release_texture(tile);
+    }
+    if (tile->built && tile->lineCount == lineCount) {
+        return false;
+    }
+
+    // Lines are searched for with a margin of their width, which spills over the edge of the tile
+    const CameraView box = tile_box(tile->level, tile->tx, tile->ty);
+    const float texel = ldexpf(1.0f, tile->level);
+    const float margin = (lineWidth / 2.0f + 1.0f) * texel;
+    const CameraView search = {box.minX - margin, box.minY - margin, box.maxX + margin, box.maxY + margin};
+
+    // A few new lines are tested one by one and drawn as a range, clipped to the tile
+    if (tile->built && lineCount - tile->lineCount <= TILE_SCAN_LINES) {
+        const bool crossed = lines_cross(tile->lineCount, lineCount, search);
+        if (crossed) {
+            begin_tile(tile, box, false);
+            draw_line_range(tile->lineCount, lineCount - tile->lineCount);
+        }
+        tile->lineCount = lineCount;
+        return crossed;
+    }
+
+    // Otherwise the spatial index lists the lines inside the tile, and a tile without any gets no texture
+    const int first = tile->built ? tile->lineCount : 0;
+    const int* indices = NULL;
+    const int count = spatial_query_box(search.minX, search.minY, search.maxX, search.maxY, &indices);
+    const bool crossed = count > 0 && indices[count - 1] >= first;
+    if (crossed) {
+        if (*budgetLines <= 0) {
+            pending = true;
+            return false;
+        }
+        *budgetLines -= count;
+        begin_tile(tile, box, !tile->built);
+        draw_box_lines(search.minX, search.minY, search.maxX, search.maxY, 1.0f / texel, first);
+    }
+    const bool shown = crossed || !tile->built;
+    tile->built = true;
+    tile->lineCount = lineCount;
+    return shown;
+}
+
+
+static void add_quad(const Tile* tile) {
+/*
+ * add_quad - Queues a tile's texture for tiles_draw.
+ */
+
+    if (quadCount == quadCapacity) {
+        const int newCapacity = quadCapacity > 0 ? quadCapacity * 2 : 64;
+        TileQuad* newQuads = realloc(quads, (size_t)newCapacity * sizeof(TileQuad));
+        if (!newQuads) {
+            printf("Error reallocating memory for tile quads!\n");
+            exit(1);
+        }
+        quads = newQuads;
+        quadCapacity = newCapacity;
+    }
+    quads[quadCount++] = (TileQuad){tile->textureID, tile_box(tile->level, tile->tx, tile->ty)};
+}
+
+
+static void add_stand_in(const int level, const int tx, const int ty, const int lineCount) {
+/*
+ * add_stand_in - Queues the nearest coarser tile holding a tile still waiting to be rasterized.
+ *
+ * Parameters:
+ *    level, tx, ty - The tile waiting.
+ *    lineCount     - The number of lines stored; a coarser tile showing lines past it is not used.
+ */
+
+    for (int up = 1; up <= TILE_FALLBACK_LEVELS && level + up <= TILE_LEVEL_MAX; up++) {
+        const int index = find_tile(level + up, floor_div(tx, 1 << up), floor_div(ty, 1 << up));
+        if (index < 0 || !tiles[index].built || tiles[index].lineCount > lineCount) {
+            continue;
+        }
+        if (tiles[index].textureID == 0) {
+            return;
+        }
+        tiles[index].lastUsed = updateSerial;
+        for (int i = 0; i < quadCount; i++) {
+            if (quads[i].textureID == tiles[index].textureID) {
+                return;
+            }
+        }
+        add_quad(&tiles[index]);
+        return;
+    }
+}
+
+
+void tiles_update(const int lineCount, const CameraView view, const int windowWidth, const int windowHeight) {
+/*
+ * tiles_update - Rasterizes the tiles in view and the lines they are missing, and queues them for tiles_draw.
+ *
+ * The level is the one whose texels are closest to the window's pixels. The caller's projection and
+ * viewport are restored before returning.
+ *
+ * Parameters:
+ *    lineCount                 - The number of lines stored.
+ *    view                      - The part of the drawing the window shows.
+ *    windowWidth, windowHeight - The size of the window in pixels.
+ */
+
+    if (!tiles_active()) {
+        return;
+    }
+    updateSerial++;
+    pending = false;
+    apply_floors();
+
+    // A camera move changes every pixel of the window
+    if (!hasShownView || !camera_view_equal(view, shownView)) {
+        damage_all();
+    }
+    shownView = view;
+    hasShownView = true;
+
+    // Pick the level, and the tiles of it the view touches
+    const float zoom = (float)windowWidth / (view.maxX - view.minX);
+    int level = (int)lroundf(-log2f(zoom));
+    level = level < TILE_LEVEL_MIN ? TILE_LEVEL_MIN : (level > TILE_LEVEL_MAX ? TILE_LEVEL_MAX : level);
+    const float size = ldexpf((float)TILE_TEXELS, level);
+    const int tx0 = (int)floorf(view.minX / size);
+    const int ty0 = (int)floorf(view.minY / size);
+    const int tx1 = (int)floorf(view.maxX / size) < tx0 + TILE_MAX_SPAN ? (int)floorf(view.maxX / size)
+                                                                         : tx0 + TILE_MAX_SPAN - 1;
+    const int ty1 = (int)floorf(view.maxY / size) < ty0 + TILE_MAX_SPAN ? (int)floorf(view.maxY / size)
+                                                                         : ty0 + TILE_MAX_SPAN - 1;
+
+    // Each tile loads its own projection over the camera's, which is restored afterwards
+    glViewport(0, 0, TILE_TEXELS, TILE_TEXELS);
+    glDisable(GL_TEXTURE_2D);
+    pglBindFramebuffer(GL_FRAMEBUFFER, tileFBO);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+
+    // Rasterize the tiles in view, newest lines first and new tiles up to the budget
+    int budgetLines = TILE_BUILD_LINES;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            int index = find_tile(level, tx, ty);
+            if (index < 0) {
+                index = add_tile(level, tx, ty);
+            }
+            if (index < 0) {
+                pending = true;
+                continue;
+            }
+            tiles[index].lastUsed = updateSerial;
+            if (update_tile(index, lineCount, &budgetLines)) {
+                const CameraView box = tile_box(level, tx, ty);
+                damage_drawing_rect(view, windowWidth, windowHeight, box.minX, box.minY, box.maxX, box.maxY, 0.0f);
+            }
+        }
+    }
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glViewport(0, 0, windowWidth, windowHeight);
+
+    // Rebuild the mipmaps of the tiles drawn into
+    for (int i = 0; i < tileCount; i++) {
+        if (tiles[i].mipmapsStale) {
+            glBindTexture(GL_TEXTURE_2D, tiles[i].textureID);
+            pglGenerateMipmap(GL_TEXTURE_2D);
+            tiles[i].mipmapsStale = false;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Queue the coarser stand-ins of the tiles still waiting, then the tiles themselves over them
+    quadCount = 0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const int index = find_tile(level, tx, ty);
+            if (index < 0 || !tiles[index].built) {
+                add_stand_in(level, tx, ty, lineCount);
+            }
+        }
+    }
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const int index = find_tile(level, tx, ty);
+            if (index >= 0 && tiles[index].built && tiles[index].textureID != 0) {
+                add_quad(&tiles[index]);
+            }
+        }
+    }
+    checkOpenGLError("tiles_update");
+}
+
+
+void tiles_draw(void) {
+/*
+ * tiles_draw - Draws the tiles queued by the last update over the part of the drawing they cover.
+ *
+ * Tile textures are stored bottom-up like any framebuffer, so the top of a tile samples t = 1. The current
+ * projection must be the camera's.
+ */
+
+    static const GLfloat texCoords[] = {
+        0.0f, 0.0f,  // Bottom-left
+        1.0f, 0.0f,  // Bottom-right
+        1.0f, 1.0f,  // Top-right
+        0.0f, 1.0f   // Top-left
+    };
+
+    if (!tiles_active() || quadCount == 0) {
+        return;
+    }
+
+    glEnable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+
+    for (int i = 0; i < quadCount; i++) {
+        const CameraView box = quads[i].box;
+        const GLfloat vertices[] = {
+            box.minX, box.maxY,
+            box.maxX, box.maxY,
+            box.maxX, box.minY,
+            box.minX, box.minY
+        };
+        glBindTexture(GL_TEXTURE_2D, quads[i].textureID);
+        glVertexPointer(2, GL_FLOAT, 0, vertices);
+        glDrawArrays(GL_QUADS, 0, 4);
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    checkOpenGLError("tiles_draw");
+}
+
+
+bool tiles_pending(void) {
+/*
+ * tiles_pending - Reports whether tiles in view were left to rasterize by the last update.
+ */
+
+    return pending;
+}
+
+
+void tiles_shutdown(void) {
+/*
+ * tiles_shutdown - Releases every tile and the framebuffer object.
+ *
+ * This function must be called while the OpenGL context is still current.
+ */
+
+    tiles_clear();
+    free(tiles);
+    free(quads);
+    tiles = NULL;
+    quads = NULL;
+    tileCapacity = 0;
+    quadCapacity = 0;
+    if (tileFBO != 0) {
+        pglDeleteFramebuffers(1, &tileFBO);
+        tileFBO = 0;
+    }
+}
@@ -29,6 +29,9 @@
  * The `checkOpenGLError` function is useful for ensuring that OpenGL operations
  * are completed without issues and provides valuable debugging information when
  * an error occurs.
+ *
+ * Each glGetError call stalls until the driver has processed the commands before it, so release
+ * builds only sample the checks or compile them out, see GL_ERROR_CHECKS in utilities.h.
  */
 
 //==================== Header Files ====================
@@ -38,9 +41,32 @@
 
 
 //==================== Function Definition ====================
-void checkOpenGLError(const char* stmt) {
+void (checkOpenGLError)(const char* stmt) {
     GLenum err = glGetError();
     if (err != GL_NO_ERROR) {
         printf("OpenGL error %08x, at %s\n", err, stmt);
     }
 }
+
+
+void check_opengl_error_sampled(const char* stmt) {
+/*
+ * check_opengl_error_sampled - Checks for OpenGL errors on one call in GL_ERROR_SAMPLE_INTERVAL.
+ *
+ * Only the render thread issues OpenGL calls, so the counter needs no synchronization.
+ *
+ * Parameters:
+ *    stmt - The statement just executed, reported with the error.
+ */
+
+    static int calls = 0;
+    if (++calls < GL_ERROR_SAMPLE_INTERVAL) {
+        return;
+    }
+    calls = 0;
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        printf("OpenGL error %08x, at or before %s\n", err, stmt);
+    }
+}